@@ -53,6 +53,7 @@ Remarks         : -
 //#undef ICK_DEBUG
 
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include <stdbool.h>
 #include <pthread.h>
@@ -61,6 +62,7 @@ Remarks         : -
 #include "ickutils.h"
 #include "audio.h"
 #include "fifo.h"
+#include "metrics.h"
 
 
 /*=========================================================================*\
@@ -75,6 +77,9 @@ Remarks         : -
 typedef struct {
   snd_pcm_t        *pcm;        // PCM output
   snd_mixer_elem_t *mixerElem;  // Volume control
+  bool              mmapAccess; // Write directly to DMA buffer
+  snd_pcm_uframes_t bufferSize; // Size of ring buffer in frames
+  snd_pcm_uframes_t startThres; // Fill level starting the stream (mmap access)
 } AlsaData; 
 
 
@@ -93,6 +98,8 @@ static int    _ifSetVolume( AudioIf *aif, double volume, bool muted );
 static int               _ifSetParameters( AudioIf *aif, AudioFormat *format );
 static snd_pcm_format_t  _getAlsaFormat( const AudioFormat *format );
 static void             *_ifThread( void *arg );
+static snd_pcm_sframes_t _ifWriteMmap( AudioIf *aif, const char *data, snd_pcm_uframes_t frames );
+static int               _ifStartMmap( AudioIf *aif );
 
 
 /*=========================================================================*\
@@ -539,6 +546,7 @@ static int _ifSetParameters( AudioIf *aif, AudioFormat *format )
   AlsaData            *ifData = (AlsaData*)aif->ifData;
   snd_pcm_format_t     alsaFormat;
   snd_pcm_hw_params_t *hwParams;
+  snd_pcm_sw_params_t *swParams;
   unsigned int         realRate;
   int                  rc;
   
@@ -570,12 +578,21 @@ static int _ifSetParameters( AudioIf *aif, AudioFormat *format )
                      format->channels );
     return -1;
   }
-  if( format->channels>1 )
+
+  // Prefer direct access to the DMA buffer, fall back to read/write access
+  ifData->mmapAccess = true;
+  rc = snd_pcm_hw_params_set_access( ifData->pcm, hwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED );
+  if( rc<0 ) {
+    loginfo( "alsa: device \"%s\" does not support mmap access, using read/write access",
+             aif->devName );
+    ifData->mmapAccess = false;
     rc = snd_pcm_hw_params_set_access( ifData->pcm, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED );
+  }
   if( rc<0 ) {
     logerr( "Unable to set alsa pcm hw parameter: SND_PCM_ACCESS_RW_INTERLEAVED" );
     return -1;
   }
+  DBGMSG( "Alsa: using %s access", ifData->mmapAccess?"mmap":"read/write" );
 
   // Set data format and calculate frame size (sample size*channels)
   rc = snd_pcm_hw_params_set_format( ifData->pcm, hwParams, alsaFormat );
@@ -624,6 +641,26 @@ static int _ifSetParameters( AudioIf *aif, AudioFormat *format )
 \*------------------------------------------------------------------------*/  
   // buffer size 
   // fixme: snd_pcm_sw_params_set_avail_min(pcm_handle, sw_params, period_size);
+
+  // Start threshold: writei starts the stream implicitly, with mmap access
+  // this is done by the thread once the ring buffer is filled
+  snd_pcm_sw_params_alloca( &swParams );
+  rc = snd_pcm_hw_params_get_buffer_size( hwParams, &ifData->bufferSize );
+  if( rc>=0 )
+    rc = snd_pcm_sw_params_current( ifData->pcm, swParams );
+  if( rc>=0 && ifData->mmapAccess ) {
+    rc = snd_pcm_sw_params_set_start_threshold( ifData->pcm, swParams, ifData->bufferSize );
+    if( rc>=0 )
+      rc = snd_pcm_sw_params( ifData->pcm, swParams );
+  }
+  if( rc>=0 )
+    rc = snd_pcm_sw_params_get_start_threshold( swParams, &ifData->startThres );
+  if( rc<0 ) {
+    logerr( "Unable to set alsa pcm sw parameters: %s", snd_strerror(rc) );
+    return -1;
+  }
+  DBGMSG( "Alsa: buffer size %lu frames, start threshold %lu frames",
+          (unsigned long)ifData->bufferSize, (unsigned long)ifData->startThres );
   
 /*------------------------------------------------------------------------*\
     Prepare interface 
@@ -715,12 +752,16 @@ static void *_ifThread( void *arg )
     
     // Wait (max 500ms) till data is actually needed
     //0: timedout  1: ready  <0: xrun, suspend or error  
+    TRACEBEGIN( "waitDevice" );
     rc =  snd_pcm_wait( ifData->pcm, 500 );
+    TRACEEND( "waitDevice" );
     if( !rc ) {
       DBGMSG( "Alsa thread: timeout while waiting for free buffer size." );
       continue;
     }
     if( rc==-EPIPE || rc==-ESTRPIPE ) {
+      TRACEINSTANT( "underrun" );
+      metricsAdd( MetricAudioXruns, aif->backend->name, 1 );
       rc = snd_pcm_recover( ifData->pcm, rc, 0 ); 
       if( rc ) {
         logerr( "Alsa thread (after wait): Unable to recover alsa interface: %s", strerror(rc) );
@@ -735,7 +776,9 @@ static void *_ifThread( void *arg )
     } 
     
     // Wait for data in fifo
+    TRACEBEGIN( "waitFifo" );
     rc = fifoLockWaitReadable( aif->fifoIn, 500 );
+    TRACEEND( "waitFifo" );
     if( rc==ETIMEDOUT ) {
       DBGMSG( "Alsa thread: timeout while waiting for fifo data." );
   	  continue;
@@ -751,10 +794,19 @@ static void *_ifThread( void *arg )
     snd_pcm_sframes_t frames_readable = fifoGetSize( aif->fifoIn, FifoNextReadable )/aif->framesize;
     snd_pcm_sframes_t frames = MIN( frames_writable, frames_readable );
 
-    // Do transfer the data
+    // Do transfer the data (an xrun might already be reported by avail_update)
     DBGMSG( "Alsa thread: writing %ld frames", (long)frames );
-    rc = snd_pcm_writei( ifData->pcm, fifoGetReadPtr(aif->fifoIn), frames );
+    TRACEBEGIN( "write" );
+    if( frames_writable<0 )
+      rc = frames_writable;
+    else if( ifData->mmapAccess )
+      rc = _ifWriteMmap( aif, fifoGetReadPtr(aif->fifoIn), frames );
+    else
+      rc = snd_pcm_writei( ifData->pcm, fifoGetReadPtr(aif->fifoIn), frames );
+    TRACEEND( "write" );
     if( rc==-EPIPE || rc==-ESTRPIPE ){
+      TRACEINSTANT( "underrun" );
+      metricsAdd( MetricAudioXruns, aif->backend->name, 1 );
       rc = snd_pcm_recover( ifData->pcm, rc, 0 ); 
       if( rc ) {
         logerr( "Alsa thread (after write): Unable to recover alsa interface: %s", strerror(rc) );
@@ -767,7 +819,27 @@ static void *_ifThread( void *arg )
     } 
 
     // Check out accepted data from fifo
-    fifoUnlockAfterRead( aif->fifoIn, rc*aif->framesize ); 
+    fifoUnlockAfterRead( aif->fifoIn, rc>0?rc*aif->framesize:0 ); 
+
+    // With mmap access the stream is started separately: frames committed
+    // to the device are checked out of the fifo even if this fails. This is
+    // also retried without new frames, the buffer might be full already.
+    if( ifData->mmapAccess && rc>=0 && aif->state==AudioIfRunning ) {
+      rc = _ifStartMmap( aif );
+      if( rc==-EPIPE || rc==-ESTRPIPE ) {
+        TRACEINSTANT( "underrun" );
+        metricsAdd( MetricAudioXruns, aif->backend->name, 1 );
+        rc = snd_pcm_recover( ifData->pcm, rc, 0 );
+        if( rc ) {
+          logerr( "Alsa thread (after start): Unable to recover alsa interface: %s", snd_strerror(rc) );
+          aif->state = AudioIfTerminatedError;
+        }
+      }
+      else if( rc<0 ) {
+        logerr( "Alsa thread: Unable to start alsa interface: %s", snd_strerror(rc) );
+        aif->state = AudioIfTerminatedError;
+      }
+    }
   	
   }  // End of: Thread main loop
    
@@ -785,6 +857,85 @@ static void *_ifThread( void *arg )
 }
 
 
+/*=========================================================================*\
+       Copy frames from fifo directly to the DMA buffer of the device
+         returns the number of frames written or a negative error code
+\*=========================================================================*/
+static snd_pcm_sframes_t _ifWriteMmap( AudioIf *aif, const char *data, snd_pcm_uframes_t frames )
+{
+  AlsaData                     *ifData  = (AlsaData*)aif->ifData;
+  const snd_pcm_channel_area_t *areas;
+  snd_pcm_uframes_t             offset;
+  snd_pcm_uframes_t             chunk;
+  snd_pcm_uframes_t             written = 0;
+  snd_pcm_sframes_t             committed;
+  int                           rc;
+
+/*------------------------------------------------------------------------*\
+    The ring buffer might wrap, so this could take more than one chunk
+\*------------------------------------------------------------------------*/
+  while( written<frames ) {
+    chunk = frames - written;
+    rc = snd_pcm_mmap_begin( ifData->pcm, &areas, &offset, &chunk );
+    if( rc<0 )
+      return written ? (snd_pcm_sframes_t)written : rc;
+    if( !chunk )
+      break;
+
+    // Interleaved: all channels share the first area
+    char *dest = (char*)areas[0].addr + (areas[0].first+offset*areas[0].step)/8;
+    memcpy( dest, data+written*aif->framesize, chunk*aif->framesize );
+
+    committed = snd_pcm_mmap_commit( ifData->pcm, offset, chunk );
+    if( committed<0 )
+      return written ? (snd_pcm_sframes_t)written : committed;
+    written += committed;
+    if( (snd_pcm_uframes_t)committed!=chunk )
+      break;
+  }
+
+/*------------------------------------------------------------------------*\
+    That's it ...
+\*------------------------------------------------------------------------*/
+  return written;
+}
+
+
+/*=========================================================================*\
+       Start a prepared stream with mmap access
+         other than writei, commit does not start the stream, so this is
+         done as soon as the fill level reaches the start threshold
+         returns 0 or a negative error code
+\*=========================================================================*/
+static int _ifStartMmap( AudioIf *aif )
+{
+  AlsaData          *ifData = (AlsaData*)aif->ifData;
+  snd_pcm_sframes_t  avail;
+
+/*------------------------------------------------------------------------*\
+    Nothing to do if already running (or paused, draining, ...)
+\*------------------------------------------------------------------------*/
+  if( snd_pcm_state(ifData->pcm)!=SND_PCM_STATE_PREPARED )
+    return 0;
+
+/*------------------------------------------------------------------------*\
+    Wait for more data if buffer is not yet filled up to the threshold
+\*------------------------------------------------------------------------*/
+  avail = snd_pcm_avail_update( ifData->pcm );
+  if( avail<0 )
+    return avail;
+  if( (snd_pcm_sframes_t)ifData->bufferSize-avail<(snd_pcm_sframes_t)ifData->startThres )
+    return 0;
+
+/*------------------------------------------------------------------------*\
+    Start stream
+\*------------------------------------------------------------------------*/
+  DBGMSG( "Alsa: starting stream with %ld frames buffered",
+          (long)ifData->bufferSize-avail );
+  return snd_pcm_start( ifData->pcm );
+}
+
+
 /*=========================================================================*\
                                     END OF FILE
 \*=========================================================================*/
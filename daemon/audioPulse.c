@@ -174,7 +174,7 @@ static int _backendInit( void )
     pa_threaded_mainloop_free( pulseMainLoop );
     return -1;
   }
-  pulseContext = pa_context_new( api, playerGetName() );
+  pulseContext = pa_context_new( api, playerGetName(playerGetZone(0)) );
   if( !pulseContext ) {
     logerr( "Pulse Audio: Can not create context" );
     pa_threaded_mainloop_free( pulseMainLoop );
@@ -547,7 +547,7 @@ static int _ifPlay( AudioIf *aif, AudioFormat *format )
     Try to create stream client side
 \*------------------------------------------------------------------------*/
   pa_threaded_mainloop_lock( pulseMainLoop );
-  ifData->stream = pa_stream_new( pulseContext, playerGetName(), &sampleSpec, &chanMap );
+  ifData->stream = pa_stream_new( pulseContext, playerGetName(playerGetZone(0)), &sampleSpec, &chanMap );
   if( !ifData->stream ) {
     logerr( "Pulse Audio (%p): Could not create stream (%s): %s",
             aif, audioFormatStr(NULL,format),
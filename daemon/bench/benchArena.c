@@ -0,0 +1,236 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : benchArena.c
+
+Description     : micro benchmark for the JSON arena of incoming messages
+
+Comments        : Parses a setTracks command and a getServiceInformation
+                  response with and without arena and reports the
+                  allocations and time per message. Only parsing uses the
+                  arena, allocations of the handlers are not covered.
+                  Build with "make bench", the binary is not installed.
+
+Called by       : -
+
+Calls           : jsonArena, benchStubs
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <jansson.h>
+
+#include "ickutils.h"
+#include "metrics.h"
+#include "jsonArena.h"
+#include "benchStubs.h"
+
+
+/*=========================================================================*\
+  Private definitions and symbols
+\*=========================================================================*/
+#define BenchDefaultRounds 20000
+#define BenchTracks        50
+
+
+/*=========================================================================*\
+  Private prototypes
+\*=========================================================================*/
+static char *_benchSetTracks( int count );
+static char *_benchServiceInfo( void );
+static void  _benchRun( const char *name, const char *message, int rounds, bool arena, bool promote );
+
+
+/*=========================================================================*\
+  Main: parse messages with and without arena
+    argv[1] optional number of rounds
+\*=========================================================================*/
+int main( int argc, char *argv[] )
+{
+  int   rounds = BenchDefaultRounds;
+  char *setTracks;
+  char *serviceInfo;
+
+  if( argc>1 )
+    rounds = atoi( argv[1] );
+  if( rounds<=0 ) {
+    fprintf( stderr, "usage: %s [rounds]\n", argv[0] );
+    return 1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Init arena allocator, this installs the counting hooks
+\*------------------------------------------------------------------------*/
+  if( jsonArenaInit() ) {
+    fprintf( stderr, "Could not init JSON arena.\n" );
+    return 1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Create sample messages
+\*------------------------------------------------------------------------*/
+  setTracks   = _benchSetTracks( BenchTracks );
+  serviceInfo = _benchServiceInfo();
+  if( !setTracks || !serviceInfo ) {
+    fprintf( stderr, "Could not create messages.\n" );
+    return 1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Before (heap) and after (arena) for a command and a response
+\*------------------------------------------------------------------------*/
+  printf( "%-28s %12s %12s %12s %10s\n", "message/mode", "heap/msg",
+          "arena/msg", "promote/msg", "us/msg" );
+  _benchRun( "setTracks heap",          setTracks,   rounds, false, false );
+  _benchRun( "setTracks arena",         setTracks,   rounds, true,  false );
+  _benchRun( "serviceInfo heap",        serviceInfo, rounds, false, false );
+  _benchRun( "serviceInfo arena",       serviceInfo, rounds, true,  false );
+  _benchRun( "serviceInfo arena+promote", serviceInfo, rounds, true, true );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  free( setTracks );
+  free( serviceInfo );
+  return 0;
+}
+
+
+/*=========================================================================*\
+  Parse message repeatedly and report allocations and time per message
+    promote: copy the tree to the heap before releasing the arena,
+             as done for responses handed to callbacks
+\*=========================================================================*/
+static void _benchRun( const char *name, const char *message, int rounds, bool arena, bool promote )
+{
+  size_t       len = strlen( message );
+  double       heap0, arena0, promo0, t0, t;
+  json_error_t error;
+  int          i;
+
+  benchCollect();
+  heap0  = benchMetric( MetricJsonAllocations, "heap" );
+  arena0 = benchMetric( MetricJsonAllocations, "arena" );
+  promo0 = benchMetric( MetricJsonAllocations, "promoted" );
+  t0     = srvtime();
+
+  for( i=0; i<rounds; i++ ) {
+    JsonArena *jArena = arena ? jsonArenaNew() : NULL;
+    json_t    *jRoot;
+
+    jsonArenaActivate( jArena );
+    jRoot = json_loadb( message, len, 0, &error );
+    jsonArenaActivate( NULL );
+    if( !jRoot ) {
+      fprintf( stderr, "%s: parse error line %d: %s\n", name, error.line, error.text );
+      jsonArenaRelease( jArena );
+      return;
+    }
+    if( promote )
+      json_decref( jsonArenaPromote(jRoot) );
+    json_decref( jRoot );
+    jsonArenaRelease( jArena );
+  }
+
+  t = srvtime() - t0;
+  benchCollect();
+  printf( "%-28s %12.1f %12.1f %12.2f %10.2f\n", name,
+          (benchMetric(MetricJsonAllocations,"heap")-heap0)/rounds,
+          (benchMetric(MetricJsonAllocations,"arena")-arena0)/rounds,
+          (benchMetric(MetricJsonAllocations,"promoted")-promo0)/rounds,
+          t*1e6/rounds );
+}
+
+
+/*=========================================================================*\
+  Create a setTracks command with some items
+\*=========================================================================*/
+static char *_benchSetTracks( int count )
+{
+  json_t *jItems = json_array();
+  json_t *jMsg;
+  char   *str;
+  char    id[64];
+  int     i;
+
+  for( i=0; i<count; i++ ) {
+    sprintf( id, "content:track/%08d", i );
+    json_array_append_new( jItems, json_pack( "{ss ss ss ss s[{ss ss ss si si si}] s{ss ss si}}",
+       "id", id, "text", "Some track title", "type", "track",
+       "image", "http://example.com/image/cover.jpg",
+       "streamingRefs",
+         "format", "audio/mpeg", "url", "service://example/track.mp3",
+         "intermediate", "false", "sampleSize", 16, "channels", 2, "sampleRate", 44100,
+       "itemAttributes",
+         "album", "Some album", "artist", "Some artist", "duration", 240 ) );
+  }
+  jMsg = json_pack( "{ss si ss s{si so}}", "jsonrpc", "2.0", "id", 1, "method", "setTracks",
+                    "params", "playbackQueuePos", 0, "items", jItems );
+  str = json_dumps( jMsg, JSON_COMPACT );
+  json_decref( jMsg );
+  return str;
+}
+
+
+/*=========================================================================*\
+  Create a getServiceInformation response
+\*=========================================================================*/
+static char *_benchServiceInfo( void )
+{
+  json_t *jMsg;
+  char   *str;
+
+  jMsg = json_pack( "{ss si s{ss ss ss ss ss}}", "jsonrpc", "2.0", "id", 42,
+                    "result", "id", "a1b2c3d4-0000-4000-8000-00000000cafe",
+                    "name", "Some server", "type", "content",
+                    "url", "http://192.168.0.2:8080",
+                    "serviceUrl", "http://192.168.0.2:8080/service" );
+  str = json_dumps( jMsg, JSON_COMPACT );
+  json_decref( jMsg );
+  return str;
+}
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
@@ -0,0 +1,365 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : benchNotify.c
+
+Description     : replay of a control session counting status broadcasts
+
+Comments        : Replays the notification calls of a scripted control session
+                  (setTracks, play, volume slide, addTracks, pause/play, setTrack)
+                  with the timing of the daemon and counts the broadcasts sent
+                  for a given debounce window. Peers and player are stubbed.
+                  Build with "make bench", the binary is not installed.
+
+Called by       : -
+
+Calls           : ickMessage, playlist, jsonArena, benchStubs
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <jansson.h>
+#include <ickP2p.h>
+
+#include "ickutils.h"
+#include "playlist.h"
+#include "player.h"
+#include "hmi.h"
+#include "ickCloud.h"
+#include "ickMessage.h"
+
+
+/*=========================================================================*\
+  Private definitions and symbols
+\*=========================================================================*/
+#define BenchMs(ms)   usleep( (ms)*1000 )
+
+static Playlist *queue;
+static long      broadcasts;
+static long      messages;
+
+// Single zone, never dereferenced by ickMessage
+static char      zoneDummy;
+#define BenchZone    ((Player*)&zoneDummy)
+
+
+/*=========================================================================*\
+  Private prototypes
+\*=========================================================================*/
+static void _benchSession( void );
+
+
+/*=========================================================================*\
+  Main: replay session with a debounce window
+    argv[1] optional window in seconds (0 disables coalescing)
+\*=========================================================================*/
+int main( int argc, char *argv[] )
+{
+  double delay = 0.1;
+
+  if( argc>1 )
+    delay = atof( argv[1] );
+  if( delay<0 ) {
+    fprintf( stderr, "usage: %s [delay]\n", argv[0] );
+    return 1;
+  }
+  logSetStreamLevel( LOG_ERR );
+
+  queue = playlistNew();
+  if( !queue ) {
+    fprintf( stderr, "Could not create queue.\n" );
+    return 1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Replay session, shutdown sends what's left
+\*------------------------------------------------------------------------*/
+  ickMessageSetNotificationDelay( delay );
+  _benchSession();
+  ickMessageShutdown();
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  printf( "window %.2fs: %ld broadcasts (%ld messages)\n", delay, broadcasts, messages );
+  return 0;
+}
+
+
+/*=========================================================================*\
+  The scripted session
+    Same call pattern as the daemon: RPC handlers notify at the end of the
+    request, playerSetState flushes, the playback thread notifies on item
+    start and for meta data (ICY header and codec updates).
+\*=========================================================================*/
+static void _benchSession( void )
+{
+  int i;
+
+/*------------------------------------------------------------------------*\
+    setTracks
+\*------------------------------------------------------------------------*/
+  ickMessageNotifyPlaylist( BenchZone, NULL );
+  ickMessageNotifyPlayerState( BenchZone, NULL );
+  BenchMs( 300 );
+
+/*------------------------------------------------------------------------*\
+    play: state change, item start, ICY header and three meta updates
+\*------------------------------------------------------------------------*/
+  ickMessageNotifyPlayerState( BenchZone, NULL );
+  ickMessageFlushNotifications();
+  BenchMs( 5 );
+  ickMessageNotifyPlayerState( BenchZone, NULL );
+  BenchMs( 20 );
+  ickMessageNotifyPlayerState( BenchZone, NULL );
+  for( i=0; i<3; i++ ) {
+    BenchMs( 10 );
+    ickMessageNotifyPlayerState( BenchZone, NULL );
+  }
+  BenchMs( 500 );
+
+/*------------------------------------------------------------------------*\
+    Volume slider: 10 setVolume requests within 400ms
+\*------------------------------------------------------------------------*/
+  for( i=0; i<10; i++ ) {
+    ickMessageNotifyPlayerState( BenchZone, NULL );
+    BenchMs( 40 );
+  }
+  BenchMs( 300 );
+
+/*------------------------------------------------------------------------*\
+    Three addTracks in quick succession
+\*------------------------------------------------------------------------*/
+  for( i=0; i<3; i++ ) {
+    ickMessageNotifyPlaylist( BenchZone, NULL );
+    ickMessageNotifyPlayerState( BenchZone, NULL );
+    BenchMs( 15 );
+  }
+  BenchMs( 300 );
+
+/*------------------------------------------------------------------------*\
+    pause and play
+\*------------------------------------------------------------------------*/
+  for( i=0; i<2; i++ ) {
+    ickMessageNotifyPlayerState( BenchZone, NULL );
+    ickMessageFlushNotifications();
+    BenchMs( 200 );
+  }
+
+/*------------------------------------------------------------------------*\
+    setTrack: state change, new item and meta data
+\*------------------------------------------------------------------------*/
+  ickMessageNotifyPlayerState( BenchZone, NULL );
+  ickMessageFlushNotifications();
+  BenchMs( 5 );
+  ickMessageNotifyPlayerState( BenchZone, NULL );
+  BenchMs( 10 );
+  ickMessageNotifyPlayerState( BenchZone, NULL );
+  BenchMs( 300 );
+}
+
+
+/*=========================================================================*\
+  Stubs for peers: count broadcasts
+\*=========================================================================*/
+ickErrcode_t ickP2pSendMsg( ickP2pContext_t *ictx, const char *szDeviceId, ickP2pServicetype_t targetServices, ickP2pServicetype_t sourceService, const char *message, size_t mSize )
+{
+  if( !szDeviceId )
+    broadcasts++;
+  messages++;
+  return ICKERR_SUCCESS;
+}
+
+ickP2pServicetype_t ickP2pGetServices( ickP2pContext_t *ictx )
+{
+  return ICKP2P_SERVICE_PLAYER;
+}
+
+
+/*=========================================================================*\
+  Stubs for player (one zone, stopped)
+\*=========================================================================*/
+int playerGetZoneCount( void )
+{
+  return 1;
+}
+
+Player *playerGetZone( int index )
+{
+  return index ? NULL : BenchZone;
+}
+
+Player *playerGetZoneByContext( const ickP2pContext_t *ictx )
+{
+  return BenchZone;
+}
+
+int playerGetZoneIndex( const Player *zone )
+{
+  return 0;
+}
+
+ickP2pContext_t *playerGetContext( const Player *zone )
+{
+  return (ickP2pContext_t*)&zoneDummy;
+}
+
+Playlist *playerGetQueue( Player *zone )
+{
+  return queue;
+}
+
+PlayerState playerGetState( Player *zone )
+{
+  return PlayerStateStop;
+}
+
+PlayerPlaybackMode playerGetPlaybackMode( Player *zone )
+{
+  return PlaybackQueue;
+}
+
+double playerGetLastChange( Player *zone )
+{
+  return 0;
+}
+
+const char *playerGetHWID( void )
+{
+  return NULL;
+}
+
+const char *playerGetName( Player *zone )
+{
+  return "Bench";
+}
+
+const char *playerGetModel( void )
+{
+  return "Bench";
+}
+
+double playerGetVolume( Player *zone )
+{
+  return 0.5;
+}
+
+bool playerGetMuting( Player *zone )
+{
+  return false;
+}
+
+double playerGetSeekPos( Player *zone )
+{
+  return 0;
+}
+
+const char *playerPlaybackModeToStr( PlayerPlaybackMode mode )
+{
+  return "QUEUE";
+}
+
+PlayerPlaybackMode playerPlaybackModeFromStr( const char *str )
+{
+  return PlaybackQueue;
+}
+
+const char *playerStateToStr( PlayerState state )
+{
+  return "STOP";
+}
+
+void playerSetName( Player *zone, const char *name, bool broadcast )
+{
+}
+
+double playerSetVolume( Player *zone, double volume, bool muted, bool broadcast )
+{
+  return volume;
+}
+
+int playerSetPlaybackMode( Player *zone, PlayerPlaybackMode state, bool broadcast )
+{
+  return 0;
+}
+
+int playerSetState( Player *zone, PlayerState state, bool broadcast )
+{
+  return 0;
+}
+
+
+/*=========================================================================*\
+  Stubs for cloud and hmi
+\*=========================================================================*/
+const char *ickCloudGetAccessToken( void )
+{
+  return NULL;
+}
+
+const char *ickCloudGetCoreUrl( void )
+{
+  return NULL;
+}
+
+int ickCloudSetCoreUrl( const char *url )
+{
+  return 0;
+}
+
+int ickCloudRegisterDevice( const char *token )
+{
+  return 0;
+}
+
+#ifndef ICK_NOHMI
+void hmiNewQueue( Playlist *plst )
+{
+}
+#endif
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
@@ -0,0 +1,197 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : benchPlaylist.c
+
+Description     : micro benchmark for the mapping of hybrid playlist views
+
+Comments        : Builds shuffled playlists of 1k to 100k items and reports the
+                  time for the hybrid mapping (position tags versus one index
+                  query per item) and for the item lists of a snapshot.
+                  Build with "make bench", the binary is not installed.
+
+Called by       : -
+
+Calls           : playlist, jsonArena, benchStubs
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <jansson.h>
+
+#include "ickutils.h"
+#include "playlist.h"
+
+
+/*=========================================================================*\
+  Private definitions and symbols
+\*=========================================================================*/
+#define BenchDefaultMaxItems 100000
+#define BenchItemsPerSize    1000000     // Rounds are scaled to this
+#define BenchChunks          8           // Small ranges use the index
+
+
+/*=========================================================================*\
+  Private prototypes
+\*=========================================================================*/
+static Playlist *_benchPlaylist( int n );
+static void      _benchRun( int n );
+
+
+/*=========================================================================*\
+  Main: run benchmark for 1k, 10k, ... items
+    argv[1] optional maximum number of items
+\*=========================================================================*/
+int main( int argc, char *argv[] )
+{
+  int maxItems = BenchDefaultMaxItems;
+  int n;
+
+  if( argc>1 )
+    maxItems = atoi( argv[1] );
+  if( maxItems<1000 ) {
+    fprintf( stderr, "usage: %s [maxItems>=1000]\n", argv[0] );
+    return 1;
+  }
+  logSetStreamLevel( LOG_ERR );
+
+/*------------------------------------------------------------------------*\
+    The plain original view is the baseline, the difference to the hybrid
+    views is the cost of the mapping.
+\*------------------------------------------------------------------------*/
+  printf( "%8s %12s %12s %12s %12s\n", "items", "original/ms",
+          "tags/ms", "index/ms", "snapshot/ms" );
+  for( n=1000; n<=maxItems; n*=10 )
+    _benchRun( n );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return 0;
+}
+
+
+/*=========================================================================*\
+  Measure views of a shuffled playlist with n items
+    tags:     hybrid view in one call, mapped positions are tagged in one
+              pass over the mapped list
+    index:    hybrid view in small chunks, one index query per item
+    snapshot: building the item lists of a snapshot after each shuffle
+              (done by the writer when it unlocks the playlist)
+  Playlists are not deleted, they are freed on exit.
+\*=========================================================================*/
+static void _benchRun( int n )
+{
+  Playlist *plst;
+  int       rounds = BenchItemsPerSize/n;
+  int       chunk  = n/BenchChunks;
+  double    tOriginal = 0, tTags = 0, tIndex = 0, tSnapshot = 0, t;
+  int       r, i;
+
+  plst = _benchPlaylist( n );
+  if( !plst ) {
+    fprintf( stderr, "Could not create playlist with %d items.\n", n );
+    return;
+  }
+
+  for( r=0; r<rounds; r++ ) {
+    PlaylistSnapshot *snapshot;
+
+    playlistShuffle( plst, 0, n-1, false );
+
+    t = srvtime();
+    snapshot = playlistGetSnapshot( plst );
+    tSnapshot += srvtime() - t;
+    playlistSnapshotRelease( snapshot );
+
+    t = srvtime();
+    json_decref( playlistGetJSON(plst,PlaylistOriginal,0,n) );
+    tOriginal += srvtime() - t;
+
+    t = srvtime();
+    json_decref( playlistGetJSON(plst,PlaylistHybrid,0,n) );
+    tTags += srvtime() - t;
+
+    t = srvtime();
+    for( i=0; i<n; i+=chunk )
+      json_decref( playlistGetJSON(plst,PlaylistHybrid,i,chunk) );
+    tIndex += srvtime() - t;
+  }
+
+  printf( "%8d %12.3f %12.3f %12.3f %12.3f\n", n, tOriginal*1000/rounds,
+          (tTags-tOriginal)*1000/rounds, (tIndex-tOriginal)*1000/rounds,
+          tSnapshot*1000/rounds );
+  fflush( stdout );
+}
+
+
+/*=========================================================================*\
+  Create a playlist with n minimal track items
+\*=========================================================================*/
+static Playlist *_benchPlaylist( int n )
+{
+  Playlist *plst = playlistNew();
+  json_t   *jItems = json_array();
+  char      id[64];
+  int       i;
+
+  if( !plst )
+    return NULL;
+  for( i=0; i<n; i++ ) {
+    sprintf( id, "content:track/%08d", i );
+    json_array_append_new( jItems, json_pack("{ss ss ss}", "id", id,
+                                   "text", "Some track title", "type", "track") );
+  }
+  if( playlistAddItems(plst,-1,-1,jItems,false) ) {
+    json_decref( jItems );
+    playlistDelete( plst );
+    return NULL;
+  }
+  json_decref( jItems );
+  return plst;
+}
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
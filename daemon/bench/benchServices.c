@@ -0,0 +1,232 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : benchServices.c
+
+Description     : micro benchmark for the service registry
+
+Comments        : Registers a few hundred device and cloud services and reports
+                  the time for lookups by id, iterations by type and the
+                  resolution of service URIs (cached and uncached).
+                  Build with "make bench", the binary is not installed.
+
+Called by       : -
+
+Calls           : ickService, jsonArena, benchStubs
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <jansson.h>
+
+#include "ickutils.h"
+#include "ickCloud.h"
+#include "ickService.h"
+
+
+/*=========================================================================*\
+  Private definitions and symbols
+\*=========================================================================*/
+#define BenchDefaultServices 400
+#define BenchRounds          200000
+#define BenchUris            64         // Working set of resolved URIs
+
+static const char *serviceTypes[] = { "content", "radio", "friends", "search", "player" };
+#define BenchTypes           (sizeof(serviceTypes)/sizeof(*serviceTypes))
+
+
+/*=========================================================================*\
+  Private prototypes
+\*=========================================================================*/
+static int  _benchAddServices( int count );
+static void _benchPrint( const char *name, double t, int rounds );
+
+
+/*=========================================================================*\
+  Stubs for cloud access
+\*=========================================================================*/
+const char *ickCloudGetAccessToken( void )
+{
+  return NULL;
+}
+
+json_t *ickCloudRequestSync( const char *uri, const char *oAuthToken, const char *method, json_t *jParams, int *httpCode )
+{
+  return NULL;
+}
+
+
+/*=========================================================================*\
+  Main: register services and measure lookups
+    argv[1] optional number of services (half device, half cloud)
+\*=========================================================================*/
+int main( int argc, char *argv[] )
+{
+  int              count = BenchDefaultServices;
+  ServiceListItem *service;
+  char             id[64], uri[128];
+  double           t;
+  long             hits = 0;
+  int              i;
+
+  if( argc>1 )
+    count = atoi( argv[1] );
+  if( count<2 ) {
+    fprintf( stderr, "usage: %s [services>=2]\n", argv[0] );
+    return 1;
+  }
+  logSetStreamLevel( LOG_ERR );
+
+/*------------------------------------------------------------------------*\
+    Register services
+\*------------------------------------------------------------------------*/
+  if( _benchAddServices(count) ) {
+    fprintf( stderr, "Could not register services.\n" );
+    return 1;
+  }
+  printf( "%d services, %d types\n", count, (int)BenchTypes );
+  printf( "%-28s %10s\n", "operation", "us/op" );
+
+/*------------------------------------------------------------------------*\
+    Find by id (as for items and streaming refs), the last one is a miss
+\*------------------------------------------------------------------------*/
+  t = srvtime();
+  for( i=0; i<BenchRounds; i++ ) {
+    sprintf( id, "%08x-0000-4000-8000-%012x", i%(count+1), i%(count+1) );
+    if( ickServiceFind(NULL,id,NULL,0) )
+      hits++;
+  }
+  _benchPrint( "find by id", srvtime()-t, BenchRounds );
+
+/*------------------------------------------------------------------------*\
+    Iterate all services of a type
+\*------------------------------------------------------------------------*/
+  t = srvtime();
+  for( i=0; i<BenchRounds/100; i++ ) {
+    const char *type = serviceTypes[ i%BenchTypes ];
+    for( service=ickServiceFind(NULL,NULL,type,0); service;
+         service=ickServiceFind(service,NULL,type,0) )
+      hits++;
+  }
+  _benchPrint( "iterate by type", srvtime()-t, BenchRounds/100 );
+
+/*------------------------------------------------------------------------*\
+    Resolve a working set of URIs (as on every track start)
+\*------------------------------------------------------------------------*/
+  t = srvtime();
+  for( i=0; i<BenchRounds; i++ ) {
+    char *url;
+    int   n = i%BenchUris;
+    sprintf( uri, "%s%08x-0000-4000-8000-%012x/track/%d", IckServiceSchemePrefix,
+             n%count, n%count, n );
+    url = ickServiceResolveURI( uri, serviceTypes[(n%count)%BenchTypes] );
+    if( url )
+      hits++;
+    Sfree( url );
+  }
+  _benchPrint( "resolve URI (working set)", srvtime()-t, BenchRounds );
+
+/*------------------------------------------------------------------------*\
+    Resolve distinct URIs, every call is a cache miss
+\*------------------------------------------------------------------------*/
+  t = srvtime();
+  for( i=0; i<BenchRounds; i++ ) {
+    char *url;
+    sprintf( uri, "%s%08x-0000-4000-8000-%012x/track/%d", IckServiceSchemePrefix,
+             i%count, i%count, i );
+    url = ickServiceResolveURI( uri, NULL );
+    if( url )
+      hits++;
+    Sfree( url );
+  }
+  _benchPrint( "resolve URI (distinct)", srvtime()-t, BenchRounds );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  if( !hits )
+    fprintf( stderr, "No service found.\n" );
+  return 0;
+}
+
+
+/*=========================================================================*\
+  Register count services, half of them from devices and from the cloud
+\*=========================================================================*/
+static int _benchAddServices( int count )
+{
+  char id[64], name[64], url[128];
+  int  i;
+
+  for( i=0; i<count; i++ ) {
+    const char    *type   = serviceTypes[ i%BenchTypes ];
+    ServiceOrigin  origin = i%2 ? ServiceCloud : ServiceDevice;
+    json_t        *jService;
+    int            rc;
+
+    sprintf( id, "%08x-0000-4000-8000-%012x", i, i );
+    sprintf( name, "Service %d", i );
+    sprintf( url, "http://192.168.%d.%d:8080/service", i/250, i%250+1 );
+    jService = json_pack( "{ss ss ss ss ss}", "id", id, "name", name, "type", type,
+                          "url", url, "serviceUrl", url );
+    rc = ickServiceAdd( jService, origin );
+    json_decref( jService );
+    if( rc )
+      return -1;
+  }
+  return 0;
+}
+
+
+/*=========================================================================*\
+  Print result line
+\*=========================================================================*/
+static void _benchPrint( const char *name, double t, int rounds )
+{
+  printf( "%-28s %10.3f\n", name, t*1e6/rounds );
+}
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
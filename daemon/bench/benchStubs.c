@@ -0,0 +1,175 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : benchStubs.c
+
+Description     : stubs of the metrics module for the micro benchmarks
+
+Comments        : Collectors are kept and can be run on demand, the last
+                  value set for a metric and label can be read back.
+                  Build with "make bench", not linked with ickpd.
+
+Called by       : benchArena, benchPlaylist, benchServices, benchNotify
+
+Calls           : -
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <jansson.h>
+
+#include "metrics.h"
+#include "benchStubs.h"
+
+
+/*=========================================================================*\
+  Private definitions and symbols
+\*=========================================================================*/
+#define BenchMaxCollectors 16
+#define BenchMaxValues     64
+
+typedef struct {
+  MetricId    id;
+  char       *label;              // strong, NULL if metric has no label
+  double      value;
+} BenchValue;
+
+static MetricsCollector collectors[BenchMaxCollectors];
+static int              collectorCount;
+static BenchValue       values[BenchMaxValues];
+static int              valueCount;
+
+
+/*=========================================================================*\
+  Private prototypes
+\*=========================================================================*/
+static BenchValue *_benchValue( MetricId id, const char *label, bool create );
+
+
+/*=========================================================================*\
+  Stubs for metrics module: keep collectors and values
+\*=========================================================================*/
+int metricsRegisterCollector( MetricsCollector collector )
+{
+  int i;
+
+  for( i=0; i<collectorCount; i++ ) {
+    if( collectors[i]==collector )
+      return 0;
+  }
+  if( collectorCount>=BenchMaxCollectors )
+    return -1;
+  collectors[collectorCount++] = collector;
+  return 0;
+}
+
+void metricsAdd( MetricId id, const char *label, double value )
+{
+  BenchValue *entry = _benchValue( id, label, true );
+  if( entry )
+    entry->value += value;
+}
+
+void metricsSet( MetricId id, const char *label, double value )
+{
+  BenchValue *entry = _benchValue( id, label, true );
+  if( entry )
+    entry->value = value;
+}
+
+void metricsObserve( MetricId id, const char *label, double value )
+{
+}
+
+
+/*=========================================================================*\
+  Run all registered collectors
+\*=========================================================================*/
+void benchCollect( void )
+{
+  int i;
+
+  for( i=0; i<collectorCount; i++ )
+    collectors[i]();
+}
+
+
+/*=========================================================================*\
+  Get last value of a metric
+    returns 0 if the metric was never set
+\*=========================================================================*/
+double benchMetric( MetricId id, const char *label )
+{
+  BenchValue *entry = _benchValue( id, label, false );
+  return entry ? entry->value : 0;
+}
+
+
+/*=========================================================================*\
+  Find (or create) a value entry
+    returns NULL if not found or the table is full
+\*=========================================================================*/
+static BenchValue *_benchValue( MetricId id, const char *label, bool create )
+{
+  int i;
+
+  for( i=0; i<valueCount; i++ ) {
+    if( values[i].id!=id )
+      continue;
+    if( (!label && !values[i].label) ||
+        (label && values[i].label && !strcmp(label,values[i].label)) )
+      return &values[i];
+  }
+  if( !create || valueCount>=BenchMaxValues )
+    return NULL;
+
+  values[valueCount].id    = id;
+  values[valueCount].label = label ? strdup( label ) : NULL;
+  values[valueCount].value = 0;
+  return &values[valueCount++];
+}
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
@@ -64,6 +64,7 @@ Remarks         : -
 #include "ickutils.h"
 #include "audio.h"
 #include "codec.h"
+#include "metrics.h"
 
 
 /*=========================================================================*\
@@ -74,13 +75,19 @@ Remarks         : -
 /*=========================================================================*\
 	Private symbols
 \*=========================================================================*/
-static Codec *codecList;
+#define CodecPoolSize  2      // Recycled instances per codec (current and pre-roll)
+
+static Codec           *codecList;
+static CodecInstance   *codecInstancePool;     // Recycled instances of all codecs
+static pthread_mutex_t  codecPoolMutex = PTHREAD_MUTEX_INITIALIZER;
 
 
 /*=========================================================================*\
 	Private prototypes
 \*=========================================================================*/
 static void *_codecThread( void *arg );
+static void  _codecInstanceFree( CodecInstance *instance );
+static void  _codecMetricsCollector( void );
 
 
 /*=========================================================================*\
@@ -99,6 +106,9 @@ int codecRegister( Codec *codec )
   codec->next = codecList;
   codecList   = codec;	
 
+  // Decoded bytes are counted by codec and reported on collection
+  metricsRegisterCollector( _codecMetricsCollector );
+
   // That's all
   loginfo( "codecRegister (%s): Ok.", codec->name );
   return 0;
@@ -113,6 +123,11 @@ void codecShutdown( bool force )
   Codec *codec; 
   DBGMSG( "codecShutdown: %s.", force?"force":"wait" );
 
+/*------------------------------------------------------------------------*\
+    Free recycled instances while codecs are still available
+\*------------------------------------------------------------------------*/
+  codecFreeInstancePool();
+
 /*------------------------------------------------------------------------*\
     Loop over all codecs 
 \*------------------------------------------------------------------------*/
@@ -133,6 +148,25 @@ void codecShutdown( bool force )
 }
 
 
+/*=========================================================================*\
+      Free all recycled codec instances
+\*=========================================================================*/
+void codecFreeInstancePool( void )
+{
+  CodecInstance *instance;
+
+  DBGMSG( "codecFreeInstancePool." );
+
+  pthread_mutex_lock( &codecPoolMutex );
+  while( codecInstancePool ) {
+    instance          = codecInstancePool;
+    codecInstancePool = instance->next;
+    _codecInstanceFree( instance );
+  }
+  pthread_mutex_unlock( &codecPoolMutex );
+}
+
+
 /*=========================================================================*\
       Find a codec for type and format
         for initial call codec shall be NULL
@@ -184,16 +218,52 @@ Codec *codecFind( const char *type, AudioFormat *format, Codec *codec )
 CodecInstance *codecNewInstance( const Codec *codec, const char *type, const AudioFormat *format, int fd, Fifo *fifo )
 {
   CodecInstance       *instance;
+  CodecInstance      **pLink;
 
   DBGMSG( "codecNewInstance (%s): creating new instance for type \"%s\".", codec->name, type );
 
+/*------------------------------------------------------------------------*\
+    Try to recycle an instance of this codec (keeps codec specific data)
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &codecPoolMutex );
+  for( pLink=&codecInstancePool; *pLink && (*pLink)->codec!=codec; pLink=&(*pLink)->next )
+    ;
+  instance = *pLink;
+  if( instance )
+    *pLink = instance->next;
+  pthread_mutex_unlock( &codecPoolMutex );
+
+  if( instance ) {
+    DBGMSG( "codecNewInstance (%s): recycling instance %p.", codec->name, instance );
+    instance->next                   = NULL;
+    instance->bytesDelivered         = 0;
+    instance->formatCallback         = NULL;
+    instance->formatCallbackUserData = NULL;
+    instance->metaCallback           = NULL;
+    instance->metaCallbackUserData   = NULL;
+    instance->icyInterval            = 0;
+    instance->threadStarted          = false;
+    instance->recyclable             = false;
+    memset( &instance->thread, 0, sizeof(pthread_t) );
+    if( strcmp(instance->type,type) )
+      Sfree( instance->type );
+  }
+
 /*------------------------------------------------------------------------*\
     Create header 
 \*------------------------------------------------------------------------*/
-  instance = calloc( 1, sizeof(CodecInstance) );
-  if( !instance ) {
-    logerr( "codecNewInstance (%s): Out of memory!", codec->name );
-    return NULL;
+  else {
+    instance = calloc( 1, sizeof(CodecInstance) );
+    if( !instance ) {
+      logerr( "codecNewInstance (%s): Out of memory!", codec->name );
+      return NULL;
+    }
+
+    // Init mutex and conditions
+    ickMutexInit( &instance->mutex_access );
+    ickMutexInit( &instance->mutex_state );
+    pthread_cond_init( &instance->condIsReady, NULL );
+    pthread_cond_init( &instance->condEndOfTrack, NULL );
   }
 
 /*------------------------------------------------------------------------*\
@@ -204,21 +274,14 @@ CodecInstance *codecNewInstance( const Codec *codec, const char *type, const Aud
   instance->fifoOut     = fifo;
   instance->fdIn        = fd;
   memcpy( &instance->format, format, sizeof(AudioFormat) );
-  instance->type        = strdup( type );
+  if( !instance->type )
+    instance->type      = strdup( type );
   if( !instance->type ) {
-    Sfree( instance );
     logerr( "codecNewInstance (%s): Out of memory!", codec->name );
+    _codecInstanceFree( instance );
     return NULL;
   }
 
-/*------------------------------------------------------------------------*\
-    Init mutex and conditions
-\*------------------------------------------------------------------------*/
-  ickMutexInit( &instance->mutex_access );
-  ickMutexInit( &instance->mutex_state );
-  pthread_cond_init( &instance->condIsReady, NULL );
-  pthread_cond_init( &instance->condEndOfTrack, NULL );
-
 /*------------------------------------------------------------------------*\
     That's all
 \*------------------------------------------------------------------------*/
@@ -259,6 +322,7 @@ int codecStartInstance( CodecInstance *instance )
             instance->codec->name, strerror(rc) );
     return -1;
   }
+  instance->threadStarted = true;
 
 /*------------------------------------------------------------------------*\
     Wait for max. 5 seconds till thread is up and running
@@ -325,31 +389,58 @@ void codecInstanceIsInitialized( CodecInstance *instance, CodecInstanceState sta
 \*=========================================================================*/
 int codecDeleteInstance( CodecInstance *instance, bool wait )
 {
+  CodecInstance *pooled;
+  int            count = 0;
+
   DBGMSG( "codecDeleteInstance (%s,%p): Deleting instance (%s).",
           instance->codec->name, instance, wait?"wait":"nowait" );
 
 /*------------------------------------------------------------------------*\
-    Stop thread and optionally wait for termination   
+    Stop thread and optionally wait for termination (if it was started)
 \*------------------------------------------------------------------------*/
   instance->state = CodecTerminating;
-  if( instance->state!=CodecInitialized && wait ) {
-     pthread_join( instance->thread, NULL ); 
-      DBGMSG( "codecDeleteInstance (%s,%p): Instance has terminated.",
+  if( instance->threadStarted && wait ) {
+    pthread_join( instance->thread, NULL );
+    instance->threadStarted = false;
+    DBGMSG( "codecDeleteInstance (%s,%p): Instance has terminated.",
             instance->codec->name, instance );
   }
 
 /*------------------------------------------------------------------------*\
-    Delete mutex and conditions
+    Thread might still be running: only free header
 \*------------------------------------------------------------------------*/
-  pthread_mutex_destroy( &instance->mutex_access );
-  pthread_mutex_destroy( &instance->mutex_state );
-  pthread_cond_destroy( &instance->condEndOfTrack );
-  
+  if( !wait ) {
+    pthread_mutex_destroy( &instance->mutex_access );
+    pthread_mutex_destroy( &instance->mutex_state );
+    pthread_cond_destroy( &instance->condEndOfTrack );
+    Sfree( instance->type );
+    Sfree( instance );
+    return 0;
+  }
+
 /*------------------------------------------------------------------------*\
-    Free header  
+    Recycle cleanly terminated instance if there are not enough spares
 \*------------------------------------------------------------------------*/
-  Sfree( instance->type );
-  Sfree( instance );
+  if( instance->recyclable ) {
+    pthread_mutex_lock( &codecPoolMutex );
+    for( pooled=codecInstancePool; pooled; pooled=pooled->next ) {
+      if( pooled->codec==instance->codec )
+        count++;
+    }
+    if( count<CodecPoolSize ) {
+      instance->next    = codecInstancePool;
+      codecInstancePool = instance;
+      instance          = NULL;
+    }
+    pthread_mutex_unlock( &codecPoolMutex );
+    if( !instance )
+      return 0;
+  }
+
+/*------------------------------------------------------------------------*\
+    Free instance with codec specific data
+\*------------------------------------------------------------------------*/
+  _codecInstanceFree( instance );
 
 /*------------------------------------------------------------------------*\
     That's it  
@@ -554,7 +645,9 @@ static void *_codecThread( void *arg )
     size_t size = 0;
     
     // Wait max. 500 ms for any free space in output fifo
+    TRACEBEGIN( "waitFifo" );
     rc = fifoLockWaitWritable( instance->fifoOut, 500, 0 );
+    TRACEEND( "waitFifo" );
     if( rc==ETIMEDOUT ) {
       continue;
     }   
@@ -567,11 +660,15 @@ static void *_codecThread( void *arg )
     
     // Transfer data from codec to fifo
     size_t space = fifoGetSize( instance->fifoOut, FifoNextWritable );
+    TRACEBEGIN( "decode" );
     rc = codec->deliverOutput( instance, fifoGetWritePtr(instance->fifoOut), space, &size );
+    TRACEEND( "decode" );
 
     // Unlock fifo
     fifoUnlockAfterWrite( instance->fifoOut, size );
     instance->bytesDelivered += size;
+    if( size )    // the counter is the only mutable member of the codec
+      __sync_add_and_fetch( &((Codec *)codec)->decodedBytes, size );
 
     // Be verbose
     DBGMSG( "Codec thread (%s,%p): %ld bytes written to output (space=%ld, rc=%d)",
@@ -594,6 +691,7 @@ static void *_codecThread( void *arg )
     instance->state = CodecTerminatedError;
     return NULL;
   }
+  instance->recyclable = true;
   DBGMSG( "Codec thread (%s,%p): Terminated due to state %d.",
           codec->name, instance, instance->state );
 
@@ -610,6 +708,49 @@ static void *_codecThread( void *arg )
 }
 
 
+/*=========================================================================*\
+      Free an instance including data kept by the codec for reuse
+        thread must not be running
+\*=========================================================================*/
+static void _codecInstanceFree( CodecInstance *instance )
+{
+  DBGMSG( "_codecInstanceFree (%s,%p).", instance->codec->name, instance );
+
+/*------------------------------------------------------------------------*\
+    Let codec free its data (decoder handles)
+\*------------------------------------------------------------------------*/
+  if( instance->instanceData && instance->codec->freeInstance )
+    instance->codec->freeInstance( instance );
+
+/*------------------------------------------------------------------------*\
+    Delete mutex and conditions
+\*------------------------------------------------------------------------*/
+  pthread_mutex_destroy( &instance->mutex_access );
+  pthread_mutex_destroy( &instance->mutex_state );
+  pthread_cond_destroy( &instance->condIsReady );
+  pthread_cond_destroy( &instance->condEndOfTrack );
+
+/*------------------------------------------------------------------------*\
+    Free header  
+\*------------------------------------------------------------------------*/
+  Sfree( instance->type );
+  Sfree( instance );
+}
+
+
+/*=========================================================================*\
+    Metrics collector: decoded bytes per codec
+      The codec threads do not touch the metrics registry (and its lock)
+\*=========================================================================*/
+static void _codecMetricsCollector( void )
+{
+  Codec *codec;
+
+  for( codec=codecList; codec; codec=codec->next )
+    metricsSet( MetricCodecDecodedBytes, codec->name, codec->decodedBytes );
+}
+
+
 /*=========================================================================*\
                                     END OF FILE
 \*=========================================================================*/
@@ -126,6 +126,8 @@ struct _codecInstance {
   pthread_mutex_t              mutex_state;
   pthread_cond_t               condIsReady;
   pthread_cond_t               condEndOfTrack;
+  bool                         threadStarted;          // private: thread needs to be joined
+  bool                         recyclable;             // private: thread terminated cleanly
 };
  
 
@@ -136,11 +138,13 @@ struct _codec {
   CodecInit            init;                // optional
   CodecShutdown        shutdown;            // optional
   CodecCheckType       checkType;
-  CodecInstanceNew     newInstance; 
-  CodecInstanceDelete  deleteInstance;
+  CodecInstanceNew     newInstance;         // instanceData might be kept from recycled instance
+  CodecInstanceDelete  deleteInstance;      // might keep instanceData for reuse ...
+  CodecInstanceDelete  freeInstance;        // ... then this frees it (optional)
   CodecOutput          deliverOutput;       // optional
   CodecVolume          setVolume;           // optional
   CodecGetSeekTime     getSeekTime;
+  volatile long        decodedBytes;        // private: statistics (metrics)
 };
 
 
@@ -149,6 +153,7 @@ struct _codec {
 \*=========================================================================*/
 int    codecRegister( Codec *codec );
 void   codecShutdown( bool force );
+void   codecFreeInstancePool( void );
 Codec *codecFind( const char *type, AudioFormat *format, Codec *codec );
 
 CodecInstance      *codecNewInstance( const Codec *codec, const char *type, const AudioFormat *format, int fd, Fifo *fifo );
@@ -86,6 +86,7 @@ Remarks         : -
 static bool   _codecCheckType(const char *type, const AudioFormat *format );
 static int    _codecNewInstance( CodecInstance *instance ); 
 static int    _codecDeleteInstance( CodecInstance *instance ); 
+static int    _codecFreeInstance( CodecInstance *instance ); 
 
 static FLAC__StreamDecoderReadStatus _read_callback( const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data );
 static FLAC__StreamDecoderWriteStatus _write_callback( const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data );
@@ -113,6 +114,7 @@ Codec *flacDescriptor( void )
   codec.checkType      = &_codecCheckType;
   codec.newInstance    = &_codecNewInstance; 
   codec.deleteInstance = &_codecDeleteInstance;
+  codec.freeInstance   = &_codecFreeInstance;
   codec.deliverOutput  = NULL;
   codec.setVolume      = NULL;
   codec.getSeekTime    = NULL;
@@ -158,25 +160,25 @@ static bool _codecCheckType(const char *type, const AudioFormat *format )
 \*=========================================================================*/
 static int _codecNewInstance( CodecInstance *instance )
 {
-  FLAC__StreamDecoder           *decoder;
+  FLAC__StreamDecoder           *decoder = (FLAC__StreamDecoder*)instance->instanceData;
   FLAC__StreamDecoderInitStatus  rc;
   
-  DBGMSG( "flac (%p): init instance.", instance );
+  DBGMSG( "flac (%p): init instance (%s decoder).", instance, decoder?"recycled":"new" );
 
 /*------------------------------------------------------------------------*\
-    Get library handle
+    Get library handle, a recycled one was already finished
 \*------------------------------------------------------------------------*/
-  decoder = FLAC__stream_decoder_new();
   if( !decoder ) {
-    logerr( "flac: could not allocate decoder." );
-    codecInstanceIsInitialized( instance, CodecTerminatedError );
-    return -1;
+    decoder = FLAC__stream_decoder_new();
+    if( !decoder ) {
+      logerr( "flac: could not allocate decoder." );
+      codecInstanceIsInitialized( instance, CodecTerminatedError );
+      return -1;
+    }
+
+    // Store auxiliary data in instance
+    instance->instanceData = decoder;
   }
-  
-/*------------------------------------------------------------------------*\
-    Store auxiliary data in instance and return
-\*------------------------------------------------------------------------*/
-  instance->instanceData = decoder;
 
 /*------------------------------------------------------------------------*\
     Set md5 checking
@@ -192,7 +194,7 @@ static int _codecNewInstance( CodecInstance *instance )
   if( rc!=FLAC__STREAM_DECODER_INIT_STATUS_OK ) {
     logerr( "flac: could not allocate decoder (%s).",
             FLAC__StreamDecoderInitStatusString[rc] );
-    FLAC__stream_decoder_delete( decoder );
+    _codecFreeInstance( instance );
     codecInstanceIsInitialized( instance, CodecTerminatedError );
     return -1;
 }
@@ -241,6 +243,7 @@ static int _codecNewInstance( CodecInstance *instance )
 
 /*=========================================================================*\
       Get rid of a codec instance 
+        the decoder is kept for reuse
 \*=========================================================================*/
 static int _codecDeleteInstance( CodecInstance *instance )
 {
@@ -251,7 +254,6 @@ static int _codecDeleteInstance( CodecInstance *instance )
 \*------------------------------------------------------------------------*/
   if( !decoder )
     return 0;
-  instance->instanceData = NULL;
 
 /*------------------------------------------------------------------------*\
     Close data source (reading pipe end)
@@ -263,10 +265,9 @@ static int _codecDeleteInstance( CodecInstance *instance )
   }
 
 /*------------------------------------------------------------------------*\
-    Delete decoder
+    Finish decoder, it's kept for reuse
 \*------------------------------------------------------------------------*/
   FLAC__stream_decoder_finish( decoder );
-  FLAC__stream_decoder_delete( decoder );
 
 /*------------------------------------------------------------------------*\
     That's all
@@ -275,6 +276,23 @@ static int _codecDeleteInstance( CodecInstance *instance )
 }
 
 
+/*=========================================================================*\
+      Free decoder of a codec instance 
+\*=========================================================================*/
+static int _codecFreeInstance( CodecInstance *instance )
+{
+  FLAC__StreamDecoder *decoder = (FLAC__StreamDecoder*)instance->instanceData;
+
+  DBGMSG( "flac (%p): free instance.", instance );
+
+  instance->instanceData = NULL;
+  if( decoder )
+    FLAC__stream_decoder_delete( decoder );
+
+  return 0;
+}
+
+
 /*=========================================================================*\
        Callback for data input to codec
 \*=========================================================================*/
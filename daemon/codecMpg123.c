@@ -88,6 +88,7 @@ static int    _codecShutdown( Codec *codec, bool force );
 static bool   _codecCheckType(const char *type, const AudioFormat *format );
 static int    _codecNewInstance( CodecInstance *instance ); 
 static int    _codecDeleteInstance( CodecInstance *instance ); 
+static int    _codecFreeInstance( CodecInstance *instance ); 
 static int    _codecDeliverOutput( CodecInstance *instance, void *data, size_t maxLength, size_t *realSize );
 static int    _codecSetVolume( CodecInstance *instance, double volume, bool muted );
 static int    _codecGetSeekTime( CodecInstance *instance, double *pos );  
@@ -118,6 +119,7 @@ Codec *mpg123Descriptor( void )
   codec.checkType      = &_codecCheckType;
   codec.newInstance    = &_codecNewInstance; 
   codec.deleteInstance = &_codecDeleteInstance;
+  codec.freeInstance   = &_codecFreeInstance;
   codec.deliverOutput  = &_codecDeliverOutput;
   codec.setVolume      = &_codecSetVolume;
   codec.getSeekTime    = &_codecGetSeekTime;
@@ -218,56 +220,66 @@ static bool _codecCheckType(const char *type, const AudioFormat *format )
 
 /*=========================================================================*\
       Get a new codec instance 
+        a recycled instance already has a library handle
 \*=========================================================================*/
 static int _codecNewInstance( CodecInstance *instance )
 {
-  mpg123_handle *mh;
+  mpg123_handle *mh = (mpg123_handle *)instance->instanceData;
   int            rc = MPG123_OK;
   
-  DBGMSG( "mpg123 (%p): init instance.", instance );
+  DBGMSG( "mpg123 (%p): init instance (%s handle).", instance, mh?"recycled":"new" );
 
 /*------------------------------------------------------------------------*\
     Get library handle
 \*------------------------------------------------------------------------*/
-  mh = mpg123_new( NULL, &rc );   
   if( !mh ) {
-    logerr( "mpg123: could not init instance (%s).", mpg123_plain_strerror(rc) );
-    codecInstanceIsInitialized( instance, CodecTerminatedError );
-    return -1;
-  }
+    mh = mpg123_new( NULL, &rc );   
+    if( !mh ) {
+      logerr( "mpg123: could not init instance (%s).", mpg123_plain_strerror(rc) );
+      codecInstanceIsInitialized( instance, CodecTerminatedError );
+      return -1;
+    }
+    instance->instanceData = mh;
   
 /*------------------------------------------------------------------------*\
     Set debug mode
 \*------------------------------------------------------------------------*/
 #ifdef ICK_DEBUG
-  DBGMSG( "mpg123 (%p): setting verbosity to %d.", instance, logGetStreamLevel() );
-  rc = mpg123_param( mh, MPG123_VERBOSE, logGetStreamLevel(), 0);
-  if( rc!=MPG123_OK ) {
-    logerr( "mpg123: could not set verbosity level to %d (%d, %s).",
-            logGetStreamLevel(), rc, MPG123ERRSTR(rc,mh) );
-    mpg123_delete( mh );
-    codecInstanceIsInitialized( instance, CodecTerminatedError );
-    return -1;
-  }
+    DBGMSG( "mpg123 (%p): setting verbosity to %d.", instance, logGetStreamLevel() );
+    rc = mpg123_param( mh, MPG123_VERBOSE, logGetStreamLevel(), 0);
+    if( rc!=MPG123_OK ) {
+      logerr( "mpg123: could not set verbosity level to %d (%d, %s).",
+              logGetStreamLevel(), rc, MPG123ERRSTR(rc,mh) );
+      _codecFreeInstance( instance );
+      codecInstanceIsInitialized( instance, CodecTerminatedError );
+      return -1;
+    }
 #endif
+  }
 
 /*------------------------------------------------------------------------*\
-    Icy mode?
+    Recycled handle: reset volume set for previous track
 \*------------------------------------------------------------------------*/
-  if( instance->icyInterval ) {
-    DBGMSG( "mpg123 (%p): icy enabled with interval %ld.",
+  else
+    mpg123_volume( mh, 1.0 );
+
+/*------------------------------------------------------------------------*\
+    Icy mode? (needs to be reset for recycled handles)
+\*------------------------------------------------------------------------*/
+  if( instance->icyInterval && !mpg123_feature(MPG123_FEATURE_PARSE_ICY) ) {
+    logerr( "mpg123: icy not supported by this library version." );
+    _codecFreeInstance( instance );
+    codecInstanceIsInitialized( instance, CodecTerminatedError );
+    return -1;
+  }
+  if( mpg123_feature(MPG123_FEATURE_PARSE_ICY) ) {
+    DBGMSG( "mpg123 (%p): icy interval is %ld.",
             instance, instance->icyInterval );
-    if( !mpg123_feature(MPG123_FEATURE_PARSE_ICY) ) {
-      logerr( "mpg123: icy not supported by this library version." );
-      mpg123_delete( mh );
-      codecInstanceIsInitialized( instance, CodecTerminatedError );
-      return -1;
-    }
     rc = mpg123_param( mh, MPG123_ICY_INTERVAL, instance->icyInterval, 0);
     if( rc!=MPG123_OK ) {
       logerr( "mpg123: could not set icy interval to %ld (%d, %s).",
               instance->icyInterval, rc, MPG123ERRSTR(rc,mh) );
-      mpg123_delete( mh );
+      _codecFreeInstance( instance );
       codecInstanceIsInitialized( instance, CodecTerminatedError );
       return -1;
     }
@@ -282,16 +294,11 @@ static int _codecNewInstance( CodecInstance *instance )
   if( rc!=MPG123_OK ) {
     logerr( "mpg123: could not open file handle %d (%d, %s).",
             instance->fdIn, rc, MPG123ERRSTR(rc,mh) );
-    mpg123_delete( mh );
+    _codecFreeInstance( instance );
     codecInstanceIsInitialized( instance, CodecTerminatedError );
     return -1;
   }
 
-/*------------------------------------------------------------------------*\
-    Store auxiliary data in instance
-\*------------------------------------------------------------------------*/
-  instance->instanceData = mh;
-
 /*------------------------------------------------------------------------*\
     Signal that codec is up and running and return
 \*------------------------------------------------------------------------*/
@@ -302,6 +309,7 @@ static int _codecNewInstance( CodecInstance *instance )
 
 /*=========================================================================*\
       Get rid of a codec instance 
+        the library handle is kept for reuse
 \*=========================================================================*/
 static int _codecDeleteInstance( CodecInstance *instance )
 {
@@ -313,7 +321,6 @@ static int _codecDeleteInstance( CodecInstance *instance )
 \*------------------------------------------------------------------------*/
   if( !mh )
     return 0;
-  instance->instanceData = NULL;
       
 /*------------------------------------------------------------------------*\
     Close data source (reading pipe end)
@@ -325,9 +332,9 @@ static int _codecDeleteInstance( CodecInstance *instance )
   }
 
 /*------------------------------------------------------------------------*\
-    Delete decoder
+    Close decoder, this resets the stream state of the handle
 \*------------------------------------------------------------------------*/  
-  mpg123_delete( mh );
+  mpg123_close( mh );
   
 /*------------------------------------------------------------------------*\
     That's all
@@ -336,6 +343,23 @@ static int _codecDeleteInstance( CodecInstance *instance )
 }
 
 
+/*=========================================================================*\
+      Free library handle of a codec instance
+\*=========================================================================*/
+static int _codecFreeInstance( CodecInstance *instance )
+{
+  mpg123_handle *mh = (mpg123_handle *)instance->instanceData;
+
+  DBGMSG( "mpg123 (%p): free instance.", instance );
+
+  instance->instanceData = NULL;
+  if( mh )
+    mpg123_delete( mh );
+
+  return 0;
+}
+
+
 /*=========================================================================*\
       Write data to output 
         return  0  on success
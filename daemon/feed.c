@@ -69,6 +69,7 @@ Remarks         : -
 #include "codec.h"
 #include "fifo.h"
 #include "feed.h"
+#include "metrics.h"
 
 /*=========================================================================*\
     Global symbols
@@ -79,7 +80,10 @@ Remarks         : -
 /*=========================================================================*\
     Private symbols
 \*=========================================================================*/
+#define FeedPoolSize  2      // Recycled feeds (current and pre-roll)
+
 struct _audioFeed {
+  struct _audioFeed       *next;             // Chain of pool
   volatile AudioFeedState  state;
   int                      flags;
   char                    *uri;
@@ -92,18 +96,27 @@ struct _audioFeed {
   int                      pipefd[2];
   char                    *header;
   size_t                   headerLen;
-  CURL                    *curlHandle;
+  size_t                   headerSize;       // Allocated, buffer is kept for reuse
+  CURL                    *curlHandle;       // Kept for reuse
   pthread_t                thread;
   pthread_mutex_t          mutex;
   pthread_cond_t           condIsConnected;
 };
 
+static AudioFeed          *feedPool;
+static int                 feedPoolCount;
+static pthread_mutex_t     feedPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile long       feedReceivedBytes;  // Reported on metrics collection
+
 
 /*=========================================================================*\
     Private prototypes
 \*=========================================================================*/
 static void *_feederThread( void *arg );
+static void   _audioFeedFree( AudioFeed *feed );
+static int    _audioFeedHeaderReserve( AudioFeed *feed, size_t size );
 static size_t _curlWriteCallback( void *contents, size_t size, size_t nmemb, void *userp );
+static void   _feedMetricsCollector( void );
 #ifdef ICK_TRACECURL
 static int    _curlTraceCallback( CURL *handle, curl_infotype type, char *data, size_t size, void *userp );
 #endif
@@ -125,17 +138,40 @@ AudioFeed *audioFeedCreate( const char *uri, const char *oAuthToken, int flags,
   int                  rc;
 
   DBGMSG( "audioFeedCreate: \"%s\", flags=%d, callback=%p", uri, flags, callback );
+  metricsRegisterCollector( _feedMetricsCollector );
+
+/*------------------------------------------------------------------------*\
+    Recycle a feed (keeps header buffer, curl handle, mutex and conditions)
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &feedPoolMutex );
+  feed = feedPool;
+  if( feed ) {
+    feedPool = feed->next;
+    feedPoolCount--;
+  }
+  pthread_mutex_unlock( &feedPoolMutex );
+  if( feed ) {
+    DBGMSG( "audioFeedCreate: recycling feed %p.", feed );
+    feed->next        = NULL;
+    feed->icyInterval = 0;
+    feed->headerLen   = 0;
+    if( feed->header )
+      *feed->header = 0;
+  }
 
 /*------------------------------------------------------------------------*\
     Create header 
 \*------------------------------------------------------------------------*/
-  feed = calloc( 1, sizeof(AudioFeed) );
-  if( !feed ) {
-    logerr( "audioCreateFeed (%s): out of memory!", uri );
-    return NULL;
+  else {
+    feed = calloc( 1, sizeof(AudioFeed) );
+    if( !feed ) {
+      logerr( "audioCreateFeed (%s): out of memory!", uri );
+      return NULL;
+    }
+    ickMutexInit( &feed->mutex );
+    pthread_cond_init( &feed->condIsConnected, NULL );
   }
   feed->state             = FeedInitialized;
-  feed->header            = NULL;
   memset( &feed->format, 0, sizeof(AudioFormat) );
 
 /*------------------------------------------------------------------------*\
@@ -144,16 +180,11 @@ AudioFeed *audioFeedCreate( const char *uri, const char *oAuthToken, int flags,
   if( pipe(feed->pipefd) ) {
     logerr( "audioFeedCreate (%s): could not create pipe (%s).",
             uri, strerror(errno) );
-    Sfree( feed );
+    feed->pipefd[1] = -1;
+    _audioFeedFree( feed );
     return NULL;
   }
 
-/*------------------------------------------------------------------------*\
-    Init mutex and conditions
-\*------------------------------------------------------------------------*/
-  ickMutexInit( &feed->mutex );
-  pthread_cond_init( &feed->condIsConnected, NULL );
-
 /*------------------------------------------------------------------------*\
     Copy parameters
 \*------------------------------------------------------------------------*/
@@ -182,6 +213,7 @@ AudioFeed *audioFeedCreate( const char *uri, const char *oAuthToken, int flags,
 
 /*=========================================================================*\
     Delete an audio feed
+      if waiting for the thread the feed is recycled
 \*=========================================================================*/
 int audioFeedDelete( AudioFeed *feed, bool wait )
 {
@@ -195,24 +227,31 @@ int audioFeedDelete( AudioFeed *feed, bool wait )
      pthread_join( feed->thread, NULL ); 
 
 /*------------------------------------------------------------------------*\
-    Close writing end of pipe
+    Thread might still be running or pool is full: free feed
 \*------------------------------------------------------------------------*/
-  close( feed->pipefd[1] );
-
-/*------------------------------------------------------------------------*\
-    Delete mutex and conditions
-\*------------------------------------------------------------------------*/
-  pthread_mutex_destroy( &feed->mutex );
-  pthread_cond_destroy( &feed->condIsConnected );
+  if( !wait ) {
+    _audioFeedFree( feed );
+    return 0;
+  }
+  pthread_mutex_lock( &feedPoolMutex );
+  if( feedPoolCount>=FeedPoolSize ) {
+    pthread_mutex_unlock( &feedPoolMutex );
+    _audioFeedFree( feed );
+    return 0;
+  }
 
 /*------------------------------------------------------------------------*\
-    Free buffers and header
+    Free per track data and put feed to pool
 \*------------------------------------------------------------------------*/
   Sfree( feed->uri );
   Sfree( feed->oAuthToken );
   Sfree( feed->type );
-  Sfree( feed->header );
-  Sfree( feed );
+  feed->callback = NULL;
+  feed->usrData  = NULL;
+  feed->next     = feedPool;
+  feedPool       = feed;
+  feedPoolCount++;
+  pthread_mutex_unlock( &feedPoolMutex );
 
 /*------------------------------------------------------------------------*\
     That's all  
@@ -221,6 +260,26 @@ int audioFeedDelete( AudioFeed *feed, bool wait )
 }
 
 
+/*=========================================================================*\
+    Free all recycled feeds
+\*=========================================================================*/
+void audioFeedFreePool( void )
+{
+  AudioFeed *feed;
+
+  DBGMSG( "audioFeedFreePool: %d feeds.", feedPoolCount );
+
+  pthread_mutex_lock( &feedPoolMutex );
+  while( feedPool ) {
+    feed     = feedPool;
+    feedPool = feed->next;
+    _audioFeedFree( feed );
+  }
+  feedPoolCount = 0;
+  pthread_mutex_unlock( &feedPoolMutex );
+}
+
+
 /*=========================================================================*\
       Lock feed to avoid concurrent modifications
 \*=========================================================================*/
@@ -473,9 +532,12 @@ static void *_feederThread( void *arg )
   pthread_sigmask( SIG_BLOCK, NULL, &sigSet );
 
 /*------------------------------------------------------------------------*\
-    Setup cURL
+    Setup cURL, a recycled handle keeps its connection and DNS caches
 \*------------------------------------------------------------------------*/
-  feed->curlHandle = curl_easy_init();
+  if( feed->curlHandle )
+    curl_easy_reset( feed->curlHandle );
+  else
+    feed->curlHandle = curl_easy_init();
   if( !feed->curlHandle ) {
     logerr( "audioFeedCreate (%s): Unable to init cURL.", feed->uri );
     feed->state = FeedTerminatedError;
@@ -592,13 +654,13 @@ end:
     Close pipe
 \*------------------------------------------------------------------------*/
   close( feed->pipefd[1]);
+  feed->pipefd[1] = -1;
 
 /*------------------------------------------------------------------------*\
-    Clean up curl
+    Clean up curl (handle is kept for reuse, but must not refer to headers)
 \*------------------------------------------------------------------------*/
-  if(feed->curlHandle )
-    curl_easy_cleanup( feed->curlHandle );
-  feed->curlHandle = NULL;
+  if( feed->curlHandle )
+    curl_easy_setopt( feed->curlHandle, CURLOPT_HTTPHEADER, NULL );
   if( addedHeaderFields )
     curl_slist_free_all( addedHeaderFields );
 
@@ -622,6 +684,8 @@ static size_t _curlWriteCallback( void *buffer, size_t size, size_t nmemb, void
   void      *newbuf = NULL;
 
   DBGMSG( "Feeder thread (%s): receiving %ld bytes", feed->uri, (long)size );
+  TRACECOUNTER( "feedBytes", size );
+  __sync_add_and_fetch( &feedReceivedBytes, size );
   //DBGMEM( "Raw feed", buffer, size );
 
 /*------------------------------------------------------------------------*\
@@ -642,8 +706,9 @@ static size_t _curlWriteCallback( void *buffer, size_t size, size_t nmemb, void
     //          feed->uri, headerSize, feed->headerLen, size );
 
     // First packet
-    if( !feed->header ) {
-      feed->header    = malloc( size );
+    if( !feed->headerLen ) {
+      if( _audioFeedHeaderReserve(feed,size) )
+        return errVal;
       feed->headerLen = size;
       memcpy( feed->header, buffer, size );
       size = 0;
@@ -660,9 +725,9 @@ static size_t _curlWriteCallback( void *buffer, size_t size, size_t nmemb, void
       buffer = newbuf;
       size  += diff;
 
-      // Terminate and shrink header string
+      // Terminate header string (buffer is kept for reuse)
       feed->header[headerSize] = 0;
-      feed->header = realloc( feed->header, headerSize+1 );
+      feed->headerLen          = headerSize;
       DBGMSG( "Feeder thread (%s): header complete: \"%s\"",
               feed->uri, feed->header );
 
@@ -700,10 +765,10 @@ static size_t _curlWriteCallback( void *buffer, size_t size, size_t nmemb, void
 
     // Extend existing header
     else {
-      size_t oldLen    = feed->headerLen;
+      if( _audioFeedHeaderReserve(feed,feed->headerLen+size) )
+        return errVal;
+      memcpy( feed->header+feed->headerLen, buffer, size );
       feed->headerLen += size;
-      feed->header     = realloc( feed->header, feed->headerLen );
-      memcpy( feed->header+oldLen, buffer, size );
       size = 0;
     }
 
@@ -787,6 +852,61 @@ static size_t _curlWriteCallback( void *buffer, size_t size, size_t nmemb, void
   return retVal;
 }
 
+/*=========================================================================*\
+      Make sure header buffer can hold size bytes
+        return -1 on error
+\*=========================================================================*/
+static int _audioFeedHeaderReserve( AudioFeed *feed, size_t size )
+{
+  char *newHeader;
+
+  if( size<=feed->headerSize )
+    return 0;
+
+  newHeader = realloc( feed->header, size );
+  if( !newHeader ) {
+    logerr( "Feeder thread (%s): out of memory!", feed->uri );
+    return -1;
+  }
+  feed->header     = newHeader;
+  feed->headerSize = size;
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+      Free a feed
+        thread must not be running (or not use the feed anymore)
+\*=========================================================================*/
+static void _audioFeedFree( AudioFeed *feed )
+{
+
+/*------------------------------------------------------------------------*\
+    Close writing end of pipe (if not done by thread)
+\*------------------------------------------------------------------------*/
+  if( feed->pipefd[1]>=0 )
+    close( feed->pipefd[1] );
+
+/*------------------------------------------------------------------------*\
+    Delete mutex, conditions and curl handle
+\*------------------------------------------------------------------------*/
+  pthread_mutex_destroy( &feed->mutex );
+  pthread_cond_destroy( &feed->condIsConnected );
+  if( feed->curlHandle )
+    curl_easy_cleanup( feed->curlHandle );
+
+/*------------------------------------------------------------------------*\
+    Free buffers and header
+\*------------------------------------------------------------------------*/
+  Sfree( feed->uri );
+  Sfree( feed->oAuthToken );
+  Sfree( feed->type );
+  Sfree( feed->header );
+  Sfree( feed );
+}
+
+
 /*=========================================================================*\
       cURL debug callback
       (stolen from http://curl.haxx.se/libcurl/c/debug.html)
@@ -835,6 +955,17 @@ static int _curlTraceCallback( CURL *handle, curl_infotype type, char *data, siz
 }
 #endif
 
+
+/*=========================================================================*\
+    Metrics collector: received bytes
+      The feeder threads do not touch the metrics registry (and its lock)
+\*=========================================================================*/
+static void _feedMetricsCollector( void )
+{
+  metricsSet( MetricFeedReceivedBytes, NULL, feedReceivedBytes );
+}
+
+
 /*=========================================================================*\
                                     END OF FILE
 \*=========================================================================*/
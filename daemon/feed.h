@@ -104,6 +104,7 @@ typedef int (*AudioFeedCallback)( AudioFeed *feed, void *usrData );
 \*=========================================================================*/
 AudioFeed      *audioFeedCreate( const char *uri, const char *oAuthToken, int flags, AudioFeedCallback callback, void *usrData );
 int             audioFeedDelete( AudioFeed *feed, bool wait );
+void            audioFeedFreePool( void );
 void            audioFeedLock( AudioFeed *feed );
 void            audioFeedUnlock( AudioFeed *feed );
 int             audioFeedLockWaitForConnection( AudioFeed *feed, int timeout );
@@ -61,6 +61,7 @@ Remarks         : -
 
 #include "ickutils.h"
 #include "fifo.h"
+#include "metrics.h"
 
 
 /*=========================================================================*\
@@ -73,6 +74,7 @@ Remarks         : -
 	Private symbols
 \*=========================================================================*/
 struct _fifo {
+  struct _fifo    *next;           // list of all fifos (metrics)
   char            *name;
 
   // Actual buffer
@@ -96,6 +98,15 @@ struct _fifo {
 #define FifoIsWritable(fifo) (fifoGetSize((fifo),FifoTotalUsed)<(fifo)->lowWatermark)
 #define FifoIsReadable(fifo) (fifoGetSize((fifo),FifoTotalUsed)>(fifo)->highWatermark)
 
+static Fifo            *fifoList;
+static pthread_mutex_t  fifoListMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*=========================================================================*\
+	Private prototypes
+\*=========================================================================*/
+static void _fifoMetricsCollector( void );
+
 
 /*=========================================================================*\
       Create a ring buffer 
@@ -127,6 +138,7 @@ Fifo *fifoCreate( const char *name, size_t size )
     Allocate buffer and init pointers 
 \*------------------------------------------------------------------------*/
   fifo->size          = size;
+  metricsSet( MetricFifoSizeBytes, name, size );
   fifo->lowWatermark  = size;
   fifo->highWatermark = 0;
   fifo->buffer = malloc( size );
@@ -148,6 +160,15 @@ Fifo *fifoCreate( const char *name, size_t size )
   pthread_cond_init( &fifo->condIsDrained, NULL );
   pthread_cond_init( &fifo->condIsReadable, NULL );
 
+/*------------------------------------------------------------------------*\
+    Link to list, fill levels are reported on metrics collection
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &fifoListMutex );
+  fifo->next = fifoList;
+  fifoList   = fifo;
+  pthread_mutex_unlock( &fifoListMutex );
+  metricsRegisterCollector( _fifoMetricsCollector );
+
 /*------------------------------------------------------------------------*\
     That's all 
 \*------------------------------------------------------------------------*/
@@ -162,9 +183,21 @@ Fifo *fifoCreate( const char *name, size_t size )
 \*=========================================================================*/
 void fifoDelete( Fifo *fifo )
 {
+  Fifo **link;
+
   DBGMSG( "Fifo %p (%s, %ld bytes) freed", fifo,
                      fifo->name?fifo->name:"<unknown>", (long)fifo->size );
 
+/*------------------------------------------------------------------------*\
+    Unlink from list
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &fifoListMutex );
+  for( link=&fifoList; *link && *link!=fifo; link=&(*link)->next )
+    ;
+  if( *link )
+    *link = fifo->next;
+  pthread_mutex_unlock( &fifoListMutex );
+
 /*------------------------------------------------------------------------*\
     Delete mutex and conditions 
 \*------------------------------------------------------------------------*/
@@ -493,6 +526,7 @@ void fifoUnlockAfterRead( Fifo *fifo, size_t size )
     Adjust pointers
 \*------------------------------------------------------------------------*/
   fifoDataConsumed( fifo, size );
+  TRACECOUNTER( fifo->name?fifo->name:"fifo", fifoGetSize(fifo,FifoTotalUsed) );
 
 /*------------------------------------------------------------------------*\
     Release mutex
@@ -538,6 +572,7 @@ void fifoUnlockAfterWrite( Fifo *fifo, size_t size )
     Adjust pointers
 \*------------------------------------------------------------------------*/
   fifoDataWritten( fifo, size );
+  TRACECOUNTER( fifo->name?fifo->name:"fifo", fifoGetSize(fifo,FifoTotalUsed) );
   
 /*------------------------------------------------------------------------*\
     Release mutex
@@ -812,6 +847,23 @@ int fifoDataConsumed( Fifo *fifo, size_t size )
 }
 
 
+/*=========================================================================*\
+    Metrics collector: fill levels of all fifos
+      Reads the pointers without the fifo lock, which is good enough for a
+      gauge and keeps the metrics registry (and its lock) out of the
+      audio and codec threads
+\*=========================================================================*/
+static void _fifoMetricsCollector( void )
+{
+  Fifo *fifo;
+
+  pthread_mutex_lock( &fifoListMutex );
+  for( fifo=fifoList; fifo; fifo=fifo->next )
+    metricsSet( MetricFifoUsedBytes, fifo->name, fifoGetSize(fifo,FifoTotalUsed) );
+  pthread_mutex_unlock( &fifoListMutex );
+}
+
+
 /*=========================================================================*\
                                     END OF FILE
 \*=========================================================================*/
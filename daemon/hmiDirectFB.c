@@ -263,7 +263,7 @@ void hmiShutdown( void )
 void hmiNewConfig( void )
 {
   DBGMSG( "hmiNewConfig: %s, \"%s\", \"%s\".",
-      playerGetUUID(),  playerGetName(), ickCloudGetAccessToken()?"Cloud":"No Cloud" );
+      playerGetUUID(playerGetZone(0)),  playerGetName(playerGetZone(0)), ickCloudGetAccessToken()?"Cloud":"No Cloud" );
 
 /*------------------------------------------------------------------------*\
     Request updates for configuration, current item and playback queue
@@ -392,10 +392,11 @@ void hmiNewPosition( double seekPos )
 \*=========================================================================*/
 static void _hmiRenderCurrentItem( void )
 {
-  Playlist     *plst = playerGetQueue( );
-  PlaylistItem *item = NULL;
-  DfbtWidget   *screen = dfbtGetScreen();
-  int           width, height, border, size;
+  Playlist         *plst     = playerGetQueue( playerGetZone(0) );
+  PlaylistSnapshot *snapshot = NULL;
+  PlaylistItem     *item     = NULL;
+  DfbtWidget       *screen   = dfbtGetScreen();
+  int               width, height, border, size;
 
   DBGMSG( "_hmiRenderCurrentItem" );
 
@@ -414,23 +415,29 @@ static void _hmiRenderCurrentItem( void )
   }
 
 /*------------------------------------------------------------------------*\
-    Lock playlist and get current item
+    Get snapshot of playlist and current item, don't block the queue
 \*------------------------------------------------------------------------*/
   if( plst ) {
     playlistLock( plst );
-    item = playlistGetCursorItem( plst );
+    snapshot = playlistGetSnapshot( plst );
+    playlistUnlock( plst );
   }
+  if( snapshot )
+    item = playlistSnapshotGetCursorItem( snapshot );
 
 /*------------------------------------------------------------------------*\
     Show Artwork
 \*------------------------------------------------------------------------*/
   if( item ) {
-    json_t *jObj = playlistItemGetAttribute( item, "image" );
-    if( jObj && json_is_string(jObj) ) {
-      char *uri = ickServiceResolveURI( json_string_value(jObj), "content" );
-      if( uri )
-        wArtwork = dfbtImage( artRect.w, artRect.h, uri, false );
-    }
+    const char *image;
+    char       *uri = NULL;
+    playlistItemLock( item );
+    image = playlistItemGetImageUri( item );
+    if( image )
+      uri = ickServiceResolveURI( image, "content" );
+    playlistItemUnlock( item );
+    if( uri )
+      wArtwork = dfbtImage( artRect.w, artRect.h, uri, false );
   }
   if( !wArtwork )
     wArtwork = dfbtImage( artRect.w, artRect.h, "icklogo.png", true );
@@ -463,10 +470,10 @@ static void _hmiRenderCurrentItem( void )
   }
 
 /*------------------------------------------------------------------------*\
-    Unlock playlist, that's all
+    Release snapshot, that's all
 \*------------------------------------------------------------------------*/
-  if( plst )
-    playlistUnlock( plst );
+  if( snapshot )
+    playlistSnapshotRelease( snapshot );
 }
 
 
@@ -475,9 +482,10 @@ static void _hmiRenderCurrentItem( void )
 \*=========================================================================*/
 static void _hmiRenderPlaybackQueue( void )
 {
-  Playlist     *plst = playerGetQueue( );
-  PlaylistItem *item = NULL;
-  int           width, height, border, i;
+  Playlist         *plst     = playerGetQueue( playerGetZone(0) );
+  PlaylistSnapshot *snapshot = NULL;
+  PlaylistItem     *item     = NULL;
+  int               width, height, border, i;
 
   DBGMSG( "_hmiRenderPlaybackQueue" );
 
@@ -494,12 +502,15 @@ static void _hmiRenderPlaybackQueue( void )
   dfbtContainerRemove( wPlaylist, NULL );
 
 /*------------------------------------------------------------------------*\
-    Lock playlist and get current item
+    Get snapshot of playlist and current item, don't block the queue
 \*------------------------------------------------------------------------*/
   if( plst ) {
     playlistLock( plst );
-    item = playlistGetCursorItem( plst );
+    snapshot = playlistGetSnapshot( plst );
+    playlistUnlock( plst );
   }
+  if( snapshot )
+    item = playlistSnapshotGetCursorItem( snapshot );
 
 /*------------------------------------------------------------------------*\
     Create widgets for playback queue items
@@ -509,27 +520,21 @@ static void _hmiRenderPlaybackQueue( void )
     PlaylistItem *theItem = NULL;
     DfbtWidget   *wItem;
 
-    if( plst ) {
-      pos     = playlistGetCursorPos(plst)-DFB_ITEMS/2 + i;
-      theItem = playlistGetItem( plst, PlaylistMapped, pos );
+    if( snapshot ) {
+      pos     = playlistSnapshotGetCursorPos(snapshot)-DFB_ITEMS/2 + i;
+      theItem = playlistSnapshotGetItem( snapshot, PlaylistMapped, pos );
     }
 
-    if( theItem )
-      playlistItemLock( theItem );
-
     wItem = wPlaylistItem( theItem, pos, width-border, height-border, item && theItem==item );
     dfbtContainerAdd( wPlaylist, wItem, 0, i*height, DfbtAlignTopLeft );
     dfbtRelease( wItem );
-
-    if( theItem )
-      playlistItemUnlock( theItem );
   }
 
 /*------------------------------------------------------------------------*\
-    Unlock playlist, that's all
+    Release snapshot, that's all
 \*------------------------------------------------------------------------*/
-  if( plst )
-    playlistUnlock( plst );
+  if( snapshot )
+    playlistSnapshotRelease( snapshot );
 }
 
 
@@ -567,9 +572,9 @@ static void _hmiRenderConfig( void )
   wTxt = dfbtText( "Player:", font3, &cWhite );
   dfbtContainerAdd( wConfig, wTxt, border, txt_y, DfbtAlignBaseLeft );
   dfbtRelease( wTxt );
-  txt = malloc( 30+strlen(playerGetUUID())+strlen(playerGetName()) );
-  sprintf( txt, "\"%s\", %s (%s)", playerGetName(),
-      ickCloudGetAccessToken()?"registered":"unregistered", playerGetUUID() );
+  txt = malloc( 30+strlen(playerGetUUID(playerGetZone(0)))+strlen(playerGetName(playerGetZone(0))) );
+  sprintf( txt, "\"%s\", %s (%s)", playerGetName(playerGetZone(0)),
+      ickCloudGetAccessToken()?"registered":"unregistered", playerGetUUID(playerGetZone(0)) );
   wTxt = dfbtText( txt, font3, &cWhite );
   dfbtContainerAdd( wConfig, wTxt, txt_x, txt_y, DfbtAlignBaseLeft );
   dfbtRelease( wTxt );
@@ -646,7 +651,7 @@ static void _hmiRenderConfig( void )
 \*=========================================================================*/
 static void _hmiRenderState( void )
 {
-  PlayerState   state  = playerGetState();
+  PlayerState   state  = playerGetState( playerGetZone(0) );
   DfbtWidget   *screen = dfbtGetScreen();
   int           width, height, border;
 
@@ -701,7 +706,7 @@ static void _hmiRenderState( void )
 \*=========================================================================*/
 static void _hmiRenderPlaybackMode( void )
 {
-  PlayerPlaybackMode mode   = playerGetPlaybackMode();
+  PlayerPlaybackMode mode   = playerGetPlaybackMode( playerGetZone(0) );
   DfbtWidget        *screen = dfbtGetScreen();
   int                width, height, border;
 
@@ -776,8 +781,8 @@ static void _hmiRenderPlaybackMode( void )
 \*=========================================================================*/
 static void _hmiRenderVolume( void )
 {
-  double        volume = playerGetVolume();
-  bool          muted  = playerGetMuting();
+  double        volume = playerGetVolume( playerGetZone(0) );
+  bool          muted  = playerGetMuting( playerGetZone(0) );
   DfbtWidget   *screen = dfbtGetScreen();
   int           width, height, border, size, y, a;
   char          buffer[64];
@@ -899,7 +904,7 @@ static void _hmiRenderPositionSlider( void )
 /*------------------------------------------------------------------------*\
     Hide slider if there is no item, total length or we are not playing
 \*------------------------------------------------------------------------*/
-  if( currentLength<=0 || currentSeekPos<0 || playerGetState()==PlayerStateStop ) {
+  if( currentLength<=0 || currentSeekPos<0 || playerGetState(playerGetZone(0))==PlayerStateStop ) {
     if( wPositionIcon && dfbtContainerFind(screen,wPositionIcon) )
       dfbtContainerRemove( screen, wPositionIcon );
     return;
@@ -1249,7 +1254,7 @@ static void *_hmiThread( void *arg )
     lastTime = now;
 
     // Forward position counter
-    if( currentSeekPos>0.0 && playerGetState()==PlayerStatePlay ) {
+    if( currentSeekPos>0.0 && playerGetState(playerGetZone(0))==PlayerStatePlay ) {
       currentSeekPos += delta;
       theUpdates |= HmiElementPositionSlider;
       // theUpdates |= HmiElementPositionString;
@@ -1350,6 +1355,7 @@ static DfbtWidget *wPlaylistItem( PlaylistItem *item, int pos, int width, int he
   DfbtWidget            *wImage;
   json_t                *jObj;
   const char            *txt;
+  char                  *uri;
   char                   buffer[64];
   int                    border = width/100;
   int                    txt_y  = 0;
@@ -1391,11 +1397,14 @@ static DfbtWidget *wPlaylistItem( PlaylistItem *item, int pos, int width, int he
   wNum = dfbtText( buffer, font1, &cWhite );
 
   jObj = playlistItemGetModelAttribute( item, "name" );
+  playlistItemLock( item );
   if( jObj && json_is_string(jObj) )
     txt = json_string_value( jObj );
   else
     txt = playlistItemGetText( item );
   wTxt = dfbtText( txt, font2, &cWhite );
+  playlistItemUnlock( item );
+  json_decref( jObj );
 
   font1->GetMaxAdvance( font1, &a );
   txt_x += 3*a;
@@ -1417,13 +1426,14 @@ static DfbtWidget *wPlaylistItem( PlaylistItem *item, int pos, int width, int he
   txt_y += a;
   jObj = playlistItemGetModelAttribute( item, "album" );
   if( jObj ) {
-    jObj = json_object_get( jObj, "name" );
-    if( jObj && json_is_string(jObj) ) {
-      txt = json_string_value( jObj );
+    json_t *jName = json_object_get( jObj, "name" );
+    if( jName && json_is_string(jName) ) {
+      txt = json_string_value( jName );
       wTxt = dfbtText( txt, font1, &cWhite );
       dfbtContainerAdd( container, wTxt, txt_x, txt_y, DfbtAlignBaseLeft );
       dfbtRelease( wTxt );
     }
+    json_decref( jObj );
   }
   d = playlistItemGetDuration( item );
   if( d ) {
@@ -1474,17 +1484,18 @@ static DfbtWidget *wPlaylistItem( PlaylistItem *item, int pos, int width, int he
       Sfree( str );
     }
   }
+  json_decref( jObj );
 
 /*------------------------------------------------------------------------*\
     Show Artwork
 \*------------------------------------------------------------------------*/
   wImage = NULL;
-  jObj = playlistItemGetAttribute( item, "image" );
-  if( jObj && json_is_string(jObj) ) {
-    char *uri = ickServiceResolveURI( json_string_value(jObj), "content" );
-    if( uri )
-      wImage = dfbtImage( height-2*border, height-2*border, uri, false );
-  }
+  playlistItemLock( item );
+  txt = playlistItemGetImageUri( item );
+  uri = txt ? ickServiceResolveURI( txt, "content" ) : NULL;
+  playlistItemUnlock( item );
+  if( uri )
+    wImage = dfbtImage( height-2*border, height-2*border, uri, false );
  if( !wImage )
     wImage = dfbtImage( height-2*border, height-2*border, "icklogo.png", true );
   dfbtContainerAdd( container, wImage, border, border, DfbtAlignTopLeft );
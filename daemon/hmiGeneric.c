@@ -121,10 +121,10 @@ void hmiNewConfig( void )
   ServiceListItem *service;
 
   DBGMSG( "hmiNewConfig: %s, \"%s\", \"%s\".",
-      playerGetUUID(),  playerGetName(), ickCloudGetAccessToken()?"Cloud":"No Cloud" );
+      playerGetUUID(playerGetZone(0)),  playerGetName(playerGetZone(0)), ickCloudGetAccessToken()?"Cloud":"No Cloud" );
 
-  printf( "HMI Player id        : %s\n", playerGetUUID() );
-  printf( "HMI Player name      : \"%s\"\n", playerGetName() );
+  printf( "HMI Player id        : %s\n", playerGetUUID(playerGetZone(0)) );
+  printf( "HMI Player name      : \"%s\"\n", playerGetName(playerGetZone(0)) );
   printf( "HMI Cloud status     : %s\n", ickCloudGetAccessToken()?"Registered":"Unregistered" );
 
   for( service=ickServiceFind(NULL,NULL,NULL,0); service;
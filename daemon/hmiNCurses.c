@@ -308,12 +308,12 @@ void hmiNewConfig( void )
   ServiceListItem *service;
 
   DBGMSG( "hmiNewConfig: %s, \"%s\", \"%s\".",
-      playerGetUUID(),  playerGetName(), ickCloudGetAccessToken()?"Cloud":"No Cloud" );
+      playerGetUUID(playerGetZone(0)),  playerGetName(playerGetZone(0)), ickCloudGetAccessToken()?"Cloud":"No Cloud" );
 
   pthread_mutex_lock( &mutex );
   wmove( winConfig, 0, 0 );
-  wprintw( winConfig, "Player id    : %s\n", playerGetUUID() );
-  wprintw( winConfig, "Player name  : \"%s\"\n", playerGetName() );
+  wprintw( winConfig, "Player id    : %s\n", playerGetUUID(playerGetZone(0)) );
+  wprintw( winConfig, "Player name  : \"%s\"\n", playerGetName(playerGetZone(0)) );
   wprintw( winConfig, "Cloud status : %s\n", ickCloudGetAccessToken()?"Registered":"Unregistered" );
 
   for( service=ickServiceFind(NULL,NULL,NULL,0); service;
@@ -61,6 +61,7 @@ Remarks         : -
 #include "player.h"
 #include "ickMessage.h"
 #include "ickCloud.h"
+#include "metrics.h"
 
 
 /*=========================================================================*\
@@ -72,27 +73,113 @@ Remarks         : -
 /*=========================================================================*\
     Private definitions and symbols
 \*=========================================================================*/
-typedef struct {
+typedef struct _cloudRequest {
+  struct _cloudRequest *next;
   char              *uri;          // strong
   char              *oAuthToken;   // strong
   char              *method;       // string
   json_t            *jParams;      // strong
   long               id;
+  IckCloudPriority   priority;
+  double             created;
+  double             deadline;
   IckCloudCb         callback;
   void              *userData;     // weak
+  bool               sync;         // caller waits for completion
+  bool               done;
+  json_t            *jResult;      // result of synchronous requests
+  int                rc;
+  int                httpCode;
 } CloudRequest;
 
 static char *_cloudCoreUrl;
 static char *_accessToken;
 
+// Worker pool and request queue (one FIFO per priority)
+#define IckCloudWorkers         2
+#define IckCloudQueueSize       64        // Max. number of queued async requests
+static CloudRequest    *_queueHead[IckCloudPriorities];
+static CloudRequest    *_queueTail[IckCloudPriorities];
+static int              _queueDepth;
+static pthread_mutex_t  _queueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   _queueCond  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   _doneCond   = PTHREAD_COND_INITIALIZER;
+static pthread_t        _workers[IckCloudWorkers];
+static CURL            *_workerCurl[IckCloudWorkers];
+static int              _workersRunning;
+static bool             _workersStop;
+
+// Statistics (protected by _queueMutex)
+static struct {
+  long    submitted;
+  long    completed;
+  long    failed;
+  long    expired;
+  long    rejected;
+  long    cacheHits;
+  long    cacheRevalidated;
+  long    cacheMisses;
+  int     depthMax;
+  double  waitSum;
+  double  waitMax;
+  double  execSum;
+  double  execMax;
+} _stats;
+
+// Response cache: policies per method and cached results
+#define IckCloudCacheSize       64        // Max. number of cached responses
+#define IckCloudCachePersistKey "IckCloudCache"
+#define IckCloudScopeDevice     "device"  // Cache key scope of authorized requests
+#define IckCloudScopePublic     "public"  // Cache key scope of other requests
+typedef struct _cachePolicy {
+  struct _cachePolicy *next;
+  char                *method;
+  double               ttl;
+  bool                 persist;
+} CachePolicy;
+typedef struct _cacheEntry {
+  struct _cacheEntry  *next;
+  char                *key;           // endpoint, token, method and parameters
+  char                *etag;          // might be NULL
+  json_t              *jResult;
+  double               expires;
+  bool                 persist;
+} CacheEntry;
+static CachePolicy     *_cachePolicies;
+static CacheEntry      *_cacheEntries;
+static int              _cacheCount;
+static pthread_mutex_t  _cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
 
 /*=========================================================================*\
     Private prototypes
 \*=========================================================================*/
 static void _registerDeviceCb( const char *method, json_t *jParams, json_t *jResult, int rc, int httpCode, void *userData );
 
+static CloudRequest *_requestNew( const char *uri, const char *oAuthToken, const char *method,
+                                  json_t *jParams, long id, IckCloudPriority priority, double timeout );
+static void    _requestFree( CloudRequest *request );
+static int     _requestEnqueue( CloudRequest *request );
+static void    _requestExecute( CloudRequest *request, CURL *curlHandle );
+static CURL   *_workerHandle( void );
+static void    _metricsCollector( void );
+static void   *_cloudWorkerThread( void *arg );
+static int     _jsonRpcTransact( CURL *curlHandle, const char *uri, const char *oAuthToken, long id,
+                                 const char *method, json_t *jParams, double timeout,
+                                 const char *etag, char **newEtag,
+                                 json_t **jResult, int *httpCode );
+static char   *_httpHeaderValue( const char *headers, size_t len, const char *name );
+
+static const CachePolicy *_cacheGetPolicy( const char *method );
+static char   *_cacheKey( const CloudRequest *request );
+static bool    _cacheKeyIsScoped( const char *key );
+static int     _cacheLookup( CloudRequest *request, const char *key, char **etag );
+static void    _cacheStore( const char *key, const char *etag, json_t *jResult, const CachePolicy *policy );
+static void    _cacheRefresh( CloudRequest *request, const char *key, const CachePolicy *policy );
+static void    _cacheFreeEntry( CacheEntry *entry );
+static void    _cacheLoad( void );
+static void    _cachePersist( void );
 static size_t  _curlWriteCallback( void *buffer, size_t size, size_t nmemb, void *userp );
-static void   *_cloudRequestThread( void *arg );
 
 
 /*=========================================================================*\
@@ -103,6 +190,11 @@ int ickCloudInit( void )
   const char *val;
   DBGMSG( "Initializing cloud module..." );
 
+/*------------------------------------------------------------------------*\
+    cURL global init is not thread safe, so do it before workers start
+\*------------------------------------------------------------------------*/
+  curl_global_init( CURL_GLOBAL_ALL );
+
 /*------------------------------------------------------------------------*\
     Get core URL
 \*------------------------------------------------------------------------*/
@@ -119,6 +211,17 @@ int ickCloudInit( void )
    if( val )
      _accessToken = strdup( val );
 
+/*------------------------------------------------------------------------*\
+    Default cache policies, restore persisted responses
+\*------------------------------------------------------------------------*/
+  ickCloudCacheSetPolicy( "findServices", 24*3600, true );
+  _cacheLoad();
+
+/*------------------------------------------------------------------------*\
+    Report queue length with metrics
+\*------------------------------------------------------------------------*/
+  metricsRegisterCollector( _metricsCollector );
+
 /*------------------------------------------------------------------------*\
     That's all
 \*------------------------------------------------------------------------*/
@@ -131,8 +234,62 @@ int ickCloudInit( void )
 \*=========================================================================*/
 void ickCloudShutdown( void )
 {
+  CloudRequest *request;
+  int           i, dropped = 0;
+
   DBGMSG( "Shutting down cloud module..." );
 
+/*------------------------------------------------------------------------*\
+    Stop workers and discard queued requests. Callbacks of asynchronous
+    requests are not called any more, waiting synchronous callers get an error.
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &_queueMutex );
+  _workersStop = true;
+  for( i=IckCloudPriorities-1; i>=0; i-- ) {
+    while( (request=_queueHead[i]) ) {
+      _queueHead[i] = request->next;
+      if( request->sync ) {
+        request->rc   = -1;
+        request->done = true;
+      }
+      else {
+        _requestFree( request );
+        dropped++;
+      }
+    }
+    _queueTail[i] = NULL;
+  }
+  _queueDepth = 0;
+  pthread_cond_broadcast( &_queueCond );
+  pthread_cond_broadcast( &_doneCond );
+  pthread_mutex_unlock( &_queueMutex );
+  if( dropped )
+    logwarn( "ickCloudShutdown: dropped %d queued requests.", dropped );
+
+/*------------------------------------------------------------------------*\
+    Wait for transactions in progress
+\*------------------------------------------------------------------------*/
+  for( i=0; i<_workersRunning; i++ )
+    pthread_join( _workers[i], NULL );
+  _workersRunning = 0;
+
+  loginfo( "ickCloudShutdown: %ld requests, %ld failed, %ld expired, %ld rejected, "
+           "max. queue depth %d, max. wait %.3fs, max. execution %.3fs",
+           _stats.submitted, _stats.failed, _stats.expired, _stats.rejected,
+           _stats.depthMax, _stats.waitMax, _stats.execMax );
+
+/*------------------------------------------------------------------------*\
+    Free cache (persisted entries are already in the repository)
+\*------------------------------------------------------------------------*/
+  ickCloudCacheFlush( false );
+  pthread_mutex_lock( &_cacheMutex );
+  while( _cachePolicies ) {
+    CachePolicy *policy = _cachePolicies;
+    _cachePolicies = policy->next;
+    Sfree( policy->method );
+    Sfree( policy );
+  }
+  pthread_mutex_unlock( &_cacheMutex );
 }
 
 
@@ -242,10 +399,11 @@ int ickCloudRegisterDevice( const char *token )
   DBGMSG( "ickCloudRegisterDevice: %s", token?token:"(nil)" );
 
 /*------------------------------------------------------------------------*\
-    Reset old access token
+    Reset old access token, cached responses might belong to another user
 \*------------------------------------------------------------------------*/
   if( ickCloudSetAccessToken(NULL) )
     return -1;
+  ickCloudCacheFlush( true );
 
 /*------------------------------------------------------------------------*\
     Prepare cloud request parameters
@@ -268,7 +426,8 @@ int ickCloudRegisterDevice( const char *token )
 /*------------------------------------------------------------------------*\
     Fire off request, set callback
 \*------------------------------------------------------------------------*/
-  rc = ickCloudRequestAsync( NULL, token, "addDevice", jParams, _registerDeviceCb, NULL );
+  rc = ickCloudRequestAsyncPrio( NULL, token, "addDevice", jParams, IckCloudPriorityHigh,
+                                 IckCloudDefaultTimeout, _registerDeviceCb, NULL );
   if( rc )
     logerr( "ickCloudRegisterDevice: Could not register device (%d).", rc );
 
@@ -289,7 +448,7 @@ static void _registerDeviceCb( const char *method, json_t *jParams, json_t *jRes
 \*------------------------------------------------------------------------*/
   if( rc || !jResult ) {
     loginfo( "_registerDeviceCb: cloud transaction unsuccessful" );
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( NULL, NULL );
     return;
   }
 
@@ -299,7 +458,7 @@ static void _registerDeviceCb( const char *method, json_t *jParams, json_t *jRes
   jObj = json_object_get( jResult, "error" );
   if( jObj ) {
     loginfo( "_registerDeviceCb: Error %s.", json_rpcerrstr(jObj) );
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( NULL, NULL );
     return;
   }
 
@@ -309,7 +468,7 @@ static void _registerDeviceCb( const char *method, json_t *jParams, json_t *jRes
   jResult = json_object_get( jResult, "result" );
   if( !jResult ) {
     logerr( "_registerDeviceCb: No \"result\" object in answer." );
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( NULL, NULL );
     return;
   }
 
@@ -319,12 +478,12 @@ static void _registerDeviceCb( const char *method, json_t *jParams, json_t *jRes
   jObj = json_object_get( jResult, "accessToken" );
   if( !jObj || !json_is_string(jObj) )  {
     logerr( "_registerDeviceCb: missing field \"accessToken\"." );
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( NULL, NULL );
     return;
   }
   if( ickCloudSetAccessToken(json_string_value(jObj)) ) {
     logerr( "_registerDeviceCb: could not set \"accessToken\"." );
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( NULL, NULL );
     return;
   }
 
@@ -333,7 +492,7 @@ static void _registerDeviceCb( const char *method, json_t *jParams, json_t *jRes
 \*------------------------------------------------------------------------*/
   jObj = json_object_get( jResult, "name" );
   if( jObj && json_is_string(jObj) )
-    playerSetName( json_string_value(jObj), false );
+    playerSetName( playerGetZone(0), json_string_value(jObj), false );
   else if( jObj )
     logerr( "_registerDeviceCb: field \"name\" is not a string" );
 
@@ -349,7 +508,7 @@ static void _registerDeviceCb( const char *method, json_t *jParams, json_t *jRes
 /*------------------------------------------------------------------------*\
     Send notification about new device state, that's all
 \*------------------------------------------------------------------------*/
-  ickMessageNotifyPlayerState( NULL );
+  ickMessageNotifyPlayerState( NULL, NULL );
 }
 
 
@@ -374,7 +533,7 @@ int ickCloudSetDeviceAddress( void )
 /*------------------------------------------------------------------------*\
     ... and Id ...
 \*------------------------------------------------------------------------*/
-  deviceId = playerGetUUID();
+  deviceId = playerGetUUID( playerGetZone(0) );
 
 /*------------------------------------------------------------------------*\
     ... and address
@@ -406,7 +565,7 @@ int ickCloudSetDeviceAddress( void )
   if( httpCode==401 ) {
     loginfo( "ickCloudSetDeviceAddress: not authorized" );
     ickCloudSetAccessToken( NULL );
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( NULL, NULL );
     return 0;
   }
 
@@ -422,22 +581,65 @@ int ickCloudSetDeviceAddress( void )
 /*=========================================================================*\
     Send a JSON request (synchronous mode)
       uri can b NULL to use the standard ickstream cloud endpoint
+      The request is executed by the cloud workers, the caller is blocked
+      until it is done.
 \*=========================================================================*/
 json_t *ickCloudRequestSync( const char *uri, const char *oAuthToken, const char *method, json_t *jParams, int *httpCode )
 {
-  json_t *jResult;
-  long    id;
-  int     rc;
-
-  // Get ID
-  id = getAndIncrementCounter();
+  CloudRequest *request;
+  json_t       *jResult;
 
-  // Do transaction
-  rc = jsonRpcTransact( uri, oAuthToken, id, method, jParams, &jResult, httpCode );
-  if( rc )
+/*------------------------------------------------------------------------*\
+    Create request, sync requests preempt queued async ones
+\*------------------------------------------------------------------------*/
+  request = _requestNew( uri, oAuthToken, method, jParams, getAndIncrementCounter(),
+                         IckCloudPriorityHigh, IckCloudDefaultTimeout );
+  if( !request ) {
+    if( httpCode )
+      *httpCode = 0;
     return NULL;
+  }
+  request->sync = true;
+
+/*------------------------------------------------------------------------*\
+    Try to serve from cache without involving the workers
+\*------------------------------------------------------------------------*/
+  if( _cacheGetPolicy(method) ) {
+    char *key = _cacheKey( request );
+    if( key && !_cacheLookup(request,key,NULL) ) {
+      request->done = true;
+      pthread_mutex_lock( &_queueMutex );
+      _stats.cacheHits++;
+      pthread_mutex_unlock( &_queueMutex );
+    }
+    Sfree( key );
+  }
+
+/*------------------------------------------------------------------------*\
+    Queue and wait for completion, or execute directly if we are a worker
+    ourselves (e.g. called from a callback) or the pool is not available
+\*------------------------------------------------------------------------*/
+  if( !request->done ) {
+    if( _workerHandle() || _requestEnqueue(request) )
+      _requestExecute( request, _workerHandle() );
+    else {
+      pthread_mutex_lock( &_queueMutex );
+      while( !request->done )
+        pthread_cond_wait( &_doneCond, &_queueMutex );
+      pthread_mutex_unlock( &_queueMutex );
+    }
+  }
 
-  // Return result
+/*------------------------------------------------------------------------*\
+    Collect result and clean up
+\*------------------------------------------------------------------------*/
+  if( httpCode )
+    *httpCode = request->httpCode;
+  jResult = request->rc ? NULL : request->jResult;
+  if( request->rc && request->jResult )
+    json_decref( request->jResult );
+  request->jResult = NULL;
+  _requestFree( request );
   return jResult;
 }
 
@@ -448,7 +650,27 @@ json_t *ickCloudRequestSync( const char *uri, const char *oAuthToken, const char
 \*=========================================================================*/
 int ickCloudNotify( const char *uri, const char *oAuthToken, const char *method, json_t *jParams )
 {
-  return jsonRpcTransact( uri, oAuthToken, 0, method, jParams, NULL, NULL );
+  CloudRequest *request;
+  int           rc;
+
+  request = _requestNew( uri, oAuthToken, method, jParams, 0,
+                         IckCloudPriorityHigh, IckCloudDefaultTimeout );
+  if( !request )
+    return -1;
+  request->sync = true;
+
+  if( _workerHandle() || _requestEnqueue(request) )
+    _requestExecute( request, _workerHandle() );
+  else {
+    pthread_mutex_lock( &_queueMutex );
+    while( !request->done )
+      pthread_cond_wait( &_doneCond, &_queueMutex );
+    pthread_mutex_unlock( &_queueMutex );
+  }
+
+  rc = request->rc;
+  _requestFree( request );
+  return rc;
 }
 
 
@@ -458,106 +680,810 @@ int ickCloudNotify( const char *uri, const char *oAuthToken, const char *method,
 \*=========================================================================*/
 int ickCloudRequestAsync( const char *uri, const char *oAuthToken, const char *method,
                           json_t *jParams, IckCloudCb callback, void *userData )
+{
+  return ickCloudRequestAsyncPrio( uri, oAuthToken, method, jParams,
+                                   IckCloudPriorityNormal, IckCloudDefaultTimeout,
+                                   callback, userData );
+}
+
+
+/*=========================================================================*\
+    Send a JSON request (asynchronous mode) with priority and deadline
+      uri      - can be NULL to use the standard ickstream cloud endpoint
+      priority - requests are served highest priority first, FIFO otherwise
+      timeout  - seconds from now, the callback gets rc -1 and httpCode 0
+                 if the request could not be completed in time
+    returns -1 on error (e.g. queue full), the callback is not called then
+\*=========================================================================*/
+int ickCloudRequestAsyncPrio( const char *uri, const char *oAuthToken, const char *method,
+                              json_t *jParams, IckCloudPriority priority, double timeout,
+                              IckCloudCb callback, void *userData )
 {
   CloudRequest *request;
-  pthread_t     thread;
-  long          id;
-  int           rc;
 
 /*------------------------------------------------------------------------*\
-    Get id
+    Create and init request object
 \*------------------------------------------------------------------------*/
-  id = getAndIncrementCounter();
+  request = _requestNew( uri, oAuthToken, method, jParams, getAndIncrementCounter(),
+                         priority, timeout );
+  if( !request )
+    return -1;
+  request->callback = callback;
+  request->userData = userData;
 
 /*------------------------------------------------------------------------*\
-    Create and init request object
+    Queue it
+\*------------------------------------------------------------------------*/
+  if( _requestEnqueue(request) ) {
+    _requestFree( request );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    That's it
+\*------------------------------------------------------------------------*/
+  return 0;
+}
+
+
+/*=========================================================================*\
+    Get statistics of cloud request engine
+      caller must decref the result
+\*=========================================================================*/
+json_t *ickCloudGetStatistics( void )
+{
+  json_t *jResult;
+  long    executed;
+
+  pthread_mutex_lock( &_queueMutex );
+  executed = _stats.completed + _stats.failed;
+  jResult = json_pack( "{sisisisisisisisisisisisfsfsfsf}",
+                       "workers",    _workersRunning,
+                       "queueDepth", _queueDepth,
+                       "queueMax",   _stats.depthMax,
+                       "submitted",  _stats.submitted,
+                       "completed",  _stats.completed,
+                       "failed",     _stats.failed,
+                       "expired",    _stats.expired,
+                       "rejected",   _stats.rejected,
+                       "cacheHits",  _stats.cacheHits,
+                       "cacheRevalidated", _stats.cacheRevalidated,
+                       "cacheMisses", _stats.cacheMisses,
+                       "waitAvg",    executed ? _stats.waitSum/executed : 0.0,
+                       "waitMax",    _stats.waitMax,
+                       "execAvg",    executed ? _stats.execSum/executed : 0.0,
+                       "execMax",    _stats.execMax );
+  pthread_mutex_unlock( &_queueMutex );
+
+  return jResult;
+}
+
+
+/*=========================================================================*\
+    Set cache policy for a method
+      ttl     - time to live of responses in seconds, <=0 disables caching
+      persist - store responses in the persistence repository, so they
+                survive a restart
+    returns -1 on error
+\*=========================================================================*/
+int ickCloudCacheSetPolicy( const char *method, double ttl, bool persist )
+{
+  CachePolicy **link;
+  CachePolicy  *policy;
+
+  DBGMSG( "ickCloudCacheSetPolicy (%s): ttl=%.0fs persist=%s",
+          method, ttl, persist?"On":"Off" );
+
+  pthread_mutex_lock( &_cacheMutex );
+
+/*------------------------------------------------------------------------*\
+    Find existing policy
+\*------------------------------------------------------------------------*/
+  for( link=&_cachePolicies; *link; link=&(*link)->next ) {
+    if( !strcmp((*link)->method,method) )
+      break;
+  }
+  policy = *link;
+
+/*------------------------------------------------------------------------*\
+    Disable caching for method
+\*------------------------------------------------------------------------*/
+  if( ttl<=0 ) {
+    if( policy ) {
+      *link = policy->next;
+      Sfree( policy->method );
+      Sfree( policy );
+    }
+    pthread_mutex_unlock( &_cacheMutex );
+    return 0;
+  }
+
+/*------------------------------------------------------------------------*\
+    Create new policy
+\*------------------------------------------------------------------------*/
+  if( !policy ) {
+    policy = calloc( 1, sizeof(CachePolicy) );
+    if( policy )
+      policy->method = strdup( method );
+    if( !policy || !policy->method ) {
+      pthread_mutex_unlock( &_cacheMutex );
+      logerr( "ickCloudCacheSetPolicy (%s): out of memory!", method );
+      Sfree( policy );
+      return -1;
+    }
+    policy->next   = _cachePolicies;
+    _cachePolicies = policy;
+  }
+
+/*------------------------------------------------------------------------*\
+    Set values, that's all
+\*------------------------------------------------------------------------*/
+  policy->ttl     = ttl;
+  policy->persist = persist;
+  pthread_mutex_unlock( &_cacheMutex );
+  return 0;
+}
+
+
+/*=========================================================================*\
+    Drop all cached responses
+      persist - also remove persisted responses from repository
+\*=========================================================================*/
+void ickCloudCacheFlush( bool persist )
+{
+  DBGMSG( "ickCloudCacheFlush: %d entries", _cacheCount );
+
+  pthread_mutex_lock( &_cacheMutex );
+  while( _cacheEntries ) {
+    CacheEntry *entry = _cacheEntries;
+    _cacheEntries = entry->next;
+    _cacheFreeEntry( entry );
+  }
+  _cacheCount = 0;
+  pthread_mutex_unlock( &_cacheMutex );
+
+  if( persist )
+    persistRemove( IckCloudCachePersistKey );
+}
+
+
+/*=========================================================================*\
+    Get cache policy for a method
+      returns NULL if responses are not to be cached
+      Policies are only removed on shutdown, so the result stays valid
+\*=========================================================================*/
+static const CachePolicy *_cacheGetPolicy( const char *method )
+{
+  CachePolicy *policy;
+
+  pthread_mutex_lock( &_cacheMutex );
+  for( policy=_cachePolicies; policy; policy=policy->next ) {
+    if( !strcmp(policy->method,method) )
+      break;
+  }
+  pthread_mutex_unlock( &_cacheMutex );
+
+  return policy;
+}
+
+
+/*=========================================================================*\
+    Build cache key from endpoint, scope, method and canonicalized parameters
+      The token is not part of the key: it changes on every registration and
+      keys are persisted. Authorized requests are scoped to this device,
+      the cache is flushed if the device is registered anew.
+      returns an allocated string or NULL on error
+\*=========================================================================*/
+static char *_cacheKey( const CloudRequest *request )
+{
+  const char *uri    = request->uri ? request->uri : ickCloudGetCoreUrl();
+  const char *scope  = request->oAuthToken ? IckCloudScopeDevice : IckCloudScopePublic;
+  char       *params = NULL;
+  char       *key;
+
+  if( request->jParams )
+    params = json_dumps( request->jParams, JSON_SORT_KEYS | JSON_COMPACT | JSON_ENSURE_ASCII );
+
+  key = malloc( strlen(uri)+strlen(scope)+strlen(request->method)+(params?strlen(params):4)+4 );
+  if( !key ) {
+    logerr( "ickCloudRequest (%s): out of memory!", request->method );
+    Sfree( params );
+    return NULL;
+  }
+  sprintf( key, "%s\n%s\n%s\n%s", uri, scope, request->method, params?params:"null" );
+
+  Sfree( params );
+  return key;
+}
+
+
+/*=========================================================================*\
+    Check if a persisted key has a scope (in its second line)
+\*=========================================================================*/
+static bool _cacheKeyIsScoped( const char *key )
+{
+  const char *scope = strchr( key, '\n' );
+  const char *end;
+
+  if( !scope++ )
+    return false;
+  end = strchr( scope, '\n' );
+  if( !end )
+    return false;
+
+  return ( end-scope==strlen(IckCloudScopeDevice) && !strncmp(scope,IckCloudScopeDevice,end-scope) ) ||
+         ( end-scope==strlen(IckCloudScopePublic) && !strncmp(scope,IckCloudScopePublic,end-scope) );
+}
+
+
+/*=========================================================================*\
+    Serve a request from cache
+      etag - pointer to ETag of a stale entry, caller must free (might be NULL)
+    returns 0 if a fresh entry was found, the request is completed then
+\*=========================================================================*/
+static int _cacheLookup( CloudRequest *request, const char *key, char **etag )
+{
+  CacheEntry **link;
+  CacheEntry  *entry;
+  int          rc = -1;
+
+  pthread_mutex_lock( &_cacheMutex );
+
+/*------------------------------------------------------------------------*\
+    Find entry and move it to front (least recently used ones are at the end)
+\*------------------------------------------------------------------------*/
+  for( link=&_cacheEntries; *link; link=&(*link)->next ) {
+    if( !strcmp((*link)->key,key) )
+      break;
+  }
+  entry = *link;
+  if( entry ) {
+    *link         = entry->next;
+    entry->next   = _cacheEntries;
+    _cacheEntries = entry;
+  }
+
+/*------------------------------------------------------------------------*\
+    Fresh hit: complete request with copy of cached result
+\*------------------------------------------------------------------------*/
+  if( entry && entry->expires>srvtime() ) {
+    request->jResult  = json_deep_copy( entry->jResult );
+    request->rc       = request->jResult ? 0 : -1;
+    request->httpCode = 200;
+    rc = 0;
+  }
+
+/*------------------------------------------------------------------------*\
+    Stale: provide ETag for conditional request
+\*------------------------------------------------------------------------*/
+  else if( entry && entry->etag && etag )
+    *etag = strdup( entry->etag );
+  pthread_mutex_unlock( &_cacheMutex );
+
+  DBGMSG( "ickCloudRequest (%p,%s): cache %s.",
+          request, request->method, rc?"miss":"hit" );
+  return rc;
+}
+
+
+/*=========================================================================*\
+    Add or replace a cache entry
+\*=========================================================================*/
+static void _cacheStore( const char *key, const char *etag, json_t *jResult, const CachePolicy *policy )
+{
+  CacheEntry **link;
+  CacheEntry  *entry;
+
+  pthread_mutex_lock( &_cacheMutex );
+
+/*------------------------------------------------------------------------*\
+    Remove existing entry
+\*------------------------------------------------------------------------*/
+  for( link=&_cacheEntries; *link; link=&(*link)->next ) {
+    if( !strcmp((*link)->key,key) ) {
+      entry = *link;
+      *link = entry->next;
+      _cacheFreeEntry( entry );
+      _cacheCount--;
+      break;
+    }
+  }
+
+/*------------------------------------------------------------------------*\
+    Create new entry
+\*------------------------------------------------------------------------*/
+  entry = calloc( 1, sizeof(CacheEntry) );
+  if( entry ) {
+    entry->key     = strdup( key );
+    entry->etag    = etag ? strdup( etag ) : NULL;
+    entry->jResult = json_deep_copy( jResult );
+    entry->expires = srvtime() + policy->ttl;
+    entry->persist = policy->persist;
+  }
+  if( !entry || !entry->key || (etag&&!entry->etag) || !entry->jResult ) {
+    pthread_mutex_unlock( &_cacheMutex );
+    logerr( "ickCloudRequest: out of memory!" );
+    if( entry )
+      _cacheFreeEntry( entry );
+    return;
+  }
+
+/*------------------------------------------------------------------------*\
+    Link to front, evict least recently used entry if cache is full
 \*------------------------------------------------------------------------*/
+  entry->next   = _cacheEntries;
+  _cacheEntries = entry;
+  if( ++_cacheCount>IckCloudCacheSize ) {
+    for( link=&_cacheEntries; (*link)->next; link=&(*link)->next )
+      ;
+    _cacheFreeEntry( *link );
+    *link = NULL;
+    _cacheCount--;
+  }
+  pthread_mutex_unlock( &_cacheMutex );
+
+/*------------------------------------------------------------------------*\
+    Update persisted entries
+\*------------------------------------------------------------------------*/
+  if( policy->persist )
+    _cachePersist();
+}
+
+
+/*=========================================================================*\
+    Revalidated entry (server answered "not modified"): renew and use it
+\*=========================================================================*/
+static void _cacheRefresh( CloudRequest *request, const char *key, const CachePolicy *policy )
+{
+  CacheEntry *entry;
+
+  pthread_mutex_lock( &_cacheMutex );
+  for( entry=_cacheEntries; entry; entry=entry->next ) {
+    if( !strcmp(entry->key,key) )
+      break;
+  }
+  if( entry ) {
+    entry->expires    = srvtime() + policy->ttl;
+    request->jResult  = json_deep_copy( entry->jResult );
+  }
+  pthread_mutex_unlock( &_cacheMutex );
+
+  // Entry vanished in the meantime?
+  if( !request->jResult ) {
+    logwarn( "ickCloudRequest (%s): not modified, but no cached result.", request->method );
+    request->rc = -1;
+    return;
+  }
+  request->httpCode = 200;
+
+  pthread_mutex_lock( &_queueMutex );
+  _stats.cacheRevalidated++;
+  pthread_mutex_unlock( &_queueMutex );
+
+  if( policy->persist )
+    _cachePersist();
+}
+
+
+/*=========================================================================*\
+    Free a cache entry
+\*=========================================================================*/
+static void _cacheFreeEntry( CacheEntry *entry )
+{
+  Sfree( entry->key );
+  Sfree( entry->etag );
+  if( entry->jResult )
+    json_decref( entry->jResult );
+  Sfree( entry );
+}
+
+
+/*=========================================================================*\
+    Restore persisted cache entries
+\*=========================================================================*/
+static void _cacheLoad( void )
+{
+  json_t *jEntries = persistGetJSON( IckCloudCachePersistKey );
+  double  now      = srvtime();
+  int     legacy   = 0;
+  int     i;
+
+  if( !jEntries || !json_is_array(jEntries) )
+    return;
+
+  pthread_mutex_lock( &_cacheMutex );
+  for( i=json_array_size(jEntries)-1; i>=0 && _cacheCount<IckCloudCacheSize; i-- ) {
+    json_t     *jEntry   = json_array_get( jEntries, i );
+    json_t     *jKey     = json_object_get( jEntry, "key" );
+    json_t     *jEtag    = json_object_get( jEntry, "etag" );
+    json_t     *jExpires = json_object_get( jEntry, "expires" );
+    json_t     *jResult  = json_object_get( jEntry, "result" );
+    CacheEntry *entry;
+
+    // Skip corrupt or expired entries (unless they can be revalidated)
+    if( !json_is_string(jKey) || !json_is_number(jExpires) || !json_is_object(jResult) )
+      continue;
+
+    // Skip entries of older versions, their keys contain the access token
+    if( !_cacheKeyIsScoped(json_string_value(jKey)) ) {
+      legacy++;
+      continue;
+    }
+    if( json_number_value(jExpires)<=now && !json_is_string(jEtag) )
+      continue;
+
+    entry = calloc( 1, sizeof(CacheEntry) );
+    if( !entry ) {
+      logerr( "ickCloudInit: out of memory!" );
+      break;
+    }
+    entry->key     = strdup( json_string_value(jKey) );
+    entry->etag    = json_is_string(jEtag) ? strdup( json_string_value(jEtag) ) : NULL;
+    entry->jResult = json_deep_copy( jResult );
+    entry->expires = json_number_value( jExpires );
+    entry->persist = true;
+    entry->next    = _cacheEntries;
+    _cacheEntries  = entry;
+    _cacheCount++;
+  }
+  pthread_mutex_unlock( &_cacheMutex );
+
+  DBGMSG( "ickCloudInit: restored %d cached responses.", _cacheCount );
+
+/*------------------------------------------------------------------------*\
+    Remove tokens of legacy entries from repository
+\*------------------------------------------------------------------------*/
+  if( legacy ) {
+    loginfo( "ickCloudInit: dropped %d cached responses of an older version.", legacy );
+    _cachePersist();
+  }
+}
+
+
+/*=========================================================================*\
+    Store cache entries to be persisted in repository (most recent first)
+\*=========================================================================*/
+static void _cachePersist( void )
+{
+  json_t     *jEntries = json_array();
+  CacheEntry *entry;
+
+  pthread_mutex_lock( &_cacheMutex );
+  for( entry=_cacheEntries; entry; entry=entry->next ) {
+    json_t *jEntry;
+    if( !entry->persist )
+      continue;
+    jEntry = json_pack( "{sssfso}",                  // no shared references
+                        "key",     entry->key,
+                        "expires", entry->expires,
+                        "result",  json_deep_copy(entry->jResult) );
+    if( entry->etag )
+      json_object_set_new( jEntry, "etag", json_string(entry->etag) );
+    json_array_append_new( jEntries, jEntry );
+  }
+  pthread_mutex_unlock( &_cacheMutex );
+
+  persistSetJSON_new( IckCloudCachePersistKey, jEntries );
+}
+
+
+/*=========================================================================*\
+    Create a request object
+      returns NULL on error
+\*=========================================================================*/
+static CloudRequest *_requestNew( const char *uri, const char *oAuthToken, const char *method,
+                                  json_t *jParams, long id, IckCloudPriority priority, double timeout )
+{
+  CloudRequest *request;
+
   request = calloc( 1, sizeof(CloudRequest) );
   if( !request ) {
-    logerr( "ickCloudRequestAsync (%s): out of memory!", method );
-    return -1;
+    logerr( "ickCloudRequest (%s): out of memory!", method );
+    return NULL;
   }
   request->uri        = uri ? strdup( uri ) : NULL;
-  request->oAuthToken = strdup( oAuthToken );
+  request->oAuthToken = oAuthToken ? strdup( oAuthToken ) : NULL;
   request->method     = strdup( method );
-  request->jParams    = json_incref( jParams );
+  request->jParams    = jParams ? json_incref( jParams ) : NULL;
   request->id         = id;
-  request->callback   = callback;
-  request->userData   = userData;
+  request->priority   = priority;
+  request->created    = srvtime();
+  request->deadline   = request->created + timeout;
+  if( (uri && !request->uri) || (oAuthToken && !request->oAuthToken) || !request->method ) {
+    logerr( "ickCloudRequest (%s): out of memory!", method );
+    _requestFree( request );
+    return NULL;
+  }
+
+  pthread_mutex_lock( &_queueMutex );
+  _stats.submitted++;
+  pthread_mutex_unlock( &_queueMutex );
+  return request;
+}
+
+
+/*=========================================================================*\
+    Free a request object
+\*=========================================================================*/
+static void _requestFree( CloudRequest *request )
+{
+  if( request->jParams )
+    json_decref( request->jParams );
+  if( request->jResult )
+    json_decref( request->jResult );
+  Sfree( request->uri );
+  Sfree( request->oAuthToken );
+  Sfree( request->method );
+  Sfree( request );
+}
+
+
+/*=========================================================================*\
+    Queue a request, start workers if necessary
+      returns -1 on error (queue full or pool not available)
+\*=========================================================================*/
+static int _requestEnqueue( CloudRequest *request )
+{
+  int perr;
+
+  pthread_mutex_lock( &_queueMutex );
 
 /*------------------------------------------------------------------------*\
-    Create thread
+    Shutting down?
 \*------------------------------------------------------------------------*/
-  rc = pthread_create( &thread, NULL, _cloudRequestThread, request );
-  if( rc ) {
-    logerr( "ickCloudRequestAsync (%s): Unable to start request thread (%s).", method, strerror(rc) );
-    json_decref( jParams );
-    Sfree( request->uri );
-    Sfree( request->oAuthToken );
-    Sfree( request->method );
-    Sfree( request );
+  if( _workersStop ) {
+    pthread_mutex_unlock( &_queueMutex );
+    logwarn( "ickCloudRequest (%s): module is shut down.", request->method );
     return -1;
   }
 
 /*------------------------------------------------------------------------*\
-    We don't care for that thread any more
+    Bound the queue for asynchronous requests (sync callers are blocked anyway)
 \*------------------------------------------------------------------------*/
-  rc = pthread_detach( thread );
-  if( rc )
-    logerr( "ickCloudRequestAsync (%s): Unable to detach request thread (%s).", method, strerror(rc) );
+  if( !request->sync && _queueDepth>=IckCloudQueueSize ) {
+    _stats.rejected++;
+    pthread_mutex_unlock( &_queueMutex );
+    logwarn( "ickCloudRequest (%s): queue is full (%d requests).",
+             request->method, IckCloudQueueSize );
+    return -1;
+  }
 
 /*------------------------------------------------------------------------*\
-    That's it
+    Lazily start workers
+\*------------------------------------------------------------------------*/
+  while( _workersRunning<IckCloudWorkers ) {
+    perr = pthread_create( &_workers[_workersRunning], NULL, _cloudWorkerThread,
+                           (void*)(long)_workersRunning );
+    if( perr ) {
+      logerr( "ickCloudRequest: Unable to start worker thread (%s).", strerror(perr) );
+      break;
+    }
+    _workersRunning++;
+  }
+  if( !_workersRunning ) {
+    pthread_mutex_unlock( &_queueMutex );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Append to queue of priority and wake up a worker
 \*------------------------------------------------------------------------*/
+  request->next = NULL;
+  if( _queueTail[request->priority] )
+    _queueTail[request->priority]->next = request;
+  else
+    _queueHead[request->priority] = request;
+  _queueTail[request->priority] = request;
+  _queueDepth++;
+  if( _queueDepth>_stats.depthMax )
+    _stats.depthMax = _queueDepth;
+  pthread_cond_signal( &_queueCond );
+  pthread_mutex_unlock( &_queueMutex );
+
+  DBGMSG( "ickCloudRequest (%p,%s): queued with priority %d (depth %d).",
+          request, request->method, request->priority, _queueDepth );
   return 0;
 }
 
 
 /*=========================================================================*\
-       A thread for an asynchronous cloud request
+    Execute a request and account for statistics
+      curlHandle might be NULL
 \*=========================================================================*/
-static void *_cloudRequestThread( void *arg )
+static void _requestExecute( CloudRequest *request, CURL *curlHandle )
 {
-  CloudRequest *request = (CloudRequest*)arg;
-  int           rc;
-  json_t       *jResult = NULL;
-  int           httpCode;
+  double             start  = srvtime();
+  double             end;
+  const CachePolicy *policy = NULL;
+  char              *key    = NULL;
+  char              *etag   = NULL;
+  char              *newEtag = NULL;
+
+/*------------------------------------------------------------------------*\
+    Cacheable request: serve fresh entry or get ETag for revalidation
+\*------------------------------------------------------------------------*/
+  if( request->id )
+    policy = _cacheGetPolicy( request->method );
+  if( policy ) {
+    key = _cacheKey( request );
+    if( key && !_cacheLookup(request,key,&etag) ) {
+      pthread_mutex_lock( &_queueMutex );
+      _stats.cacheHits++;
+      pthread_mutex_unlock( &_queueMutex );
+      Sfree( key );
+      return;
+    }
+    pthread_mutex_lock( &_queueMutex );
+    _stats.cacheMisses++;
+    pthread_mutex_unlock( &_queueMutex );
+  }
+
+/*------------------------------------------------------------------------*\
+    Deadline passed while waiting?
+\*------------------------------------------------------------------------*/
+  if( start>=request->deadline ) {
+    logwarn( "ickCloudRequest (%s): deadline expired after %.3fs in queue.",
+             request->method, start-request->created );
+    request->rc       = -1;
+    request->httpCode = 0;
+    pthread_mutex_lock( &_queueMutex );
+    _stats.expired++;
+    pthread_mutex_unlock( &_queueMutex );
+    Sfree( key );
+    Sfree( etag );
+    return;
+  }
+
+/*------------------------------------------------------------------------*\
+    Do the transaction within the remaining time
+\*------------------------------------------------------------------------*/
+  request->rc = _jsonRpcTransact( curlHandle, request->uri, request->oAuthToken, request->id,
+                                  request->method, request->jParams, request->deadline-start,
+                                  etag, key ? &newEtag : NULL,
+                                  request->id ? &request->jResult : NULL, &request->httpCode );
+  end = srvtime();
+  DBGMSG( "ickCloudRequest (%p,%s): Performed request (%d) in %.3fs.",
+          request, request->method, request->rc, end-start );
+
+/*------------------------------------------------------------------------*\
+    Update cache: entry not modified or new valid result
+\*------------------------------------------------------------------------*/
+  if( key && !request->rc ) {
+    if( request->httpCode==304 && etag )
+      _cacheRefresh( request, key, policy );
+    else if( request->httpCode==200 && request->jResult &&
+             json_object_get(request->jResult,"result") &&
+             !json_object_get(request->jResult,"error") )
+      _cacheStore( key, newEtag, request->jResult, policy );
+  }
+  Sfree( key );
+  Sfree( etag );
+  Sfree( newEtag );
+
+/*------------------------------------------------------------------------*\
+    Update statistics
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &_queueMutex );
+  if( request->rc )
+    _stats.failed++;
+  else
+    _stats.completed++;
+  _stats.waitSum += start - request->created;
+  if( start-request->created>_stats.waitMax )
+    _stats.waitMax = start - request->created;
+  _stats.execSum += end - start;
+  if( end-start>_stats.execMax )
+    _stats.execMax = end - start;
+  pthread_mutex_unlock( &_queueMutex );
+  metricsObserve( MetricCloudRequestSeconds, NULL, end-start );
+}
+
 
-  DBGMSG( "Cloud Request thread (%p,%s): starting.", request, request->method );
+/*=========================================================================*\
+    Metrics collector: length of request queue
+\*=========================================================================*/
+static void _metricsCollector( void )
+{
+  int depth;
+
+  pthread_mutex_lock( &_queueMutex );
+  depth = _queueDepth;
+  pthread_mutex_unlock( &_queueMutex );
+
+  metricsSet( MetricCloudQueueLength, NULL, depth );
+}
+
+
+/*=========================================================================*\
+    Get cURL handle of calling thread if it is a cloud worker
+      returns NULL otherwise
+\*=========================================================================*/
+static CURL *_workerHandle( void )
+{
+  int i;
+
+  for( i=0; i<_workersRunning; i++ ) {
+    if( pthread_equal(_workers[i],pthread_self()) )
+      return _workerCurl[i];
+  }
+  return NULL;
+}
+
+
+/*=========================================================================*\
+       A worker thread for cloud requests
+         Each worker keeps its own cURL handle, so connections are reused.
+\*=========================================================================*/
+static void *_cloudWorkerThread( void *arg )
+{
+  int           index = (int)(long)arg;
+  CloudRequest *request;
+  int           i;
+
+  DBGMSG( "Cloud worker thread #%d: starting.", index );
   PTHREADSETNAME( "cloudReq" );
 
+  _workerCurl[index] = curl_easy_init();
+  if( !_workerCurl[index] )
+    logwarn( "Cloud worker thread #%d: Unable to init cURL.", index );
+
+/*------------------------------------------------------------------------*\
+    Loop: get next request with highest priority
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &_queueMutex );
+  while( !_workersStop ) {
+    request = NULL;
+    for( i=IckCloudPriorities-1; i>=0 && !request; i-- ) {
+      request = _queueHead[i];
+      if( request ) {
+        _queueHead[i] = request->next;
+        if( !_queueHead[i] )
+          _queueTail[i] = NULL;
+        _queueDepth--;
+      }
+    }
+    if( !request ) {
+      pthread_cond_wait( &_queueCond, &_queueMutex );
+      continue;
+    }
+    pthread_mutex_unlock( &_queueMutex );
+
 /*------------------------------------------------------------------------*\
     Do the transaction
 \*------------------------------------------------------------------------*/
-  rc = jsonRpcTransact( request->uri, request->oAuthToken, request->id,
-                        request->method, request->jParams, &jResult, &httpCode );
-  DBGMSG( "Cloud Request thread (%p,%s): Performed request (%d).",
-          request, request->method, rc );
+    _requestExecute( request, _workerCurl[index] );
 
 /*------------------------------------------------------------------------*\
-    Call callback (if any)
+    Synchronous request: wake up caller, who will free the request
 \*------------------------------------------------------------------------*/
-  if( request->callback ) {
-    DBGMSG( "Cloud Request thread (%p,%s): Calling call back function.",
-            request, request->method, rc );
-    request->callback( request->method, request->jParams, jResult, rc, httpCode, request->userData );
-  }
+    if( request->sync ) {
+      pthread_mutex_lock( &_queueMutex );
+      request->done = true;
+      pthread_cond_broadcast( &_doneCond );
+      continue;
+    }
 
 /*------------------------------------------------------------------------*\
-    Clean up
+    Asynchronous request: call callback (if any) and clean up
 \*------------------------------------------------------------------------*/
-  DBGMSG( "Cloud Request thread (%p,%s): Done.", request, request->method );
-  json_decref( request->jParams );
-  if( jResult )
-    json_decref( jResult );
-  Sfree( request->uri );
-  Sfree( request->oAuthToken );
-  Sfree( request->method );
-  Sfree( request );
+    if( request->callback ) {
+      DBGMSG( "Cloud worker thread #%d (%p,%s): Calling call back function.",
+              index, request, request->method );
+      request->callback( request->method, request->jParams, request->jResult,
+                         request->rc, request->httpCode, request->userData );
+    }
+    _requestFree( request );
+    pthread_mutex_lock( &_queueMutex );
+  }
+  pthread_mutex_unlock( &_queueMutex );
 
 /*------------------------------------------------------------------------*\
     That's it
 \*------------------------------------------------------------------------*/
+  if( _workerCurl[index] )
+    curl_easy_cleanup( _workerCurl[index] );
+  _workerCurl[index] = NULL;
+  DBGMSG( "Cloud worker thread #%d: terminating.", index );
   return NULL;
 }
 
@@ -576,10 +1502,29 @@ static void *_cloudRequestThread( void *arg )
 \*=========================================================================*/
 int jsonRpcTransact( const char *uri, const char *oAuthToken, int id,
                      const char *method, json_t *jParams, json_t **jResult, int *httpCode )
+{
+  return _jsonRpcTransact( NULL, uri, oAuthToken, id, method, jParams, 0, NULL, NULL, jResult, httpCode );
+}
+
+
+/*=========================================================================*\
+    Perform a generic JSON-RPC transaction
+      curlHandle - handle to reuse (keeps connections alive),
+                   if NULL a temporary one is used
+      timeout    - max. duration in seconds, 0 for none
+      etag       - send conditional request (might be NULL),
+                   the http code is 304 and no result is set if not modified
+      newEtag    - pointer to ETag of response, caller must free (might be NULL)
+    see jsonRpcTransact() for the other parameters
+\*=========================================================================*/
+static int _jsonRpcTransact( CURL *curlHandle, const char *uri, const char *oAuthToken, long id,
+                             const char *method, json_t *jParams, double timeout,
+                             const char *etag, char **newEtag,
+                             json_t **jResult, int *httpCode )
 {
   json_t            *jCmd         = NULL;
   char              *cmdStr       = NULL;
-  CURL              *curlHandle   = NULL;
+  CURL              *tmpHandle    = NULL;
   struct curl_slist *headers      = NULL;
   char              *receivedData = NULL;
   int                retval       = 0;
@@ -608,7 +1553,7 @@ int jsonRpcTransact( const char *uri, const char *oAuthToken, int id,
                         "jsonrpc", "2.0",
                         "method", method );
   if( id>0 )
-    json_object_set( jCmd, "id", json_integer(id) );
+    json_object_set_new( jCmd, "id", json_integer(id) );
   if( jParams )
     json_object_set( jCmd, "params", jParams );
   cmdStr = json_dumps( jCmd, JSON_PRESERVE_ORDER|JSON_COMPACT|JSON_ENSURE_ASCII );
@@ -619,13 +1564,28 @@ int jsonRpcTransact( const char *uri, const char *oAuthToken, int id,
   }
 
 /*------------------------------------------------------------------------*\
-    Setup cURL
+    Setup cURL, reset options of a reused handle
 \*------------------------------------------------------------------------*/
-  curlHandle = curl_easy_init();
-  if( !curlHandle ) {
-    logerr( "jsonRpcTransact (%s): Unable to init cURL.", uri );
-    retval = -1;
-    goto end;
+  if( curlHandle )
+    curl_easy_reset( curlHandle );
+  else {
+    curlHandle = tmpHandle = curl_easy_init();
+    if( !curlHandle ) {
+      logerr( "jsonRpcTransact (%s): Unable to init cURL.", uri );
+      retval = -1;
+      goto end;
+    }
+  }
+
+  // Limit duration (no signals in multithreaded environment)
+  if( timeout>0 ) {
+    curl_easy_setopt( curlHandle, CURLOPT_NOSIGNAL, 1L );
+    rc = curl_easy_setopt( curlHandle, CURLOPT_TIMEOUT_MS, (long)(timeout*1000)+1 );
+    if( rc ) {
+      logerr( "jsonRpcTransact (%s): Unable to set timeout.", uri );
+      retval = -1;
+      goto end;
+    }
   }
 
   // Set URI
@@ -668,6 +1628,12 @@ int jsonRpcTransact( const char *uri, const char *oAuthToken, int id,
     headers = curl_slist_append( headers, hdr );  // Performs a strdup(hdr)
     Sfree( hdr );
   }
+  if( etag ) {
+    char *hdr = malloc( strlen(etag)+32 );
+    sprintf( hdr, "If-None-Match: %s", etag );
+    headers = curl_slist_append( headers, hdr );
+    Sfree( hdr );
+  }
   rc = curl_easy_setopt( curlHandle, CURLOPT_HTTPHEADER, headers );
   if( rc ) {
     logerr( "jsonRpcTransact (%s): Unable to set HTTP headers.", uri );
@@ -744,6 +1710,8 @@ int jsonRpcTransact( const char *uri, const char *oAuthToken, int id,
   code = atoi( ptr );
   DBGMSG( "jsonRpcTransact (%s): HTTP code is %d", uri, code );
   DBGMSG( "jsonRpcTransact (%s): HTTP content is \"%.20s\"...", uri, receivedData+headerSize );
+  if( newEtag )
+    *newEtag = _httpHeaderValue( ptr, receivedData+headerSize-ptr, "ETag" );
   if( code!=200 )
     goto end;
 
@@ -805,8 +1773,8 @@ int jsonRpcTransact( const char *uri, const char *oAuthToken, int id,
 end:
   if( jCmd )
     json_decref( jCmd );
-  if( curlHandle )
-    curl_easy_cleanup( curlHandle );
+  if( tmpHandle )
+    curl_easy_cleanup( tmpHandle );
   if( headers )
     curl_slist_free_all( headers );
   Sfree( cmdStr );
@@ -818,6 +1786,37 @@ end:
 }
 
 
+/*=========================================================================*\
+    Get value of a HTTP header field
+      headers - header block of one response (without body)
+      name    - field name (case insensitive)
+    returns an allocated string or NULL if not found
+\*=========================================================================*/
+static char *_httpHeaderValue( const char *headers, size_t len, const char *name )
+{
+  const char *end    = headers + len;
+  size_t      nlen   = strlen( name );
+  const char *line;
+
+  for( line=headers; line && line<end; ) {
+    const char *eol = memchr( line, '\n', end-line );
+    if( !eol )
+      eol = end;
+    if( eol-line>nlen && line[nlen]==':' && !strncasecmp(line,name,nlen) ) {
+      const char *val = line + nlen + 1;
+      while( val<eol && (*val==' '||*val=='\t') )
+        val++;
+      while( eol>val && (eol[-1]=='\r'||eol[-1]==' '||eol[-1]=='\n') )
+        eol--;
+      return strndup( val, eol-val );
+    }
+    line = eol<end ? eol+1 : NULL;
+  }
+
+  return NULL;
+}
+
+
 /*=========================================================================*\
       cURL write callback
 \*=========================================================================*/
@@ -867,5 +1866,5 @@ static size_t _curlWriteCallback( void *buffer, size_t size, size_t nmemb, void
 /*=========================================================================*\
                                     END OF FILE
 \*=========================================================================*/
-
-
+
+
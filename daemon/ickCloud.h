@@ -52,12 +52,24 @@ Remarks         : -
 /*=========================================================================*\
   Includes needed by definitions from this file
 \*=========================================================================*/
+#include <stdbool.h>
 #include <jansson.h> 
 
 /*========================================================================n
   Macro and type definitions
 \*========================================================================*/
 #define IckCloudCoreURI "http://api.ickstream.com/ickstream-cloud-core/jsonrpc"
+#define IckCloudDefaultTimeout  60.0      // Deadline for requests in seconds
+
+/*------------------------------------------------------------------------*\
+    Priorities of queued requests
+\*------------------------------------------------------------------------*/
+typedef enum {
+  IckCloudPriorityLow,
+  IckCloudPriorityNormal,
+  IckCloudPriorityHigh
+} IckCloudPriority;
+#define IckCloudPriorities      3
 
 /*------------------------------------------------------------------------*\
     Signatures for function pointers
@@ -82,6 +94,12 @@ json_t *ickCloudRequestSync( const char *uri, const char *oAuthToken, const char
 int     ickCloudNotify( const char *uri, const char *oAuthToken, const char *method, json_t *jParams );
 int     ickCloudRequestAsync( const char *uri, const char *oAuthToken, const char *method,
                               json_t *jParams, IckCloudCb callback, void *userData );
+int     ickCloudRequestAsyncPrio( const char *uri, const char *oAuthToken, const char *method,
+                                  json_t *jParams, IckCloudPriority priority, double timeout,
+                                  IckCloudCb callback, void *userData );
+json_t *ickCloudGetStatistics( void );
+int     ickCloudCacheSetPolicy( const char *method, double ttl, bool persist );
+void    ickCloudCacheFlush( bool persist );
 int     jsonRpcTransact( const char *uri, const char *oAuthToken, int id,
                          const char *method, json_t *jParams, json_t **jResult, int *httpCode );
 
@@ -59,6 +59,7 @@ Remarks         : -
 #include "hmi.h"
 #include "ickDevice.h"
 #include "ickMessage.h"
+#include "player.h"
 #include "ickService.h"
 
 
@@ -80,30 +81,35 @@ static const char *_ickDeviceServiceTypeToStr( ickP2pServicetype_t type );
 void ickDevice( ickP2pContext_t *ictx, const char *uuid,
                 ickP2pDeviceState_t cmd, ickP2pServicetype_t type )
 {
-  
+  Player *zone = playerGetZoneByContext( ictx );
+  bool    main = zone && !playerGetZoneIndex( zone );
+
   loginfo( "ickDevice \"%s\" (type %d: %s) %s",
             uuid, type, _ickDeviceServiceTypeToStr(type), ickLibDeviceState2Str(cmd) );
 
+  // Services are shared by all zones and managed via the main zone
+
   switch( cmd ) {
 
     case ICKP2P_CONNECTED:
 
       // New server found: request service descriptor
-      if( type==ICKP2P_SERVICE_SERVER_GENERIC ) {
+      if( type==ICKP2P_SERVICE_SERVER_GENERIC && main ) {
         sendIckCommand( ictx, uuid, "getServiceInformation", NULL, NULL,
                                     &_handleGetServiceInformation );
       }
 
       // New controller found: send current player state
-      if( type==ICKP2P_SERVICE_CONTROLLER )
-        ickMessageNotifyPlayerState( uuid );
+      if( type==ICKP2P_SERVICE_CONTROLLER && zone )
+        ickMessageNotifyPlayerState( zone, uuid );
 
       break;
 
     case ICKP2P_DISCONNECTED:
 
       // Remove service(s) for this device
-      ickServiceRemove( uuid, NULL, ServiceDevice );
+      if( main )
+        ickServiceRemove( uuid, NULL, ServiceDevice );
 
       break;
 
@@ -53,6 +53,7 @@ Remarks         : -
 
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <strings.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -69,6 +70,7 @@ Remarks         : -
 #include "player.h"
 #include "playlist.h"
 #include "audio.h"
+#include "metrics.h"
 
 
 /*=========================================================================*\
@@ -80,45 +82,190 @@ Remarks         : -
   Private definitions and symbols
 \*=========================================================================*/
 
-// Linked list of open command requests
+// Open command requests, hashed by id and expired by a timer wheel
+#define IckRequestTimeout             60      // Timeout in seconds
+#define IckRequestHashSize            256
+#define IckWheelBits                  6
+#define IckWheelSize                  (1<<IckWheelBits)
+#define IckWheelMask                  (IckWheelSize-1)
+#define IckWheelLevels                2       // Covers 64 and 4096 ticks (seconds)
 typedef struct _openRequest {
-  struct _openRequest  *next;
+  struct _openRequest  *next;           // Chain of hash bucket
+  struct _openRequest  *wheelNext;      // Chain of timer wheel slot
+  struct _openRequest **wheelPrev;      // Link pointing to this element
   long                  id;
   char                 *szDeviceId;
   json_t               *jCommand;
   IckCmdCallback        callback;
   double                timestamp; 
+  long                  expires;        // Tick of timeout
 } OpenRequest;
-OpenRequest    *openRequestList;
-pthread_mutex_t openRequestListMutex = PTHREAD_MUTEX_INITIALIZER;
+static OpenRequest     *openRequestTable[IckRequestHashSize];
+static OpenRequest     *openRequestWheel[IckWheelLevels][IckWheelSize];
+static long             openRequestTick;
+static int              openRequestCount;
+static pthread_mutex_t  openRequestListMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Statistics of requests per peer (protected by openRequestListMutex)
+#define IckPeerHashSize               64
+typedef struct _peerStatistics {
+  struct _peerStatistics *next;
+  char                   *szDeviceId;
+  long                    requests;
+  long                    responses;
+  long                    timeouts;
+  double                  rttSum;
+  double                  rttMin;
+  double                  rttMax;
+  double                  rttLast;
+} PeerStatistics;
+static PeerStatistics  *peerStatisticsTable[IckPeerHashSize];
+static long             orphanedResponses;
+
+// Coalescing of broadcast notifications
+#define IckMessageDefaultNotifyDelay  0.1     // Debounce window in seconds
+#define IckNotifyPlaylist             0x01
+#define IckNotifyPlayerState          0x02
+static pthread_mutex_t  notifyMutex     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   notifyCond      = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t  notifySendMutex = PTHREAD_MUTEX_INITIALIZER;
+static int              notifyPending[PlayerMaxZones];   // by zone index
+static bool             notifyAnyPending;
+static double           notifyPendingSince;
+static double           notifyDelay     = IckMessageDefaultNotifyDelay;
+static pthread_t        notifyThread;
+static bool             notifyRunning;
+static bool             notifyStop;
+static long             notifyRequested;
+static long             notifySent;
+
+// Registry of JSON-RPC methods, hashed by case folded name
+#define IckRpcHashSize                64
+typedef struct _ickRpcMethod {
+  const char            *name;
+  IckRpcHandler          handler;
+  IckRpcParams           params;
+  int                    flags;
+  unsigned               hash;
+  struct _ickRpcMethod  *next;
+} IckRpcMethod;
+static IckRpcMethod    *rpcMethodTable[IckRpcHashSize];
+static pthread_mutex_t  rpcMethodMutex  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t   rpcMethodsOnce  = PTHREAD_ONCE_INIT;
+
+// Worker pool for asynchronous methods
+#define IckRpcWorkers                 2
+typedef struct _rpcJob {
+  struct _rpcJob  *next;
+  IckRpcRequest   *request;
+} RpcJob;
+static RpcJob          *rpcJobHead;
+static RpcJob          *rpcJobTail;
+static pthread_mutex_t  rpcJobMutex     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   rpcJobCond      = PTHREAD_COND_INITIALIZER;
+static pthread_t        rpcWorkers[IckRpcWorkers];
+static int              rpcWorkersRunning;
+static bool             rpcWorkersStop;
 
 
 /*=========================================================================*\
   Private prototypes
 \*=========================================================================*/
-void    _unlinkOpenRequest( OpenRequest *request );	
-void    _freeOpenRequest( OpenRequest *request );	
-void    _timeoutOpenRequest( int timeout );	
-json_t *_jPlayerStatus( void );
+static void  _linkOpenRequest( OpenRequest *request );
+static OpenRequest *_takeOpenRequest( long id );
+static void  _wheelInsert( OpenRequest *request );
+static void  _wheelRemove( OpenRequest *request );
+static void  _freeOpenRequest( OpenRequest *request );
+static void  _timeoutOpenRequests( void );
+static PeerStatistics *_peerStatistics( const char *szDeviceId );
+static void  _freeOpenRequests( void );
+json_t *_jPlayerStatusHeader( Player *zone, Playlist *plst );
+char   *_strPlayerStatus( Player *zone );
+static void  _scheduleNotification( Player *zone, int what );
+static void  _sendPendingNotifications( void );
+static void  _sendPlaylistNotification( Player *zone, const char *szDeviceId );
+static void  _sendPlayerStateNotification( Player *zone, const char *szDeviceId );
+static void *_notifyThread( void *arg );
+static void  _rpcRegistryInit( void );
+static unsigned _rpcHash( const char *name );
+static const IckRpcMethod *_rpcFindMethod( const char *name );
+static void  _rpcExecute( IckRpcRequest *request );
+static void  _rpcComplete( IckRpcRequest *request );
+static void  _rpcRequestFree( IckRpcRequest *request );
+static int   _rpcQueueRequest( IckRpcRequest *request );
+static void *_rpcWorkerThread( void *arg );
+static int   _rpcGetProtocolVersions( IckRpcRequest *request, json_t *jParams );
+static int   _rpcGetPlayerStatus( IckRpcRequest *request, json_t *jParams );
+static int   _rpcGetSeekPosition( IckRpcRequest *request, json_t *jParams );
+static int   _rpcGetTrack( IckRpcRequest *request, json_t *jParams );
+static int   _rpcSetPlaybackQueueMode( IckRpcRequest *request, json_t *jParams );
+static int   _rpcSetTrack( IckRpcRequest *request, json_t *jParams );
+static int   _rpcPlay( IckRpcRequest *request, json_t *jParams );
+static int   _rpcGetVolume( IckRpcRequest *request, json_t *jParams );
+static int   _rpcSetVolume( IckRpcRequest *request, json_t *jParams );
+static int   _rpcGetPlaybackQueue( IckRpcRequest *request, json_t *jParams );
+static int   _rpcGetPlaybackQueueChanges( IckRpcRequest *request, json_t *jParams );
+static int   _rpcSetPlaylistName( IckRpcRequest *request, json_t *jParams );
+static int   _rpcSetTracks( IckRpcRequest *request, json_t *jParams );
+static int   _rpcAddTracks( IckRpcRequest *request, json_t *jParams );
+static int   _rpcRemoveTracks( IckRpcRequest *request, json_t *jParams );
+static int   _rpcMoveTracks( IckRpcRequest *request, json_t *jParams );
+static int   _rpcShuffleTracks( IckRpcRequest *request, json_t *jParams );
+static int   _rpcSetTrackMetadata( IckRpcRequest *request, json_t *jParams );
+static int   _rpcSetPlayerConfiguration( IckRpcRequest *request, json_t *jParams );
+static int   _rpcGetPlayerConfiguration( IckRpcRequest *request, json_t *jParams );
+#ifdef ICK_TRACE
+static int   _rpcGetPlayerTrace( IckRpcRequest *request, json_t *jParams );
+#endif
+
+
+/*=========================================================================*\
+  Built in methods
+\*=========================================================================*/
+static IckRpcMethod rpcBuiltinMethods[] = {
+  { "getProtocolVersions",     _rpcGetProtocolVersions,        IckRpcParamsNone,      0 },
+  { "getPlayerStatus",         _rpcGetPlayerStatus,            IckRpcParamsNone,      0 },
+  { "getSeekPosition",         _rpcGetSeekPosition,            IckRpcParamsNone,      IckRpcLockQueue },
+  { "getTrack",                _rpcGetTrack,                   IckRpcParamsRequired,  IckRpcLockQueue },
+  { "setPlaybackQueueMode",    _rpcSetPlaybackQueueMode,       IckRpcParamsRequired,  0 },
+  { "setTrack",                _rpcSetTrack,                   IckRpcParamsRequired,  0 },
+  { "play",                    _rpcPlay,                       IckRpcParamsRequired,  0 },
+  { "getVolume",               _rpcGetVolume,                  IckRpcParamsNone,      0 },
+  { "setVolume",               _rpcSetVolume,                  IckRpcParamsOptional,  0 },
+  { "getPlaybackQueue",        _rpcGetPlaybackQueue,           IckRpcParamsOptional,  IckRpcAsync },
+  { "getPlaybackQueueChanges", _rpcGetPlaybackQueueChanges,    IckRpcParamsRequired,  IckRpcAsync },
+  { "setPlaylistName",         _rpcSetPlaylistName,            IckRpcParamsRequired,  IckRpcLockQueue },
+  { "setTracks",               _rpcSetTracks,                  IckRpcParamsOptional,  IckRpcLockQueue },
+  { "addTracks",               _rpcAddTracks,                  IckRpcParamsRequired,  IckRpcLockQueue },
+  { "removeTracks",            _rpcRemoveTracks,               IckRpcParamsRequired,  IckRpcLockQueue },
+  { "moveTracks",              _rpcMoveTracks,                 IckRpcParamsRequired,  IckRpcLockQueue },
+  { "shuffleTracks",           _rpcShuffleTracks,              IckRpcParamsOptional,  IckRpcLockQueue },
+  { "setTrackMetadata",        _rpcSetTrackMetadata,           IckRpcParamsRequired,  IckRpcLockQueue },
+  { "setPlayerConfiguration",  _rpcSetPlayerConfiguration,     IckRpcParamsRequired,  0 },
+  { "getPlayerConfiguration",  _rpcGetPlayerConfiguration,     IckRpcParamsNone,      0 },
+#ifdef ICK_TRACE
+  { "getPlayerTrace",          _rpcGetPlayerTrace,             IckRpcParamsNone,      IckRpcAsync },
+#endif
+  { NULL }
+};
 
 
 /*=========================================================================*\
   Handle messages for this device
+    Requests are dispatched via the method registry, handlers flagged as
+    asynchronous are executed by the worker pool
 \*=========================================================================*/
 void  ickMessage( ickP2pContext_t *ictx, const char *sourceUuid, ickP2pServicetype_t sourceService,
                   ickP2pServicetype_t targetServices, const char *message, size_t mSize, ickP2pMessageFlag_t mFlags )
 {
-  json_t       *jRoot,
-               *jObj,
-               *jParams,
-               *jResult = NULL;
-  json_error_t  error;
-  const char   *method;
-  json_t       *rpcId;
-  int           rpcErrCode         = RPC_NO_ERROR;
-  char         *rpcErrMessage      = "Generic Error";
-  bool          playlistChanged    = false;
-  bool          playerStateChanged = false;
+  IckRpcRequest      *request;
+  const IckRpcMethod *rpcMethod;
+  JsonArena          *arena;
+  json_t             *jRoot,
+                     *jObj,
+                     *jParams;
+  json_error_t        error;
+  json_t             *rpcId;
 
   // Fixme: trim message for terminating zeros
   while( mSize>0 && !message[mSize-1] ) {
@@ -130,22 +277,28 @@ void  ickMessage( ickP2pContext_t *ictx, const char *sourceUuid, ickP2pServicety
             sourceUuid, sourceService, (int)mSize, message );
 
 /*------------------------------------------------------------------------*\
-    Init JSON interpreter
+    Init JSON interpreter, parse into an arena (falls back to heap)
+      The arena is active for parsing only. Handlers run with the heap,
+      since they hand objects to the queue, the player state and the cloud
+      module, which outlive the request. The parsed tree stays valid till
+      the request is freed.
 \*------------------------------------------------------------------------*/
+  arena = jsonArenaNew();
+  jsonArenaActivate( arena );
   jRoot = json_loadb( message, mSize, 0, &error );
+  jsonArenaActivate( NULL );
   if( !jRoot ) {
     logerr( "ickMessage from %s: corrupt line %d: %s",
              sourceUuid, error.line, error.text );
-    rpcErrCode    = RPC_INVALID_REQUEST;
-    rpcErrMessage = "Could not parse";
-    goto rpcError;
+    jsonArenaRelease( arena );
+    return;
   }
   if( !json_is_object(jRoot) ) {
     logerr( "ickMessage from %s: could not parse to object: %.*s",
             sourceUuid, (int)mSize, message );
-    rpcErrCode    = RPC_INVALID_REQUEST;
-    rpcErrMessage = "Parse did not result in JSON object";
-    goto rpcError;
+    json_decref( jRoot );
+    jsonArenaRelease( arena );
+    return;
   } 
   // DBGMSG( "ickMessage from %s: parsed.", szDeviceId );
   
@@ -157,6 +310,7 @@ void  ickMessage( ickP2pContext_t *ictx, const char *sourceUuid, ickP2pServicety
     loginfo( "ickMessage from %s is a notification (no id): %.*s",
               sourceUuid, (int)mSize, message );
     json_decref( jRoot );
+    jsonArenaRelease( arena );
     return;
   }
   // DBGMSG( "ickMessage from %s: found id.", szDeviceId );
@@ -168,7 +322,7 @@ void  ickMessage( ickP2pContext_t *ictx, const char *sourceUuid, ickP2pServicety
   if( !jObj )
     jObj = json_object_get( jRoot, "error" );
   if( jObj && json_is_object(jObj) ) {
-    OpenRequest *request = openRequestList;
+    OpenRequest *openRequest;
     long id;
     
     // Get integer id from message
@@ -176,21 +330,22 @@ void  ickMessage( ickP2pContext_t *ictx, const char *sourceUuid, ickP2pServicety
       logwarn( "ickMessage from %s returned id in unknown format: %.*s",
                sourceUuid, (int)mSize, message );
       json_decref( jRoot );
+      jsonArenaRelease( arena );
       return;
     }
 
-    // Find open request for ID 
-    pthread_mutex_lock( &openRequestListMutex );
-    while( request && request->id!=id )
-      request = request->next;
-    pthread_mutex_unlock( &openRequestListMutex );
-
-    // Unlink open request and execute callback
-    if( request ) {
-      _unlinkOpenRequest( request );
-      if( request->callback )
-        request->callback( request->szDeviceId, request->jCommand, jRoot );
-      _freeOpenRequest( request );
+    // Find and unlink open request for ID, execute callback
+    // Callbacks might keep parts of the answer, so hand over a heap copy
+    openRequest = _takeOpenRequest( id );
+    if( openRequest ) {
+      if( openRequest->callback ) {
+        json_t *jAnswer = jsonArenaPromote( jRoot );
+        if( jAnswer ) {
+          openRequest->callback( openRequest->szDeviceId, openRequest->jCommand, jAnswer );
+          json_decref( jAnswer );
+        }
+      }
+      _freeOpenRequest( openRequest );
     }
 
     // Orphaned result?
@@ -200,1101 +355,1714 @@ void  ickMessage( ickP2pContext_t *ictx, const char *sourceUuid, ickP2pServicety
 
     // Clean up and take the chance to check for timedout requests
     json_decref( jRoot ); 
-    _timeoutOpenRequest( 60 );
+    jsonArenaRelease( arena );
+    _timeoutOpenRequests();
 
     // That's all for processing results
     return;
   }
 
 /*------------------------------------------------------------------------*\
-    This is a command we need to answer: get message type and parameters
+    This is a command we need to answer: create request context
+\*------------------------------------------------------------------------*/
+  request = calloc( 1, sizeof(IckRpcRequest) );
+  if( request ) {
+    request->sourceUuid = strdup( sourceUuid );
+    request->message    = malloc( mSize+1 );
+  }
+  if( !request || !request->sourceUuid || !request->message ) {
+    logerr( "ickMessage: out of memory!" );
+    if( request )
+      _rpcRequestFree( request );
+    json_decref( jRoot );
+    jsonArenaRelease( arena );
+    return;
+  }
+  memcpy( request->message, message, mSize );
+  request->message[mSize] = 0;
+  request->mSize          = mSize;
+  request->ictx           = ictx;
+  request->zone           = playerGetZoneByContext( ictx );
+  request->jRoot          = jRoot;
+  request->rpcId          = rpcId;
+  request->arena          = arena;
+
+/*------------------------------------------------------------------------*\
+    Get message type and parameters
 \*------------------------------------------------------------------------*/
   jObj = json_object_get( jRoot, "method" );
   if( !jObj || !json_is_string(jObj) ) {
     logerr( "ickMessage from %s contains neither method or result: %.*s",
                      sourceUuid, (int)mSize, message );
-    rpcErrCode    = RPC_INVALID_REQUEST;
-    rpcErrMessage = "RPC header contains no method, result or error field";
-    goto rpcError;
+    ickMessageRpcError( request, RPC_INVALID_REQUEST, "RPC header contains no method, result or error field" );
+    _rpcComplete( request );
+    return;
+  }
+  request->method = json_string_value( jObj );
+  DBGMSG( "ickMessage from %s: Executing command \"%s\"", sourceUuid, request->method );
+
+/*------------------------------------------------------------------------*\
+    Commands address the zone served by the receiving context
+\*------------------------------------------------------------------------*/
+  if( !request->zone ) {
+    logerr( "ickMessage from %s: no zone for context %p", sourceUuid, ictx );
+    ickMessageRpcError( request, RPC_INTERNAL_JSONRPC, "No player zone for this context" );
+    _rpcComplete( request );
+    return;
   }
-  method = json_string_value( jObj );
-  DBGMSG( "ickMessage from %s: Executing command \"%s\"", sourceUuid, method );
 
   jParams = json_object_get( jRoot, "params" );
   if( jParams && !json_is_object(jParams) ) {
     logerr( "ickMessage from %s contains bad parameter field: %.*s",
             sourceUuid, (int)mSize, message );
-    rpcErrCode    = RPC_INVALID_REQUEST;
-    rpcErrMessage = "Parameter filed in RPC header is of wrong type (no object)";
-    goto rpcError;
+    ickMessageRpcError( request, RPC_INVALID_REQUEST, "Parameter filed in RPC header is of wrong type (no object)" );
+    _rpcComplete( request );
+    return;
   }
 
 /*------------------------------------------------------------------------*\
-    Get versions of supported protocols
+    Look up method
 \*------------------------------------------------------------------------*/
-  if( !strcasecmp(method,"getProtocolVersions") ) {
-
-    // Expect no parameters
-    if( jParams && json_object_size(jParams) ) {
-      logerr( "ickMessage from %s contains parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Unexpected parameters in RPC header";
-      goto rpcError;
-    }
-
-    // Get result
-    jResult = json_pack( "{ss ss}",
-                         "minVersion", ICK_MINVERSION,
-                         "maxVersion", ICK_MAXVERSION );
+  rpcMethod = _rpcFindMethod( request->method );
+  if( !rpcMethod ) {
+    logerr( "ickMessage from %s: ignoring method %s", sourceUuid, request->method );
+    ickMessageRpcError( request, RPC_METHOD_NOT_FOUND, "Method not found" );
+    _rpcComplete( request );
+    return;
   }
+  request->handler = rpcMethod->handler;
+  request->flags   = rpcMethod->flags;
 
 /*------------------------------------------------------------------------*\
-    Get player status 
+    Check parameters as expected by method
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"getPlayerStatus") ) {
-
-    // Expect no parameters
-    if( jParams && json_object_size(jParams) ) {
-      logerr( "ickMessage from %s contains parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Unexpected parameters in RPC header";
-      goto rpcError;
-    }
-
-    // Get result
-    jResult = _jPlayerStatus();
+  if( rpcMethod->params==IckRpcParamsNone && jParams && json_object_size(jParams) ) {
+    logerr( "ickMessage from %s contains parameters: %.*s",
+            sourceUuid, (int)mSize, message );
+    ickMessageRpcError( request, RPC_INVALID_REQUEST, "Unexpected parameters in RPC header" );
+    _rpcComplete( request );
+    return;
+  }
+  if( rpcMethod->params==IckRpcParamsRequired && !jParams ) {
+    logerr( "ickMessage from %s contains no parameters: %.*s",
+            sourceUuid, (int)mSize, message );
+    ickMessageRpcError( request, RPC_INVALID_REQUEST, "Missing parameters in RPC header" );
+    _rpcComplete( request );
+    return;
   }
 
 /*------------------------------------------------------------------------*\
-    Get position in track
+    Execute on worker pool or directly
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"getSeekPosition") ) {
-    Playlist *plst = playerGetQueue();
+  if( !(request->flags&IckRpcAsync) || _rpcQueueRequest(request) )
+    _rpcExecute( request );
 
-    // Expect no parameters
-    if( jParams && json_object_size(jParams) ) {
-      logerr( "ickMessage from %s contains parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Unexpected parameters in RPC header";
-      goto rpcError;
-    }
+/*------------------------------------------------------------------------*\
+    Check for timedout requests
+\*------------------------------------------------------------------------*/
+  _timeoutOpenRequests();
+}
 
-    // Get positions
-    playlistLock( plst );
-    jResult = json_pack( "{si sf}",
-                         "playbackQueuePos", playlistGetCursorPos(plst),
-                         "seekPos",          playerGetSeekPos() );
-    playlistUnlock( plst );
+
+/*=========================================================================*\
+  Register a JSON-RPC method
+    Names are case insensitive, an existing method of the same name is
+    replaced (this also applies to the built in methods)
+    return 0 on success, -1 on error
+\*=========================================================================*/
+int ickMessageRegisterMethod( const char *name, IckRpcHandler handler, IckRpcParams params, int flags )
+{
+  IckRpcMethod *rpcMethod;
+  unsigned      hash = _rpcHash( name );
+
+  DBGMSG( "ickMessageRegisterMethod: \"%s\" params=%d flags=0x%02x", name, params, flags );
+  pthread_once( &rpcMethodsOnce, _rpcRegistryInit );
+
+/*------------------------------------------------------------------------*\
+    Replace existing entry
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &rpcMethodMutex );
+  for( rpcMethod=rpcMethodTable[hash%IckRpcHashSize]; rpcMethod; rpcMethod=rpcMethod->next ) {
+    if( rpcMethod->hash==hash && !strcasecmp(rpcMethod->name,name) )
+      break;
+  }
+  if( rpcMethod ) {
+    rpcMethod->handler = handler;
+    rpcMethod->params  = params;
+    rpcMethod->flags   = flags;
+    pthread_mutex_unlock( &rpcMethodMutex );
+    return 0;
   }
 
 /*------------------------------------------------------------------------*\
-    Get track info
+    Create and link new entry
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"getTrack") ) {
-    Playlist     *plst = playerGetQueue();
-    PlaylistItem *pItem;
-    int           pos;
-    playlistLock( plst );
+  rpcMethod = calloc( 1, sizeof(IckRpcMethod) );
+  if( rpcMethod )
+    rpcMethod->name = strdup( name );
+  if( !rpcMethod || !rpcMethod->name ) {
+    pthread_mutex_unlock( &rpcMethodMutex );
+    logerr( "ickMessageRegisterMethod: out of memory!" );
+    Sfree( rpcMethod );
+    return -1;
+  }
+  rpcMethod->hash    = hash;
+  rpcMethod->handler = handler;
+  rpcMethod->params  = params;
+  rpcMethod->flags   = flags;
+  rpcMethod->next    = rpcMethodTable[hash%IckRpcHashSize];
+  rpcMethodTable[hash%IckRpcHashSize] = rpcMethod;
+  pthread_mutex_unlock( &rpcMethodMutex );
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
-    }
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return 0;
+}
 
-    // Get optionally requested position or use cursor for current track as default
-    jObj = json_object_get( jParams, "playbackQueuePos" );
-    if( !jObj )
-      pos = playlistGetCursorPos( plst );
-    else if( json_is_integer(jObj) )
-      pos = json_integer_value( jObj );
-    else {
-      logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"playbackQueuePos\": wrong type (no integer)";
-      goto rpcError;
-    }
 
-    // Construct result
-    jResult   = json_pack( "{ss si}",
-                           "playlistId",       playlistGetId(plst),
-                           "playbackQueuePos", pos );
-    
-    // Add info about current track (if any)
-    pItem = playlistGetItem( plst, PlaylistMapped, pos );
-    if( pItem ) {
-      playlistItemLock( pItem );
-      json_object_set( jResult, "track", playlistItemGetJSON(pItem) );
-      playlistItemUnlock( pItem );
-    }
+/*=========================================================================*\
+  Set error state of a request (to be used by method handlers)
+    returns -1, so handlers can use "return ickMessageRpcError(...)"
+\*=========================================================================*/
+int ickMessageRpcError( IckRpcRequest *request, int code, const char *message )
+{
+  request->rpcErrCode    = code;
+  request->rpcErrMessage = message;
+  return -1;
+}
 
-    playlistUnlock( plst );
-  }  
 
-/*------------------------------------------------------------------------*\
-    Set repeat mode
-\*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"setPlaybackQueueMode") ) {
-    PlayerPlaybackMode   mode;
+/*=========================================================================*\
+  Init method registry with built in methods (called once)
+\*=========================================================================*/
+static void _rpcRegistryInit( void )
+{
+  int i;
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
-    }
+  for( i=0; rpcBuiltinMethods[i].name; i++ ) {
+    IckRpcMethod *rpcMethod = &rpcBuiltinMethods[i];
+    rpcMethod->hash = _rpcHash( rpcMethod->name );
+    rpcMethod->next = rpcMethodTable[rpcMethod->hash%IckRpcHashSize];
+    rpcMethodTable[rpcMethod->hash%IckRpcHashSize] = rpcMethod;
+  }
+}
 
-    // Get mandatory mode
-    jObj = json_object_get( jParams, "playbackQueueMode" );
-    if( !jObj || !json_is_string(jObj) )  {
-      logerr( "ickMessage from %s: missing field \"playbackQueueMode\": %.*s",
-                       sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"repeatMode\": missing or of wrong type";
-      goto rpcError;
-    }
-    mode = playerPlaybackModeFromStr( json_string_value(jObj) );
-    if( mode<0 ) {
-      logerr( "ickMessage from %s: unknown repeat mode: %s",
-                       sourceUuid, json_string_value(jObj) );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"repeatMode\": invalid value";
-      goto rpcError;
-    }
 
-    // Set and broadcast player mode to account for skipped tracks
-    playerSetPlaybackMode( mode, true );
+/*=========================================================================*\
+  Hash of case folded method name (FNV-1a)
+\*=========================================================================*/
+static unsigned _rpcHash( const char *name )
+{
+  unsigned hash = 2166136261U;
 
-    // report current state
-    jResult = json_pack( "{ss}",
-                         "playbackQueueMode", playerPlaybackModeToStr(playerGetPlaybackMode()) );
+  while( *name ) {
+    hash ^= (unsigned char) tolower( (unsigned char)*name++ );
+    hash *= 16777619U;
   }
+  return hash;
+}
 
-/*------------------------------------------------------------------------*\
-    Set track index to play 
-\*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"setTrack") ) {
-    Playlist *plst   = playerGetQueue();
-    int       offset = 0;
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
-    }
+/*=========================================================================*\
+  Find method in registry
+    Entries are never removed, so the result stays valid
+    return NULL if not found
+\*=========================================================================*/
+static const IckRpcMethod *_rpcFindMethod( const char *name )
+{
+  IckRpcMethod *rpcMethod;
+  unsigned      hash = _rpcHash( name );
 
-    // Get mandatory position
-    jObj = json_object_get( jParams, "playbackQueuePos" );
-    if( !jObj || !json_is_integer(jObj) )  {
-      logerr( "ickMessage from %s: missing field \"playbackQueuePos\": %.*s",
-                       sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"playbackQueuePos\": missing or of wrong type";
-      goto rpcError;
-    }
-    offset = json_integer_value( jObj );
+  pthread_once( &rpcMethodsOnce, _rpcRegistryInit );
+  pthread_mutex_lock( &rpcMethodMutex );
+  for( rpcMethod=rpcMethodTable[hash%IckRpcHashSize]; rpcMethod; rpcMethod=rpcMethod->next ) {
+    if( rpcMethod->hash==hash && !strcasecmp(rpcMethod->name,name) )
+      break;
+  }
+  pthread_mutex_unlock( &rpcMethodMutex );
 
-    // Change pointer in playlist
-    playlistLock( plst );
-    playlistSetCursorPos( plst, offset );
-    playlistUnlock( plst );
+  return rpcMethod;
+}
 
-    // Set and broadcast player mode to account for skipped tracks
-    playerSetState( playerGetState(), true );
 
-    // report current state
+/*=========================================================================*\
+  Execute method handler of a request and send the answer
+\*=========================================================================*/
+static void _rpcExecute( IckRpcRequest *request )
+{
+  Playlist *plst = NULL;
+  json_t   *jParams;
+  double    start = srvtime();
+
+  DBGMSG( "_rpcExecute (%p): \"%s\" from %s", request, request->method, request->sourceUuid );
+
+/*------------------------------------------------------------------------*\
+    Execute handler, lock playback queue if requested
+\*------------------------------------------------------------------------*/
+  jParams = json_object_get( request->jRoot, "params" );
+  if( request->flags&IckRpcLockQueue ) {
+    plst = playerGetQueue( request->zone );
     playlistLock( plst );
-    jResult = json_pack( "{si}",
-                         "playbackQueuePos", playlistGetCursorPos(plst) );
-    playlistUnlock( plst );
   }
+  TRACEBEGIN( request->method );
+  if( request->handler(request,jParams) && request->rpcErrCode==RPC_NO_ERROR )
+    ickMessageRpcError( request, RPC_INTERNAL_JSONRPC, "Internal error" );
+  if( plst )
+    playlistUnlock( plst );
+  TRACEEND( request->method );
+  metricsObserve( MetricMessageSeconds, request->method, srvtime()-start );
 
 /*------------------------------------------------------------------------*\
-    Play or pause 
+    Answer and broadcast changes
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"play") ) {
-    PlayerState newState;
+  _rpcComplete( request );
+}
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
-    }
 
-    // Get mandatory mode
-    jObj = json_object_get( jParams, "playing" );
-    if( !jObj || !json_is_boolean(jObj) )  {
-      logerr( "ickMessage from %s: missing field \"playing\": %.*s",
-                       sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"playing\": missing or of wrong type";
-      goto rpcError;
+/*=========================================================================*\
+  Send answer of a request, broadcast changes and free the request
+\*=========================================================================*/
+static void _rpcComplete( IckRpcRequest *request )
+{
+  json_t *jMsg;
+  char   *str;
+
+/*------------------------------------------------------------------------*\
+   Return error
+\*------------------------------------------------------------------------*/
+  if( request->rpcErrCode!=RPC_NO_ERROR ) {
+    logwarn( "ickMessage from %s: error code %d (%s) (message was: %.*s)",
+             request->sourceUuid, request->rpcErrCode, request->rpcErrMessage,
+             (int)request->mSize, request->message );
+    jMsg = json_pack( "{ss s{si ss} sO}",
+                      "jsonrpc", "2.0",
+                      "error",
+                        "code",    request->rpcErrCode,
+                        "message", request->rpcErrMessage,
+                      "id",      request->rpcId );
+    if( jMsg ) {
+      sendIckMessage( request->ictx, request->sourceUuid, jMsg );
+      json_decref( jMsg );
     }
-    newState = json_is_true(jObj) ? PlayerStatePlay : PlayerStatePause;
-    
-    // Set and broadcast player mode
-    playerSetState( newState, true );
-     
-    // report current state
-    jResult = json_pack( "{sb}",
-                         "playing", playerGetState()==PlayerStatePlay );                         
   }
-    
+
 /*------------------------------------------------------------------------*\
-    Report player volume 
+   Return nominal result
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"getVolume") ) {
-
-    // Expect no parameters
-    if( jParams && json_object_size(jParams) ) {
-      logerr( "ickMessage from %s contains parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Unexpected parameters in RPC header";
-      goto rpcError;
+  else if( request->jResult ) {
+    jMsg = json_pack( "{ss sO sO}",
+                      "jsonrpc", "2.0", 
+                      "id",     request->rpcId,
+                      "result", request->jResult );
+    if( jMsg ) {
+      sendIckMessage( request->ictx, request->sourceUuid, jMsg );
+      json_decref( jMsg );
     }
+  } 
 
-    // Report current volume and muting state
-    jResult = json_pack( "{sfsb}",
-                         "volumeLevel", playerGetVolume(), 
-                         "muted", playerGetMuting() );
+/*------------------------------------------------------------------------*\
+   Return nominal result that is already serialized
+\*------------------------------------------------------------------------*/
+  else if( request->resultStr ) {
+    jMsg = json_pack( "{ss sO}",
+                      "jsonrpc", "2.0",
+                      "id",      request->rpcId );
+    str = json_dumps_member( jMsg, JSON_PRESERVE_ORDER | JSON_COMPACT | JSON_ENSURE_ASCII,
+                             "result", request->resultStr );
+    if( str )
+      sendIckMessageString( request->ictx, request->sourceUuid, str );
+    else
+      logerr( "ickMessage from %s: could not serialize result.", request->sourceUuid );
+    Sfree( str );
+    json_decref( jMsg );
   }
 
 /*------------------------------------------------------------------------*\
-    Adjust player volume 
+   Broadcast changes in playlist and/or player state
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"setVolume") ) {
-    double volume = playerGetVolume();
-    bool   muted  = playerGetMuting();
+  DBGMSG( "ickMessage from %s: need to update playlist: %s", 
+            request->sourceUuid, request->playlistChanged?"Yes":"No" );
+  if( request->playlistChanged ) {
+    ickMessageNotifyPlaylist( request->zone, NULL );
+    if( !playerGetZoneIndex(request->zone) )
+      hmiNewQueue( playerGetQueue(request->zone) );
+  }
+  DBGMSG( "ickMessage from %s: need to update player state: %s",
+            request->sourceUuid, request->playerStateChanged?"Yes":"No" );
+  if( request->playerStateChanged )
+    ickMessageNotifyPlayerState( request->zone, NULL );
 
-    // Interpret parameters, if any
-    if( jParams ) {
+/*------------------------------------------------------------------------*\
+    Clean up
+\*------------------------------------------------------------------------*/
+  _rpcRequestFree( request );
+}
 
-      // Get optional muting state
-      jObj = json_object_get( jParams, "muted" );
-      if( jObj && json_is_boolean(jObj) )
-        muted = json_is_true( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non boolean field \"muted\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"muted\": wrong type (no boolean)";
-        goto rpcError;
-      }
 
-      // Set volume relative to current value (optional)
-      jObj = json_object_get( jParams, "relativeVolumeLevel" );
-      if( jObj && json_is_real(jObj) )
-        volume *= 1 + json_real_value( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non real field \"relativeVolumeLevel\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"muted\": wrong type (no real)";
-        goto rpcError;
-      }
+/*=========================================================================*\
+  Free a request
+\*=========================================================================*/
+static void _rpcRequestFree( IckRpcRequest *request )
+{
+  if( request->jRoot )
+    json_decref( request->jRoot );
+  if( request->jResult )
+    json_decref( request->jResult );
+  jsonArenaRelease( request->arena );
+  Sfree( request->resultStr );
+  Sfree( request->sourceUuid );
+  Sfree( request->message );
+  Sfree( request );
+}
 
-      // Set volume absolutely (optional)
-      jObj = json_object_get( jParams, "volumeLevel" );
-      if( jObj && json_is_real(jObj) )
-        volume = json_real_value( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non real field \"volumeLevel\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"muted\": wrong type (no real)";
-        goto rpcError;
-      }
 
-      // Set new volume and muting state
-      playerSetVolume( volume, muted, true );
-    }
+/*=========================================================================*\
+  Queue a request for the worker pool, start workers on demand
+    return 0 on success, -1 on error (caller should execute directly)
+\*=========================================================================*/
+static int _rpcQueueRequest( IckRpcRequest *request )
+{
+  RpcJob *job;
+  int     perr;
 
-    // report current state
-    jResult = json_pack( "{sfsb}",
-                         "volumeLevel", playerGetVolume(),
-                         "muted",       playerGetMuting() );                         
-  }
+  DBGMSG( "_rpcQueueRequest (%p): \"%s\"", request, request->method );
 
 /*------------------------------------------------------------------------*\
-    Get playback queue
+    Create job
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"getPlaybackQueue") ) {
-    Playlist        *plst   = playerGetQueue();
-    int              offset;
-    int              count;
-    PlaylistSortType order  = PlaylistMapped;
-
-    // Lock playlist and get defaults
-    playlistLock( plst );
-    offset = 0;
-    count  = playlistGetLength(plst);
-
-    // Interpret parameters, if any
-    if( jParams ) {
-
-      // Get optional ordering
-      jObj = json_object_get( jParams, "order" );
-      if( jObj && json_is_string(jObj) ) {
-         order = playlistSortTypeFromStr( json_string_value(jObj) );
-         if( order<0 || order>PlaylistHybrid ) {
-           logerr( "ickMessage from %s contains non field \"order\" with unknown value: %.*s",
-                   sourceUuid, (int)mSize, message );
-           rpcErrCode    = RPC_INVALID_PARAMS;
-           rpcErrMessage = "Parameter \"order\": invalid value";
-           playlistUnlock( plst );
-           goto rpcError;
-         }
-      }
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non string field \"order\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"order\": wrong type (no string)";
-        playlistUnlock( plst );
-        goto rpcError;
-      }
-
-      // Get optional explicit offset
-      jObj = json_object_get( jParams, "offset" );
-      if( jObj && json_is_integer(jObj) )
-         offset = json_integer_value( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non integer field \"offset\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"offset\": wrong type (no integer)";
-        playlistUnlock( plst );
-        goto rpcError;
-      }
+  job = calloc( 1, sizeof(RpcJob) );
+  if( !job ) {
+    logerr( "_rpcQueueRequest: out of memory!" );
+    return -1;
+  }
+  job->request = request;
 
-      // Get optional explicit count
-      jObj = json_object_get( jParams, "count" );
-      if( jObj && json_is_integer(jObj) )
-         count = json_integer_value( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non integer field \"count\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"count\": wrong type (no integer)";
-        playlistUnlock( plst );
-        goto rpcError;
-      }
+/*------------------------------------------------------------------------*\
+    Start workers if necessary
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &rpcJobMutex );
+  while( !rpcWorkersStop && rpcWorkersRunning<IckRpcWorkers ) {
+    perr = pthread_create( &rpcWorkers[rpcWorkersRunning], NULL, _rpcWorkerThread, NULL );
+    if( perr ) {
+      logerr( "Cannot start RPC worker thread: %s", strerror(perr) );
+      break;
     }
-
-    // Compile JSON projection of list and unlock
-    jResult = playlistGetJSON( plst, order, offset, count );
-    playlistUnlock( plst );
+    rpcWorkersRunning++;
+  }
+  if( !rpcWorkersRunning || rpcWorkersStop ) {
+    pthread_mutex_unlock( &rpcJobMutex );
+    Sfree( job );
+    return -1;
   }
 
 /*------------------------------------------------------------------------*\
-    Set playback queue id and name
+    Append to queue (FIFO) and wake up a worker
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"setPlaylistName") ) {
-    Playlist   *plst = playerGetQueue();
-    const char *id   = NULL;
-    const char *name = NULL;
+  if( rpcJobTail )
+    rpcJobTail->next = job;
+  else
+    rpcJobHead = job;
+  rpcJobTail = job;
+  pthread_cond_signal( &rpcJobCond );
+  pthread_mutex_unlock( &rpcJobMutex );
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
-    }
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return 0;
+}
 
-    // Get mandatory ID
-    jObj = json_object_get( jParams, "playlistId" );
-    if( !jObj || !json_is_string(jObj) )  {
-      logerr( "ickMessage from %s: missing field \"playlistId\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"playListId\": missing or of wrong type";
-      goto rpcError;
-    }
-    id = json_string_value( jObj );
-    
-    // Get mandatory name
-    jObj = json_object_get( jParams, "playlistName" );
-    if( !jObj || !json_is_string(jObj) ) {
-      logerr( "ickMessage from %s: missing field \"playlistName\": %.*s",
-                       sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"playListName\": missing or of wrong type";
-      goto rpcError;
-    }
-    name = json_string_value( jObj );
 
-    // Set id and name
-    playlistLock( plst );
-    playlistSetId( plst, id );
-    playlistSetName( plst, name );
+/*=========================================================================*\
+  Worker thread: execute queued requests
+\*=========================================================================*/
+static void *_rpcWorkerThread( void *arg )
+{
+  RpcJob *job;
 
-    // Playlist has changed
-    playlistChanged = true;
+  DBGMSG( "RPC worker thread: starting." );
+  PTHREADSETNAME( "rpcWorker" );
 
-    // report result 
-    jResult = json_pack( "{sssssi}",
-                         "playlistId", id, 
-                         "playlistName", name, 
-                         "countAll", playlistGetLength(plst) );
+/*------------------------------------------------------------------------*\
+    Loop until stopped and queue is drained
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &rpcJobMutex );
+  for(;;) {
 
-    playlistUnlock( plst );
+    // Wait for jobs
+    if( !rpcJobHead ) {
+      if( rpcWorkersStop )
+        break;
+      pthread_cond_wait( &rpcJobCond, &rpcJobMutex );
+      continue;
+    }
+
+    // Unlink job
+    job = rpcJobHead;
+    rpcJobHead = job->next;
+    if( !rpcJobHead )
+      rpcJobTail = NULL;
+
+    // Execute without holding the lock
+    pthread_mutex_unlock( &rpcJobMutex );
+    _rpcExecute( job->request );
+    Sfree( job );
+    pthread_mutex_lock( &rpcJobMutex );
   }
+  pthread_mutex_unlock( &rpcJobMutex );
 
 /*------------------------------------------------------------------------*\
-    Replace playback queue
+    That's all
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"setTracks") ) {
-    Playlist *plst      = playerGetQueue();
-    int       pos       = -1;        // New playlist position
-    json_t   *jItems    = NULL;      // List of new items
-    int       result    = 1;
+  DBGMSG( "RPC worker thread: terminating." );
+  return NULL;
+}
 
-    // Interpret optional parameters
-    if( jParams ) {
 
-      // Get optional explicit position
-      jObj = json_object_get( jParams, "playbackQueuePos" );
-      if( jObj && json_is_integer(jObj) )
-        pos    = json_integer_value( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"playbackQueuePos\": wrong type (no integer)";
-        goto rpcError;
-      }
+/*=========================================================================*\
+  RPC: Get versions of supported protocols
+\*=========================================================================*/
+static int _rpcGetProtocolVersions( IckRpcRequest *request, json_t *jParams )
+{
+  // Get result
+  request->jResult = json_pack( "{ss ss}",
+                       "minVersion", ICK_MINVERSION,
+                       "maxVersion", ICK_MAXVERSION );
 
-      // Get optional list of new items
-      jItems = json_object_get( jParams, "items" );
-      if( jItems && !json_is_array(jItems) ) {
-        logerr( "ickMessage from %s: contains non array field \"items\": %.*s",
-                 sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"items\": wrong type (no array)";
-        goto rpcError;
-      }
-    }
+  return 0;
+}
 
-    // Replace tracks in playback queue
-    playlistLock( plst );
-    if( playlistAddItems(plst,0,0,jItems,true) ) {
-      logerr( "ickMessage from %s: could not add/set items in playlist: %.*s",
-               sourceUuid, (int)mSize, message );
-      result = 0;
-    }
 
-    // Set cursor position
-    if( pos>=0 )
-      playlistSetCursorPos( plst, pos );
+/*=========================================================================*\
+  RPC: Get player status
+\*=========================================================================*/
+static int _rpcGetPlayerStatus( IckRpcRequest *request, json_t *jParams )
+{
+  // Get serialized result
+  request->resultStr = _strPlayerStatus( request->zone );
+
+  return 0;
+}
 
-    // Playback queue has changed
-    playlistChanged = true;
 
-    // Playlist cursor might have changed
-    playerStateChanged = true;
+/*=========================================================================*\
+  RPC: Get position in track
+\*=========================================================================*/
+static int _rpcGetSeekPosition( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist *plst = playerGetQueue(request->zone);
 
-    // report result 
-    jResult = json_pack( "{sb si}",
-                         "result", result,
-                         "playbackQueuePos", playlistGetCursorPos(plst) );
+  // Get positions
+  request->jResult = json_pack( "{si sf}",
+                       "playbackQueuePos", playlistGetCursorPos(plst),
+                       "seekPos",          playerGetSeekPos(request->zone) );
 
-    playlistUnlock( plst );
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Get track info
+\*=========================================================================*/
+static int _rpcGetTrack( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist     *plst = playerGetQueue(request->zone);
+  PlaylistItem *pItem;
+  int           pos;
+  json_t       *jObj;
+
+  // Get optionally requested position or use cursor for current track as default
+  jObj = json_object_get( jParams, "playbackQueuePos" );
+  if( !jObj )
+    pos = playlistGetCursorPos( plst );
+  else if( json_is_integer(jObj) )
+    pos = json_integer_value( jObj );
+  else {
+    logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playbackQueuePos\": wrong type (no integer)" );
   }
 
-  /*------------------------------------------------------------------------*\
-      Add tracks to playback queue
-  \*------------------------------------------------------------------------*/
-    else if( !strcasecmp(method,"addTracks") ) {
-      Playlist *plst      = playerGetQueue();
-      int       mPos      = -1;        // Position in mapped list to add list before
-      int       oPos      = -1;        // Position in original list to add list before
-      json_t   *jItems    = NULL;      // List of new items
-      int       result    = 1;
-
-      // Expect parameters
-      if( !jParams  ) {
-        logerr( "ickMessage from %s contains no parameters: %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_REQUEST;
-        rpcErrMessage = "Missing parameters in RPC header";
-        goto rpcError;
-      }
+  // Construct result
+  request->jResult   = json_pack( "{ss si}",
+                         "playlistId",       playlistGetId(plst),
+                         "playbackQueuePos", pos );
+  
+  // Add info about current track (if any)
+  pItem = playlistGetItem( plst, PlaylistMapped, pos );
+  if( pItem ) {
+    json_object_set_new( request->jResult, "track", playlistItemGetJSON(pItem) );
+  }
 
-      // Get optional explicit position
-      jObj = json_object_get( jParams, "playbackQueuePos" );
-      if( jObj && json_is_integer(jObj) )
-        mPos = json_integer_value( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"playbackQueuePos\": wrong type (no integer)";
-        goto rpcError;
-      }
+  return 0;
+}
 
-      // Get mandatory list of new items
-      jItems = json_object_get( jParams, "items" );
-      if( !jItems || !json_is_array(jItems) ) {
-        logerr( "ickMessage from %s: contains non array field \"items\": %.*s",
-                 sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"items\": missing or of wrong type";
-        goto rpcError;
-      }
 
-      // What to modify?
-      switch( playerGetPlaybackMode() ) {
-        case PlaybackShuffle:
-        case PlaybackRepeatShuffle:
-          // append to end of playback queue
-          oPos = -1;
-          break;
-
-        case PlaybackQueue:
-        case PlaybackRepeatQueue:
-        case PlaybackRepeatItem:
-        case PlaybackDynamic:
-          oPos = mPos;
-          break;
-      }
+/*=========================================================================*\
+  RPC: Set repeat mode
+\*=========================================================================*/
+static int _rpcSetPlaybackQueueMode( IckRpcRequest *request, json_t *jParams )
+{
+  PlayerPlaybackMode  mode;
+  json_t             *jObj;
+
+  // Get mandatory mode
+  jObj = json_object_get( jParams, "playbackQueueMode" );
+  if( !jObj || !json_is_string(jObj) )  {
+    logerr( "ickMessage from %s: missing field \"playbackQueueMode\": %.*s",
+                     request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"repeatMode\": missing or of wrong type" );
+  }
+  mode = playerPlaybackModeFromStr( json_string_value(jObj) );
+  if( mode<0 ) {
+    logerr( "ickMessage from %s: unknown repeat mode: %s",
+                     request->sourceUuid, json_string_value(jObj) );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"repeatMode\": invalid value" );
+  }
 
-      // Add tracks to playback queue
-      playlistLock( plst );
-      if( playlistAddItems(plst,oPos,mPos,jItems,false) ) {
-        logerr( "ickMessage from %s: could not add/set items in playlist: %.*s",
-                 sourceUuid, (int)mSize, message );
-        playlistUnlock( plst );
-        result = 0;
-      }
+  // Set and broadcast player mode to account for skipped tracks
+  playerSetPlaybackMode( request->zone, mode, true );
 
-      // Playback queue has changed
-      playlistChanged = true;
+  // report current state
+  request->jResult = json_pack( "{ss}",
+                       "playbackQueueMode", playerPlaybackModeToStr(playerGetPlaybackMode(request->zone)) );
 
-      // Playlist cursor might have changed
-      playerStateChanged = true;
+  return 0;
+}
 
-      // report result
-      jResult = json_pack( "{sbsi}",
-                           "result", result,
-                           "playbackQueuePos", playlistGetCursorPos(plst) );
 
-      playlistUnlock( plst );
-    }
+/*=========================================================================*\
+  RPC: Set track index to play
+\*=========================================================================*/
+static int _rpcSetTrack( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist *plst   = playerGetQueue(request->zone);
+  int       offset = 0;
+  json_t   *jObj;
+
+  // Get mandatory position
+  jObj = json_object_get( jParams, "playbackQueuePos" );
+  if( !jObj || !json_is_integer(jObj) )  {
+    logerr( "ickMessage from %s: missing field \"playbackQueuePos\": %.*s",
+                     request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playbackQueuePos\": missing or of wrong type" );
+  }
+  offset = json_integer_value( jObj );
 
+  // Change pointer in playlist
+  playlistLock( plst );
+  playlistSetCursorPos( plst, offset );
+  playlistUnlock( plst );
 
-/*------------------------------------------------------------------------*\
-    Remove tracks from playback queue
-\*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"removeTracks") ) {
-    Playlist *plst = playerGetQueue();
-    json_t   *jItems;
-    int       result = 1;
+  // Set and broadcast player mode to account for skipped tracks
+  playerSetState( request->zone, playerGetState(request->zone), true );
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
-    }
+  // report current state
+  playlistLock( plst );
+  request->jResult = json_pack( "{si}",
+                       "playbackQueuePos", playlistGetCursorPos(plst) );
+  playlistUnlock( plst );
 
-    // Get list of items to be removed
-    jItems = json_object_get( jParams, "items" );
-    if( !jItems || !json_is_array(jItems) ) {
-      logerr( "ickMessage from %s: missing field \"items\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"items\": missing or of wrong type";
-      goto rpcError;
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Play or pause
+\*=========================================================================*/
+static int _rpcPlay( IckRpcRequest *request, json_t *jParams )
+{
+  PlayerState  newState;
+  json_t      *jObj;
+
+  // Get mandatory mode
+  jObj = json_object_get( jParams, "playing" );
+  if( !jObj || !json_is_boolean(jObj) )  {
+    logerr( "ickMessage from %s: missing field \"playing\": %.*s",
+                     request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playing\": missing or of wrong type" );
+  }
+  newState = json_is_true(jObj) ? PlayerStatePlay : PlayerStatePause;
+  
+  // Set and broadcast player mode
+  playerSetState( request->zone, newState, true );
+   
+  // report current state
+  request->jResult = json_pack( "{sb}",
+                       "playing", playerGetState(request->zone)==PlayerStatePlay );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Report player volume
+\*=========================================================================*/
+static int _rpcGetVolume( IckRpcRequest *request, json_t *jParams )
+{
+  // Report current volume and muting state
+  request->jResult = json_pack( "{sfsb}",
+                       "volumeLevel", playerGetVolume(request->zone), 
+                       "muted", playerGetMuting(request->zone) );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Adjust player volume
+\*=========================================================================*/
+static int _rpcSetVolume( IckRpcRequest *request, json_t *jParams )
+{
+  double  volume = playerGetVolume(request->zone);
+  bool    muted  = playerGetMuting(request->zone);
+  json_t *jObj;
+
+  // Interpret parameters, if any
+  if( jParams ) {
+
+    // Get optional muting state
+    jObj = json_object_get( jParams, "muted" );
+    if( jObj && json_is_boolean(jObj) )
+      muted = json_is_true( jObj );
+    else if( jObj ) {
+      logerr( "ickMessage from %s contains non boolean field \"muted\": %.*s",
+              request->sourceUuid, (int)request->mSize, request->message );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"muted\": wrong type (no boolean)" );
     }
-    
-    // Remove items from playlist
-    playlistLock( plst );
-    if( playlistDeleteItems(plst,jItems) ) {
-      logerr( "ickMessage from %s: could not remove items from playlist: %.*s",
-               sourceUuid, (int)mSize, message );
+
+    // Set volume relative to current value (optional)
+    jObj = json_object_get( jParams, "relativeVolumeLevel" );
+    if( jObj && json_is_real(jObj) )
+      volume *= 1 + json_real_value( jObj );
+    else if( jObj ) {
+      logerr( "ickMessage from %s contains non real field \"relativeVolumeLevel\": %.*s",
+              request->sourceUuid, (int)request->mSize, request->message );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"muted\": wrong type (no real)" );
+    }
+
+    // Set volume absolutely (optional)
+    jObj = json_object_get( jParams, "volumeLevel" );
+    if( jObj && json_is_real(jObj) )
+      volume = json_real_value( jObj );
+    else if( jObj ) {
+      logerr( "ickMessage from %s contains non real field \"volumeLevel\": %.*s",
+              request->sourceUuid, (int)request->mSize, request->message );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"muted\": wrong type (no real)" );
+    }
+
+    // Set new volume and muting state
+    playerSetVolume( request->zone, volume, muted, true );
+  }
+
+  // report current state
+  request->jResult = json_pack( "{sfsb}",
+                       "volumeLevel", playerGetVolume(request->zone),
+                       "muted",       playerGetMuting(request->zone) );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Get playback queue
+\*=========================================================================*/
+static int _rpcGetPlaybackQueue( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist         *plst   = playerGetQueue(request->zone);
+  PlaylistSnapshot *snapshot;
+  int               offset;
+  int               count;
+  PlaylistSortType  order  = PlaylistMapped;
+  json_t           *jObj;
+
+  // Lock playlist and get defaults
+  playlistLock( plst );
+  offset = 0;
+  count  = playlistGetLength(plst);
+
+  // Interpret parameters, if any
+  if( jParams ) {
+
+    // Get optional ordering
+    jObj = json_object_get( jParams, "order" );
+    if( jObj && json_is_string(jObj) ) {
+       order = playlistSortTypeFromStr( json_string_value(jObj) );
+       if( order<0 || order>PlaylistHybrid ) {
+         logerr( "ickMessage from %s contains non field \"order\" with unknown value: %.*s",
+                 request->sourceUuid, (int)request->mSize, request->message );
+         playlistUnlock( plst );
+         return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                   "Parameter \"order\": invalid value" );
+       }
+    }
+    else if( jObj ) {
+      logerr( "ickMessage from %s contains non string field \"order\": %.*s",
+              request->sourceUuid, (int)request->mSize, request->message );
       playlistUnlock( plst );
-      result = 0;
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"order\": wrong type (no string)" );
     }
 
-    // Playback queue has changed
-    playlistChanged = true;
+    // Get optional explicit offset
+    jObj = json_object_get( jParams, "offset" );
+    if( jObj && json_is_integer(jObj) )
+       offset = json_integer_value( jObj );
+    else if( jObj ) {
+      logerr( "ickMessage from %s contains non integer field \"offset\": %.*s",
+              request->sourceUuid, (int)request->mSize, request->message );
+      playlistUnlock( plst );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"offset\": wrong type (no integer)" );
+    }
 
-    // Playlist cursor might have changed
-    playerStateChanged = true;
+    // Get optional explicit count
+    jObj = json_object_get( jParams, "count" );
+    if( jObj && json_is_integer(jObj) )
+       count = json_integer_value( jObj );
+    else if( jObj ) {
+      logerr( "ickMessage from %s contains non integer field \"count\": %.*s",
+              request->sourceUuid, (int)request->mSize, request->message );
+      playlistUnlock( plst );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"count\": wrong type (no integer)" );
+    }
+  }
 
-    // report result 
-    jResult = json_pack( "{sb si}",
-                         "result", result,
-                         "playbackQueuePos", playlistGetCursorPos(plst) );
-    playlistUnlock( plst );
+  // Get snapshot and unlock, serialize projection without blocking the queue
+  snapshot = playlistGetSnapshot( plst );
+  playlistUnlock( plst );
+  if( snapshot ) {
+    request->resultStr = playlistSnapshotGetJSONString( snapshot, order, offset, count );
+    playlistSnapshotRelease( snapshot );
   }
 
-/*------------------------------------------------------------------------*\
-    Move tracks within playback queue
-\*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"moveTracks") ) {
-    Playlist        *plst    = playerGetQueue();
-    json_t          *jItems;
-    int              pos     = -1;                // Item to add list before
-    PlaylistSortType order   = PlaylistOriginal;
-    int              result  = 1;
+  return 0;
+}
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
+
+/*=========================================================================*\
+  RPC: Get changes of playback queue since a version (extension)
+\*=========================================================================*/
+static int _rpcGetPlaybackQueueChanges( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist         *plst     = playerGetQueue(request->zone);
+  PlaylistSnapshot *snapshot = NULL;
+  json_int_t        version;
+  json_t           *jChanges;
+  json_t           *jObj;
+
+  // Get mandatory version
+  jObj = json_object_get( jParams, "version" );
+  if( !jObj || !json_is_integer(jObj) )  {
+    logerr( "ickMessage from %s: missing field \"version\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"version\": missing or of wrong type" );
+  }
+  version = json_integer_value( jObj );
+
+  // Get delta or full queue
+  playlistLock( plst );
+  jChanges = playlistGetChanges( plst, version );
+  if( jChanges )
+    request->jResult = json_pack( "{sb sI sf si so}",
+                         "full",        0,
+                         "version",     playlistGetVersion(plst),
+                         "lastChanged", (double) playlistGetLastChange(plst),
+                         "countAll",    playlistGetLength(plst),
+                         "changes",     jChanges );
+  else {
+    DBGMSG( "ickMessage from %s: no delta since version %lld, sending full queue.",
+            request->sourceUuid, (long long)version );
+    snapshot = playlistGetSnapshot( plst );
+  }
+  playlistUnlock( plst );
+
+  // Serialize full queue without lock and mark it as such
+  if( snapshot ) {
+    char *str = playlistSnapshotGetJSONString( snapshot, PlaylistHybrid, 0, 0 );
+    playlistSnapshotRelease( snapshot );
+    if( str ) {
+      request->resultStr = malloc( strlen(str)+13 );
+      if( request->resultStr )
+        sprintf( request->resultStr, "{\"full\":true,%s", str+1 );
+      else
+        logerr( "ickMessage: out of memory!" );
     }
+    Sfree( str );
+  }
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Set playback queue id and name
+\*=========================================================================*/
+static int _rpcSetPlaylistName( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist   *plst = playerGetQueue(request->zone);
+  const char *id   = NULL;
+  const char *name = NULL;
+  json_t     *jObj;
+
+  // Get mandatory ID
+  jObj = json_object_get( jParams, "playlistId" );
+  if( !jObj || !json_is_string(jObj) )  {
+    logerr( "ickMessage from %s: missing field \"playlistId\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playListId\": missing or of wrong type" );
+  }
+  id = json_string_value( jObj );
+  
+  // Get mandatory name
+  jObj = json_object_get( jParams, "playlistName" );
+  if( !jObj || !json_is_string(jObj) ) {
+    logerr( "ickMessage from %s: missing field \"playlistName\": %.*s",
+                     request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playListName\": missing or of wrong type" );
+  }
+  name = json_string_value( jObj );
+
+  // Set id and name
+  playlistSetId( plst, id );
+  playlistSetName( plst, name );
+
+  // Playlist has changed
+  request->playlistChanged = true;
+
+  // report result 
+  request->jResult = json_pack( "{sssssi}",
+                       "playlistId", id, 
+                       "playlistName", name, 
+                       "countAll", playlistGetLength(plst) );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Replace playback queue
+\*=========================================================================*/
+static int _rpcSetTracks( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist *plst      = playerGetQueue(request->zone);
+  int       pos       = -1;        // New playlist position
+  json_t   *jItems    = NULL;      // List of new items
+  int       result    = 1;
+  json_t   *jObj;
+
+  // Interpret optional parameters
+  if( jParams ) {
 
     // Get optional explicit position
     jObj = json_object_get( jParams, "playbackQueuePos" );
     if( jObj && json_is_integer(jObj) )
-      pos = json_integer_value( jObj );
+      pos    = json_integer_value( jObj );
     else if( jObj ) {
       logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"playbackQueuePos\": wrong type (no integer)";
-      goto rpcError;
+              request->sourceUuid, (int)request->mSize, request->message );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"playbackQueuePos\": wrong type (no integer)" );
     }
-    
-    // Get mandatory list of items to move
+
+    // Get optional list of new items
     jItems = json_object_get( jParams, "items" );
-    if( !jItems || !json_is_array(jItems) ) {
-      logerr( "ickMessage from %s: missing field \"items\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"items\": missing or of wrong type";
-      goto rpcError;
+    if( jItems && !json_is_array(jItems) ) {
+      logerr( "ickMessage from %s: contains non array field \"items\": %.*s",
+               request->sourceUuid, (int)request->mSize, request->message );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"items\": wrong type (no array)" );
     }
+  }
+
+  // Replace tracks in playback queue
+  if( playlistAddItems(plst,0,0,jItems,true) ) {
+    logerr( "ickMessage from %s: could not add/set items in playlist: %.*s",
+             request->sourceUuid, (int)request->mSize, request->message );
+    result = 0;
+  }
+
+  // Set cursor position
+  if( pos>=0 )
+    playlistSetCursorPos( plst, pos );
+
+  // Playback queue has changed
+  request->playlistChanged = true;
+
+  // Playlist cursor might have changed
+  request->playerStateChanged = true;
+
+  // report result 
+  request->jResult = json_pack( "{sb si}",
+                       "result", result,
+                       "playbackQueuePos", playlistGetCursorPos(plst) );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Add tracks to playback queue
+\*=========================================================================*/
+static int _rpcAddTracks( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist *plst      = playerGetQueue(request->zone);
+  int       mPos      = -1;        // Position in mapped list to add list before
+  int       oPos      = -1;        // Position in original list to add list before
+  json_t   *jItems    = NULL;      // List of new items
+  int       result    = 1;
+  json_t   *jObj;
+
+  // Get optional explicit position
+  jObj = json_object_get( jParams, "playbackQueuePos" );
+  if( jObj && json_is_integer(jObj) )
+    mPos = json_integer_value( jObj );
+  else if( jObj ) {
+    logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playbackQueuePos\": wrong type (no integer)" );
+  }
+
+  // Get mandatory list of new items
+  jItems = json_object_get( jParams, "items" );
+  if( !jItems || !json_is_array(jItems) ) {
+    logerr( "ickMessage from %s: contains non array field \"items\": %.*s",
+             request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"items\": missing or of wrong type" );
+  }
+
+  // What to modify?
+  switch( playerGetPlaybackMode(request->zone) ) {
+    case PlaybackShuffle:
+    case PlaybackRepeatShuffle:
+      // append to end of playback queue
+      oPos = -1;
+      break;
+
+    case PlaybackQueue:
+    case PlaybackRepeatQueue:
+    case PlaybackRepeatItem:
+    case PlaybackDynamic:
+      oPos = mPos;
+      break;
+  }
+
+  // Add tracks to playback queue
+  if( playlistAddItems(plst,oPos,mPos,jItems,false) ) {
+    logerr( "ickMessage from %s: could not add/set items in playlist: %.*s",
+             request->sourceUuid, (int)request->mSize, request->message );
+    result = 0;
+  }
+
+  // Playback queue has changed
+  request->playlistChanged = true;
+
+  // Playlist cursor might have changed
+  request->playerStateChanged = true;
+
+  // report result
+  request->jResult = json_pack( "{sbsi}",
+                       "result", result,
+                       "playbackQueuePos", playlistGetCursorPos(plst) );
+
+  return 0;
+}
 
-    // Lock playlist
-    playlistLock( plst );
 
-    // What to modify?
-    switch( playerGetPlaybackMode() ) {
+/*=========================================================================*\
+  RPC: Remove tracks from playback queue
+\*=========================================================================*/
+static int _rpcRemoveTracks( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist *plst = playerGetQueue(request->zone);
+  json_t   *jItems;
+  int       result = 1;
+
+  // Get list of items to be removed
+  jItems = json_object_get( jParams, "items" );
+  if( !jItems || !json_is_array(jItems) ) {
+    logerr( "ickMessage from %s: missing field \"items\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"items\": missing or of wrong type" );
+  }
+  
+  // Remove items from playlist
+  if( playlistDeleteItems(plst,jItems) ) {
+    logerr( "ickMessage from %s: could not remove items from playlist: %.*s",
+             request->sourceUuid, (int)request->mSize, request->message );
+    result = 0;
+  }
+
+  // Playback queue has changed
+  request->playlistChanged = true;
+
+  // Playlist cursor might have changed
+  request->playerStateChanged = true;
+
+  // report result 
+  request->jResult = json_pack( "{sb si}",
+                       "result", result,
+                       "playbackQueuePos", playlistGetCursorPos(plst) );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Move tracks within playback queue
+\*=========================================================================*/
+static int _rpcMoveTracks( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist        *plst    = playerGetQueue(request->zone);
+  json_t          *jItems;
+  int              pos     = -1;                // Item to add list before
+  PlaylistSortType order   = PlaylistOriginal;
+  int              result  = 1;
+  json_t          *jObj;
+
+  // Get optional explicit position
+  jObj = json_object_get( jParams, "playbackQueuePos" );
+  if( jObj && json_is_integer(jObj) )
+    pos = json_integer_value( jObj );
+  else if( jObj ) {
+    logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playbackQueuePos\": wrong type (no integer)" );
+  }
+  
+  // Get mandatory list of items to move
+  jItems = json_object_get( jParams, "items" );
+  if( !jItems || !json_is_array(jItems) ) {
+    logerr( "ickMessage from %s: missing field \"items\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"items\": missing or of wrong type" );
+  }
+
+  // What to modify?
+  switch( playerGetPlaybackMode(request->zone) ) {
+    case PlaybackShuffle:
+    case PlaybackRepeatShuffle:
+      order = PlaylistMapped;
+      break;
+
+    case PlaybackQueue:
+    case PlaybackRepeatQueue:
+    case PlaybackRepeatItem:
+    case PlaybackDynamic:
+      order = PlaylistOriginal;
+      break;
+  }
+
+  // Move tracks within playlist
+  if( playlistMoveItems(plst,order,pos,jItems) ) {
+    logerr( "ickMessage from %s: could not move items in playlist: %.*s",
+             request->sourceUuid, (int)request->mSize, request->message );
+    result = 0;
+  }
+
+  // Sync mapping to changes of original playlist
+  if( order==PlaylistOriginal )
+    playlistResetMapping( plst, false );
+
+  // Playback queue has changed
+  request->playlistChanged = true;
+
+  // Playlist cursor might have changed
+  request->playerStateChanged = true;
+
+  // report result 
+  request->jResult = json_pack( "{sbsi}",
+                       "result", result,
+                       "playbackQueuePos", playlistGetCursorPos(plst) );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Shuffle playback queue
+\*=========================================================================*/
+static int _rpcShuffleTracks( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist      *plst    = playerGetQueue(request->zone);
+  int            result  = 1;
+  int            rangeStart;
+  int            rangeEnd;
+  json_t        *jObj;
+
+  // Get defaults
+  rangeStart = 0*playlistGetCursorPos( plst );
+  rangeEnd   = playlistGetLength( plst )-1;
+
+  // Get explicit positions (non standard extension)
+  if( jParams ) {
+    jObj = json_object_get( jParams, "playlistStartPos" );
+    if( jObj && json_is_integer(jObj) )
+      rangeStart = json_integer_value( jObj );
+    else if( jObj ) {
+      logerr( "ickMessage from %s contains non integer field \"playlistStartPos\": %.*s",
+              request->sourceUuid, (int)request->mSize, request->message );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"playlistStartPos\": wrong type (no integer)" );
+    }
+
+    jObj = json_object_get( jParams, "playlistEndPos" );
+    if( jObj && json_is_integer(jObj) )
+      rangeEnd = json_integer_value( jObj );
+    else if( jObj ) {
+      logerr( "ickMessage from %s contains non integer field \"playlistEndPos\": %.*s",
+              request->sourceUuid, (int)request->mSize, request->message );
+      return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                                "Parameter \"playlistEndPos\": wrong type (no integer)" );
+    }
+
+  }
+
+  // Do the shuffling
+  if( rangeStart<rangeEnd ) {
+    if( !playlistShuffle(plst,rangeStart,rangeEnd,true) )
+      result = 0;
+
+    // Need to sync original list?
+    switch( playerGetPlaybackMode(request->zone) ) {
       case PlaybackShuffle:
       case PlaybackRepeatShuffle:
-        order = PlaylistMapped;
+        // No!
         break;
 
       case PlaybackQueue:
       case PlaybackRepeatQueue:
       case PlaybackRepeatItem:
       case PlaybackDynamic:
-        order = PlaylistOriginal;
+        playlistResetMapping( plst, true );
         break;
     }
 
-    // Move tracks within playlist
-    if( playlistMoveItems(plst,order,pos,jItems) ) {
-      logerr( "ickMessage from %s: could not move items in playlist: %.*s",
-               sourceUuid, (int)mSize, message );
+    // Playback queue has changed
+    request->playlistChanged = true;
+
+    // Playlist cursor might have changed
+    request->playerStateChanged = true;
+  }
+
+  // report result
+  request->jResult = json_pack( "{sb si}",
+                       "result", result,
+                       "playbackQueuePos", playlistGetCursorPos(plst) );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+  RPC: Modify data of a playback queue item
+\*=========================================================================*/
+static int _rpcSetTrackMetadata( IckRpcRequest *request, json_t *jParams )
+{
+  Playlist      *plst        = playerGetQueue(request->zone);
+  int            pos;
+  bool           replaceFlag = true;
+  PlaylistItem  *pItem;
+  int            result     = 1;
+  json_t        *jObj;
+
+  // Get default position
+  pos = playlistGetCursorPos( plst );
+
+  // Get optional explicit position
+  jObj = json_object_get( jParams, "playbackQueuePos" );
+  if( jObj && json_is_integer(jObj) )
+    pos = json_integer_value( jObj );
+  else if( jObj ) {
+    logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playbackQueuePos\": wrong type (no integer)" );
+  }
+
+  // Get optional replace flag
+  jObj = json_object_get( jParams, "replace" );
+  if( jObj && json_is_boolean(jObj) )
+    replaceFlag = json_is_true(jObj) ? true : false;
+  else if( jObj ) {
+    logerr( "ickMessage from %s contains non boolean field \"replace\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"replace\": wrong type (no boolean)" );
+  }
+
+  // Get mandatory new meta data
+  jObj = json_object_get( jParams, "track" );
+  if( !jObj || !json_is_object(jObj) ) {
+    logerr( "ickMessage from %s: missing field \"track\": %-*s",
+                     request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"track\": missing or of wrong type" );
+  }
+
+  // Address item of interest
+  pItem = playlistGetItem( plst, PlaylistMapped, pos );
+  if( !pItem ) {
+    logwarn( "ickMessage from %s: no item found at queue position %d: %.*s",
+             request->sourceUuid, pos, (int)request->mSize, request->message );
+    result = 0;
+  }
+
+  // Modify meta data
+  else {
+    playlistItemLock( pItem );
+    if( playlistItemSetMetaData(pItem,jObj,replaceFlag) )
       result = 0;
-    }
+    playlistItemUnlock( pItem );
+    playlistItemChanged( plst, pItem );
+    request->playlistChanged = true;
+  }
 
-    // Sync mapping to changes of original playlist
-    if( order==PlaylistOriginal )
-      playlistResetMapping( plst, false );
+  // report result
+  request->jResult = json_pack( "{sb}",
+                       "result", result );
+  if( pItem ) {
+    json_object_set_new( request->jResult, "track", playlistItemGetJSON(pItem) );
+  }
 
-    // Playback queue has changed
-    playlistChanged = true;
+  return 0;
+}
 
-    // Playlist cursor might have changed
-    playerStateChanged = true;
 
-    // report result 
-    jResult = json_pack( "{sbsi}",
-                         "result", result,
-                         "playbackQueuePos", playlistGetCursorPos(plst) );
+/*=========================================================================*\
+  RPC: Set player configuration
+\*=========================================================================*/
+static int _rpcSetPlayerConfiguration( IckRpcRequest *request, json_t *jParams )
+{
+  const char *registrationToken = NULL;
+  const char *cloudUrl          = NULL;
+  json_t     *jObj;
 
-    // Unlock playlist
-    playlistUnlock( plst );
+  // Get mandatory player name
+  jObj = json_object_get( jParams, "playerName" );
+  if( !jObj || !json_is_string(jObj) ) {
+    logerr( "ickMessage from %s: item missing field \"playerName\": %.*s",
+                     request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"playerName\": missing or of wrong type" );
   } 
+  playerSetName( request->zone, json_string_value(jObj), true );
+
+  // Get optional registration token
+  jObj = json_object_get( jParams, "deviceRegistrationToken" );
+  if( jObj && json_is_string(jObj) )
+    registrationToken = json_string_value(jObj);
+  else if( jObj ) {
+    logerr( "ickMessage from %s contains non string field \"deviceRegistrationToken\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"accessToken\": wrong type (no string)" );
+  }
 
-/*------------------------------------------------------------------------*\
-   Shuffle playback queue
-\*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"shuffleTracks") ) {
-    Playlist      *plst    = playerGetQueue();
-    int            result  = 1;
-    int            rangeStart;
-    int            rangeEnd;
+  // Get optional cloud URL
+  jObj = json_object_get( jParams, "cloudCoreUrl" );
+  if( jObj && json_is_string(jObj) )
+    cloudUrl = json_string_value(jObj);
+  else if( jObj ) {
+    logerr( "ickMessage from %s contains non string field \"cloudCoreUrl\": %.*s",
+            request->sourceUuid, (int)request->mSize, request->message );
+    return ickMessageRpcError( request, RPC_INVALID_PARAMS,
+                              "Parameter \"cloudCoreUrl\": wrong type (no string)" );
+  }
 
-    // Lock playlist and get defaults
-    playlistLock( plst );
-    rangeStart = 0*playlistGetCursorPos( plst );
-    rangeEnd   = playlistGetLength( plst )-1;
-
-    // Get explicit positions (non standard extension)
-    if( jParams ) {
-      jObj = json_object_get( jParams, "playlistStartPos" );
-      if( jObj && json_is_integer(jObj) )
-        rangeStart = json_integer_value( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non integer field \"playlistStartPos\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"playlistStartPos\": wrong type (no integer)";
-        playlistUnlock( plst );
-        goto rpcError;
-      }
+  // Set cloud URL and reinit registration or reset registration if token is not given
+  if( cloudUrl ) {
+    ickCloudSetCoreUrl( json_string_value(jObj) );
+    ickCloudRegisterDevice( registrationToken );
+  }
 
-      jObj = json_object_get( jParams, "playlistEndPos" );
-      if( jObj && json_is_integer(jObj) )
-        rangeEnd = json_integer_value( jObj );
-      else if( jObj ) {
-        logerr( "ickMessage from %s contains non integer field \"playlistEndPos\": %.*s",
-                sourceUuid, (int)mSize, message );
-        rpcErrCode    = RPC_INVALID_PARAMS;
-        rpcErrMessage = "Parameter \"playlistEndPos\": wrong type (no integer)";
-        playlistUnlock( plst );
-        goto rpcError;
-      }
+  // Set or change access token
+  else if( registrationToken )
+    ickCloudRegisterDevice( registrationToken );
 
-    }
+/*
+  // Register with the cloud core
+  ickCloudSetDeviceAddress( );
 
-    // Do the shuffling
-    if( rangeStart<rangeEnd ) {
-      if( !playlistShuffle(plst,rangeStart,rangeEnd,true) )
-        result = 0;
-
-      // Need to sync original list?
-      switch( playerGetPlaybackMode() ) {
-        case PlaybackShuffle:
-        case PlaybackRepeatShuffle:
-          // No!
-          break;
-
-        case PlaybackQueue:
-        case PlaybackRepeatQueue:
-        case PlaybackRepeatItem:
-        case PlaybackDynamic:
-          playlistResetMapping( plst, true );
-          break;
-      }
+  // Get services using this token
+  ickServiceAddFromCloud( NULL, true );
 
-      // Playback queue has changed
-      playlistChanged = true;
+  // Inform HMI
+  hmiNewConfig( );
+*/
+  // report result 
+  request->jResult = json_pack( "{ss ss}",
+                       "playerName", playerGetName(request->zone), 
+                       "playerModel", playerGetModel() );
 
-      // Playlist cursor might have changed
-      playerStateChanged = true;
-    }
+  // Append cloud URL if available
+  cloudUrl = ickCloudGetCoreUrl();
+  if( cloudUrl )
+    json_object_set_new( request->jResult, "cloudCoreUrl", json_string(cloudUrl) );
 
-    // report result
-    jResult = json_pack( "{sb si}",
-                         "result", result,
-                         "playbackQueuePos", playlistGetCursorPos(plst) );
+  return 0;
+}
 
-    playlistUnlock( plst );
-  }
 
-/*------------------------------------------------------------------------*\
-   Modify data of a playback queue item
-\*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"setTrackMetadata") ) {
-    Playlist      *plst        = playerGetQueue();
-    int            pos;
-    bool           replaceFlag = true;
-    PlaylistItem  *pItem;
-    int            result     = 1;
+/*=========================================================================*\
+  RPC: Report player configuration
+\*=========================================================================*/
+static int _rpcGetPlayerConfiguration( IckRpcRequest *request, json_t *jParams )
+{
+  const char *hwid;
+  const char *cloudUrl;
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
-    }
+  // Compile result
+  request->jResult = json_pack( "{ss ss}",
+                       "playerName",  playerGetName(request->zone), 
+                       "playerModel", playerGetModel() );
 
-    // Lock playlist and get default position
-    playlistLock( plst );
-    pos = playlistGetCursorPos( plst );
+  // Append hardware id if available
+  hwid = playerGetHWID();
+  if( hwid ) 
+    json_object_set_new( request->jResult, "hardwareId", json_string(hwid) );
 
-    // Get optional explicit position
-    jObj = json_object_get( jParams, "playbackQueuePos" );
-    if( jObj && json_is_integer(jObj) )
-      pos = json_integer_value( jObj );
-    else if( jObj ) {
-      logerr( "ickMessage from %s contains non integer field \"playbackQueuePos\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"playbackQueuePos\": wrong type (no integer)";
-      playlistUnlock( plst );
-      goto rpcError;
-    }
+  // Append cloud URL if available
+  cloudUrl = ickCloudGetCoreUrl();
+  if( cloudUrl )
+    json_object_set_new( request->jResult, "hardwareId", json_string(cloudUrl) );
 
-    // Get optional replace flag
-    jObj = json_object_get( jParams, "replace" );
-    if( jObj && json_is_boolean(jObj) )
-      replaceFlag = json_is_true(jObj) ? true : false;
-    else if( jObj ) {
-      logerr( "ickMessage from %s contains non boolean field \"replace\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"replace\": wrong type (no boolean)";
-      playlistUnlock( plst );
-      goto rpcError;
-    }
+  return 0;
+}
+
+
+#ifdef ICK_TRACE
+/*=========================================================================*\
+  RPC: Get recorded trace events (Chrome trace format)
+\*=========================================================================*/
+static int _rpcGetPlayerTrace( IckRpcRequest *request, json_t *jParams )
+{
+  request->jResult = traceGetJSON();
+
+  return request->jResult ? 0 : -1;
+}
+#endif
+
+
+/*=========================================================================*\
+  Send a notification for playlist update
+    Broadcasts (szDeviceId==NULL) are coalesced within the notification
+    delay, notifications for a single device are sent immediately
+    zone==NULL notifies for all zones
+\*=========================================================================*/
+void ickMessageNotifyPlaylist( Player *zone, const char *szDeviceId )
+{
+  int i;
 
-    // Get mandatory new meta data
-    jObj = json_object_get( jParams, "track" );
-    if( !jObj || !json_is_object(jObj) ) {
-      logerr( "ickMessage from %s: missing field \"track\": %-*s",
-                       sourceUuid, (int)mSize, message );
-      playlistUnlock( plst );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"track\": missing or of wrong type";
-      goto rpcError;
-    }
+  // All zones?
+  if( !zone ) {
+    for( i=0; i<playerGetZoneCount(); i++ )
+      ickMessageNotifyPlaylist( playerGetZone(i), szDeviceId );
+    return;
+  }
 
-    // Address item of interest
-    pItem = playlistGetItem( plst, PlaylistMapped, pos );
-    if( !pItem ) {
-      logwarn( "ickMessage from %s: no item found at queue position %d: %.*s",
-               sourceUuid, pos, (int)mSize, message );
-      result = 0;
-    }
+  DBGMSG( "ickMessageNotifyPlaylist (zone %d): %s.",
+          playerGetZoneIndex(zone), szDeviceId?szDeviceId:"ALL" );
 
-    // Modify meta data
-    else {
-      playlistItemLock( pItem );
-      if( playlistItemSetMetaData(pItem,jObj,replaceFlag) )
-        result = 0;
-      playlistItemUnlock( pItem );
-      playlistChanged = true;
-    }
+  if( szDeviceId )
+    _sendPlaylistNotification( zone, szDeviceId );
+  else
+    _scheduleNotification( zone, IckNotifyPlaylist );
+}
 
-    // report result
-    jResult = json_pack( "{sb}",
-                         "result", result );
-    if( pItem ) {
-      playlistItemLock( pItem );
-      json_object_set_new( jResult, "track", playlistItemGetJSON(pItem) );
-      playlistItemUnlock( pItem );
-    }
 
-    playlistUnlock( plst );
+/*=========================================================================*\
+  Send a notification for player status update
+    Broadcasts (szDeviceId==NULL) are coalesced within the notification
+    delay, notifications for a single device are sent immediately
+    zone==NULL notifies for all zones
+\*=========================================================================*/
+void ickMessageNotifyPlayerState( Player *zone, const char *szDeviceId )
+{
+  int i;
+
+  // All zones (e.g. for a changed cloud status)?
+  if( !zone ) {
+    for( i=0; i<playerGetZoneCount(); i++ )
+      ickMessageNotifyPlayerState( playerGetZone(i), szDeviceId );
+    return;
   }
 
-/*------------------------------------------------------------------------*\
-    Set player configuration
-\*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"setPlayerConfiguration") ) {
-    const char *registrationToken = NULL;
-    const char *cloudUrl          = NULL;
+  DBGMSG( "ickMessageNotifyPlayerState (zone %d): %s.",
+          playerGetZoneIndex(zone), szDeviceId?szDeviceId:"ALL" );
 
-    // Expect parameters
-    if( !jParams ) {
-      logerr( "ickMessage from %s contains no parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Missing parameters in RPC header";
-      goto rpcError;
-    }
+  if( szDeviceId )
+    _sendPlayerStateNotification( zone, szDeviceId );
+  else
+    _scheduleNotification( zone, IckNotifyPlayerState );
+}
 
-    // Get mandatory player name
-    jObj = json_object_get( jParams, "playerName" );
-    if( !jObj || !json_is_string(jObj) ) {
-      logerr( "ickMessage from %s: item missing field \"playerName\": %.*s",
-                       sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"playerName\": missing or of wrong type";
-      goto rpcError;
-    } 
-    playerSetName( json_string_value(jObj), true );
-
-    // Get optional registration token
-    jObj = json_object_get( jParams, "deviceRegistrationToken" );
-    if( jObj && json_is_string(jObj) )
-      registrationToken = json_string_value(jObj);
-    else if( jObj ) {
-      logerr( "ickMessage from %s contains non string field \"deviceRegistrationToken\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"accessToken\": wrong type (no string)";
-      goto rpcError;
-    }
 
-    // Get optional cloud URL
-    jObj = json_object_get( jParams, "cloudCoreUrl" );
-    if( jObj && json_is_string(jObj) )
-      cloudUrl = json_string_value(jObj);
-    else if( jObj ) {
-      logerr( "ickMessage from %s contains non string field \"cloudCoreUrl\": %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_PARAMS;
-      rpcErrMessage = "Parameter \"cloudCoreUrl\": wrong type (no string)";
-      goto rpcError;
-    }
+/*=========================================================================*\
+  Set debounce window for broadcast notifications (in seconds)
+    0 disables coalescing
+\*=========================================================================*/
+void ickMessageSetNotificationDelay( double delay )
+{
+  DBGMSG( "ickMessageSetNotificationDelay: %.3lfs", delay );
 
-    // Set cloud URL and reinit registration or reset registration if token is not given
-    if( cloudUrl ) {
-      ickCloudSetCoreUrl( json_string_value(jObj) );
-      ickCloudRegisterDevice( registrationToken );
-    }
+  pthread_mutex_lock( &notifyMutex );
+  notifyDelay = delay>0 ? delay : 0;
+  pthread_cond_signal( &notifyCond );
+  pthread_mutex_unlock( &notifyMutex );
+}
 
-    // Set or change access token
-    else if( registrationToken )
-      ickCloudRegisterDevice( registrationToken );
 
-  /*
-    // Register with the cloud core
-    ickCloudSetDeviceAddress( );
+/*=========================================================================*\
+  Send pending broadcast notifications immediately
+    Use this for latency sensitive changes (e.g. play/pause)
+\*=========================================================================*/
+void ickMessageFlushNotifications( void )
+{
+  DBGMSG( "ickMessageFlushNotifications: pending %s", notifyAnyPending?"yes":"no" );
+  _sendPendingNotifications();
+}
 
-    // Get services using this token
-    ickServiceAddFromCloud( NULL, true );
 
-    // Inform HMI
-    hmiNewConfig( );
-*/
-    // report result 
-    jResult = json_pack( "{ss ss}",
-                         "playerName", playerGetName(), 
-                         "playerModel", playerGetModel() );
+/*=========================================================================*\
+  Shutdown RPC workers and notification scheduler
+    queued requests are executed, pending notifications are sent
+\*=========================================================================*/
+void ickMessageShutdown( void )
+{
+  int i;
 
-    // Append cloud URL if available
-    cloudUrl = ickCloudGetCoreUrl();
-    if( cloudUrl )
-      json_object_set_new( jResult, "cloudCoreUrl", json_string(cloudUrl) );
+  loginfo( "Shutting down ickMessage module..." );
 
+/*------------------------------------------------------------------------*\
+    Stop RPC workers (they drain the job queue)
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &rpcJobMutex );
+  rpcWorkersStop = true;
+  pthread_cond_broadcast( &rpcJobCond );
+  pthread_mutex_unlock( &rpcJobMutex );
+  for( i=0; i<rpcWorkersRunning; i++ )
+    pthread_join( rpcWorkers[i], NULL );
+  rpcWorkersRunning = 0;
+
+/*------------------------------------------------------------------------*\
+    Stop scheduler thread
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &notifyMutex );
+  if( notifyRunning ) {
+    notifyStop = true;
+    pthread_cond_signal( &notifyCond );
+    pthread_mutex_unlock( &notifyMutex );
+    pthread_join( notifyThread, NULL );
+    pthread_mutex_lock( &notifyMutex );
+    notifyRunning = false;
+    notifyStop    = false;
   }
+  pthread_mutex_unlock( &notifyMutex );
 
 /*------------------------------------------------------------------------*\
-    Report player configuration
+    Send what's left and report efficiency
 \*------------------------------------------------------------------------*/
-  else if( !strcasecmp(method,"getPlayerConfiguration") ) {
-    const char *hwid;
-    const char *cloudUrl;
+  _sendPendingNotifications();
+  loginfo( "ickMessageShutdown: sent %ld of %ld requested broadcast notifications.",
+           notifySent, notifyRequested );
 
-    // Expect no parameters
-    if( jParams && json_object_size(jParams) ) {
-      logerr( "ickMessage from %s contains parameters: %.*s",
-              sourceUuid, (int)mSize, message );
-      rpcErrCode    = RPC_INVALID_REQUEST;
-      rpcErrMessage = "Unexpected parameters in RPC header";
-      goto rpcError;
-    }
+/*------------------------------------------------------------------------*\
+    Drop outstanding requests
+\*------------------------------------------------------------------------*/
+  _freeOpenRequests();
+}
+
+
+/*=========================================================================*\
+  Schedule a broadcast notification
+    The first request opens the debounce window, all further requests
+    of the same type are merged until the scheduler thread sends them
+\*=========================================================================*/
+static void _scheduleNotification( Player *zone, int what )
+{
+  int index = playerGetZoneIndex( zone );
+  int perr;
+
+  pthread_mutex_lock( &notifyMutex );
+  notifyRequested++;
 
-    // Compile result
-    jResult = json_pack( "{ss ss}",
-                         "playerName",  playerGetName(), 
-                         "playerModel", playerGetModel() );
-
-    // Append hardware id if available
-    hwid = playerGetHWID();
-    if( hwid ) 
-      json_object_set_new( jResult, "hardwareId", json_string(hwid) );
-
-    // Append cloud URL if available
-    cloudUrl = ickCloudGetCoreUrl();
-    if( cloudUrl )
-      json_object_set_new( jResult, "hardwareId", json_string(cloudUrl) );
-  }  
-  
 /*------------------------------------------------------------------------*\
-    Unknown message 
+    Already pending?
 \*------------------------------------------------------------------------*/
-  else {
-    logerr( "ickMessage from %s: ignoring method %s", sourceUuid, method );
-    rpcErrCode = RPC_METHOD_NOT_FOUND;
-    rpcErrMessage = "Method not found";
+  if( notifyPending[index]&what ) {
+    DBGMSG( "_scheduleNotification (zone %d): 0x%02x merged with pending", index, what );
+    pthread_mutex_unlock( &notifyMutex );
+    return;
   }
 
 /*------------------------------------------------------------------------*\
-   Return error
+    Mark as pending, start of debounce window
 \*------------------------------------------------------------------------*/
-rpcError:
-  if( rpcErrCode!=RPC_NO_ERROR ) {
-    logwarn( "ickMessage from %s: error code %d (%s) (message was: %.*s)",
-             sourceUuid, rpcErrCode, rpcErrMessage, (int)mSize, message);
-    jResult = json_pack( "{siss}",
-                         "code",    rpcErrCode,
-                         "message", rpcErrMessage);
-    jResult = json_pack( "{ssso}",
-                         "jsonrpc", "2.0",
-                         "error",   jResult);
-    if( rpcId )
-      json_object_set_new( jResult, "id", rpcId );
+  if( !notifyAnyPending )
+    notifyPendingSince = srvtime();
+  notifyPending[index] |= what;
+  notifyAnyPending      = true;
+
+/*------------------------------------------------------------------------*\
+    No coalescing: send directly
+\*------------------------------------------------------------------------*/
+  if( notifyDelay<=0 ) {
+    pthread_mutex_unlock( &notifyMutex );
+    _sendPendingNotifications();
+    return;
   }
 
 /*------------------------------------------------------------------------*\
-   Return nominal result
+    Start scheduler thread if necessary or wake it up
 \*------------------------------------------------------------------------*/
-  else if( jResult ) {
-    jResult = json_pack( "{sssoso}",
-                         "jsonrpc", "2.0", 
-                         "id",     rpcId,
-                         "result", jResult );
-    sendIckMessage( ictx, sourceUuid, jResult );
-    json_decref( jResult );
-  } 
+  if( !notifyRunning ) {
+    perr = pthread_create( &notifyThread, NULL, _notifyThread, NULL );
+    if( perr ) {
+      pthread_mutex_unlock( &notifyMutex );
+      logerr( "Cannot start notification thread: %s", strerror(perr) );
+      _sendPendingNotifications();
+      return;
+    }
+    notifyRunning = true;
+  }
+  else
+    pthread_cond_signal( &notifyCond );
+  pthread_mutex_unlock( &notifyMutex );
+}
+
+
+/*=========================================================================*\
+  Send all pending broadcast notifications
+    Sending is serialized, messages are compiled from the current state
+\*=========================================================================*/
+static void _sendPendingNotifications( void )
+{
+  int what[PlayerMaxZones];
+  int i, count = playerGetZoneCount();
+
+  pthread_mutex_lock( &notifySendMutex );
 
 /*------------------------------------------------------------------------*\
-   Broadcast changes in playlist and/or player state
+    Get and reset pending flags
 \*------------------------------------------------------------------------*/
-  DBGMSG( "ickMessage from %s: need to update playlist: %s", 
-            sourceUuid, playlistChanged?"Yes":"No" );
-  if( playlistChanged ) {
-    ickMessageNotifyPlaylist( NULL );
-    hmiNewQueue( playerGetQueue() );
+  pthread_mutex_lock( &notifyMutex );
+  for( i=0; i<count; i++ ) {
+    what[i] = notifyPending[i];
+    notifyPending[i] = 0;
+    if( what[i]&IckNotifyPlaylist )
+      notifySent++;
+    if( what[i]&IckNotifyPlayerState )
+      notifySent++;
   }
-  DBGMSG( "ickMessage from %s: need to update player state: %s",
-            sourceUuid, playerStateChanged?"Yes":"No" );
-  if( playerStateChanged )
-    ickMessageNotifyPlayerState( NULL );
+  notifyAnyPending = false;
+  pthread_mutex_unlock( &notifyMutex );
 
+/*------------------------------------------------------------------------*\
+    Send playlist first, since player status refers to it
+\*------------------------------------------------------------------------*/
+  for( i=0; i<count; i++ ) {
+    if( what[i]&IckNotifyPlaylist )
+      _sendPlaylistNotification( playerGetZone(i), NULL );
+    if( what[i]&IckNotifyPlayerState )
+      _sendPlayerStateNotification( playerGetZone(i), NULL );
+  }
+
+  pthread_mutex_unlock( &notifySendMutex );
+}
+
+
+/*=========================================================================*\
+  Scheduler thread: send notifications after debounce window
+\*=========================================================================*/
+static void *_notifyThread( void *arg )
+{
+  struct timespec abstime;
+  double          due;
+
+  DBGMSG( "Notification thread: starting." );
+  PTHREADSETNAME( "notify" );
 
 /*------------------------------------------------------------------------*\
-    Clean up: Free JSON message object and check for timedout requests
+    Loop until stopped
 \*------------------------------------------------------------------------*/
-  if( jRoot )
-    json_decref( jRoot );
-  _timeoutOpenRequest( 60 );
+  pthread_mutex_lock( &notifyMutex );
+  while( !notifyStop ) {
+
+    // Wait for requests
+    if( !notifyAnyPending ) {
+      pthread_cond_wait( &notifyCond, &notifyMutex );
+      continue;
+    }
+
+    // Wait for end of debounce window
+    due = notifyPendingSince + notifyDelay;
+    if( srvtime()<due ) {
+      abstime.tv_sec  = (time_t)due;
+      abstime.tv_nsec = (long)((due-abstime.tv_sec)*1E9);
+      pthread_cond_timedwait( &notifyCond, &notifyMutex, &abstime );
+      continue;
+    }
+
+    // Send without holding the lock
+    pthread_mutex_unlock( &notifyMutex );
+    _sendPendingNotifications();
+    pthread_mutex_lock( &notifyMutex );
+  }
+  pthread_mutex_unlock( &notifyMutex );
+
+/*------------------------------------------------------------------------*\
+    That's all (pending notifications are sent by ickMessageShutdown)
+\*------------------------------------------------------------------------*/
+  DBGMSG( "Notification thread: terminating." );
+  return NULL;
 }
 
 
 /*=========================================================================*\
-  Send a notification for playlist update
+  Compile and send playlistChanged notification
 \*=========================================================================*/
-void ickMessageNotifyPlaylist( const char *szDeviceId )
+static void _sendPlaylistNotification( Player *zone, const char *szDeviceId )
 {
   Playlist   *plst;
   json_t     *jMsg;
   const char *str;
 
-  DBGMSG( "ickMessageNotifyPlaylist: %s.", szDeviceId?szDeviceId:"ALL" );
+  DBGMSG( "_sendPlaylistNotification (zone %d): %s.",
+          playerGetZoneIndex(zone), szDeviceId?szDeviceId:"ALL" );
+
+/*------------------------------------------------------------------------*\
+    No context (yet)?
+\*------------------------------------------------------------------------*/
+  if( !playerGetContext(zone) )
+    return;
 
 /*------------------------------------------------------------------------*\
     Set up parameters
 \*------------------------------------------------------------------------*/
-  plst = playerGetQueue( );
+  plst = playerGetQueue( zone );
   playlistLock( plst );
-  jMsg = json_pack( "{sf si}",
+  jMsg = json_pack( "{sf sI si}",
                       "lastChanged", (double) playlistGetLastChange(plst), 
+                      "version", playlistGetVersion(plst),
                       "countAll", playlistGetLength(plst) );
   // Name and ID are optional                       
   str = playlistGetId( plst );
@@ -1316,86 +2084,128 @@ void ickMessageNotifyPlaylist( const char *szDeviceId )
 /*------------------------------------------------------------------------*\
     Broadcast and clean up
 \*------------------------------------------------------------------------*/
-  sendIckMessage( _ictx, szDeviceId, jMsg );
+  sendIckMessage( playerGetContext(zone), szDeviceId, jMsg );
   json_decref( jMsg );
 }
 
 
 /*=========================================================================*\
-  Send a notification for plyer status update
+  Compile and send playerStatusChanged notification
 \*=========================================================================*/
-void ickMessageNotifyPlayerState( const char *szDeviceId )
+static void _sendPlayerStateNotification( Player *zone, const char *szDeviceId )
 {
   json_t *jMsg;
+  char   *params;
+  char   *str;
   
-  DBGMSG( "ickMessageNotifyPlayerState: %s.", szDeviceId?szDeviceId:"ALL" );
-  
+  DBGMSG( "_sendPlayerStateNotification (zone %d): %s.",
+          playerGetZoneIndex(zone), szDeviceId?szDeviceId:"ALL" );
+
+/*------------------------------------------------------------------------*\
+    No context (yet)?
+\*------------------------------------------------------------------------*/
+  if( !playerGetContext(zone) )
+    return;
+
 /*------------------------------------------------------------------------*\
-    Get player state
+    Get serialized player state
 \*------------------------------------------------------------------------*/
-  jMsg = _jPlayerStatus();
+  params = _strPlayerStatus( zone );
+  if( !params )
+    return;
 
 /*------------------------------------------------------------------------*\
     Set up message
 \*------------------------------------------------------------------------*/
-  jMsg = json_pack( "{ss ss so}",
+  jMsg = json_pack( "{ss ss}",
                     "jsonrpc", "2.0", 
-                    "method", "playerStatusChanged",
-                    "params", jMsg );
+                    "method", "playerStatusChanged" );
+  str  = json_dumps_member( jMsg, JSON_PRESERVE_ORDER | JSON_COMPACT | JSON_ENSURE_ASCII,
+                            "params", params );
+  json_decref( jMsg );
+  Sfree( params );
+  if( !str ) {
+    logerr( "_sendPlayerStateNotification: could not serialize message." );
+    return;
+  }
 
 /*------------------------------------------------------------------------*\
     Broadcast and clean up
 \*------------------------------------------------------------------------*/
-  sendIckMessage( _ictx, szDeviceId, jMsg );
-  json_decref( jMsg );                       	
+  sendIckMessageString( playerGetContext(zone), szDeviceId, str );
+  Sfree( str );
 }
 
 
 /*=========================================================================*\
-  Compile player status for getPlayerStatus or playerStatusChanged
+  Compile serialized player status for getPlayerStatus or playerStatusChanged
+    The current track is inserted in its cached serialized form
+    return allocated string or NULL on error
 \*=========================================================================*/
-json_t *_jPlayerStatus( void )
+char *_strPlayerStatus( Player *zone )
 {
-  Playlist     *plst     = playerGetQueue();
-  int           cursorPos;
-  double        pChange, aChange;
-  json_t       *jResult;
-  PlaylistItem *pItem;
-  playlistLock( plst );
+  Playlist         *plst     = playerGetQueue( zone );
+  PlaylistSnapshot *snapshot;
+  json_t           *jStatus;
+  PlaylistItem     *pItem;
+  char             *trackStr = NULL;
+  char             *result;
 
-  DBGMSG( "_PlayerStatus." );
+  DBGMSG( "_strPlayerStatus." );
 
 /*------------------------------------------------------------------------*\
-    Create status message
+    Get header and serialized current track (if any)
 \*------------------------------------------------------------------------*/
-  cursorPos = playlistGetCursorPos( plst );
-  pChange   = playlistGetLastChange( plst );
-  aChange   = playerGetLastChange( );
-  jResult   = json_pack( "{sb sf si sf sb ss ss sf}",
-                         "playing",           playerGetState()==PlayerStatePlay,
-                         "seekPos",           playerGetSeekPos(),
-                         "playbackQueuePos",  cursorPos,
-                         "volumeLevel",       playerGetVolume(),
-                         "muted",             playerGetMuting(),
-                         "playbackQueueMode", playerPlaybackModeToStr(playerGetPlaybackMode()),
-                         "cloudCoreStatus",   ickCloudGetAccessToken()?"REGISTERED":"UNREGISTERED",
-                         "lastChanged",       MAX(aChange,pChange) );
+  playlistLock( plst );
+  jStatus  = _jPlayerStatusHeader( zone, plst );
+  snapshot = playlistGetSnapshot( plst );
+  playlistUnlock( plst );
+  if( snapshot ) {
+    pItem = playlistSnapshotGetCursorItem( snapshot );
+    if( pItem )
+      trackStr = playlistItemGetJSONString( pItem );
+    playlistSnapshotRelease( snapshot );
+  }
 
 /*------------------------------------------------------------------------*\
-    Add info about current track (if any)
+    Serialize
 \*------------------------------------------------------------------------*/
-  pItem = playlistGetItem( plst, PlaylistMapped, cursorPos );
-  if( pItem ) {
-    playlistItemLock( pItem );
-    json_object_set( jResult, "track", playlistItemGetJSON(pItem) );
-    playlistItemUnlock( pItem );
-  }
+  if( trackStr )
+    result = json_dumps_member( jStatus, JSON_PRESERVE_ORDER | JSON_COMPACT | JSON_ENSURE_ASCII,
+                                "track", trackStr );
+  else
+    result = json_dumps( jStatus, JSON_PRESERVE_ORDER | JSON_COMPACT | JSON_ENSURE_ASCII );
+  if( !result )
+    logerr( "_strPlayerStatus: could not serialize status." );
 
 /*------------------------------------------------------------------------*\
-    That's all
+    Clean up, that's all
 \*------------------------------------------------------------------------*/
-  playlistUnlock( plst );
-  return jResult;   
+  Sfree( trackStr );
+  json_decref( jStatus );
+  return result;
+}
+
+
+/*=========================================================================*\
+  Compile player status without current track
+    Caller needs to lock playlist
+\*=========================================================================*/
+json_t *_jPlayerStatusHeader( Player *zone, Playlist *plst )
+{
+  double pChange, aChange;
+
+  pChange = playlistGetLastChange( plst );
+  aChange = playerGetLastChange( zone );
+  return json_pack( "{sb sf si sf sb ss ss sf}",
+                    "playing",           playerGetState(zone)==PlayerStatePlay,
+                    "seekPos",           playerGetSeekPos(zone),
+                    "playbackQueuePos",  playlistGetCursorPos(plst),
+                    "volumeLevel",       playerGetVolume(zone),
+                    "muted",             playerGetMuting(zone),
+                    "playbackQueueMode", playerPlaybackModeToStr(playerGetPlaybackMode(zone)),
+                    "cloudCoreStatus",   ickCloudGetAccessToken()?"REGISTERED":"UNREGISTERED",
+                    "lastChanged",       MAX(aChange,pChange) );
 }
 
 
@@ -1411,22 +2221,31 @@ ickErrcode_t sendIckMessage( ickP2pContext_t *ictx, const char *szDeviceId, json
     Convert JSON to string
 \*------------------------------------------------------------------------*/
   message = json_dumps( jMessage, JSON_PRESERVE_ORDER | JSON_COMPACT | JSON_ENSURE_ASCII );
+  if( !message ) {
+    logerr( "sendIckMessage: could not serialize message." );
+    return ICKERR_NOMEM;
+  }
 
 /*------------------------------------------------------------------------*\
-    Loop till timeout or success
-\*------------------------------------------------------------------------*/
-  loginfo( "ickMessage to %s: %s", szDeviceId?szDeviceId:"ALL", message );
-  irc = ickP2pSendMsg( ictx, szDeviceId, ICKP2P_SERVICE_ANY,
-                       ickP2pGetServices(ictx), message, strlen(message) );
-  
-/*------------------------------------------------------------------------*\
-    Clean up and that's all
+    Send and clean up
 \*------------------------------------------------------------------------*/
+  irc = sendIckMessageString( ictx, szDeviceId, message );
   Sfree( message );
   return irc;
 }
 
 
+/*=========================================================================*\
+  Send an already serialized ickstream JSON message
+\*=========================================================================*/
+ickErrcode_t sendIckMessageString( ickP2pContext_t *ictx, const char *szDeviceId, const char *message )
+{
+  loginfo( "ickMessage to %s: %s", szDeviceId?szDeviceId:"ALL", message );
+  return ickP2pSendMsg( ictx, szDeviceId, ICKP2P_SERVICE_ANY,
+                        ickP2pGetServices(ictx), message, strlen(message) );
+}
+
+
 /*=========================================================================*\
   Send a command and register callback.
     requestID returns the unique ID (we use an integer here) and might be NULL
@@ -1466,12 +2285,9 @@ ickErrcode_t sendIckCommand( ickP2pContext_t *ictx, const char *szDeviceId,
     json_object_set_new( request->jCommand, "params", json_object() );
       
 /*------------------------------------------------------------------------*\
-    Link request to open list
+    Register request in hash table and timer wheel
 \*------------------------------------------------------------------------*/
-  pthread_mutex_lock( &openRequestListMutex );
-  request->next   = openRequestList;
-  openRequestList = request;
-  pthread_mutex_unlock( &openRequestListMutex );
+  _linkOpenRequest( request );
   
 /*------------------------------------------------------------------------*\
     Send Request (need no decref, since the command is stored in open request
@@ -1481,54 +2297,212 @@ ickErrcode_t sendIckCommand( ickP2pContext_t *ictx, const char *szDeviceId,
 
 
 /*=========================================================================*\
-  Unlink an open request from list
+  Get statistics on requests sent to peers
+    returns an array of objects (one per peer), caller must decref
+\*=========================================================================*/
+json_t *ickMessageGetPeerStatistics( void )
+{
+  json_t *jResult = json_array();
+  int     i;
+
+  pthread_mutex_lock( &openRequestListMutex );
+  for( i=0; i<IckPeerHashSize; i++ ) {
+    PeerStatistics *stats;
+    for( stats=peerStatisticsTable[i]; stats; stats=stats->next ) {
+      json_t *jStats = json_pack( "{sssisisi}",
+                                  "deviceId",  stats->szDeviceId,
+                                  "requests",  stats->requests,
+                                  "responses", stats->responses,
+                                  "timeouts",  stats->timeouts );
+      if( stats->responses ) {
+        json_object_set_new( jStats, "rttAvg",  json_real(stats->rttSum/stats->responses) );
+        json_object_set_new( jStats, "rttMin",  json_real(stats->rttMin) );
+        json_object_set_new( jStats, "rttMax",  json_real(stats->rttMax) );
+        json_object_set_new( jStats, "rttLast", json_real(stats->rttLast) );
+      }
+      json_array_append_new( jResult, jStats );
+    }
+  }
+  pthread_mutex_unlock( &openRequestListMutex );
+
+  return jResult;
+}
+
+
+/*=========================================================================*\
+  Link an open request to hash table and timer wheel
 \*=========================================================================*/
-void _unlinkOpenRequest( OpenRequest *request )	
+static void _linkOpenRequest( OpenRequest *request )
 {
+  OpenRequest   **bucket = &openRequestTable[ (unsigned long)request->id%IckRequestHashSize ];
+  long            now    = (long) srvtime();
+
+  pthread_mutex_lock( &openRequestListMutex );
+
+/*------------------------------------------------------------------------*\
+    Wheel is idle: synchronize time base
+\*------------------------------------------------------------------------*/
+  if( !openRequestCount )
+    openRequestTick = now;
+
+/*------------------------------------------------------------------------*\
+    Link to bucket and wheel
+\*------------------------------------------------------------------------*/
+  request->next    = *bucket;
+  *bucket          = request;
+  request->expires = now + IckRequestTimeout;
+  _wheelInsert( request );
+  openRequestCount++;
 
 /*------------------------------------------------------------------------*\
-    Lock list and search for entry 
+    Count request for peer
 \*------------------------------------------------------------------------*/
+  PeerStatistics *stats = _peerStatistics( request->szDeviceId );
+  if( stats )
+    stats->requests++;
+
+  pthread_mutex_unlock( &openRequestListMutex );
+}
+
+
+/*=========================================================================*\
+  Find and unlink an open request by id
+    Updates the round trip statistics of the peer
+    returns NULL if not found
+\*=========================================================================*/
+static OpenRequest *_takeOpenRequest( long id )
+{
+  OpenRequest   **link;
+  OpenRequest    *request;
+
   pthread_mutex_lock( &openRequestListMutex );
-  OpenRequest *prevElement = NULL;
-  OpenRequest *element     = openRequestList;
-  while( element ) {
-    if( element==request )
-      break;
-    prevElement = element;
-    element = element->next;
-  }
 
 /*------------------------------------------------------------------------*\
-    Unlink element 
+    Search bucket
 \*------------------------------------------------------------------------*/
-  if( element ) {
-    if( !prevElement )    // replace list root
-      openRequestList = element->next;
-    else
-      prevElement->next = element->next;
+  link = &openRequestTable[ (unsigned long)id%IckRequestHashSize ];
+  while( *link && (*link)->id!=id )
+    link = &(*link)->next;
+  request = *link;
+  if( !request ) {
+    orphanedResponses++;
+    pthread_mutex_unlock( &openRequestListMutex );
+    return NULL;
   }
-  
+
 /*------------------------------------------------------------------------*\
-    Straying request? 
+    Unlink from bucket and wheel
 \*------------------------------------------------------------------------*/
-  else {
-    char *txt = json_dumps( request->jCommand, JSON_PRESERVE_ORDER | JSON_COMPACT | JSON_ENSURE_ASCII );
-    logwarn( "Cannot unlink straying open request #%d: %s", request->id, txt );
-    Sfree( txt );
-  }
-    
+  *link = request->next;
+  _wheelRemove( request );
+  openRequestCount--;
+
 /*------------------------------------------------------------------------*\
-    Unlock list 
+    Account round trip time
 \*------------------------------------------------------------------------*/
+  PeerStatistics *stats = _peerStatistics( request->szDeviceId );
+  if( stats ) {
+    double rtt = srvtime() - request->timestamp;
+    if( !stats->responses || rtt<stats->rttMin )
+      stats->rttMin = rtt;
+    if( rtt>stats->rttMax )
+      stats->rttMax = rtt;
+    stats->rttLast = rtt;
+    stats->rttSum += rtt;
+    stats->responses++;
+  }
+
   pthread_mutex_unlock( &openRequestListMutex );
+  return request;
+}
+
+
+/*=========================================================================*\
+  Insert an open request into the timer wheel
+    Requests expiring within the next IckWheelSize ticks go to level 0,
+    later ones to level 1 (and are cascaded down when their turn comes).
+    Needs openRequestListMutex to be locked.
+\*=========================================================================*/
+static void _wheelInsert( OpenRequest *request )
+{
+  OpenRequest **slot;
+  long          delta = request->expires - openRequestTick;
+
+  if( delta<0 ) {
+    request->expires = openRequestTick + 1;
+    delta            = 1;
+  }
+
+  if( delta<IckWheelSize )
+    slot = &openRequestWheel[0][request->expires&IckWheelMask];
+  else {
+    long level1 = request->expires>>IckWheelBits;
+    if( level1-(openRequestTick>>IckWheelBits)>=IckWheelSize )
+      level1 = (openRequestTick>>IckWheelBits) + IckWheelSize - 1;
+    slot = &openRequestWheel[1][level1&IckWheelMask];
+  }
+
+  request->wheelNext = *slot;
+  request->wheelPrev = slot;
+  if( *slot )
+    (*slot)->wheelPrev = &request->wheelNext;
+  *slot = request;
+}
+
+
+/*=========================================================================*\
+  Remove an open request from the timer wheel
+    Needs openRequestListMutex to be locked.
+\*=========================================================================*/
+static void _wheelRemove( OpenRequest *request )
+{
+  *request->wheelPrev = request->wheelNext;
+  if( request->wheelNext )
+    request->wheelNext->wheelPrev = request->wheelPrev;
+  request->wheelNext = NULL;
+  request->wheelPrev = NULL;
+}
+
+
+/*=========================================================================*\
+  Get statistics element for a peer, create if not yet existing
+    Needs openRequestListMutex to be locked.
+    returns NULL on error
+\*=========================================================================*/
+static PeerStatistics *_peerStatistics( const char *szDeviceId )
+{
+  PeerStatistics **bucket;
+  PeerStatistics  *stats;
+
+  if( !szDeviceId )
+    return NULL;
+
+  bucket = &peerStatisticsTable[ _rpcHash(szDeviceId)%IckPeerHashSize ];
+  for( stats=*bucket; stats; stats=stats->next )
+    if( !strcmp(stats->szDeviceId,szDeviceId) )
+      return stats;
+
+  stats = calloc( 1, sizeof(PeerStatistics) );
+  if( !stats ) {
+    logerr( "_peerStatistics: out of memory" );
+    return NULL;
+  }
+  stats->szDeviceId = strdup( szDeviceId );
+  if( !stats->szDeviceId ) {
+    logerr( "_peerStatistics: out of memory" );
+    Sfree( stats );
+    return NULL;
+  }
+  stats->next = *bucket;
+  *bucket     = stats;
+  return stats;
 }
 
 
 /*=========================================================================*\
-  Free an open request list element
+  Free an open request element
 \*=========================================================================*/
-void _freeOpenRequest( OpenRequest *request )	
+static void _freeOpenRequest( OpenRequest *request )
 {
   Sfree( request->szDeviceId );
   json_decref( request->jCommand );
@@ -1538,62 +2512,113 @@ void _freeOpenRequest( OpenRequest *request )
 
 /*=========================================================================*\
   Check for timedout requests
+    Advances the timer wheel up to now, timedout requests are collected
+    and reported without holding the lock.
 \*=========================================================================*/
-void _timeoutOpenRequest( int timeout )	
+static void _timeoutOpenRequests( void )
 {
-  double timeoutStamp = srvtime() - timeout;
+  OpenRequest *expired = NULL;
+  OpenRequest *element;
+  long         now     = (long) srvtime();
 
 /*------------------------------------------------------------------------*\
-    Lock list and loop over all entries 
+    Lock and advance wheel tick by tick
 \*------------------------------------------------------------------------*/
   pthread_mutex_lock( &openRequestListMutex );
-  OpenRequest *prevElement = NULL;
-  OpenRequest *element     = openRequestList;
-  while( element ) {
+  if( now-openRequestTick>IckWheelSize*IckWheelSize )   // clock jump
+    openRequestTick = now - IckWheelSize*IckWheelSize;
+  while( openRequestCount && openRequestTick<now ) {
+    OpenRequest **slot;
+    openRequestTick++;
 
 /*------------------------------------------------------------------------*\
-    Not yet timed out
+    Level 0 wrapped: cascade next level 1 slot
 \*------------------------------------------------------------------------*/
-    if( element->timestamp>timeoutStamp ) {
-      prevElement = element;
-      element = element->next;
-      continue;
+    if( !(openRequestTick&IckWheelMask) ) {
+      slot    = &openRequestWheel[1][(openRequestTick>>IckWheelBits)&IckWheelMask];
+      element = *slot;
+      *slot   = NULL;
+      while( element ) {
+        OpenRequest *nextElement = element->wheelNext;
+        _wheelInsert( element );
+        element = nextElement;
+      }
     }
 
 /*------------------------------------------------------------------------*\
-    Buffer follower (since element might vanish)
+    Collect expired elements of current level 0 slot
 \*------------------------------------------------------------------------*/
-    OpenRequest *nextElement = element->next;  
-    
+    slot    = &openRequestWheel[0][openRequestTick&IckWheelMask];
+    element = *slot;
+    *slot   = NULL;
+    while( element ) {
+      OpenRequest *nextElement = element->wheelNext;
+      if( element->expires>openRequestTick )
+        _wheelInsert( element );
+      else {
+        OpenRequest **link = &openRequestTable[ (unsigned long)element->id%IckRequestHashSize ];
+        while( *link!=element )
+          link = &(*link)->next;
+        *link = element->next;
+        openRequestCount--;
+        PeerStatistics *stats = _peerStatistics( element->szDeviceId );
+        if( stats )
+          stats->timeouts++;
+        element->next = expired;
+        expired       = element;
+      }
+      element = nextElement;
+    }
+  }
+  if( !openRequestCount )
+    openRequestTick = now;
+  pthread_mutex_unlock( &openRequestListMutex );
+
 /*------------------------------------------------------------------------*\
-    Be verbose
+    Be verbose and free resources
 \*------------------------------------------------------------------------*/
+  while( expired ) {
+    element = expired;
+    expired = element->next;
     char *txt = json_dumps( element->jCommand, JSON_PRESERVE_ORDER | JSON_COMPACT | JSON_ENSURE_ASCII );  
-    logwarn( "ickRequest #%d timed out: %s", element->id, txt );
+    logwarn( "ickRequest #%ld to %s timed out: %s", element->id, element->szDeviceId, txt );
     Sfree( txt );
-
-/*------------------------------------------------------------------------*\
-    Unlink timedout element
-\*------------------------------------------------------------------------*/
-    if( !prevElement )    // replace list root
-      openRequestList = element->next;
-    else
-      prevElement->next = element->next;
-        
-/*------------------------------------------------------------------------*\
-    Free resources
-\*------------------------------------------------------------------------*/
     _freeOpenRequest( element );  
-    
-/*------------------------------------------------------------------------*\
-    Go to next element
-\*------------------------------------------------------------------------*/
-    element = nextElement;
   }
-    
-/*------------------------------------------------------------------------*\
-    Unlock list 
-\*------------------------------------------------------------------------*/
+}
+
+
+/*=========================================================================*\
+  Drop all open requests and report peer statistics
+\*=========================================================================*/
+static void _freeOpenRequests( void )
+{
+  int i;
+
+  pthread_mutex_lock( &openRequestListMutex );
+  for( i=0; i<IckRequestHashSize; i++ ) {
+    while( openRequestTable[i] ) {
+      OpenRequest *element = openRequestTable[i];
+      openRequestTable[i] = element->next;
+      _freeOpenRequest( element );
+    }
+  }
+  memset( openRequestWheel, 0, sizeof(openRequestWheel) );
+  openRequestCount = 0;
+
+  for( i=0; i<IckPeerHashSize; i++ ) {
+    while( peerStatisticsTable[i] ) {
+      PeerStatistics *stats = peerStatisticsTable[i];
+      peerStatisticsTable[i] = stats->next;
+      loginfo( "ickMessage: peer %s: %ld requests, %ld responses, %ld timeouts, rtt avg %.3fs max %.3fs",
+               stats->szDeviceId, stats->requests, stats->responses, stats->timeouts,
+               stats->responses?stats->rttSum/stats->responses:0.0, stats->rttMax );
+      Sfree( stats->szDeviceId );
+      Sfree( stats );
+    }
+  }
+  if( orphanedResponses )
+    loginfo( "ickMessage: %ld responses without open request", orphanedResponses );
   pthread_mutex_unlock( &openRequestListMutex );
 }
 
@@ -52,7 +52,11 @@ Remarks         : -
 /*=========================================================================*\
 	Includes needed by definitions from this file
 \*=========================================================================*/
+#include <stdbool.h>
+#include <jansson.h>
 #include <ickP2p.h>
+#include "jsonArena.h"
+#include "player.h"
 
 
 /*=========================================================================*\
@@ -72,8 +76,48 @@ Remarks         : -
 /*=========================================================================*\
        Global symbols 
 \*=========================================================================*/
+// jResult is released after the callback returns (see jsonArenaPromote())
 typedef void (*IckCmdCallback)(const char *szDeviceId, json_t *jCmd, json_t *jResult);  
 
+// An incoming JSON-RPC request as seen by method handlers
+// jRoot (and thus the parameters) is located in an arena that is released
+// with the request: use jsonArenaPromote() to keep objects beyond that
+typedef struct _ickRpcRequest IckRpcRequest;
+
+// Method handlers set jResult or resultStr, return 0 on success, -1 on error
+typedef int (*IckRpcHandler)( IckRpcRequest *request, json_t *jParams );
+
+struct _ickRpcRequest {
+  ickP2pContext_t *ictx;
+  Player          *zone;                // addressed zone (by ictx)
+  char            *sourceUuid;          // strong
+  char            *message;             // strong, raw request (for logging)
+  size_t           mSize;
+  json_t          *jRoot;               // strong
+  json_t          *rpcId;               // weak, part of jRoot
+  const char      *method;              // weak, part of jRoot
+  json_t          *jResult;             // strong, result object
+  char            *resultStr;           // strong, alternative: serialized result
+  int              rpcErrCode;
+  const char      *rpcErrMessage;
+  bool             playlistChanged;     // broadcast playlistChanged afterwards
+  bool             playerStateChanged;  // broadcast playerStatusChanged afterwards
+  IckRpcHandler    handler;             // private: resolved method
+  int              flags;
+  JsonArena       *arena;               // private: memory of jRoot, might be NULL
+};
+
+// Expected parameters of a method
+typedef enum {
+  IckRpcParamsOptional,
+  IckRpcParamsNone,
+  IckRpcParamsRequired
+} IckRpcParams;
+
+// Method flags
+#define IckRpcLockQueue   0x01    // Run handler with queue of zone locked
+#define IckRpcAsync       0x02    // Handler may run on a worker thread
+
 
 /*========================================================================*\
    Prototypes
@@ -81,10 +125,18 @@ typedef void (*IckCmdCallback)(const char *szDeviceId, json_t *jCmd, json_t *jRe
 void  ickMessage( ickP2pContext_t *ictx, const char *sourceUuid, ickP2pServicetype_t sourceService,
                   ickP2pServicetype_t targetServices, const char *message, size_t mSize, ickP2pMessageFlag_t mFlags );
 ickErrcode_t sendIckMessage( ickP2pContext_t *ictx, const char *szDeviceId, json_t *jMsg );
+ickErrcode_t sendIckMessageString( ickP2pContext_t *ictx, const char *szDeviceId, const char *message );
 ickErrcode_t sendIckCommand( ickP2pContext_t *ictx, const char *szDeviceId, const char *method, json_t *jParams, int *requestID, IckCmdCallback callBack );
+json_t      *ickMessageGetPeerStatistics( void );
+
+int  ickMessageRegisterMethod( const char *name, IckRpcHandler handler, IckRpcParams params, int flags );
+int  ickMessageRpcError( IckRpcRequest *request, int code, const char *message );
 
-void ickMessageNotifyPlaylist( const char *szDeviceId );
-void ickMessageNotifyPlayerState( const char *szDeviceId );
+void ickMessageNotifyPlaylist( Player *zone, const char *szDeviceId );
+void ickMessageNotifyPlayerState( Player *zone, const char *szDeviceId );
+void ickMessageSetNotificationDelay( double delay );
+void ickMessageFlushNotifications( void );
+void ickMessageShutdown( void );
 
 #endif  /* __ICKMESSAGE_H */
 
@@ -6,7 +6,10 @@ Source File     : ickScrobble.c
 
 Description     : ickstream scrobble service
 
-Comments        : -
+Comments        : Scrobble events are queued by the playback thread and
+                  delivered by a spool thread in batches. Pending events
+                  are kept in a small file (one JSON record per line), so
+                  they survive restarts and cloud outages.
 
 Called by       : player
 
@@ -51,9 +54,14 @@ Remarks         : -
 \************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <sys/stat.h>
 #include <jansson.h>
 
 #include "ickutils.h"
@@ -71,45 +79,169 @@ Remarks         : -
 /*=========================================================================*\
   Private definitions and symbols
 \*=========================================================================*/
-// none
+#define ScrobbleSpoolSuffix     ".scrobble"
+#define ScrobbleMaxEvents       500          // Oldest events are dropped beyond
+#define ScrobbleMaxAge          (7*24*3600)  // Drop if there is no service that long
+#define ScrobbleBatchSize       20           // Events per service and pass
+#define ScrobbleMinBackoff      30.0
+#define ScrobbleMaxBackoff      3600.0
+
+typedef struct _scrobbleEvent {
+  struct _scrobbleEvent *next;
+  json_t                *jParams;     // strong, parameters of "playedTrack"
+  json_t                *jDone;       // strong, ids of services already served
+  bool                   stored;      // contained in spool file
+} ScrobbleEvent;
+
+// New events, queued by the playback thread
+static ScrobbleEvent   *eventHead;
+static ScrobbleEvent   *eventTail;
+static int              eventCount;
+static pthread_mutex_t  spoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   spoolCond  = PTHREAD_COND_INITIALIZER;
+
+// Spool thread and file (only accessed by spool thread after init)
+static pthread_t        spoolThread;
+static bool             spoolRunning;
+static bool             spoolStop;
+static bool             spoolDirty;         // Spool file needs to be rewritten
+static char            *spoolFileName;
+static int              spoolLines;         // Records in spool file
+static double           spoolBackoff = ScrobbleMinBackoff;
+static double           spoolNextTry;       // Time of next delivery attempt
 
 
 /*=========================================================================*\
   Private prototypes
 \*=========================================================================*/
-// none
+static void          *_spoolThread( void *arg );
+static ScrobbleEvent *_spoolDeliver( ScrobbleEvent *events, bool *success, bool *changed );
+static ScrobbleEvent *_spoolLoad( void );
+static int            _spoolStore( ScrobbleEvent *events, bool rewrite );
+static int            _spoolRewrite( ScrobbleEvent *events );
+static json_t        *_eventRecord( const ScrobbleEvent *event );
+static bool           _eventDone( const ScrobbleEvent *event, const char *serviceId );
+static void           _eventFree( ScrobbleEvent *event );
 
 
 /*=========================================================================*\
-    Announce a track played to all scrobble services
+    Set base name of spool file
+      pending events are stored in <baseName>.scrobble
 \*=========================================================================*/
-int ickScrobbleTrack( PlaylistItem *item, double seekPos )
+int ickScrobbleSetFilename( const char *baseName )
 {
-  const char      *token;
-  json_t          *jParams;
-  double           duration;
-  ServiceListItem *service;
+  DBGMSG( "ickScrobbleSetFilename: \"%s\"", baseName );
+
+  Sfree( spoolFileName );
+  spoolFileName = malloc( strlen(baseName)+strlen(ScrobbleSpoolSuffix)+1 );
+  if( !spoolFileName ) {
+    logerr( "ickScrobbleSetFilename: out of memory!" );
+    return -1;
+  }
+  sprintf( spoolFileName, "%s%s", baseName, ScrobbleSpoolSuffix );
+
+  return 0;
+}
 
-  DBGMSG( "ickScrobbleTrack (%p,%s): seekPos=%.2lfs.",
-          item, playlistItemGetText(item), seekPos );
+
+/*=========================================================================*\
+    Init scrobble module: load pending events and start spool thread
+      returns -1 on error
+\*=========================================================================*/
+int ickScrobbleInit( void )
+{
+  ScrobbleEvent *events;
+  int            perr;
+
+  DBGMSG( "Initializing scrobble module..." );
 
 /*------------------------------------------------------------------------*\
-    Need token...
+    Load pending events, they are delivered before new ones
 \*------------------------------------------------------------------------*/
-  token = ickCloudGetAccessToken();
-  if( !token ) {
-    logwarn( "ickScrobbleTrack (%s): No device token set.",
-             playlistItemGetText(item) );
+  events = _spoolLoad();
+  pthread_mutex_lock( &spoolMutex );
+  if( events ) {
+    ScrobbleEvent *last = events;
+    int            count = 1;
+    while( last->next ) {
+      last = last->next;
+      count++;
+    }
+    last->next = eventHead;
+    if( !eventHead )
+      eventTail = last;
+    eventHead   = events;
+    eventCount += count;
+  }
+
+/*------------------------------------------------------------------------*\
+    Start spool thread
+\*------------------------------------------------------------------------*/
+  spoolStop = false;
+  perr = pthread_create( &spoolThread, NULL, _spoolThread, NULL );
+  if( perr ) {
+    pthread_mutex_unlock( &spoolMutex );
+    logerr( "ickScrobbleInit: Unable to start spool thread (%s).", strerror(perr) );
     return -1;
   }
+  spoolRunning = true;
+  pthread_mutex_unlock( &spoolMutex );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+    Shut down scrobble module
+      Stops the spool thread, pending events stay in the spool file
+\*=========================================================================*/
+void ickScrobbleShutdown( void )
+{
+  ScrobbleEvent *event;
+
+  DBGMSG( "Shutting down scrobble module..." );
+
+/*------------------------------------------------------------------------*\
+    Stop thread (it stores all pending events)
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &spoolMutex );
+  if( spoolRunning ) {
+    spoolStop = true;
+    pthread_cond_signal( &spoolCond );
+    pthread_mutex_unlock( &spoolMutex );
+    pthread_join( spoolThread, NULL );
+    pthread_mutex_lock( &spoolMutex );
+    spoolRunning = false;
+  }
 
 /*------------------------------------------------------------------------*\
-    Any scrobble service available?
+    Free what's left
 \*------------------------------------------------------------------------*/
-  service = ickServiceFind( NULL, NULL, "scrobble", 0 );
-  if( !service ) {
-    return 0;
+  while( (event=eventHead) ) {
+    eventHead = event->next;
+    _eventFree( event );
   }
+  eventTail  = NULL;
+  eventCount = 0;
+  pthread_mutex_unlock( &spoolMutex );
+
+  Sfree( spoolFileName );
+}
+
+
+/*=========================================================================*\
+    Announce a track played to all scrobble services
+      This only queues the event, delivery is done by the spool thread.
+\*=========================================================================*/
+int ickScrobbleTrack( PlaylistItem *item, double seekPos )
+{
+  ScrobbleEvent *event;
+  json_t        *jParams;
+  json_t        *jTrack;
+  double         duration;
+
+  DBGMSG( "ickScrobbleTrack (%p,%s): seekPos=%.2lfs.",
+          item, playlistItemGetText(item), seekPos );
 
 /*------------------------------------------------------------------------*\
     Build scrobble message
@@ -117,54 +249,559 @@ int ickScrobbleTrack( PlaylistItem *item, double seekPos )
   jParams = json_object();
 
   // Add timestamp
-  json_object_set( jParams, "occurrenceTimestamp", json_real(srvtime()) );
+  json_object_set_new( jParams, "occurrenceTimestamp", json_real(srvtime()) );
 
   // If possible calculate and add percentage to method parameters
   duration = playlistItemGetDuration( item );
   if( seekPos>=0 && duration>0 )
-    json_object_set( jParams, "playedPercentage",
-                     json_integer((int)(seekPos*100/duration+.5)) );
+    json_object_set_new( jParams, "playedPercentage",
+                         json_integer((int)(seekPos*100/duration+.5)) );
 
-  // Add playlist item info itself to method parameters
-  json_object_set( jParams, "track", playlistItemGetJSON(item) );
+  // Add copy of playlist item info itself to method parameters
+  jTrack = playlistItemGetJSON( item );
+  if( jTrack )
+    json_object_set_new( jParams, "track", jTrack );
 
 /*------------------------------------------------------------------------*\
-    Loop over all scrobble services
+    Create event
 \*------------------------------------------------------------------------*/
-  for( ; service; service=ickServiceFind(service,NULL,"scrobble",0) ) {
-    const char *uri;
-    int         rc;
+  event = calloc( 1, sizeof(ScrobbleEvent) );
+  if( !event ) {
+    logerr( "ickScrobbleTrack (%s): out of memory!", playlistItemGetText(item) );
+    json_decref( jParams );
+    return -1;
+  }
+  event->jParams = jParams;
+  event->jDone   = json_array();
 
-    DBGMSG( "ickScrobbleTrack (%p,%s): Using service \"%s\" (%s).",
-             item,  playlistItemGetText(item),
-             ickServiceGetName(service), ickServiceGetId(service) );
+/*------------------------------------------------------------------------*\
+    Queue it (drop oldest event if spool is full) and wake up spool thread
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &spoolMutex );
+  if( eventCount>=ScrobbleMaxEvents ) {
+    ScrobbleEvent *oldest = eventHead;
+    eventHead = oldest->next;
+    if( !eventHead )
+      eventTail = NULL;
+    eventCount--;
+    if( oldest->stored )
+      spoolDirty = true;
+    _eventFree( oldest );
+    logwarn( "ickScrobbleTrack: spool full, dropped oldest event." );
+  }
+  if( eventTail )
+    eventTail->next = event;
+  else
+    eventHead = event;
+  eventTail = event;
+  eventCount++;
+  pthread_cond_signal( &spoolCond );
+  pthread_mutex_unlock( &spoolMutex );
 
-    // Get service URI
-    uri = ickServiceGetURI( service );
-    if( !uri ) {
-      logerr( "ickScrobbleTrack (%s): No endpoint defined for service \"%s\" (%s).",
-               playlistItemGetText(item), ickServiceGetName(service), ickServiceGetId(service) );
+/*------------------------------------------------------------------------*\
+    That's it
+\*------------------------------------------------------------------------*/
+  return 0;
+}
+
+
+/*=========================================================================*\
+    Spool thread: store new events and deliver pending ones
+\*=========================================================================*/
+static void *_spoolThread( void *arg )
+{
+  ScrobbleEvent *events;
+  ScrobbleEvent *event;
+  int            remaining;
+  bool           stop;
+  bool           rewrite;
+
+  DBGMSG( "Scrobble spool thread: starting." );
+  PTHREADSETNAME( "scrobble" );
+
+  pthread_mutex_lock( &spoolMutex );
+  for(;;) {
+
+/*------------------------------------------------------------------------*\
+    Take all events, the playback thread may queue new ones meanwhile
+\*------------------------------------------------------------------------*/
+    events     = eventHead;
+    eventHead  = NULL;
+    eventTail  = NULL;
+    eventCount = 0;
+    stop       = spoolStop;
+    rewrite    = spoolDirty;
+    spoolDirty = false;
+    pthread_mutex_unlock( &spoolMutex );
+
+/*------------------------------------------------------------------------*\
+    Store new events, deliver if due and update spool file
+\*------------------------------------------------------------------------*/
+    _spoolStore( events, rewrite );
+    if( events && !stop && srvtime()>=spoolNextTry ) {
+      bool success;
+      bool changed;
+      events = _spoolDeliver( events, &success, &changed );
+      if( success ) {
+        spoolBackoff = ScrobbleMinBackoff;
+        spoolNextTry = 0;
+      }
+      else {
+        spoolNextTry = srvtime() + spoolBackoff;
+        DBGMSG( "Scrobble spool thread: retry in %.0fs.", spoolBackoff );
+        spoolBackoff = spoolBackoff*2<ScrobbleMaxBackoff ? spoolBackoff*2 : ScrobbleMaxBackoff;
+      }
+      if( changed )
+        _spoolStore( events, true );
+    }
+
+/*------------------------------------------------------------------------*\
+    Put remaining events in front of new ones, enforce limit
+\*------------------------------------------------------------------------*/
+    pthread_mutex_lock( &spoolMutex );
+    remaining = 0;
+    if( events ) {
+      ScrobbleEvent *last = events;
+      remaining = 1;
+      while( last->next ) {
+        last = last->next;
+        remaining++;
+      }
+      last->next = eventHead;
+      if( !eventHead )
+        eventTail = last;
+      eventHead   = events;
+      eventCount += remaining;
+    }
+    while( eventCount>ScrobbleMaxEvents ) {
+      event     = eventHead;
+      eventHead = event->next;
+      eventCount--;
+      if( event->stored )
+        spoolDirty = true;
+      _eventFree( event );
+    }
+    if( remaining>eventCount )
+      remaining = eventCount;
+
+/*------------------------------------------------------------------------*\
+    Terminate or loop again if new events are to be stored
+\*------------------------------------------------------------------------*/
+    if( stop )
+      break;
+    if( spoolStop || spoolDirty || eventCount>remaining )
       continue;
+
+/*------------------------------------------------------------------------*\
+    Wait for new events or next delivery attempt
+\*------------------------------------------------------------------------*/
+    if( !remaining )
+      pthread_cond_wait( &spoolCond, &spoolMutex );
+    else if( spoolNextTry>srvtime() ) {
+      struct timespec abstime;
+      abstime.tv_sec  = (time_t)spoolNextTry;
+      abstime.tv_nsec = (long)((spoolNextTry-abstime.tv_sec)*1E9);
+      pthread_cond_timedwait( &spoolCond, &spoolMutex, &abstime );
     }
+  }
+
+/*------------------------------------------------------------------------*\
+    Store events queued during last pass, that's it
+\*------------------------------------------------------------------------*/
+  if( eventCount>remaining || spoolDirty )
+    _spoolStore( eventHead, spoolDirty );
+  pthread_mutex_unlock( &spoolMutex );
+  DBGMSG( "Scrobble spool thread: terminating." );
+  return NULL;
+}
 
-    // Fire off request, ignore result
-    rc = ickCloudRequestAsync( uri, token, "playedTrack", jParams, NULL, NULL );
-    if( rc ) {
-      logerr( "ickScrobbleTrack (%s): Could not send to service \"%s\" (%s) - %d.",
-          playlistItemGetText(item), ickServiceGetName(service), ickServiceGetId(service), rc );
+
+/*=========================================================================*\
+    Deliver a batch of events to all scrobble services
+      success - set to false if a service could not be reached
+      changed - set to true if events were delivered
+    returns list of events that still need to be delivered
+\*=========================================================================*/
+static ScrobbleEvent *_spoolDeliver( ScrobbleEvent *events, bool *success, bool *changed )
+{
+  const char      *token;
+  ServiceListItem *service;
+  ScrobbleEvent   *event;
+  ScrobbleEvent  **link;
+  json_t          *jServices;
+  double           now = srvtime();
+  size_t           i;
+
+  *success = true;
+  *changed = false;
+
+/*------------------------------------------------------------------------*\
+    Need token...
+\*------------------------------------------------------------------------*/
+  token = ickCloudGetAccessToken();
+  if( !token ) {
+    DBGMSG( "_spoolDeliver: No device token set." );
+    *success = false;
+    return events;
+  }
+
+/*------------------------------------------------------------------------*\
+    Collect ids and URIs of scrobble services (list might change meanwhile)
+\*------------------------------------------------------------------------*/
+  jServices = json_array();
+  for( service=ickServiceFind(NULL,NULL,"scrobble",0); service;
+       service=ickServiceFind(service,NULL,"scrobble",0) ) {
+    const char *id  = ickServiceGetId( service );
+    const char *uri = ickServiceGetURI( service );
+    if( !uri ) {
+      logerr( "_spoolDeliver: No endpoint defined for service \"%s\" (%s).",
+              ickServiceGetName(service), id );
       continue;
     }
+    json_array_append_new( jServices, json_pack("{ssss}","id",id,"uri",uri) );
+  }
+
+/*------------------------------------------------------------------------*\
+    No scrobble service (yet): keep events for a while
+\*------------------------------------------------------------------------*/
+  if( !json_array_size(jServices) ) {
+    json_decref( jServices );
+    link = &events;
+    while( (event=*link) ) {
+      json_t *jObj = json_object_get( event->jParams, "occurrenceTimestamp" );
+      if( json_is_number(jObj) && json_number_value(jObj)<now-ScrobbleMaxAge ) {
+        *link = event->next;
+        _eventFree( event );
+        *changed = true;
+      }
+      else
+        link = &event->next;
+    }
+    *success = false;
+    return events;
+  }
+
+/*------------------------------------------------------------------------*\
+    Send a batch of events to each service, stop on first error per service
+\*------------------------------------------------------------------------*/
+  for( i=0; i<json_array_size(jServices) && !spoolStop; i++ ) {
+    json_t     *jService = json_array_get( jServices, i );
+    const char *id       = json_string_value( json_object_get(jService,"id") );
+    const char *uri      = json_string_value( json_object_get(jService,"uri") );
+    int         count    = 0;
+
+    for( event=events; event && count<ScrobbleBatchSize && !spoolStop; event=event->next ) {
+      json_t *jResult;
+      int     httpCode;
+
+      if( _eventDone(event,id) )
+        continue;
+      count++;
+
+      jResult = ickCloudRequestSync( uri, token, "playedTrack", event->jParams, &httpCode );
+      if( !jResult || json_object_get(jResult,"error") ) {
+        logwarn( "_spoolDeliver: Could not send to service %s (%s, http %d).",
+                 id, jResult?json_rpcerrstr(json_object_get(jResult,"error")):"no answer",
+                 httpCode );
+        if( jResult )
+          json_decref( jResult );
+        *success = false;
+        break;
+      }
+      json_decref( jResult );
+      json_array_append_new( event->jDone, json_string(id) );
+      *changed = true;
+    }
+  }
 
+/*------------------------------------------------------------------------*\
+    Remove events delivered to all services
+\*------------------------------------------------------------------------*/
+  link = &events;
+  while( (event=*link) ) {
+    bool done = true;
+    for( i=0; i<json_array_size(jServices) && done; i++ )
+      done = _eventDone( event, json_string_value(json_object_get(json_array_get(jServices,i),"id")) );
+    if( done ) {
+      *link = event->next;
+      _eventFree( event );
+    }
+    else
+      link = &event->next;
   }
 
 /*------------------------------------------------------------------------*\
     Clean up, that's it
 \*------------------------------------------------------------------------*/
-  json_decref( jParams );
+  json_decref( jServices );
+  return events;
+}
+
+
+/*=========================================================================*\
+    Load pending events from spool file
+      returns list of events (NULL if none)
+\*=========================================================================*/
+static ScrobbleEvent *_spoolLoad( void )
+{
+  ScrobbleEvent  *events = NULL;
+  ScrobbleEvent **link   = &events;
+  FILE           *fp;
+  char           *line    = NULL;
+  size_t          lineLen = 0;
+  ssize_t         len;
+  int             count   = 0;
+  json_error_t    error;
+
+  if( !spoolFileName )
+    return NULL;
+
+/*------------------------------------------------------------------------*\
+    Open spool file
+\*------------------------------------------------------------------------*/
+  fp = fopen( spoolFileName, "r" );
+  if( !fp ) {
+    if( errno!=ENOENT )
+      logerr( "ickScrobbleInit: could not open \"%s\": %s", spoolFileName, strerror(errno) );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Loop over all lines
+\*------------------------------------------------------------------------*/
+  while( (len=getline(&line,&lineLen,fp))>0 ) {
+    json_t        *jRecord;
+    json_t        *jParams;
+    json_t        *jDone;
+    ScrobbleEvent *event;
+    spoolLines++;
+
+    // Incomplete last line is the result of an interrupted write
+    if( line[len-1]!='\n' ) {
+      logwarn( "ickScrobbleInit: ignoring incomplete record in line %d.", spoolLines );
+      spoolDirty = true;
+      break;
+    }
+    jRecord = json_loads( line, 0, &error );
+    jParams = json_object_get( jRecord, "params" );
+    jDone   = json_object_get( jRecord, "done" );
+    if( !json_is_object(jParams) || !json_is_array(jDone) ) {
+      logwarn( "ickScrobbleInit: ignoring corrupt record in line %d.", spoolLines );
+      if( jRecord )
+        json_decref( jRecord );
+      spoolDirty = true;
+      continue;
+    }
+
+    event = calloc( 1, sizeof(ScrobbleEvent) );
+    if( !event ) {
+      logerr( "ickScrobbleInit: out of memory!" );
+      json_decref( jRecord );
+      break;
+    }
+    event->jParams = json_incref( jParams );
+    event->jDone   = json_incref( jDone );
+    event->stored  = true;
+    json_decref( jRecord );
+    *link = event;
+    link  = &event->next;
+    count++;
+  }
+
+/*------------------------------------------------------------------------*\
+    Clean up, that's all
+\*------------------------------------------------------------------------*/
+  free( line );
+  fclose( fp );
+  if( count )
+    loginfo( "ickScrobbleInit: %d pending events in spool.", count );
+  return events;
+}
+
+
+/*=========================================================================*\
+    Store events in spool file
+      New events are appended, the file is rewritten if requested or if it
+      contains too many obsolete records.
+      returns -1 on error
+\*=========================================================================*/
+static int _spoolStore( ScrobbleEvent *events, bool rewrite )
+{
+  ScrobbleEvent *event;
+  int            fd;
+  int            count = 0;
+  int            rc    = 0;
+
+/*------------------------------------------------------------------------*\
+    No file: just mark as stored
+\*------------------------------------------------------------------------*/
+  if( !spoolFileName ) {
+    for( event=events; event; event=event->next )
+      event->stored = true;
+    return 0;
+  }
+
+/*------------------------------------------------------------------------*\
+    Count new events
+\*------------------------------------------------------------------------*/
+  for( event=events; event; event=event->next ) {
+    if( !event->stored )
+      count++;
+  }
+  if( !count && !rewrite )
+    return 0;
+
+/*------------------------------------------------------------------------*\
+    Rewrite needed (bounds the file to ScrobbleMaxEvents records)?
+\*------------------------------------------------------------------------*/
+  if( rewrite || spoolLines+count>ScrobbleMaxEvents )
+    return _spoolRewrite( events );
+
+/*------------------------------------------------------------------------*\
+    Append new events
+\*------------------------------------------------------------------------*/
+  fd = open( spoolFileName, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR );
+  if( fd<0 ) {
+    logerr( "_spoolStore: could not open \"%s\": %s", spoolFileName, strerror(errno) );
+    return -1;
+  }
+  for( event=events; event && !rc; event=event->next ) {
+    json_t *jRecord;
+    char   *str;
+    size_t  len;
+
+    if( event->stored )
+      continue;
+    jRecord = _eventRecord( event );
+    str     = json_dumps( jRecord, JSON_COMPACT );
+    json_decref( jRecord );
+    if( !str ) {
+      logerr( "_spoolStore: could not serialize event." );
+      rc = -1;
+      break;
+    }
+    len = strlen( str );
+    str[len] = '\n';      // replaces terminator, we use explicit length
+    if( write(fd,str,len+1)!=len+1 ) {
+      logerr( "_spoolStore: could not write \"%s\": %s", spoolFileName, strerror(errno) );
+      rc = -1;
+    }
+    else {
+      event->stored = true;
+      spoolLines++;
+    }
+    Sfree( str );
+  }
+  if( fsync(fd) )
+    logwarn( "_spoolStore: could not sync \"%s\": %s", spoolFileName, strerror(errno) );
+  close( fd );
+
+  return rc;
+}
+
+
+/*=========================================================================*\
+    Rewrite spool file with all events
+      written to a temporary file and renamed, so it is always consistent
+      returns -1 on error
+\*=========================================================================*/
+static int _spoolRewrite( ScrobbleEvent *events )
+{
+  ScrobbleEvent *event;
+  char          *tmpName;
+  FILE          *fp;
+  int            lines = 0;
+  int            rc    = 0;
+
+  DBGMSG( "_spoolRewrite: \"%s\"", spoolFileName );
+
+  tmpName = malloc( strlen(spoolFileName)+5 );
+  if( !tmpName ) {
+    logerr( "_spoolRewrite: out of memory!" );
+    return -1;
+  }
+  sprintf( tmpName, "%s.tmp", spoolFileName );
+  fp = fopen( tmpName, "w" );
+  if( !fp ) {
+    logerr( "_spoolRewrite: could not open \"%s\": %s", tmpName, strerror(errno) );
+    Sfree( tmpName );
+    return -1;
+  }
+  fchmod( fileno(fp), S_IRUSR|S_IWUSR );
+
+/*------------------------------------------------------------------------*\
+    Write one record per line
+\*------------------------------------------------------------------------*/
+  for( event=events; event && !rc; event=event->next ) {
+    json_t *jRecord = _eventRecord( event );
+    if( json_dumpf(jRecord,fp,JSON_COMPACT) || fputc('\n',fp)==EOF )
+      rc = -1;
+    json_decref( jRecord );
+    lines++;
+  }
+  if( rc || fflush(fp) || fsync(fileno(fp)) ) {
+    logerr( "_spoolRewrite: could not write \"%s\": %s", tmpName, strerror(errno) );
+    rc = -1;
+  }
+  if( fclose(fp) )
+    rc = -1;
+
+/*------------------------------------------------------------------------*\
+    Replace spool file atomically
+\*------------------------------------------------------------------------*/
+  if( !rc && rename(tmpName,spoolFileName) ) {
+    logerr( "_spoolRewrite: could not rename \"%s\": %s", tmpName, strerror(errno) );
+    rc = -1;
+  }
+  if( rc ) {
+    unlink( tmpName );
+    Sfree( tmpName );
+    return -1;
+  }
+  Sfree( tmpName );
+
+  for( event=events; event; event=event->next )
+    event->stored = true;
+  spoolLines = lines;
   return 0;
 }
 
 
+/*=========================================================================*\
+    Build spool record for an event, caller must decref
+\*=========================================================================*/
+static json_t *_eventRecord( const ScrobbleEvent *event )
+{
+  return json_pack( "{sOsO}", "params", event->jParams, "done", event->jDone );
+}
+
+
+/*=========================================================================*\
+    Check if event was already delivered to a service
+\*=========================================================================*/
+static bool _eventDone( const ScrobbleEvent *event, const char *serviceId )
+{
+  size_t i;
+
+  for( i=0; i<json_array_size(event->jDone); i++ ) {
+    if( !strcmp(json_string_value(json_array_get(event->jDone,i)),serviceId) )
+      return true;
+  }
+  return false;
+}
+
+
+/*=========================================================================*\
+    Free an event
+\*=========================================================================*/
+static void _eventFree( ScrobbleEvent *event )
+{
+  json_decref( event->jParams );
+  json_decref( event->jDone );
+  Sfree( event );
+}
+
+
 /*=========================================================================*\
                                     END OF FILE
 \*=========================================================================*/
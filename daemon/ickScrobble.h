@@ -64,7 +64,10 @@ Remarks         : -
 /*=========================================================================*\
   Global symbols
 \*=========================================================================*/
-int ickScrobbleTrack( PlaylistItem *item, double seekPos );
+int  ickScrobbleSetFilename( const char *baseName );
+int  ickScrobbleInit( void );
+void ickScrobbleShutdown( void );
+int  ickScrobbleTrack( PlaylistItem *item, double seekPos );
 
 
 #endif  /* __ICKSCROBBLE_H */
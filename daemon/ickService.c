@@ -60,6 +60,7 @@ Remarks         : -
 #include "ickutils.h"
 #include "player.h"
 #include "ickCloud.h"
+#include "jsonArena.h"
 #include "ickService.h"
 
 
@@ -73,9 +74,15 @@ Remarks         : -
   Private definitions and symbols
 \*=========================================================================*/
 
-// A service list item
+// A service list item, linked to the list of all services (newest first)
+// and to the hash chains for its id and type
 struct _serviceListItem {
-  struct _serviceListItem *next;
+  struct _serviceListItem  *next;
+  struct _serviceListItem **prevLink;
+  struct _serviceListItem  *idNext;
+  struct _serviceListItem **idPrevLink;
+  struct _serviceListItem  *typeNext;
+  struct _serviceListItem **typePrevLink;
   ServiceOrigin            origin;
   json_t                  *jItem;
   const char              *id;               // weak
@@ -88,12 +95,32 @@ struct _serviceListItem {
 static ServiceListItem *serviceList;
 static pthread_mutex_t  serviceListMutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Hash index by id and type
+#define ServiceHashSize          64
+static ServiceListItem *serviceIdTable[ServiceHashSize];
+static ServiceListItem *serviceTypeTable[ServiceHashSize];
+
+// Memoized results of ickServiceResolveURI(), valid for one generation
+// of the service list (incremented with every modification)
+#define ServiceUriCacheSize      128
+typedef struct {
+  char          *uri;
+  char          *type;            // might be NULL
+  char          *result;          // might be NULL (unresolvable)
+  unsigned long  generation;
+} ResolvedUri;
+static ResolvedUri      resolvedUris[ServiceUriCacheSize];
+static unsigned long    serviceGeneration = 1;
+
 
 /*=========================================================================*\
   Private prototypes
 \*=========================================================================*/
 static ServiceListItem *_getService( ServiceListItem *item, const char *id, const char *type, ServiceOrigin origin );
+static void _linkService( ServiceListItem *item );
 static void _removeService( ServiceListItem *item ); 
+static unsigned _serviceHash( const char *str );
+static char *_resolveURI( const char* uri, const char* type );
 
 
 /*=========================================================================*\
@@ -114,16 +141,24 @@ int ickServiceAdd( json_t *jService, ServiceOrigin origin )
     return -1;
   }
   item->origin = origin;
-  item->jItem  = json_incref( jService );
+
+/*------------------------------------------------------------------------*\
+    Take an own reference, the description might live in a message arena
+\*------------------------------------------------------------------------*/
+  item->jItem = jsonArenaPromote( jService );
+  if( !item->jItem ) {
+    Sfree( item );
+    return -1;
+  }
 
 /*------------------------------------------------------------------------*\
     Extract id for quick access (weak ref.)
 \*------------------------------------------------------------------------*/
-  jObj = json_object_get( jService, "id" );
+  jObj = json_object_get( item->jItem, "id" );
   if( !jObj || !json_is_string(jObj) ) {
     logerr( "ickServiceAdd: Missing field \"id\"!" );
+    json_decref( item->jItem );
     Sfree( item );
-    json_decref( jService );
     return -1; 
   }
   item->id = json_string_value( jObj );
@@ -131,11 +166,11 @@ int ickServiceAdd( json_t *jService, ServiceOrigin origin )
 /*------------------------------------------------------------------------*\
     Extract name for quick access (weak ref.)
 \*------------------------------------------------------------------------*/
-  jObj = json_object_get( jService, "name" );
+  jObj = json_object_get( item->jItem, "name" );
   if( !jObj || !json_is_string(jObj) ) {
     logerr( "ickServiceAdd (%s): Missing field \"name\"!", item->id );
+    json_decref( item->jItem );
     Sfree( item );
-    json_decref( jService );
     return -1; 
   }
   item->name = json_string_value( jObj );   
@@ -143,11 +178,11 @@ int ickServiceAdd( json_t *jService, ServiceOrigin origin )
 /*------------------------------------------------------------------------*\
     Extract type for quick access (weak ref.)
 \*------------------------------------------------------------------------*/
-  jObj = json_object_get( jService, "type" );
+  jObj = json_object_get( item->jItem, "type" );
   if( !jObj || !json_is_string(jObj) ) {
     logerr( "ickServiceAdd (%s): Missing field \"type\"!", item->id );
+    json_decref( item->jItem );
     Sfree( item );
-    json_decref( jService );
     return -1; 
   }
   item->type = json_string_value( jObj );
@@ -155,14 +190,14 @@ int ickServiceAdd( json_t *jService, ServiceOrigin origin )
 /*------------------------------------------------------------------------*\
     Extract url for quick access (optional, weak ref.)
 \*------------------------------------------------------------------------*/
-  jObj = json_object_get( jService, "url" );
+  jObj = json_object_get( item->jItem, "url" );
   if( jObj ) 
     item->url = json_string_value( jObj );   
 
 /*------------------------------------------------------------------------*\
     Extract service url for quick access (optional, weak ref.)
 \*------------------------------------------------------------------------*/
-  jObj = json_object_get( jService, "serviceUrl" );
+  jObj = json_object_get( item->jItem, "serviceUrl" );
   if( jObj ) 
     item->serviceUrl = json_string_value( jObj );   
 
@@ -179,9 +214,8 @@ int ickServiceAdd( json_t *jService, ServiceOrigin origin )
     _removeService( oldItem );
   }
 
-  // Insert new item in list
-  item->next = serviceList;
-  serviceList = item;
+  // Insert new item in list and index
+  _linkService( item );
   pthread_mutex_unlock( &serviceListMutex );
 
 /*------------------------------------------------------------------------*\
@@ -272,8 +306,12 @@ int ickServiceAddFromCloud( const char *type, bool reset )
 \*------------------------------------------------------------------------*/
   if( reset ) {
     pthread_mutex_lock( &serviceListMutex );
-    while( (service=_getService(NULL,NULL,type,ServiceCloud)) != NULL )
+    service = _getService( NULL, NULL, type, ServiceCloud );
+    while( service ) {
+      ServiceListItem *next = _getService( service, NULL, type, ServiceCloud );
       _removeService( service );
+      service = next;
+    }
     pthread_mutex_unlock( &serviceListMutex );
   }
 
@@ -307,8 +345,12 @@ void ickServiceRemove( const char *id, const char *type, ServiceOrigin origin )
     Lock list and delete all matching entry 
 \*------------------------------------------------------------------------*/
   pthread_mutex_lock( &serviceListMutex );
-  while( (item=_getService(NULL,id,type,origin)) != NULL )
+  item = _getService( NULL, id, type, origin );
+  while( item ) {
+    ServiceListItem *next = _getService( item, id, type, origin );
     _removeService( item );
+    item = next;
+  }
 
 /*------------------------------------------------------------------------*\
     Unlock list 
@@ -336,13 +378,13 @@ ServiceListItem *ickServiceFind( ServiceListItem *item, const char *id, const ch
 
 /*=========================================================================*\
     Dereference an item URI using the service hints
+      Results are memoized until the service list is modified.
       returns an allocated string (called needs to free that) or NULL on error
 \*=========================================================================*/
 char *ickServiceResolveURI( const char* uri, const char* type )
 {
-  ServiceListItem *service;
-  char            *serviceId;
-  char            *urlStub;
+  ResolvedUri *entry;
+  char        *retval;
 
   DBGMSG( "ickServiceResolveURI: \"%s\" type=\"%s\".", uri, type?type:"(no type)" );
 
@@ -353,36 +395,36 @@ char *ickServiceResolveURI( const char* uri, const char* type )
     return strdup( uri );
 
 /*------------------------------------------------------------------------*\
-    Get service id
-\*------------------------------------------------------------------------*/
-  serviceId = strdup( uri+strlen(IckServiceSchemePrefix) );
-  urlStub   = strchr( serviceId, '/' );
-  if( urlStub )
-    *(urlStub++) = 0; 
-
-/*------------------------------------------------------------------------*\
-    Look up service by id and (optionally) type
+    Lookup in cache (direct mapped by URI)
 \*------------------------------------------------------------------------*/
   pthread_mutex_lock( &serviceListMutex );
-  service = _getService( NULL, serviceId, type, 0 );
+  entry = &resolvedUris[ _serviceHash(uri)%ServiceUriCacheSize ];
+  if( entry->generation!=serviceGeneration || strcmp(entry->uri,uri) ||
+      (type?!entry->type||strcmp(entry->type,type):entry->type!=NULL) ) {
+
+/*------------------------------------------------------------------------*\
+    Miss: resolve and replace entry
+\*------------------------------------------------------------------------*/
+    Sfree( entry->uri );
+    Sfree( entry->type );
+    Sfree( entry->result );
+    entry->generation = 0;
+    entry->uri        = strdup( uri );
+    entry->type       = type ? strdup( type ) : NULL;
+    entry->result     = _resolveURI( uri, type );
+    if( entry->uri && (!type||entry->type) )
+      entry->generation = serviceGeneration;
+    else
+      logerr( "ickServiceResolveURI: out of memory!" );
+  }
 
 /*------------------------------------------------------------------------*\
-    Build result
+    Return copy of result
 \*------------------------------------------------------------------------*/
-  char *retval = NULL;
-  if( service  && service->serviceUrl ) {
-    retval = malloc( strlen(service->serviceUrl) + strlen(urlStub) + 2 );
-    strcpy( retval, service->serviceUrl );
-    strcat( retval, "/" );
-    strcat( retval, urlStub );
-  }
+  retval = entry->result ? strdup( entry->result ) : NULL;
   pthread_mutex_unlock( &serviceListMutex );
 
-/*------------------------------------------------------------------------*\
-    That's all: clean up
-\*------------------------------------------------------------------------*/
   DBGMSG( "ickServiceResolveURI (%s): \"%s\".", uri, retval );
-  Sfree( serviceId );
   return retval;
 }
 
@@ -577,31 +619,53 @@ const char *ickServiceGetServiceURI( const ServiceListItem *item )
       item is the last result, supply NULL for first call
       id or type might be NULL, origin might be 0,
          in which case all entries match that criteria
+      The hash chain of the id (if given) or type is walked, so the
+      criteria must not change while iterating.
       Does not lock the list, so caller needs to set mutex!
 \*=========================================================================*/
 static ServiceListItem *_getService( ServiceListItem *item, const char *id, const char *type, ServiceOrigin origin )
 {
 
 /*------------------------------------------------------------------------*\
-    Where to start?
+    Search in id chain
 \*------------------------------------------------------------------------*/
-  item = item ? item->next : serviceList;
+  if( id ) {
+    item = item ? item->idNext : serviceIdTable[ _serviceHash(id)%ServiceHashSize ];
+    for( ; item; item=item->idNext ) {
+      if( origin && !(item->origin&origin) )
+        continue;
+      if( strcmp(item->id,id) )
+        continue;
+      if( type && strcmp(item->type,type) )
+        continue;
+      break;
+    }
+  }
 
 /*------------------------------------------------------------------------*\
-    Loop over all elements
+    Search in type chain
 \*------------------------------------------------------------------------*/
-  for( ; item; item=item->next ) {
-
-    // Check all criteria that are defined
-    if( origin && !(item->origin&origin) )
-      continue;
-    if( id && strcmp(item->id,id) )
-      continue;
-    if( type && strcmp(item->type,type) )
-      continue;
+  else if( type ) {
+    item = item ? item->typeNext : serviceTypeTable[ _serviceHash(type)%ServiceHashSize ];
+    for( ; item; item=item->typeNext ) {
+      if( origin && !(item->origin&origin) )
+        continue;
+      if( strcmp(item->type,type) )
+        continue;
+      break;
+    }
+  }
 
-    // match !
-    break;
+/*------------------------------------------------------------------------*\
+    Loop over all elements
+\*------------------------------------------------------------------------*/
+  else {
+    item = item ? item->next : serviceList;
+    for( ; item; item=item->next ) {
+      if( origin && !(item->origin&origin) )
+        continue;
+      break;
+    }
   }
 
 /*------------------------------------------------------------------------*\
@@ -611,6 +675,42 @@ static ServiceListItem *_getService( ServiceListItem *item, const char *id, cons
 }
 
 
+/*=========================================================================*\
+    Link a service to list and hash chains (in front)
+      Does not lock the list, so caller needs to set mutex!
+\*=========================================================================*/
+static void _linkService( ServiceListItem *item )
+{
+  ServiceListItem **head;
+
+  // List of all services
+  item->next     = serviceList;
+  item->prevLink = &serviceList;
+  if( serviceList )
+    serviceList->prevLink = &item->next;
+  serviceList = item;
+
+  // Chain of id
+  head             = &serviceIdTable[ _serviceHash(item->id)%ServiceHashSize ];
+  item->idNext     = *head;
+  item->idPrevLink = head;
+  if( *head )
+    (*head)->idPrevLink = &item->idNext;
+  *head = item;
+
+  // Chain of type
+  head               = &serviceTypeTable[ _serviceHash(item->type)%ServiceHashSize ];
+  item->typeNext     = *head;
+  item->typePrevLink = head;
+  if( *head )
+    (*head)->typePrevLink = &item->typeNext;
+  *head = item;
+
+  // Invalidate memoized URIs
+  serviceGeneration++;
+}
+
+
 /*=========================================================================*\
     Remove and free a service from list
       Does not lock the list, so caller needs to set mutex!
@@ -620,36 +720,84 @@ static void _removeService( ServiceListItem *item )
   DBGMSG( "_removeService (%s): (%s:%s).", item->id, item->type, item->name );
 
 /*------------------------------------------------------------------------*\
-    Search for entry 
+    Unlink element from list and hash chains
 \*------------------------------------------------------------------------*/
-  ServiceListItem *prevElement = NULL;
-  ServiceListItem *element     = serviceList;
-  while( element ) {
-    if( element==item )
-      break;
-    prevElement = element;
-    element = element->next;
-  }
+  *item->prevLink = item->next;
+  if( item->next )
+    item->next->prevLink = item->prevLink;
+  *item->idPrevLink = item->idNext;
+  if( item->idNext )
+    item->idNext->idPrevLink = item->idPrevLink;
+  *item->typePrevLink = item->typeNext;
+  if( item->typeNext )
+    item->typeNext->typePrevLink = item->typePrevLink;
 
 /*------------------------------------------------------------------------*\
-    Not found 
+    Invalidate memoized URIs
 \*------------------------------------------------------------------------*/
-  if( !element )
-    return;
+  serviceGeneration++;
 
 /*------------------------------------------------------------------------*\
-    Unlink element 
+    Free resources 
 \*------------------------------------------------------------------------*/
-  if( !prevElement )    // replace list root
-    serviceList = element->next;
-  else
-    prevElement->next = element->next;
+  json_decref( item->jItem );
+  Sfree( item );
+}
+
+
+/*=========================================================================*\
+    Hash function for ids and types (FNV-1a)
+\*=========================================================================*/
+static unsigned _serviceHash( const char *str )
+{
+  unsigned hash = 2166136261U;
+
+  while( *str ) {
+    hash ^= (unsigned char)*str++;
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+
+/*=========================================================================*\
+    Dereference a service URI
+      Does not lock the list, so caller needs to set mutex!
+      returns an allocated string or NULL on error
+\*=========================================================================*/
+static char *_resolveURI( const char* uri, const char* type )
+{
+  ServiceListItem *service;
+  const char      *serviceId = uri + strlen( IckServiceSchemePrefix );
+  const char      *urlStub;
+  char            *id;
+  char            *retval = NULL;
 
 /*------------------------------------------------------------------------*\
-    Free resources 
+    Get service id
 \*------------------------------------------------------------------------*/
-  json_decref( element->jItem );
-  Sfree( element );
+  urlStub = strchr( serviceId, '/' );
+  id = urlStub ? strndup( serviceId, urlStub-serviceId ) : strdup( serviceId );
+  if( !id ) {
+    logerr( "ickServiceResolveURI: out of memory!" );
+    return NULL;
+  }
+  urlStub = urlStub ? urlStub+1 : "";
+
+/*------------------------------------------------------------------------*\
+    Look up service by id and (optionally) type, build result
+\*------------------------------------------------------------------------*/
+  service = _getService( NULL, id, type, 0 );
+  if( service && service->serviceUrl ) {
+    retval = malloc( strlen(service->serviceUrl) + strlen(urlStub) + 2 );
+    if( retval )
+      sprintf( retval, "%s/%s", service->serviceUrl, urlStub );
+    else
+      logerr( "ickServiceResolveURI: out of memory!" );
+  }
+
+  Sfree( id );
+  return retval;
 }
 
 
@@ -74,11 +74,15 @@ Remarks         : -
 #include "ickutils.h"
 #include "config.h"
 #include "persist.h"
+#include "journal.h"
 #include "hmi.h"
 #include "ickCloud.h"
+#include "ickScrobble.h"
 #include "ickDevice.h"
 #include "ickMessage.h"
 #include "ickService.h"
+#include "metrics.h"
+#include "jsonArena.h"
 #include "audio.h"
 #include "player.h"
 
@@ -86,14 +90,19 @@ Remarks         : -
 /*=========================================================================*\
 	Global symbols
 \*=========================================================================*/
-ickP2pContext_t *_ictx;
+// none
 
 
 /*=========================================================================*\
 	Private symbols
 \*=========================================================================*/
 static volatile int stop_signal;
+#ifdef ICK_TRACE
+static volatile int trace_signal;
+#endif
 static void sigHandler( int sig, siginfo_t *siginfo, void *context );
+static int  setupZones( const char *zone_devs, const char *player_name );
+static ickP2pContext_t *startZone( Player *zone, const char *if_name );
 
 
 /*========================================================================*\
@@ -103,6 +112,7 @@ int main( int argc, char *argv[] )
 {
   int              help_flag      = 0;
   int              daemon_flag    = 0;
+  int              alog_flag      = 0;
   const char      *cfg_fname      = NULL;
   const char      *pers_fname     = ".ickpd_persist";
   const char      *pid_fname      = "/var/run/ickpd.pid";
@@ -114,14 +124,18 @@ int main( int argc, char *argv[] )
   const char      *vers_flag      = NULL;
   const char      *adev_name      = NULL;
   const char      *adev_flag      = NULL;
+  const char      *zone_devs      = NULL;
   const char      *default_format = NULL;
+  const char      *rnd_seed       = NULL;
+  const char      *pers_delay     = NULL;
+  const char      *notify_delay   = NULL;
+  const char      *metrics_port   = NULL;
   char            *eptr;
   int              cpid;
   int              fd;
   FILE            *fp;
   int              retval = 0;
-  ickP2pContext_t *ictx;
-  ickErrcode_t     irc;
+  int              i;
   
 /*-------------------------------------------------------------------------*\
 	Set up command line switches (leading * flags availability in config file)
@@ -131,17 +145,23 @@ int main( int argc, char *argv[] )
   addarg( "devices",     "-al",  &adev_flag,   NULL,       "List audio devices and quit" );
   addarg( "config",      "-c",   &cfg_fname,   "filename", "Set name of configuration file" );
   addarg( "*pers",       "-p",   &pers_fname,  "filename", "Set name of persistence file" );
+  addarg( "*pdelay",     "-pd",  &pers_delay,  "seconds",  "Delay for writing persistence file" );
+  addarg( "*ndelay",     "-nd",  &notify_delay,"seconds",  "Window for coalescing status notifications" );
 #ifdef ICK_DEBUG
   addarg( "*uuid",       "-u",   &player_uuid, "uuid",     "Init/change UUID for this player" );
 #endif
   addarg( "*name",       "-n",   &player_name, "name",     "Init/change Name for this player" );
   addarg( "*idev",       "-i",   &if_name,     "interface","Init/change network interface" );
   addarg( "*adevice",    "-ad",  &adev_name,   "name",     "Init/change audio device name" );
+  addarg( "*zones",      "-az",  &zone_devs,   "devices",  "Init/change audio devices of additional zones" );
 #ifdef ICK_NOHMI
   addarg( "daemon",      "-d",   &daemon_flag, NULL,       "Start in daemon mode" );
 #endif
+  addarg( "*metricsport","-mp",  &metrics_port,"port",     "Serve metrics on local HTTP port" );
+  addarg( "*seed",       "-rs",  &rnd_seed,    "seed",     "Seed random generator (reproducible shuffling)" );
   addarg( "*pfile",      "-pid", &pid_fname,   "filename", "Filename to store process ID" );
   addarg( "*verbose",    "-v",   &verb_arg,    "level",    "Set logging level (0-7)" );
+  addarg( "alog",        "-la",  &alog_flag,   NULL,       "Log asynchronously from a background thread" );
   addarg( "*p2pverbose", "-vp",  &p2pVerb_arg, "level",    "Set p2plib logging level (0-7)" );
 
 /*-------------------------------------------------------------------------*\
@@ -185,6 +205,20 @@ int main( int argc, char *argv[] )
   }
 #endif
 
+/*------------------------------------------------------------------------*\
+    Seed random generator (optional)
+\*------------------------------------------------------------------------*/
+  if( rnd_seed ) {
+    unsigned long seed = strtoul( rnd_seed, &eptr, 10 );
+    while( isspace(*eptr) )
+      eptr++;
+    if( *eptr ) {
+      fprintf( stderr, "Bad random seed: '%s'\n", rnd_seed );
+      return 1;
+    }
+    rndSeed( (unsigned int)seed );
+  }
+
 /*------------------------------------------------------------------------*\
     Set verbosity level for p2p lib
 \*------------------------------------------------------------------------*/
@@ -256,6 +290,11 @@ int main( int argc, char *argv[] )
     return 0;
   }
 
+/*------------------------------------------------------------------------*\
+    Use arenas for parsing JSON messages (jansson falls back to the heap)
+\*------------------------------------------------------------------------*/  
+  jsonArenaInit();
+
 /*------------------------------------------------------------------------*\
     Read configuration 
 \*------------------------------------------------------------------------*/  
@@ -265,8 +304,33 @@ int main( int argc, char *argv[] )
 /*------------------------------------------------------------------------*\
     Set persistence filename 
 \*------------------------------------------------------------------------*/  
-  if( persistSetFilename(pers_fname) )
+  if( persistSetFilename(pers_fname) || journalSetFilename(pers_fname) ||
+      ickScrobbleSetFilename(pers_fname) )
     return -1;
+  if( pers_delay ) {
+    double delay = strtod( pers_delay, &eptr );
+    while( isspace(*eptr) )
+      eptr++;
+    if( *eptr || delay<0 ) {
+      fprintf( stderr, "Bad persistence write delay: '%s'\n", pers_delay );
+      return 1;
+    }
+    persistSetWriteDelay( delay );
+  }
+
+/*------------------------------------------------------------------------*\
+    Set debounce window for notifications 
+\*------------------------------------------------------------------------*/  
+  if( notify_delay ) {
+    double delay = strtod( notify_delay, &eptr );
+    while( isspace(*eptr) )
+      eptr++;
+    if( *eptr || delay<0 ) {
+      fprintf( stderr, "Bad notification delay: '%s'\n", notify_delay );
+      return 1;
+    }
+    ickMessageSetNotificationDelay( delay );
+  }
       
 /*------------------------------------------------------------------------*\
     Interface changed or unavailable ?
@@ -287,9 +351,9 @@ int main( int argc, char *argv[] )
 \*------------------------------------------------------------------------*/  
 #ifdef ICK_DEBUG
   if( player_uuid )                  // command line or config file argument
-    playerSetUUID( player_uuid );
+    playerSetUUID( playerGetZone(0), player_uuid );
 #endif
-  player_uuid = playerGetUUID();
+  player_uuid = playerGetUUID( playerGetZone(0) );
   if( !player_uuid ) {
      fprintf( stderr, "NO player UUID!\n" );
      return 1;
@@ -300,8 +364,8 @@ int main( int argc, char *argv[] )
     Player name changed or unavailable ?
 \*------------------------------------------------------------------------*/  
   if( player_name )
-    playerSetName( player_name, false );
-  player_name = playerGetName();  
+    playerSetName( playerGetZone(0), player_name, false );
+  player_name = playerGetName( playerGetZone(0) );  
   if( !player_name ) {
     char buf[128], hname[100];
     if( gethostname(hname,sizeof(hname)) )
@@ -310,8 +374,8 @@ int main( int argc, char *argv[] )
       sprintf( buf, "ickpd @ %s", hname );
     logwarn( "Need player name, using \"%s\" as default...",
                          buf );
-    playerSetName( buf, false );
-    player_name = playerGetName();
+    playerSetName( playerGetZone(0), buf, false );
+    player_name = playerGetName( playerGetZone(0) );
   }
   loginfo( "Using name     : \"%s\"", player_name );  
 
@@ -319,16 +383,22 @@ int main( int argc, char *argv[] )
     Player device changed or unavailable ?
 \*------------------------------------------------------------------------*/  
   if( adev_name )
-    playerSetAudioDevice( adev_name );
-  adev_name = playerGetAudioDevice();  
+    playerSetAudioDevice( playerGetZone(0), adev_name );
+  adev_name = playerGetAudioDevice( playerGetZone(0) );  
   if( !adev_name ) {
     adev_name = "null";
     logwarn( "Need audio device name, using \"%s\" as default...",
                          adev_name );
-    playerSetAudioDevice( adev_name );
+    playerSetAudioDevice( playerGetZone(0), adev_name );
   }
   loginfo( "Using audio dev: \"%s\"", adev_name );
 
+/*------------------------------------------------------------------------*\
+    Create additional zones (given or persisted)
+\*------------------------------------------------------------------------*/
+  if( setupZones(zone_devs,player_name) )
+    return 1;
+
 /*------------------------------------------------------------------------*\
     Default audio format changed or unavailable ?
 \*------------------------------------------------------------------------*/
@@ -385,6 +455,12 @@ int main( int argc, char *argv[] )
     }
   } /* end of: if( daemon_flag )*/
 
+/*------------------------------------------------------------------------*\
+    Start asynchronous logging (after fork), ignore errors...
+\*------------------------------------------------------------------------*/
+  if( alog_flag )
+    logStartAsync();
+
 /*------------------------------------------------------------------------*\
     OK, from here on we catch some terminating signals and ignore others
 \*------------------------------------------------------------------------*/  
@@ -394,6 +470,9 @@ int main( int argc, char *argv[] )
   act.sa_flags     = SA_SIGINFO;
   sigaction( SIGINT, &act, NULL );
   sigaction( SIGTERM, &act, NULL );
+#ifdef ICK_TRACE
+  sigaction( SIGUSR1, &act, NULL );
+#endif
 
 /*------------------------------------------------------------------------*\
     Setup PID file, ignore errors...
@@ -405,37 +484,26 @@ int main( int argc, char *argv[] )
   }
 
 /*------------------------------------------------------------------------*\
-    Initalize ickstream environment...
+    Initalize ickstream environment, one context per zone...
 \*------------------------------------------------------------------------*/
-  ictx = ickP2pCreate( player_name, player_uuid, NULL, 0, 0, ICKP2P_SERVICE_PLAYER, &irc );
-  if( !ictx ) {
-    logerr( "ickP2pCreate: %s", ickStrError(irc) );
-    return -1;
-  }
-  _ictx = ictx;
-  irc = ickP2pAddInterface( ictx, if_name, NULL );
-  if( irc ) {
-    logerr( "Could not add interface \"%s\" (%s)", if_name, ickStrError(irc) );
-    ickP2pEnd( ictx, NULL );
-    return 1;
-  }
-  irc = ickP2pAddInterface( ictx, "127.0.0.1", NULL );
-  if( irc ) {
-    logerr( "Could not add interface \"%s\" (%s)", "127.0.0.1", ickStrError(irc) );
-    ickP2pEnd( ictx, NULL );
-    return 1;
+  for( i=0; i<playerGetZoneCount(); i++ ) {
+    if( !startZone(playerGetZone(i),if_name) ) {
+      while( --i>=0 )
+        ickP2pEnd( playerGetContext(playerGetZone(i)), NULL );
+      return 1;
+    }
   }
-  ickP2pRegisterMessageCallback( ictx, &ickMessage );
-  ickP2pRegisterDiscoveryCallback( ictx, &ickDevice );
-  ickP2pResume( ictx );
 
 /*------------------------------------------------------------------------*\
     Init player, announce state, get cloud services and inform HMI
 \*------------------------------------------------------------------------*/
   ickCloudInit();
+  ickScrobbleInit();
   playerInit();
-  ickMessageNotifyPlaylist( NULL );
-  ickMessageNotifyPlayerState( NULL );
+  if( metricsInit(metrics_port?(int)strtol(metrics_port,NULL,10):0) )
+    logwarn( "Could not init metrics server." );
+  ickMessageNotifyPlaylist( NULL, NULL );
+  ickMessageNotifyPlayerState( NULL, NULL );
   ickServiceAddFromCloud( NULL, true );
   hmiNewConfig();
 
@@ -449,6 +517,21 @@ int main( int argc, char *argv[] )
 \*------------------------------------------------------------------------*/  
    sleep( 1000 );
 
+/*------------------------------------------------------------------------*\
+   Dump trace on request (interrupts sleep)
+\*------------------------------------------------------------------------*/  
+#ifdef ICK_TRACE
+   if( trace_signal ) {
+     char *fname = malloc( strlen(pers_fname)+12 );
+     trace_signal = 0;
+     if( fname ) {
+       sprintf( fname, "%s.trace.json", pers_fname );
+       traceDumpFile( fname );
+       Sfree( fname );
+     }
+   }
+#endif
+
  } /* end of: while( !stopflag ) */
  if( stop_signal )
    loginfo( "Exiting due to signal %d ...", stop_signal );
@@ -456,23 +539,33 @@ int main( int argc, char *argv[] )
 /*------------------------------------------------------------------------*\
     Stop player and close ickstream environment...
 \*------------------------------------------------------------------------*/
-  playerSetState( PlayerStateStop, false );
-  ickP2pEnd( ictx, NULL );
+  for( i=0; i<playerGetZoneCount(); i++ )
+    playerSetState( playerGetZone(i), PlayerStateStop, false );
+  ickMessageShutdown();
+  for( i=0; i<playerGetZoneCount(); i++ )
+    ickP2pEnd( playerGetContext(playerGetZone(i)), NULL );
 
 /*------------------------------------------------------------------------*\
     ... and other modules.
 \*------------------------------------------------------------------------*/
   hmiShutdown();
   playerShutdown();
+  ickScrobbleShutdown();
   ickCloudShutdown();
   audioShutdown( AudioDrain );
   persistShutdown();
+  metricsShutdown();
 
 /*------------------------------------------------------------------------*\
     Cleanup PID file
 \*------------------------------------------------------------------------*/
   unlink( pid_fname );
 
+/*------------------------------------------------------------------------*\
+    Write pending log messages
+\*------------------------------------------------------------------------*/
+  logStopAsync();
+
 /*------------------------------------------------------------------------*\
     That's all
 \*------------------------------------------------------------------------*/  
@@ -480,6 +573,140 @@ int main( int argc, char *argv[] )
 }
 
 
+/*=========================================================================*\
+        Create additional zones and set up their identities
+          zone_devs is a white space separated list of audio devices,
+          if NULL the persisted zones are restored
+          return 0 on success, -1 on error
+\*=========================================================================*/
+static int setupZones( const char *zone_devs, const char *player_name )
+{
+  char *devs = NULL;
+  char *dev;
+  char *saveptr;
+  int   count = -1;
+  int   i;
+
+/*------------------------------------------------------------------------*\
+    Count given devices
+\*------------------------------------------------------------------------*/
+  if( zone_devs ) {
+    devs = strdup( zone_devs );
+    if( !devs ) {
+      logerr( "setupZones: out of memory!" );
+      return -1;
+    }
+    count = 1;
+    for( dev=strtok_r(devs," \t",&saveptr); dev; dev=strtok_r(NULL," \t",&saveptr) )
+      count++;
+    Sfree( devs );
+  }
+
+/*------------------------------------------------------------------------*\
+    Create zones
+\*------------------------------------------------------------------------*/
+  count = playerCreateZones( count );
+
+/*------------------------------------------------------------------------*\
+    Set audio devices
+\*------------------------------------------------------------------------*/
+  if( zone_devs ) {
+    devs = strdup( zone_devs );
+    if( !devs ) {
+      logerr( "setupZones: out of memory!" );
+      return -1;
+    }
+    dev = strtok_r( devs, " \t", &saveptr );
+    for( i=1; i<count && dev; i++ ) {
+      playerSetAudioDevice( playerGetZone(i), dev );
+      dev = strtok_r( NULL, " \t", &saveptr );
+    }
+    Sfree( devs );
+  }
+
+/*------------------------------------------------------------------------*\
+    Check identities
+\*------------------------------------------------------------------------*/
+  for( i=1; i<count; i++ ) {
+    Player *zone = playerGetZone( i );
+
+    if( !playerGetUUID(zone) ) {
+      fprintf( stderr, "NO UUID for zone %d!\n", i );
+      return -1;
+    }
+
+    if( !playerGetName(zone) ) {
+      char buf[128];
+      snprintf( buf, sizeof(buf), "%s (Zone %d)", player_name, i );
+      playerSetName( zone, buf, false );
+    }
+
+    if( !playerGetAudioDevice(zone) ) {
+      logwarn( "Need audio device name for zone %d, using \"null\" as default...", i );
+      playerSetAudioDevice( zone, "null" );
+    }
+
+    loginfo( "Zone %d         : \"%s\" (%s) on \"%s\"", i, playerGetName(zone),
+             playerGetUUID(zone), playerGetAudioDevice(zone) );
+  }
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return 0;
+}
+
+
+/*=========================================================================*\
+        Create and start ickstream context of a zone
+          return context or NULL on error
+\*=========================================================================*/
+static ickP2pContext_t *startZone( Player *zone, const char *if_name )
+{
+  ickP2pContext_t *ictx;
+  ickErrcode_t     irc;
+
+/*------------------------------------------------------------------------*\
+    Create context with identity of zone
+\*------------------------------------------------------------------------*/
+  ictx = ickP2pCreate( playerGetName(zone), playerGetUUID(zone), NULL, 0, 0,
+                       ICKP2P_SERVICE_PLAYER, &irc );
+  if( !ictx ) {
+    logerr( "ickP2pCreate (zone %d): %s", playerGetZoneIndex(zone), ickStrError(irc) );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Add interfaces
+\*------------------------------------------------------------------------*/
+  irc = ickP2pAddInterface( ictx, if_name, NULL );
+  if( irc ) {
+    logerr( "Could not add interface \"%s\" (%s)", if_name, ickStrError(irc) );
+    ickP2pEnd( ictx, NULL );
+    return NULL;
+  }
+  irc = ickP2pAddInterface( ictx, "127.0.0.1", NULL );
+  if( irc ) {
+    logerr( "Could not add interface \"%s\" (%s)", "127.0.0.1", ickStrError(irc) );
+    ickP2pEnd( ictx, NULL );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Messages are routed to the zone by context, so register it first
+\*------------------------------------------------------------------------*/
+  playerSetContext( zone, ictx );
+  ickP2pRegisterMessageCallback( ictx, &ickMessage );
+  ickP2pRegisterDiscoveryCallback( ictx, &ickDevice );
+  ickP2pResume( ictx );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return ictx;
+}
+
+
 /*=========================================================================*\
         Handle signals
 \*=========================================================================*/
@@ -504,6 +731,15 @@ static void sigHandler( int sig, siginfo_t *siginfo, void *context )
 \*------------------------------------------------------------------------*/
     case SIGPIPE:
       break;
+
+/*------------------------------------------------------------------------*\
+    Request to dump trace events
+\*------------------------------------------------------------------------*/
+#ifdef ICK_TRACE
+    case SIGUSR1:
+      trace_signal = sig;
+      break;
+#endif
   }
   
 /*------------------------------------------------------------------------*\
@@ -70,8 +70,6 @@ Remarks         : -
 \*========================================================================*/
 #define ICKPD_DEFAULTAUDIOFORMAT "2x44100x16S"
 
-extern ickP2pContext_t *_ictx;
-
 #endif  /* __ICKPD_H */
 
 
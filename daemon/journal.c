@@ -0,0 +1,898 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : journal.c
+
+Description     : crash safe persistence of the playback queue
+
+Comments        : The queue is stored as a snapshot (hybrid JSON, written
+                  atomically via temp file, fsync and rename) plus an
+                  append-only journal with one JSON record per line
+                  describing each mutation since the snapshot.
+                  The journal is compacted into a new snapshot when it
+                  grows larger than the snapshot.
+                  Records are serialized by the mutating thread and
+                  written (and synced in groups) by a writer thread, which
+                  also does the compaction based on a queue snapshot, so
+                  mutations never wait for the disk.
+
+Called by       : player.c
+
+Calls           : playlist.c, jansson lib
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <jansson.h>
+
+#include "ickutils.h"
+#include "playlist.h"
+#include "journal.h"
+#include "metrics.h"
+
+
+/*=========================================================================*\
+  Global symbols
+\*=========================================================================*/
+// none
+
+
+/*=========================================================================*\
+  Private definitions and symbols
+\*=========================================================================*/
+#define JournalVersion          1
+#define JournalSnapshotSuffix   ".queue"
+#define JournalFileSuffix       ".journal"
+#define JournalMinCompactSize   (256*1024)   // Don't compact small journals
+
+// A pending job of the writer thread
+typedef struct _journalJob {
+  struct _journalJob *next;
+  char               *line;        // Record to append (newline terminated)
+  size_t              len;
+  PlaylistSnapshot   *snapshot;    // or: compact to this queue state
+  long long           seq;         // Sequence number of record or snapshot
+} JournalJob;
+
+// A queue journal: snapshot and journal files plus writer thread
+struct _journal {
+  char            *snapshotFileName;
+  char            *journalFileName;
+  int              fd;
+  long long        seq;                // Sequence number of last record
+  off_t            size;               // Bytes in journal (incl. queued)
+  off_t            snapshotSize;       // Bytes in last snapshot
+  bool             needSnapshot;       // Snapshot outdated or writes failed
+  pthread_mutex_t  mutex;
+  pthread_cond_t   cond;
+  JournalJob      *jobList;            // Pending jobs, oldest first
+  JournalJob      *jobLast;
+  pthread_t        writerThread;
+  bool             writerRunning;
+  bool             writerStop;
+  bool             writerBroken;       // Records lost, skip until compaction
+};
+
+static char     *journalBaseName;
+
+
+/*=========================================================================*\
+  Private prototypes
+\*=========================================================================*/
+static void _journalRecord( Playlist *plst, json_t *jRecord, void *userData );
+static void _journalQueue( Journal *journal, JournalJob *job );
+static void _journalWriteJobs( Journal *journal, JournalJob *jobs );
+static int  _journalWriteSnapshot( Journal *journal, PlaylistSnapshot *snapshot, long long seq );
+static void *_journalWriterThread( void *arg );
+static int  _journalApply( Playlist *plst, json_t *jRecord );
+static int  _journalReplay( Journal *journal, Playlist *plst, long long snapshotSeq );
+static int  _journalWriteAll( int fd, const char *buffer, size_t len );
+
+
+/*=========================================================================*\
+      Set base name of queue files
+        journals are stored in <baseName>[.<name>].queue and
+        <baseName>[.<name>].journal
+\*=========================================================================*/
+int journalSetFilename( const char *baseName )
+{
+  DBGMSG( "journalSetFilename: \"%s\"", baseName );
+
+  Sfree( journalBaseName );
+  journalBaseName = strdup( baseName );
+  if( !journalBaseName ) {
+    logerr( "journalSetFilename: out of memory!" );
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+      Create a journal
+        name distinguishes the journals of several queues, the default
+        (NULL) uses the base name only
+        returns NULL on error
+\*=========================================================================*/
+Journal *journalNew( const char *name )
+{
+  Journal *journal;
+  size_t   len;
+
+  DBGMSG( "journalNew: \"%s\"", name?name:"(default)" );
+
+  if( !journalBaseName ) {
+    logerr( "journalNew: no file name set." );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Allocate and build file names
+\*------------------------------------------------------------------------*/
+  len     = strlen( journalBaseName ) + (name?strlen(name)+1:0);
+  journal = calloc( 1, sizeof(Journal) );
+  if( journal ) {
+    journal->snapshotFileName = malloc( len+strlen(JournalSnapshotSuffix)+1 );
+    journal->journalFileName  = malloc( len+strlen(JournalFileSuffix)+1 );
+  }
+  if( !journal || !journal->snapshotFileName || !journal->journalFileName ) {
+    logerr( "journalNew: out of memory!" );
+    if( journal ) {
+      Sfree( journal->snapshotFileName );
+      Sfree( journal->journalFileName );
+    }
+    Sfree( journal );
+    return NULL;
+  }
+  sprintf( journal->snapshotFileName, "%s%s%s%s", journalBaseName,
+           name?".":"", name?name:"", JournalSnapshotSuffix );
+  sprintf( journal->journalFileName, "%s%s%s%s", journalBaseName,
+           name?".":"", name?name:"", JournalFileSuffix );
+
+/*------------------------------------------------------------------------*\
+    Init state
+\*------------------------------------------------------------------------*/
+  journal->fd = -1;
+  ickMutexInit( &journal->mutex );
+  pthread_cond_init( &journal->cond, NULL );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return journal;
+}
+
+
+/*=========================================================================*\
+      Load queue from snapshot and journal
+        returns a new playlist or NULL if neither snapshot nor journal
+        are available
+\*=========================================================================*/
+Playlist *journalLoad( Journal *journal )
+{
+  Playlist     *plst = NULL;
+  json_t       *jSnapshot;
+  json_t       *jObj;
+  json_error_t  error;
+  long long     snapshotSeq = 0;
+  struct stat   buf;
+  double        start = srvtime();
+
+  DBGMSG( "journalLoad: snapshot \"%s\", journal \"%s\"",
+          journal->snapshotFileName, journal->journalFileName );
+  journal->needSnapshot = false;
+
+/*------------------------------------------------------------------------*\
+    Read snapshot (if any)
+\*------------------------------------------------------------------------*/
+  if( !stat(journal->snapshotFileName,&buf) ) {
+    journal->snapshotSize = buf.st_size;
+    jSnapshot = json_load_file( journal->snapshotFileName, 0, &error );
+    if( !jSnapshot )
+      logerr( "journalLoad: cannot read snapshot \"%s\": corrupt line %d: %s",
+              journal->snapshotFileName, error.line, error.text );
+    else {
+      jObj = json_object_get( jSnapshot, "version" );
+      if( !json_is_integer(jObj) || json_integer_value(jObj)!=JournalVersion )
+        logerr( "journalLoad: snapshot \"%s\" has unsupported version.",
+                journal->snapshotFileName );
+      else {
+        jObj = json_object_get( jSnapshot, "seq" );
+        if( json_is_integer(jObj) )
+          snapshotSeq = json_integer_value( jObj );
+        plst = playlistFromJSON( json_object_get(jSnapshot,"queue") );
+        jObj = json_object_get( jSnapshot, "cursor" );
+        if( plst && json_is_integer(jObj) && json_integer_value(jObj)>=0 )
+          playlistSetCursorPos( plst, json_integer_value(jObj) );
+      }
+      json_decref( jSnapshot );
+    }
+    if( !plst )
+      journal->needSnapshot = true;
+  }
+  journal->seq = snapshotSeq;
+
+/*------------------------------------------------------------------------*\
+    Replay journal (if any)
+\*------------------------------------------------------------------------*/
+  if( !stat(journal->journalFileName,&buf) && buf.st_size ) {
+    if( !plst )
+      plst = playlistNew();
+    if( plst && _journalReplay(journal,plst,snapshotSeq)>0 )
+      journal->needSnapshot = true;
+  }
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  if( plst )
+    loginfo( "journalLoad: loaded %d queue items (seq %lld) in %.3fs.",
+             playlistGetLength(plst), journal->seq, srvtime()-start );
+  return plst;
+}
+
+
+/*=========================================================================*\
+      Start journaling all mutations of a playlist
+        writes a new snapshot if the current one is outdated or missing
+        caller should lock playlist
+        return 0 on success, -1 on error
+\*=========================================================================*/
+int journalAttach( Journal *journal, Playlist *plst )
+{
+  struct stat buf;
+
+  DBGMSG( "journalAttach (%p): \"%s\"", plst, journal->journalFileName );
+
+/*------------------------------------------------------------------------*\
+    Compact if snapshot is outdated (this also truncates the journal)
+\*------------------------------------------------------------------------*/
+  if( journal->needSnapshot || stat(journal->snapshotFileName,&buf) ) {
+    if( journalSnapshot(journal,plst) )
+      return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Open journal for appending
+\*------------------------------------------------------------------------*/
+  if( journal->fd<0 ) {
+    journal->fd = open( journal->journalFileName, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR );
+    if( journal->fd<0 ) {
+      logerr( "journalAttach: could not open \"%s\": %s",
+              journal->journalFileName, strerror(errno) );
+      return -1;
+    }
+    journal->size = lseek( journal->fd, 0, SEEK_END );
+  }
+
+/*------------------------------------------------------------------------*\
+    Start writer thread, records are written synchronously without it
+\*------------------------------------------------------------------------*/
+  if( !journal->writerRunning ) {
+    int perr = pthread_create( &journal->writerThread, NULL, _journalWriterThread, journal );
+    if( perr )
+      logerr( "journalAttach: could not start writer thread: %s", strerror(perr) );
+    else
+      journal->writerRunning = true;
+  }
+
+/*------------------------------------------------------------------------*\
+    Register callback, that's all
+\*------------------------------------------------------------------------*/
+  playlistSetJournalCallback( plst, _journalRecord, journal );
+  return 0;
+}
+
+
+/*=========================================================================*\
+      Write a snapshot of the playlist and truncate journal
+        the current state is captured immediately, the snapshot is written
+        by the writer thread after all pending records (or synchronously
+        if there is no writer thread)
+        caller should lock playlist
+        return 0 on success, -1 on error
+\*=========================================================================*/
+int journalSnapshot( Journal *journal, Playlist *plst )
+{
+  JournalJob *job;
+
+  DBGMSG( "journalSnapshot (%p): \"%s\" seq %lld", plst,
+          journal->snapshotFileName, journal->seq );
+
+/*------------------------------------------------------------------------*\
+    Capture state
+\*------------------------------------------------------------------------*/
+  job = calloc( 1, sizeof(JournalJob) );
+  if( job )
+    job->snapshot = playlistGetSnapshot( plst );
+  if( !job || !job->snapshot ) {
+    logerr( "journalSnapshot: could not get queue snapshot." );
+    Sfree( job );
+    return -1;
+  }
+  job->seq = journal->seq;
+
+/*------------------------------------------------------------------------*\
+    Journal will be truncated
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &journal->mutex );
+  journal->size         = 0;
+  journal->needSnapshot = false;
+  pthread_mutex_unlock( &journal->mutex );
+
+/*------------------------------------------------------------------------*\
+    Hand over to writer, that's all
+\*------------------------------------------------------------------------*/
+  _journalQueue( journal, job );
+  return 0;
+}
+
+
+/*=========================================================================*\
+      Stop journaling, close and free journal
+        All mutations are already on disk, so no final snapshot is needed
+        caller should lock playlist
+\*=========================================================================*/
+void journalDelete( Journal *journal, Playlist *plst )
+{
+  DBGMSG( "journalDelete (%p): \"%s\"", plst, journal->journalFileName );
+
+/*------------------------------------------------------------------------*\
+    Detach from playlist
+\*------------------------------------------------------------------------*/
+  if( plst )
+    playlistSetJournalCallback( plst, NULL, NULL );
+
+/*------------------------------------------------------------------------*\
+    Stop writer thread after it has written all pending jobs
+\*------------------------------------------------------------------------*/
+  if( journal->writerRunning ) {
+    pthread_mutex_lock( &journal->mutex );
+    journal->writerStop = true;
+    pthread_cond_signal( &journal->cond );
+    pthread_mutex_unlock( &journal->mutex );
+    pthread_join( journal->writerThread, NULL );
+    journal->writerRunning = false;
+  }
+
+/*------------------------------------------------------------------------*\
+    Close journal
+\*------------------------------------------------------------------------*/
+  if( journal->fd>=0 ) {
+    if( fsync(journal->fd) )
+      logerr( "journalDelete: could not sync \"%s\": %s",
+              journal->journalFileName, strerror(errno) );
+    close( journal->fd );
+  }
+
+/*------------------------------------------------------------------------*\
+    Free resources
+\*------------------------------------------------------------------------*/
+  pthread_cond_destroy( &journal->cond );
+  pthread_mutex_destroy( &journal->mutex );
+  Sfree( journal->snapshotFileName );
+  Sfree( journal->journalFileName );
+  Sfree( journal );
+}
+
+
+/*=========================================================================*\
+      Journal callback: queue a mutation record for the writer thread
+        requests compaction if the journal grows larger than the snapshot
+        called with locked playlist
+\*=========================================================================*/
+static void _journalRecord( Playlist *plst, json_t *jRecord, void *userData )
+{
+  Journal    *journal = userData;
+  JournalJob *job;
+  char       *line;
+  size_t      len;
+  bool        compact;
+
+/*------------------------------------------------------------------------*\
+    Serialize record with sequence number, leave record unchanged
+\*------------------------------------------------------------------------*/
+  json_object_set_new( jRecord, "seq", json_integer(++journal->seq) );
+  line = json_dumps( jRecord, JSON_COMPACT );
+  json_object_del( jRecord, "seq" );   // record is shared with change log
+  job  = calloc( 1, sizeof(JournalJob) );
+  if( !line || !job ) {
+    logerr( "_journalRecord: could not serialize record #%lld.", journal->seq );
+    Sfree( line );
+    Sfree( job );
+    pthread_mutex_lock( &journal->mutex );
+    journal->needSnapshot = true;
+    pthread_mutex_unlock( &journal->mutex );
+    return;
+  }
+  DBGMSG( "_journalRecord (%p): %s", plst, line );
+
+/*------------------------------------------------------------------------*\
+    Queue as one line
+\*------------------------------------------------------------------------*/
+  len = strlen( line );
+  line[len++] = '\n';   // replaces terminating zero
+  job->line = line;
+  job->len  = len;
+  job->seq  = journal->seq;
+  pthread_mutex_lock( &journal->mutex );
+  journal->size += len;
+  compact = journal->needSnapshot ||
+            (journal->size>JournalMinCompactSize && journal->size>journal->snapshotSize);
+  pthread_mutex_unlock( &journal->mutex );
+  _journalQueue( journal, job );
+
+/*------------------------------------------------------------------------*\
+    Compact journal if necessary (or after errors)
+\*------------------------------------------------------------------------*/
+  if( compact && journalSnapshot(journal,plst) ) {
+    pthread_mutex_lock( &journal->mutex );
+    journal->needSnapshot = true;
+    pthread_mutex_unlock( &journal->mutex );
+  }
+}
+
+
+/*=========================================================================*\
+      Hand a job to the writer thread
+        without writer thread the job is executed immediately
+\*=========================================================================*/
+static void _journalQueue( Journal *journal, JournalJob *job )
+{
+  pthread_mutex_lock( &journal->mutex );
+  if( !journal->writerRunning ) {
+    pthread_mutex_unlock( &journal->mutex );
+    _journalWriteJobs( journal, job );
+    return;
+  }
+  if( journal->jobLast )
+    journal->jobLast->next = job;
+  else
+    journal->jobList = job;
+  journal->jobLast = job;
+  pthread_cond_signal( &journal->cond );
+  pthread_mutex_unlock( &journal->mutex );
+}
+
+
+/*=========================================================================*\
+      Writer thread: execute queued jobs until stopped
+\*=========================================================================*/
+static void *_journalWriterThread( void *arg )
+{
+  Journal    *journal = arg;
+  JournalJob *jobs;
+
+  DBGMSG( "Journal writer thread: starting." );
+  PTHREADSETNAME( "journal" );
+
+/*------------------------------------------------------------------------*\
+    Loop until stopped and all jobs are done
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &journal->mutex );
+  for(;;) {
+
+    // Wait for jobs
+    if( !journal->jobList ) {
+      if( journal->writerStop )
+        break;
+      pthread_cond_wait( &journal->cond, &journal->mutex );
+      continue;
+    }
+
+    // Take all pending jobs and execute them without holding the lock
+    jobs = journal->jobList;
+    journal->jobList = NULL;
+    journal->jobLast = NULL;
+    pthread_mutex_unlock( &journal->mutex );
+    _journalWriteJobs( journal, jobs );
+    pthread_mutex_lock( &journal->mutex );
+  }
+  pthread_mutex_unlock( &journal->mutex );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  DBGMSG( "Journal writer thread: terminating." );
+  return NULL;
+}
+
+
+/*=========================================================================*\
+      Execute and free a list of jobs
+        all records of the list are synced with one call (group commit)
+        after a failed write records are dropped until the next snapshot,
+        since the journal must not contain gaps
+\*=========================================================================*/
+static void _journalWriteJobs( Journal *journal, JournalJob *jobs )
+{
+  JournalJob *job;
+  bool        unsynced = false;
+  bool        failed   = false;
+
+  while( jobs ) {
+    job  = jobs;
+    jobs = job->next;
+
+    // Append record
+    if( job->line && !journal->writerBroken ) {
+      if( _journalWriteAll(journal->fd,job->line,job->len) ) {
+        logerr( "_journalWriteJobs: could not write record #%lld to \"%s\": %s",
+                job->seq, journal->journalFileName, strerror(errno) );
+        journal->writerBroken = true;
+        failed                = true;
+      }
+      else
+        unsynced = true;
+    }
+
+    // Compact: truncates the journal, so sync records first
+    else if( job->snapshot ) {
+      if( unsynced && fdatasync(journal->fd) )
+        logerr( "_journalWriteJobs: could not sync \"%s\": %s",
+                journal->journalFileName, strerror(errno) );
+      unsynced = false;
+      if( !_journalWriteSnapshot(journal,job->snapshot,job->seq) ) {
+        journal->writerBroken = false;
+        failed                = false;
+      }
+      else
+        failed = true;
+      playlistSnapshotRelease( job->snapshot );
+    }
+
+    Sfree( job->line );
+    Sfree( job );
+  }
+
+/*------------------------------------------------------------------------*\
+    Sync records
+\*------------------------------------------------------------------------*/
+  if( unsynced && fdatasync(journal->fd) ) {
+    logerr( "_journalWriteJobs: could not sync \"%s\": %s",
+            journal->journalFileName, strerror(errno) );
+    failed = true;
+  }
+
+/*------------------------------------------------------------------------*\
+    Request a new snapshot with the next record after errors
+\*------------------------------------------------------------------------*/
+  if( failed ) {
+    pthread_mutex_lock( &journal->mutex );
+    journal->needSnapshot = true;
+    pthread_mutex_unlock( &journal->mutex );
+  }
+}
+
+
+/*=========================================================================*\
+      Write a snapshot and truncate journal
+        the snapshot is written to a temporary file first, synced and
+        renamed, so there is always a consistent snapshot on disk
+        seq is the sequence number of the last record contained
+        return 0 on success, -1 on error
+\*=========================================================================*/
+static int _journalWriteSnapshot( Journal *journal, PlaylistSnapshot *snapshot, long long seq )
+{
+  const char *fileName = journal->snapshotFileName;
+  json_t     *jSnapshot;
+  char       *queueStr;
+  char       *snapshotStr;
+  char       *tmpName;
+  FILE       *fp;
+  off_t       size;
+  int         rc = 0;
+  double      start = srvtime();
+
+  DBGMSG( "_journalWriteSnapshot (%p): \"%s\" seq %lld", snapshot, fileName, seq );
+
+/*------------------------------------------------------------------------*\
+    Build snapshot from serialized queue
+\*------------------------------------------------------------------------*/
+  queueStr = playlistSnapshotGetJSONString( snapshot, PlaylistHybrid, 0, 0 );
+  if( !queueStr ) {
+    logerr( "_journalWriteSnapshot: could not serialize queue." );
+    return -1;
+  }
+  jSnapshot = json_pack( "{si sI si}",
+                         "version", JournalVersion,
+                         "seq",     (json_int_t)seq,
+                         "cursor",  playlistSnapshotGetCursorPos(snapshot) );
+  snapshotStr = json_dumps_member( jSnapshot, JSON_COMPACT, "queue", queueStr );
+  json_decref( jSnapshot );
+  Sfree( queueStr );
+  if( !snapshotStr ) {
+    logerr( "_journalWriteSnapshot: could not create snapshot." );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Write to temporary file and sync
+\*------------------------------------------------------------------------*/
+  tmpName = malloc( strlen(fileName)+5 );
+  if( !tmpName ) {
+    logerr( "_journalWriteSnapshot: out of memory!" );
+    Sfree( snapshotStr );
+    return -1;
+  }
+  sprintf( tmpName, "%s.tmp", fileName );
+  fp = fopen( tmpName, "w" );
+  if( !fp ) {
+    logerr( "_journalWriteSnapshot: could not open \"%s\": %s", tmpName, strerror(errno) );
+    Sfree( snapshotStr );
+    Sfree( tmpName );
+    return -1;
+  }
+  fchmod( fileno(fp), S_IRUSR|S_IWUSR );
+  if( fputs(snapshotStr,fp)==EOF || fflush(fp) || fsync(fileno(fp)) ) {
+    logerr( "_journalWriteSnapshot: could not write \"%s\": %s", tmpName, strerror(errno) );
+    rc = -1;
+  }
+  size = ftello( fp );
+  if( fclose(fp) )
+    rc = -1;
+  Sfree( snapshotStr );
+
+/*------------------------------------------------------------------------*\
+    Replace snapshot atomically
+\*------------------------------------------------------------------------*/
+  if( !rc && rename(tmpName,fileName) ) {
+    logerr( "_journalWriteSnapshot: could not rename \"%s\": %s", tmpName, strerror(errno) );
+    rc = -1;
+  }
+  if( rc ) {
+    unlink( tmpName );
+    Sfree( tmpName );
+    return -1;
+  }
+  Sfree( tmpName );
+  fsyncDir( fileName );
+  pthread_mutex_lock( &journal->mutex );
+  journal->snapshotSize = size;
+  pthread_mutex_unlock( &journal->mutex );
+
+/*------------------------------------------------------------------------*\
+    Truncate journal, all records are contained in snapshot now
+\*------------------------------------------------------------------------*/
+  if( journal->fd>=0 ) {
+    if( ftruncate(journal->fd,0) || fdatasync(journal->fd) )
+      logerr( "_journalWriteSnapshot: could not truncate \"%s\": %s",
+              journal->journalFileName, strerror(errno) );
+  }
+  else if( truncate(journal->journalFileName,0) && errno!=ENOENT )
+    logerr( "_journalWriteSnapshot: could not truncate \"%s\": %s",
+            journal->journalFileName, strerror(errno) );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  DBGMSG( "_journalWriteSnapshot (%p): %ld bytes in %.3fs", snapshot,
+          (long)size, srvtime()-start );
+  metricsObserve( MetricPersistWriteSeconds, "queue", srvtime()-start );
+  return 0;
+}
+
+
+/*=========================================================================*\
+      Replay journal records newer than the snapshot
+        stops at the first unreadable record (torn write)
+        return number of applied records or -1 on error
+\*=========================================================================*/
+static int _journalReplay( Journal *journal, Playlist *plst, long long snapshotSeq )
+{
+  FILE         *fp;
+  char         *line    = NULL;
+  size_t        lineLen = 0;
+  ssize_t       len;
+  int           count   = 0;
+  int           lineNo  = 0;
+  json_t       *jRecord;
+  json_t       *jObj;
+  json_error_t  error;
+
+/*------------------------------------------------------------------------*\
+    Open journal
+\*------------------------------------------------------------------------*/
+  fp = fopen( journal->journalFileName, "r" );
+  if( !fp ) {
+    logerr( "_journalReplay: could not open \"%s\": %s",
+            journal->journalFileName, strerror(errno) );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Loop over all lines
+\*------------------------------------------------------------------------*/
+  while( (len=getline(&line,&lineLen,fp))>0 ) {
+    long long seq;
+    lineNo++;
+
+    // Incomplete last line is the result of an interrupted write
+    if( line[len-1]!='\n' ) {
+      logwarn( "_journalReplay: ignoring incomplete record in line %d.", lineNo );
+      break;
+    }
+
+    jRecord = json_loads( line, 0, &error );
+    if( !jRecord ) {
+      logwarn( "_journalReplay: ignoring corrupt record in line %d (%s), stopping.",
+               lineNo, error.text );
+      break;
+    }
+
+    // Skip records already contained in snapshot
+    jObj = json_object_get( jRecord, "seq" );
+    seq  = json_is_integer(jObj) ? json_integer_value(jObj) : 0;
+    if( seq<=snapshotSeq ) {
+      json_decref( jRecord );
+      continue;
+    }
+
+    // Apply
+    if( _journalApply(plst,jRecord) )
+      logwarn( "_journalReplay: could not apply record #%lld in line %d.", seq, lineNo );
+    json_decref( jRecord );
+    journal->seq = seq;
+    count++;
+  }
+
+/*------------------------------------------------------------------------*\
+    Clean up, that's all
+\*------------------------------------------------------------------------*/
+  free( line );
+  fclose( fp );
+  DBGMSG( "_journalReplay (%p): applied %d records, seq %lld", plst, count, journal->seq );
+  return count;
+}
+
+
+/*=========================================================================*\
+      Apply a journal record to a playlist
+        return 0 on success, -1 on error
+\*=========================================================================*/
+static int _journalApply( Playlist *plst, json_t *jRecord )
+{
+  const char *op;
+  json_t     *jObj;
+  int         rc = 0;
+
+/*------------------------------------------------------------------------*\
+    Get operation
+\*------------------------------------------------------------------------*/
+  jObj = json_object_get( jRecord, "op" );
+  if( !json_is_string(jObj) )
+    return -1;
+  op = json_string_value( jObj );
+
+#define GETINT( key ) ((int)json_integer_value(json_object_get(jRecord,(key))))
+#define GETBOOL( key ) json_is_true(json_object_get(jRecord,(key)))
+#define GETSTR( key ) json_string_value(json_object_get(jRecord,(key)))
+
+/*------------------------------------------------------------------------*\
+    Execute
+\*------------------------------------------------------------------------*/
+  if( !strcmp(op,"add") )
+    rc = playlistAddItems( plst, GETINT("oPos"), GETINT("mPos"),
+                           json_object_get(jRecord,"items"), GETBOOL("reset") );
+  else if( !strcmp(op,"delete") )
+    rc = playlistDeleteItems( plst, json_object_get(jRecord,"items") );
+  else if( !strcmp(op,"move") && GETSTR("order") )
+    rc = playlistMoveItems( plst, playlistSortTypeFromStr(GETSTR("order")),
+                            GETINT("pos"), json_object_get(jRecord,"items") );
+  else if( !strcmp(op,"shuffle") )
+    playlistShuffleWithSeed( plst, GETINT("start"), GETINT("end"), GETBOOL("cursorToStart"),
+                             (unsigned int)json_integer_value(json_object_get(jRecord,"seed")) );
+  else if( !strcmp(op,"transpose") ) {
+    PlaylistItem *pItem1 = playlistGetItem( plst, PlaylistMapped, GETINT("pos1") );
+    PlaylistItem *pItem2 = playlistGetItem( plst, PlaylistMapped, GETINT("pos2") );
+    if( pItem1 && pItem2 )
+      playlistTranspose( plst, pItem1, pItem2 );
+    else
+      rc = -1;
+  }
+  else if( !strcmp(op,"resetMapping") )
+    playlistResetMapping( plst, GETBOOL("inverse") );
+  else if( !strcmp(op,"reset") )
+    playlistReset( plst, GETBOOL("header") );
+  else if( !strcmp(op,"setId") && GETSTR("id") )
+    playlistSetId( plst, GETSTR("id") );
+  else if( !strcmp(op,"setName") && GETSTR("name") )
+    playlistSetName( plst, GETSTR("name") );
+  else if( !strcmp(op,"setItem") ) {
+    PlaylistItem *pItem = playlistGetItem( plst, PlaylistOriginal, GETINT("pos") );
+    jObj = json_object_get( jRecord, "item" );
+    if( pItem && jObj && !playlistItemSetMetaData(pItem,jObj,true) )
+      playlistItemChanged( plst, pItem );
+    else
+      rc = -1;
+  }
+  else if( strcmp(op,"cursor") ) {
+    logerr( "_journalApply: unknown operation \"%s\".", op );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Restore cursor
+\*------------------------------------------------------------------------*/
+  if( GETINT("cursor")>=0 )
+    playlistSetCursorPos( plst, GETINT("cursor") );
+
+#undef GETINT
+#undef GETBOOL
+#undef GETSTR
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return rc;
+}
+
+
+/*=========================================================================*\
+      Write a buffer completely
+        return 0 on success, -1 on error
+\*=========================================================================*/
+static int _journalWriteAll( int fd, const char *buffer, size_t len )
+{
+  while( len ) {
+    ssize_t n = write( fd, buffer, len );
+    if( n<0 && errno==EINTR )
+      continue;
+    if( n<=0 )
+      return -1;
+    buffer += n;
+    len    -= n;
+  }
+  return 0;
+}
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
@@ -0,0 +1,81 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : journal.h
+
+Description     : Main include file for journal.c
+
+Comments        : -
+
+Date            : 18.10.2026
+
+Updates         : -
+
+Author          : -
+
+Remarks         : -
+
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+/*=========================================================================*\
+  Includes needed by definitions from this file
+\*=========================================================================*/
+#include "playlist.h"
+
+
+/*========================================================================n
+  Macro and type definitions
+\*========================================================================*/
+struct _journal;
+typedef struct _journal Journal;
+
+
+/*=========================================================================*\
+  Global symbols
+\*=========================================================================*/
+int       journalSetFilename( const char *baseName );
+Journal  *journalNew( const char *name );
+Playlist *journalLoad( Journal *journal );
+int       journalAttach( Journal *journal, Playlist *plst );
+int       journalSnapshot( Journal *journal, Playlist *plst );
+void      journalDelete( Journal *journal, Playlist *plst );
+
+
+#endif  /* __JOURNAL_H */
+
+
+/*========================================================================*\
+                                 END OF FILE
+\*========================================================================*/
@@ -0,0 +1,393 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : jsonArena.c
+
+Description     : arena allocator for JSON trees of incoming messages
+
+Comments        : jansson allocates via hooks: while an arena is active
+                  for the calling thread memory is taken from it,
+                  otherwise from the heap. Arena memory is never freed
+                  individually but released with the arena as a whole.
+                  Objects that need to survive the arena have to be
+                  promoted (i.e. copied to the heap) explicitly.
+                  ickMessage activates arenas for parsing only.
+
+Called by       : ickpd, ickMessage, playlist
+
+Calls           : 
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <jansson.h>
+
+#include "ickutils.h"
+#include "metrics.h"
+#include "jsonArena.h"
+
+
+/*=========================================================================*\
+  Global symbols
+\*=========================================================================*/
+// none
+
+
+/*=========================================================================*\
+  Private definitions and symbols
+\*=========================================================================*/
+#define JsonArenaBlockSize     (64*1024)
+#define JsonArenaBlocks        64         // Pool size: 4MB address space
+#define JsonArenaAlign         16
+
+// Arena header, located at the start of its first block
+struct _jsonArena {
+  char                 *blocks;       // Chain of blocks, linked by first word
+  char                 *ptr;          // Next free byte in current block
+  char                 *end;          // End of current block
+};
+
+static pthread_key_t       jsonArenaKey;
+static char               *jsonArenaPool;
+static int                 jsonArenaFreeList[JsonArenaBlocks];
+static int                 jsonArenaFreeCount;
+static pthread_mutex_t     jsonArenaMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Statistics
+static volatile long       jsonArenaAllocs;
+static volatile long       jsonHeapAllocs;
+static volatile long       jsonArenaPromotions;
+
+
+/*=========================================================================*\
+  Private prototypes
+\*=========================================================================*/
+static void *_jsonArenaMalloc( size_t size );
+static void  _jsonArenaFree( void *ptr );
+static char *_jsonArenaGetBlock( void );
+static void  _jsonArenaPutBlock( char *block );
+static bool  _jsonArenaContains( json_t *jObj );
+static void  _jsonArenaCollector( void );
+
+
+/*=========================================================================*\
+    Init arena allocator and install allocation hooks of jansson
+      Should be called before any JSON objects are created.
+      return -1 on error (jansson will use the heap only)
+\*=========================================================================*/
+int jsonArenaInit( void )
+{
+  int i;
+
+  DBGMSG( "jsonArenaInit: %d blocks of %d bytes.", JsonArenaBlocks, JsonArenaBlockSize );
+
+/*------------------------------------------------------------------------*\
+    Reserve address space for pool, pages are mapped on first use
+\*------------------------------------------------------------------------*/
+  jsonArenaPool = mmap( NULL, (size_t)JsonArenaBlocks*JsonArenaBlockSize,
+                        PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0 );
+  if( jsonArenaPool==MAP_FAILED ) {
+    logerr( "jsonArenaInit: could not map pool (%s).", strerror(errno) );
+    jsonArenaPool = NULL;
+    return -1;
+  }
+  for( i=0; i<JsonArenaBlocks; i++ )
+    jsonArenaFreeList[i] = JsonArenaBlocks-1-i;
+  jsonArenaFreeCount = JsonArenaBlocks;
+
+/*------------------------------------------------------------------------*\
+    Key for active arena of threads
+\*------------------------------------------------------------------------*/
+  if( pthread_key_create(&jsonArenaKey,NULL) ) {
+    logerr( "jsonArenaInit: could not create thread key." );
+    munmap( jsonArenaPool, (size_t)JsonArenaBlocks*JsonArenaBlockSize );
+    jsonArenaPool = NULL;
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Install hooks, objects allocated before are freed to the heap
+\*------------------------------------------------------------------------*/
+  json_set_alloc_funcs( _jsonArenaMalloc, _jsonArenaFree );
+  metricsRegisterCollector( _jsonArenaCollector );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return 0;
+}
+
+
+/*=========================================================================*\
+    Get a new arena
+      return NULL if the pool is exhausted or not initialized
+\*=========================================================================*/
+JsonArena *jsonArenaNew( void )
+{
+  JsonArena *arena;
+  char      *block;
+
+  if( !jsonArenaPool )
+    return NULL;
+
+/*------------------------------------------------------------------------*\
+    Get first block and place header behind the chain link
+\*------------------------------------------------------------------------*/
+  block = _jsonArenaGetBlock();
+  if( !block ) {
+    DBGMSG( "jsonArenaNew: pool exhausted." );
+    return NULL;
+  }
+  *(char **)block = NULL;
+  arena         = (JsonArena *)( block+JsonArenaAlign );
+  arena->blocks = block;
+  arena->ptr    = block + JsonArenaAlign + 
+                  ((sizeof(JsonArena)+JsonArenaAlign-1)&~(JsonArenaAlign-1));
+  arena->end    = block + JsonArenaBlockSize;
+
+  return arena;
+}
+
+
+/*=========================================================================*\
+    Set arena for allocations of the calling thread
+      arena might be NULL to allocate from the heap again
+      An arena must be active for at most one thread at a time.
+\*=========================================================================*/
+void jsonArenaActivate( JsonArena *arena )
+{
+  if( jsonArenaPool )
+    pthread_setspecific( jsonArenaKey, arena );
+}
+
+
+/*=========================================================================*\
+    Release arena with all objects allocated from it
+      arena might be NULL
+      The arena must not be active for any thread.
+\*=========================================================================*/
+void jsonArenaRelease( JsonArena *arena )
+{
+  char *block,
+       *next;
+
+  if( !arena )
+    return;
+
+/*------------------------------------------------------------------------*\
+    Return blocks to pool (the header is part of the last one in chain)
+\*------------------------------------------------------------------------*/
+  for( block=arena->blocks; block; block=next ) {
+    next = *(char **)block;
+#ifdef ICK_DEBUG
+    // Make use of not promoted objects visible
+    memset( block+sizeof(char *), 0xdb, JsonArenaBlockSize-sizeof(char *) );
+#endif
+    _jsonArenaPutBlock( block );
+  }
+}
+
+
+/*=========================================================================*\
+    Get a reference of a JSON object that is independent of arenas
+      Objects containing arena memory are deep copied, all others are
+      just referenced. The result needs to be decref'ed by the caller.
+      return NULL on error
+\*=========================================================================*/
+json_t *jsonArenaPromote( json_t *jObj )
+{
+  JsonArena *arena;
+  json_t    *jCopy;
+
+  if( !jObj )
+    return NULL;
+  if( !jsonArenaPool || !_jsonArenaContains(jObj) )
+    return json_incref( jObj );
+
+/*------------------------------------------------------------------------*\
+    Copy to heap
+\*------------------------------------------------------------------------*/
+  arena = pthread_getspecific( jsonArenaKey );
+  pthread_setspecific( jsonArenaKey, NULL );
+  jCopy = json_deep_copy( jObj );
+  pthread_setspecific( jsonArenaKey, arena );
+  if( !jCopy )
+    logerr( "jsonArenaPromote: could not copy object." );
+  else
+    __sync_add_and_fetch( &jsonArenaPromotions, 1 );
+
+  return jCopy;
+}
+
+
+/*=========================================================================*\
+    Allocation hook for jansson
+\*=========================================================================*/
+static void *_jsonArenaMalloc( size_t size )
+{
+  JsonArena *arena = pthread_getspecific( jsonArenaKey );
+  char      *block;
+  void      *ptr;
+
+/*------------------------------------------------------------------------*\
+    Take from active arena, chain new block if necessary and possible
+\*------------------------------------------------------------------------*/
+  if( arena ) {
+    size = (size+JsonArenaAlign-1) & ~(size_t)(JsonArenaAlign-1);
+    if( (size_t)(arena->end-arena->ptr)<size && size<=JsonArenaBlockSize-JsonArenaAlign &&
+        (block=_jsonArenaGetBlock())!=NULL ) {
+      *(char **)block = arena->blocks;
+      arena->blocks   = block;
+      arena->ptr      = block + JsonArenaAlign;
+      arena->end      = block + JsonArenaBlockSize;
+    }
+    if( (size_t)(arena->end-arena->ptr)>=size ) {
+      ptr         = arena->ptr;
+      arena->ptr += size;
+      __sync_add_and_fetch( &jsonArenaAllocs, 1 );
+      return ptr;
+    }
+  }
+
+/*------------------------------------------------------------------------*\
+    No arena, large chunk or pool exhausted: use heap
+\*------------------------------------------------------------------------*/
+  __sync_add_and_fetch( &jsonHeapAllocs, 1 );
+  return malloc( size );
+}
+
+
+/*=========================================================================*\
+    Deallocation hook for jansson
+      Arena memory is released with the arena
+\*=========================================================================*/
+static void _jsonArenaFree( void *ptr )
+{
+  if( (char *)ptr>=jsonArenaPool &&
+      (char *)ptr<jsonArenaPool+(size_t)JsonArenaBlocks*JsonArenaBlockSize )
+    return;
+  free( ptr );
+}
+
+
+/*=========================================================================*\
+    Get a block from pool
+      return NULL if exhausted
+\*=========================================================================*/
+static char *_jsonArenaGetBlock( void )
+{
+  char *block = NULL;
+
+  pthread_mutex_lock( &jsonArenaMutex );
+  if( jsonArenaFreeCount )
+    block = jsonArenaPool + (size_t)jsonArenaFreeList[--jsonArenaFreeCount]*JsonArenaBlockSize;
+  pthread_mutex_unlock( &jsonArenaMutex );
+
+  return block;
+}
+
+
+/*=========================================================================*\
+    Return a block to pool
+\*=========================================================================*/
+static void _jsonArenaPutBlock( char *block )
+{
+  pthread_mutex_lock( &jsonArenaMutex );
+  jsonArenaFreeList[jsonArenaFreeCount++] = (int)( (block-jsonArenaPool)/JsonArenaBlockSize );
+  pthread_mutex_unlock( &jsonArenaMutex );
+}
+
+
+/*=========================================================================*\
+    Check if a JSON object or one of its members is located in an arena
+\*=========================================================================*/
+static bool _jsonArenaContains( json_t *jObj )
+{
+  void   *iter;
+  size_t  i;
+
+  if( (char *)jObj>=jsonArenaPool &&
+      (char *)jObj<jsonArenaPool+(size_t)JsonArenaBlocks*JsonArenaBlockSize )
+    return true;
+
+  if( json_is_object(jObj) ) {
+    for( iter=json_object_iter(jObj); iter; iter=json_object_iter_next(jObj,iter) ) {
+      if( _jsonArenaContains(json_object_iter_value(iter)) )
+        return true;
+    }
+  }
+  else if( json_is_array(jObj) ) {
+    for( i=0; i<json_array_size(jObj); i++ ) {
+      if( _jsonArenaContains(json_array_get(jObj,i)) )
+        return true;
+    }
+  }
+
+  return false;
+}
+
+
+/*=========================================================================*\
+    Metrics collector: allocation statistics
+\*=========================================================================*/
+static void _jsonArenaCollector( void )
+{
+  int used;
+
+  pthread_mutex_lock( &jsonArenaMutex );
+  used = JsonArenaBlocks - jsonArenaFreeCount;
+  pthread_mutex_unlock( &jsonArenaMutex );
+
+  metricsSet( MetricJsonAllocations, "arena", jsonArenaAllocs );
+  metricsSet( MetricJsonAllocations, "heap", jsonHeapAllocs );
+  metricsSet( MetricJsonAllocations, "promoted", jsonArenaPromotions );
+  metricsSet( MetricJsonArenaBlocks, NULL, used );
+}
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
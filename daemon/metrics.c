@@ -0,0 +1,829 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : metrics.c
+
+Description     : metrics registry (counters, gauges and histograms)
+
+Comments        : Reported in Prometheus text format via a loopback
+                  HTTP port and as JSON via the "getPlayerMetrics"
+                  JSON-RPC method.
+
+Called by       : ickpd
+
+Calls           : 
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ickutils.h"
+#include "ickMessage.h"
+#include "ickCloud.h"
+#include "metrics.h"
+
+
+/*=========================================================================*\
+  Global symbols
+\*=========================================================================*/
+// none
+
+
+/*=========================================================================*\
+  Private definitions and symbols
+\*=========================================================================*/
+#define MetricsMaxBuckets      12
+#define MetricsMaxSeries       64      // per metric, more labels go to "other"
+#define MetricsMaxCollectors   16
+#define MetricsMaxRequest      1024
+
+typedef enum {
+  MetricCounter,
+  MetricGauge,
+  MetricHistogram
+} MetricType;
+
+// One time series (label value) of a metric
+typedef struct _metricSeries {
+  struct _metricSeries *next;
+  char                 *label;        // might be NULL
+  double                value;        // histograms: sum of observations
+  unsigned long         count;        // histograms: number of observations
+  unsigned long         buckets[MetricsMaxBuckets];
+} MetricSeries;
+
+typedef struct {
+  const char           *name;
+  MetricType            type;
+  const char           *labelName;    // NULL if not labeled
+  const char           *help;
+  MetricSeries         *series;
+  int                   seriesCount;
+} Metric;
+
+// Bucket limits of histograms (seconds)
+static const double metricsBuckets[] = {
+  0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 10.0
+};
+
+static Metric metricsTable[MetricCount] = {
+  [MetricFifoUsedBytes]       = { "ickpd_fifo_used_bytes",           MetricGauge,     "fifo",    "Bytes buffered in fifo" },
+  [MetricFifoSizeBytes]       = { "ickpd_fifo_size_bytes",           MetricGauge,     "fifo",    "Capacity of fifo" },
+  [MetricCodecDecodedBytes]   = { "ickpd_codec_decoded_bytes_total", MetricCounter,   "codec",   "Bytes delivered by codec" },
+  [MetricAudioXruns]          = { "ickpd_audio_xruns_total",         MetricCounter,   "backend", "Buffer underruns of audio device" },
+  [MetricFeedReceivedBytes]   = { "ickpd_feed_received_bytes_total", MetricCounter,   NULL,      "Bytes received by audio feeds" },
+  [MetricCloudRequestSeconds] = { "ickpd_cloud_request_seconds",     MetricHistogram, NULL,      "Execution time of cloud requests" },
+  [MetricCloudQueueLength]    = { "ickpd_cloud_queue_length",        MetricGauge,     NULL,      "Pending asynchronous cloud requests" },
+  [MetricMessageSeconds]      = { "ickpd_message_seconds",           MetricHistogram, "method",  "Handling time of JSON-RPC requests" },
+  [MetricQueueLength]         = { "ickpd_queue_length",              MetricGauge,     "zone",    "Items in playback queue of a zone" },
+  [MetricPersistWriteSeconds] = { "ickpd_persist_write_seconds",     MetricHistogram, "file",    "Time to write persisted state" },
+  [MetricThreadCpuSeconds]    = { "ickpd_thread_cpu_seconds",        MetricGauge,     "thread",  "CPU time of running threads by name" },
+  [MetricJsonAllocations]     = { "ickpd_json_allocations_total",    MetricCounter,   "pool",    "Allocations of JSON objects (arena, heap, promoted)" },
+  [MetricJsonArenaBlocks]     = { "ickpd_json_arena_blocks",         MetricGauge,     NULL,      "Blocks of JSON arena pool in use" }
+};
+
+static pthread_mutex_t     metricsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t     collectMutex = PTHREAD_MUTEX_INITIALIZER;
+static MetricsCollector    metricsCollectors[MetricsMaxCollectors];
+static int                 metricsCollectorCount;
+
+static int                 metricsSocket = -1;
+static pthread_t           metricsThread;
+static volatile bool       metricsThreadRunning;
+
+// A growing string buffer
+typedef struct {
+  char   *str;
+  size_t  len;
+  size_t  size;
+  bool    failed;
+} MetricsBuffer;
+
+
+/*=========================================================================*\
+  Private prototypes
+\*=========================================================================*/
+static MetricSeries *_metricsGetSeries( Metric *metric, const char *label );
+static void          _metricsReset( Metric *metric );
+static void          _metricsCollect( void );
+static void          _metricsCollectThreads( void );
+static void          _metricsPrintf( MetricsBuffer *buf, const char *fmt, ... );
+static void          _metricsPrintSeries( MetricsBuffer *buf, const Metric *metric, const MetricSeries *series, const char *suffix, const char *le, double value );
+static void         *_metricsThread( void *arg );
+static void          _metricsServe( int fd );
+static int           _rpcGetPlayerMetrics( IckRpcRequest *request, json_t *jParams );
+
+
+/*=========================================================================*\
+    Init metrics module
+      port - local TCP port for the HTTP server, 0 for none
+      return -1 on error
+\*=========================================================================*/
+int metricsInit( int port )
+{
+  struct sockaddr_in addr;
+  int                rc;
+  int                on = 1;
+
+  DBGMSG( "metricsInit: port %d.", port );
+
+/*------------------------------------------------------------------------*\
+    Register JSON-RPC method and own collectors
+\*------------------------------------------------------------------------*/
+  ickMessageRegisterMethod( "getPlayerMetrics", _rpcGetPlayerMetrics, IckRpcParamsNone, IckRpcAsync );
+  metricsRegisterCollector( _metricsCollectThreads );
+  if( !port )
+    return 0;
+
+/*------------------------------------------------------------------------*\
+    Create and bind socket (loopback only)
+\*------------------------------------------------------------------------*/
+  metricsSocket = socket( PF_INET, SOCK_STREAM, 0 );
+  if( metricsSocket<0 ) {
+    logerr( "metricsInit: Could not get socket (%s).", strerror(errno) );
+    return -1;
+  }
+  setsockopt( metricsSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+  memset( &addr, 0, sizeof(addr) );
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+  addr.sin_port        = htons( port );
+  if( bind(metricsSocket,(struct sockaddr *)&addr,sizeof(addr)) ||
+      listen(metricsSocket,4) ) {
+    logerr( "metricsInit: Could not bind to port %d (%s).", port, strerror(errno) );
+    close( metricsSocket );
+    metricsSocket = -1;
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Start thread
+\*------------------------------------------------------------------------*/
+  metricsThreadRunning = true;
+  rc = pthread_create( &metricsThread, NULL, _metricsThread, NULL );
+  if( rc ) {
+    logerr( "metricsInit: Unable to start thread (%s).", strerror(rc) );
+    metricsThreadRunning = false;
+    close( metricsSocket );
+    metricsSocket = -1;
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    That's it
+\*------------------------------------------------------------------------*/
+  lognotice( "metricsInit: Serving metrics on http://127.0.0.1:%d/metrics.", port );
+  return 0;
+}
+
+
+/*=========================================================================*\
+    Shutdown metrics module
+\*=========================================================================*/
+void metricsShutdown( void )
+{
+  int i;
+
+  DBGMSG( "metricsShutdown" );
+
+/*------------------------------------------------------------------------*\
+    Stop thread and close socket
+\*------------------------------------------------------------------------*/
+  if( metricsSocket>=0 ) {
+    metricsThreadRunning = false;
+    pthread_join( metricsThread, NULL );
+    close( metricsSocket );
+    metricsSocket = -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Free all series
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &collectMutex );
+  pthread_mutex_lock( &metricsMutex );
+  metricsCollectorCount = 0;
+  for( i=0; i<MetricCount; i++ )
+    _metricsReset( &metricsTable[i] );
+  pthread_mutex_unlock( &metricsMutex );
+  pthread_mutex_unlock( &collectMutex );
+}
+
+
+/*=========================================================================*\
+    Register a collector
+      return -1 on error
+\*=========================================================================*/
+int metricsRegisterCollector( MetricsCollector collector )
+{
+  int i;
+
+  pthread_mutex_lock( &collectMutex );
+  for( i=0; i<metricsCollectorCount; i++ ) {
+    if( metricsCollectors[i]==collector ) {
+      pthread_mutex_unlock( &collectMutex );
+      return 0;
+    }
+  }
+  if( metricsCollectorCount>=MetricsMaxCollectors ) {
+    pthread_mutex_unlock( &collectMutex );
+    logerr( "metricsRegisterCollector: too many collectors." );
+    return -1;
+  }
+  metricsCollectors[metricsCollectorCount++] = collector;
+  pthread_mutex_unlock( &collectMutex );
+
+  return 0;
+}
+
+
+/*=========================================================================*\
+    Increment a counter (or gauge)
+      label is ignored for metrics without label
+\*=========================================================================*/
+void metricsAdd( MetricId id, const char *label, double value )
+{
+  MetricSeries *series;
+
+  pthread_mutex_lock( &metricsMutex );
+  series = _metricsGetSeries( &metricsTable[id], label );
+  if( series )
+    series->value += value;
+  pthread_mutex_unlock( &metricsMutex );
+}
+
+
+/*=========================================================================*\
+    Set a gauge
+      label is ignored for metrics without label
+\*=========================================================================*/
+void metricsSet( MetricId id, const char *label, double value )
+{
+  MetricSeries *series;
+
+  pthread_mutex_lock( &metricsMutex );
+  series = _metricsGetSeries( &metricsTable[id], label );
+  if( series )
+    series->value = value;
+  pthread_mutex_unlock( &metricsMutex );
+}
+
+
+/*=========================================================================*\
+    Add an observation to a histogram
+      label is ignored for metrics without label
+\*=========================================================================*/
+void metricsObserve( MetricId id, const char *label, double value )
+{
+  MetricSeries *series;
+  int           i;
+
+  pthread_mutex_lock( &metricsMutex );
+  series = _metricsGetSeries( &metricsTable[id], label );
+  if( series ) {
+    series->value += value;
+    series->count++;
+    for( i=0; i<MetricsMaxBuckets; i++ ) {
+      if( value<=metricsBuckets[i] )
+        series->buckets[i]++;
+    }
+  }
+  pthread_mutex_unlock( &metricsMutex );
+}
+
+
+/*=========================================================================*\
+    Remove all series of a metric
+      Used by collectors to drop labels that vanished (e.g. threads)
+\*=========================================================================*/
+void metricsReset( MetricId id )
+{
+  pthread_mutex_lock( &metricsMutex );
+  _metricsReset( &metricsTable[id] );
+  pthread_mutex_unlock( &metricsMutex );
+}
+
+
+/*=========================================================================*\
+    Get all metrics as JSON
+      Counters and gauges are reported as numbers (objects label->value for
+      labeled metrics), histograms as objects with count, sum and buckets
+      (cumulative counts by upper limit).
+      returns an object or NULL on error
+\*=========================================================================*/
+json_t *metricsGetJSON( void )
+{
+  json_t       *jResult;
+  MetricSeries *series;
+  int           i, j;
+
+  DBGMSG( "metricsGetJSON" );
+
+/*------------------------------------------------------------------------*\
+    Create result, update sampled values
+\*------------------------------------------------------------------------*/
+  jResult = json_object();
+  if( !jResult ) {
+    logerr( "metricsGetJSON: out of memory!" );
+    return NULL;
+  }
+  pthread_mutex_lock( &collectMutex );
+  _metricsCollect();
+  pthread_mutex_lock( &metricsMutex );
+
+/*------------------------------------------------------------------------*\
+    Loop over all metrics and series
+\*------------------------------------------------------------------------*/
+  for( i=0; i<MetricCount; i++ ) {
+    Metric *metric = &metricsTable[i];
+    json_t *jMetric = metric->labelName ? json_object() : NULL;
+
+    for( series=metric->series; series; series=series->next ) {
+      json_t *jValue;
+
+      // Get value
+      if( metric->type==MetricHistogram ) {
+        json_t *jBuckets = json_object();
+        for( j=0; j<MetricsMaxBuckets; j++ ) {
+          char le[32];
+          sprintf( le, "%g", metricsBuckets[j] );
+          json_object_set_new( jBuckets, le, json_integer(series->buckets[j]) );
+        }
+        jValue = json_pack( "{sIsfso}", "count", (json_int_t)series->count,
+                            "sum", series->value, "buckets", jBuckets );
+      }
+      else
+        jValue = json_real( series->value );
+
+      // Store as labeled or plain value
+      if( jMetric )
+        json_object_set_new( jMetric, series->label?series->label:"", jValue );
+      else
+        jMetric = jValue;
+    }
+
+    if( jMetric )
+      json_object_set_new( jResult, metric->name, jMetric );
+  }
+  pthread_mutex_unlock( &metricsMutex );
+  pthread_mutex_unlock( &collectMutex );
+
+/*------------------------------------------------------------------------*\
+    That's it
+\*------------------------------------------------------------------------*/
+  return jResult;
+}
+
+
+/*=========================================================================*\
+    Get all metrics in Prometheus text format (version 0.0.4)
+      returns an allocated string (caller needs to free) or NULL on error
+\*=========================================================================*/
+char *metricsGetText( void )
+{
+  MetricsBuffer  buf;
+  MetricSeries  *series;
+  int            i, j;
+
+  DBGMSG( "metricsGetText" );
+  memset( &buf, 0, sizeof(buf) );
+
+/*------------------------------------------------------------------------*\
+    Update sampled values, loop over all metrics and series
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &collectMutex );
+  _metricsCollect();
+  pthread_mutex_lock( &metricsMutex );
+  for( i=0; i<MetricCount; i++ ) {
+    const Metric *metric = &metricsTable[i];
+    if( !metric->series )
+      continue;
+
+    _metricsPrintf( &buf, "# HELP %s %s\n# TYPE %s %s\n", metric->name, metric->help, metric->name,
+                    metric->type==MetricCounter?"counter":metric->type==MetricGauge?"gauge":"histogram" );
+
+    for( series=metric->series; series; series=series->next ) {
+      if( metric->type!=MetricHistogram ) {
+        _metricsPrintSeries( &buf, metric, series, "", NULL, series->value );
+        continue;
+      }
+      for( j=0; j<MetricsMaxBuckets; j++ ) {
+        char le[32];
+        sprintf( le, "%g", metricsBuckets[j] );
+        _metricsPrintSeries( &buf, metric, series, "_bucket", le, series->buckets[j] );
+      }
+      _metricsPrintSeries( &buf, metric, series, "_bucket", "+Inf", series->count );
+      _metricsPrintSeries( &buf, metric, series, "_sum", NULL, series->value );
+      _metricsPrintSeries( &buf, metric, series, "_count", NULL, series->count );
+    }
+  }
+  pthread_mutex_unlock( &metricsMutex );
+  pthread_mutex_unlock( &collectMutex );
+
+/*------------------------------------------------------------------------*\
+    Return result
+\*------------------------------------------------------------------------*/
+  if( buf.failed ) {
+    logerr( "metricsGetText: out of memory!" );
+    Sfree( buf.str );
+    return NULL;
+  }
+  return buf.str ? buf.str : strdup( "" );
+}
+
+
+/*=========================================================================*\
+    Get series of a metric by label, create if necessary
+      Caller must hold the metrics mutex.
+      returns NULL on error
+\*=========================================================================*/
+static MetricSeries *_metricsGetSeries( Metric *metric, const char *label )
+{
+  MetricSeries  *series;
+  MetricSeries **link;
+
+/*------------------------------------------------------------------------*\
+    Ignore label if metric is not labeled, limit number of series
+\*------------------------------------------------------------------------*/
+  if( !metric->labelName )
+    label = NULL;
+  else if( !label )
+    label = "";
+  else if( metric->seriesCount>=MetricsMaxSeries )
+    label = "other";
+
+/*------------------------------------------------------------------------*\
+    Search series (list is sorted by label)
+\*------------------------------------------------------------------------*/
+  for( link=&metric->series; *link; link=&(*link)->next ) {
+    int cmp = label ? strcmp( (*link)->label, label ) : 0;
+    if( !cmp )
+      return *link;
+    if( cmp>0 )
+      break;
+  }
+
+/*------------------------------------------------------------------------*\
+    Create new series
+\*------------------------------------------------------------------------*/
+  series = calloc( 1, sizeof(MetricSeries) );
+  if( !series ) {
+    logerr( "_metricsGetSeries (%s): out of memory!", metric->name );
+    return NULL;
+  }
+  if( label ) {
+    series->label = strdup( label );
+    if( !series->label ) {
+      logerr( "_metricsGetSeries (%s): out of memory!", metric->name );
+      Sfree( series );
+      return NULL;
+    }
+  }
+  series->next = *link;
+  *link = series;
+  metric->seriesCount++;
+
+  return series;
+}
+
+
+/*=========================================================================*\
+    Remove all series of a metric
+      Caller must hold the metrics mutex.
+\*=========================================================================*/
+static void _metricsReset( Metric *metric )
+{
+  MetricSeries *series, *next;
+
+  for( series=metric->series; series; series=next ) {
+    next = series->next;
+    Sfree( series->label );
+    Sfree( series );
+  }
+  metric->series      = NULL;
+  metric->seriesCount = 0;
+}
+
+
+/*=========================================================================*\
+    Call all collectors
+      Caller must hold the collector mutex (but not the metrics mutex).
+\*=========================================================================*/
+static void _metricsCollect( void )
+{
+  int i;
+
+  for( i=0; i<metricsCollectorCount; i++ )
+    metricsCollectors[i]();
+}
+
+
+/*=========================================================================*\
+    Collector: CPU time of all threads of this process (by name)
+\*=========================================================================*/
+static void _metricsCollectThreads( void )
+{
+  DIR           *dir;
+  struct dirent *entry;
+  long           ticks = sysconf( _SC_CLK_TCK );
+  char           path[64];
+  char           line[512];
+
+/*------------------------------------------------------------------------*\
+    Open task list
+\*------------------------------------------------------------------------*/
+  dir = opendir( "/proc/self/task" );
+  if( !dir )
+    return;
+  if( ticks<=0 )
+    ticks = 100;
+
+/*------------------------------------------------------------------------*\
+    Drop old values and loop over all threads
+\*------------------------------------------------------------------------*/
+  metricsReset( MetricThreadCpuSeconds );
+  while( (entry=readdir(dir)) ) {
+    FILE          *fp;
+    char          *name, *end;
+    unsigned long  utime, stime;
+
+    if( entry->d_name[0]=='.' )
+      continue;
+
+    // Read stat line: "tid (name) state ... utime stime ..."
+    snprintf( path, sizeof(path), "/proc/self/task/%s/stat", entry->d_name );
+    fp = fopen( path, "r" );
+    if( !fp )
+      continue;
+    if( !fgets(line,sizeof(line),fp) ) {
+      fclose( fp );
+      continue;
+    }
+    fclose( fp );
+    name = strchr( line, '(' );
+    end  = strrchr( line, ')' );
+    if( !name || !end || end<name )
+      continue;
+    *end = 0;
+
+    // Skip 11 fields after the state to get utime and stime (fields 14 and 15)
+    if( sscanf(end+2,"%*c %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %lu %lu",&utime,&stime)!=2 )
+      continue;
+    metricsAdd( MetricThreadCpuSeconds, name+1, (double)(utime+stime)/ticks );
+  }
+  closedir( dir );
+}
+
+
+/*=========================================================================*\
+    Print to buffer
+\*=========================================================================*/
+static void _metricsPrintf( MetricsBuffer *buf, const char *fmt, ... )
+{
+  va_list a_list;
+  int     n;
+
+  if( buf->failed )
+    return;
+
+/*------------------------------------------------------------------------*\
+    Try to print, grow buffer if necessary
+\*------------------------------------------------------------------------*/
+  for( ;; ) {
+    va_start( a_list, fmt );
+    n = vsnprintf( buf->str?buf->str+buf->len:NULL, buf->size-buf->len, fmt, a_list );
+    va_end( a_list );
+    if( n<0 ) {
+      buf->failed = true;
+      return;
+    }
+    if( buf->len+n<buf->size )
+      break;
+    char *newStr = realloc( buf->str, buf->size+n+4096 );
+    if( !newStr ) {
+      buf->failed = true;
+      return;
+    }
+    buf->str   = newStr;
+    buf->size += n+4096;
+  }
+  buf->len += n;
+}
+
+
+/*=========================================================================*\
+    Print a sample line of a series in Prometheus format
+      suffix - appended to metric name
+      le     - bucket limit (or NULL)
+\*=========================================================================*/
+static void _metricsPrintSeries( MetricsBuffer *buf, const Metric *metric, const MetricSeries *series, const char *suffix, const char *le, double value )
+{
+  _metricsPrintf( buf, "%s%s", metric->name, suffix );
+
+/*------------------------------------------------------------------------*\
+    Labels, label values are escaped
+\*------------------------------------------------------------------------*/
+  if( series->label || le ) {
+    _metricsPrintf( buf, "{" );
+    if( series->label ) {
+      const char *ptr;
+      _metricsPrintf( buf, "%s=\"", metric->labelName );
+      for( ptr=series->label; *ptr; ptr++ ) {
+        if( *ptr=='"' || *ptr=='\\' )
+          _metricsPrintf( buf, "\\%c", *ptr );
+        else if( *ptr=='\n' )
+          _metricsPrintf( buf, "\\n" );
+        else
+          _metricsPrintf( buf, "%c", *ptr );
+      }
+      _metricsPrintf( buf, "\"%s", le?",":"" );
+    }
+    if( le )
+      _metricsPrintf( buf, "le=\"%s\"", le );
+    _metricsPrintf( buf, "}" );
+  }
+
+/*------------------------------------------------------------------------*\
+    Value
+\*------------------------------------------------------------------------*/
+  _metricsPrintf( buf, " %.17g\n", value );
+}
+
+
+/*=========================================================================*\
+    HTTP server thread: answer scrapes
+\*=========================================================================*/
+static void *_metricsThread( void *arg )
+{
+  DBGMSG( "Metrics thread: starting." );
+  PTHREADSETNAME( "metrics" );
+
+/*------------------------------------------------------------------------*\
+    Loop till shutdown
+\*------------------------------------------------------------------------*/
+  while( metricsThreadRunning ) {
+    struct timeval tv;
+    fd_set         readSet;
+    int            rc, fd;
+
+    // Wait for connection, but wake up regularly to check for termination
+    FD_ZERO( &readSet );
+    FD_SET( metricsSocket, &readSet );
+    tv.tv_sec  = 0;
+    tv.tv_usec = 250000;
+    rc = select( metricsSocket+1, &readSet, NULL, NULL, &tv );
+    if( rc<0 ) {
+      if( errno==EINTR )
+        continue;
+      logerr( "Metrics thread: select failed (%s).", strerror(errno) );
+      break;
+    }
+    if( !rc )
+      continue;
+
+    // Accept and serve connection
+    fd = accept( metricsSocket, NULL, NULL );
+    if( fd<0 ) {
+      logwarn( "Metrics thread: accept failed (%s).", strerror(errno) );
+      continue;
+    }
+    _metricsServe( fd );
+    close( fd );
+  }
+
+/*------------------------------------------------------------------------*\
+    That's it
+\*------------------------------------------------------------------------*/
+  DBGMSG( "Metrics thread: terminating." );
+  return NULL;
+}
+
+
+/*=========================================================================*\
+    Serve one HTTP request (GET /metrics)
+\*=========================================================================*/
+static void _metricsServe( int fd )
+{
+  char            request[MetricsMaxRequest];
+  size_t          len = 0;
+  char           *body = NULL;
+  char            header[256];
+  const char     *status;
+  struct timeval  tv;
+
+/*------------------------------------------------------------------------*\
+    Read request line and header (with timeout)
+\*------------------------------------------------------------------------*/
+  tv.tv_sec  = 1;
+  tv.tv_usec = 0;
+  setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+  setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv) );
+  while( len<sizeof(request)-1 ) {
+    ssize_t n = recv( fd, request+len, sizeof(request)-1-len, 0 );
+    if( n<=0 )
+      break;
+    len += n;
+    request[len] = 0;
+    if( strstr(request,"\r\n\r\n") || strstr(request,"\n\n") )
+      break;
+  }
+  request[len] = 0;
+
+/*------------------------------------------------------------------------*\
+    Get result
+\*------------------------------------------------------------------------*/
+  if( !strcmpprefix(request,"GET /metrics ") || !strcmpprefix(request,"GET / ") ) {
+    body   = metricsGetText();
+    status = body ? "200 OK" : "500 Internal Server Error";
+  }
+  else
+    status = "404 Not Found";
+
+/*------------------------------------------------------------------------*\
+    Send answer
+\*------------------------------------------------------------------------*/
+  snprintf( header, sizeof(header),
+            "HTTP/1.0 %s\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %ld\r\n"
+            "Connection: close\r\n\r\n",
+            status, body?(long)strlen(body):0L );
+  if( send(fd,header,strlen(header),MSG_NOSIGNAL)>0 && body ) {
+    const char *ptr = body;
+    size_t      rest = strlen( body );
+    while( rest ) {
+      ssize_t n = send( fd, ptr, rest, MSG_NOSIGNAL );
+      if( n<=0 )
+        break;
+      ptr  += n;
+      rest -= n;
+    }
+  }
+  Sfree( body );
+}
+
+
+/*=========================================================================*\
+  RPC: Get metrics, statistics of cloud requests and peers
+\*=========================================================================*/
+static int _rpcGetPlayerMetrics( IckRpcRequest *request, json_t *jParams )
+{
+  request->jResult = json_pack( "{sososo}",
+                                "metrics", metricsGetJSON(),
+                                "cloud",   ickCloudGetStatistics(),
+                                "peers",   ickMessageGetPeerStatistics() );
+
+  return request->jResult ? 0 : -1;
+}
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
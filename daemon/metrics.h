@@ -0,0 +1,106 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : metrics.h
+
+Description     : Main include file for metrics.c
+
+Comments        : -
+
+Date            : 18.10.2026
+
+Updates         : -
+
+Author          : -
+
+Remarks         : -
+
+
+*************************************************************************
+ * Copyright (c) 2013, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+
+#ifndef __METRICS_H
+#define __METRICS_H
+
+/*=========================================================================*\
+  Includes needed by definitions from this file
+\*=========================================================================*/
+#include <jansson.h>
+
+
+/*========================================================================*\
+  Macro and type definitions
+\*========================================================================*/
+
+// Built in metrics (see metricsTable in metrics.c)
+typedef enum {
+  MetricFifoUsedBytes,          // gauge, label fifo
+  MetricFifoSizeBytes,          // gauge, label fifo
+  MetricCodecDecodedBytes,      // counter, label codec
+  MetricAudioXruns,             // counter, label backend
+  MetricFeedReceivedBytes,      // counter
+  MetricCloudRequestSeconds,    // histogram
+  MetricCloudQueueLength,       // gauge
+  MetricMessageSeconds,         // histogram, label method
+  MetricQueueLength,            // gauge, label zone
+  MetricPersistWriteSeconds,    // histogram, label file
+  MetricThreadCpuSeconds,       // gauge, label thread
+  MetricJsonAllocations,        // counter, label pool
+  MetricJsonArenaBlocks,        // gauge
+  MetricCount
+} MetricId;
+
+// Collectors are called before the metrics are reported to update
+// sampled values (gauges)
+typedef void (*MetricsCollector)( void );
+
+
+/*=========================================================================*\
+  Global symbols
+\*=========================================================================*/
+int     metricsInit( int port );
+void    metricsShutdown( void );
+int     metricsRegisterCollector( MetricsCollector collector );
+
+void    metricsAdd( MetricId id, const char *label, double value );
+void    metricsSet( MetricId id, const char *label, double value );
+void    metricsObserve( MetricId id, const char *label, double value );
+void    metricsReset( MetricId id );
+
+json_t *metricsGetJSON( void );
+char   *metricsGetText( void );
+
+
+#endif  /* __METRICS_H */
+
+
+/*========================================================================*\
+                                 END OF FILE
+\*========================================================================*/
@@ -7,6 +7,9 @@ Source File     : persist.c
 Description     : audio control 
 
 Comments        : Manager for persistent value storage
+                  Changes are written by a background thread after a
+                  coalescing window (write behind), file updates are
+                  atomic (temp file and rename).
 
 Called by       : - 
 
@@ -57,10 +60,13 @@ Remarks         : -
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
 #include <jansson.h>
 
 #include "ickutils.h"
 #include "persist.h"
+#include "metrics.h"
 
 
 /*=========================================================================*\
@@ -71,12 +77,30 @@ Remarks         : -
 /*=========================================================================*\
 	Private symbols
 \*=========================================================================*/
-static char   *repositoryFileName;
-static json_t *jRepository;
-
-static int _dumpRepository( const char *name );
-void       _freeRepository( void );  
-static int _readRepository( const char *name );
+#define PersistDefaultWriteDelay  2.0     // Coalescing window in seconds
+
+static char            *repositoryFileName;
+static json_t          *jRepository;
+static pthread_mutex_t  repositoryMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   repositoryCond  = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t  writerMutex     = PTHREAD_MUTEX_INITIALIZER;
+static bool             repositoryDirty;
+static double           repositoryDirtySince;
+static double           writeDelay      = PersistDefaultWriteDelay;
+static pthread_t        writerThread;
+static volatile bool    writerRunning;
+static volatile bool    writerStop;
+static bool             atforkRegistered;
+
+static int   _dumpRepository( const char *name );
+void         _freeRepository( void );  
+static int   _readRepository( const char *name );
+static int   _writeRepository( void );
+static int   _writeFile( const char *name, const char *buffer );
+static void *_writerThread( void *arg );
+static void  _atforkPrepare( void );
+static void  _atforkParent( void );
+static void  _atforkChild( void );
 
 
 /*=========================================================================*\
@@ -90,10 +114,17 @@ int persistSetFilename( const char *name )
   DBGMSG( "persistSetFilename: \"%s\"", name ); 
   
 /*------------------------------------------------------------------------*\
-    Defensively dump to an existing file name
+    Child processes (daemon mode) need to restart the writer thread
+\*------------------------------------------------------------------------*/
+  if( !atforkRegistered ) {
+    pthread_atfork( _atforkPrepare, _atforkParent, _atforkChild );
+    atforkRegistered = true;
+  }
+
+/*------------------------------------------------------------------------*\
+    Defensively write pending changes to an existing file name
 \*------------------------------------------------------------------------*/
-  if( repositoryFileName && jRepository )
-    _dumpRepository( repositoryFileName );
+  persistFlush();
 
 /*------------------------------------------------------------------------*\
     Try to read content from existing file
@@ -104,9 +135,11 @@ int persistSetFilename( const char *name )
 /*------------------------------------------------------------------------*\
     Create empty repository if necessary
 \*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &repositoryMutex );
   if( !jRepository )
     jRepository = json_object();
   if( !jRepository ) {
+    pthread_mutex_unlock( &repositoryMutex );
     logerr( "Could not create repository object." );
     return -1;
   }
@@ -116,10 +149,37 @@ int persistSetFilename( const char *name )
 \*------------------------------------------------------------------------*/
   Sfree( repositoryFileName );
   repositoryFileName = strdup( name );
+  pthread_mutex_unlock( &repositoryMutex );
   return 0;    
 }
 
 
+/*=========================================================================*\
+      Set coalescing window for write behind (in seconds)
+        all changes within this period are written with one file update
+\*=========================================================================*/
+void persistSetWriteDelay( double delay )
+{
+  DBGMSG( "persistSetWriteDelay: %.3lfs", delay );
+
+  pthread_mutex_lock( &repositoryMutex );
+  writeDelay = delay>0 ? delay : 0;
+  pthread_cond_signal( &repositoryCond );
+  pthread_mutex_unlock( &repositoryMutex );
+}
+
+
+/*=========================================================================*\
+      Write pending changes to file immediately (blocking)
+        return 0 on success or if nothing was pending, -1 on error
+\*=========================================================================*/
+int persistFlush( void )
+{
+  DBGMSG( "persistFlush: dirty=%s", repositoryDirty?"Yes":"No" );
+  return _writeRepository();
+}
+
+
 /*=========================================================================*\
       Shutdown module, Free all memory
 \*=========================================================================*/
@@ -128,20 +188,34 @@ void persistShutdown( void )
   loginfo( "Shutting down persistency module..." ); 
 
 /*------------------------------------------------------------------------*\
-    Dump to file a last time
+    Stop writer thread
+\*------------------------------------------------------------------------*/
+  if( writerRunning ) {
+    pthread_mutex_lock( &repositoryMutex );
+    writerStop = true;
+    pthread_cond_signal( &repositoryCond );
+    pthread_mutex_unlock( &repositoryMutex );
+    pthread_join( writerThread, NULL );
+    writerRunning = false;
+    writerStop    = false;
+  }
+
+/*------------------------------------------------------------------------*\
+    Write pending changes a last time
 \*------------------------------------------------------------------------*/
-  if( repositoryFileName && jRepository )
-    _dumpRepository( repositoryFileName );
+  persistFlush();
   
 /*------------------------------------------------------------------------*\
     Free filename
 \*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &repositoryMutex );
   Sfree( repositoryFileName ); 
 
 /*------------------------------------------------------------------------*\
     Free JSON repository in memory
 \*------------------------------------------------------------------------*/
   _freeRepository();
+  pthread_mutex_unlock( &repositoryMutex );
 
 /*------------------------------------------------------------------------*\
     That's all
@@ -179,11 +253,13 @@ int persistSetJSON_new( const char *key, json_t *value )
 /*------------------------------------------------------------------------*\
     Create repository if not available
 \*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &repositoryMutex );
   if( !jRepository ) {
     logwarn( "Set value in uninitialized repository: \"%s\"", key );
     jRepository = json_object();
   }
   if( !jRepository ) {
+    pthread_mutex_unlock( &repositoryMutex );
     logerr( "Could not create repository object." );
     return -1;
   }
@@ -191,14 +267,16 @@ int persistSetJSON_new( const char *key, json_t *value )
 /*------------------------------------------------------------------------*\
     Store or replace value in repository, steal reference
 \*------------------------------------------------------------------------*/
-  if( json_object_set(jRepository,key,value) ) {
+  if( json_object_set_new(jRepository,key,value) ) {
+    pthread_mutex_unlock( &repositoryMutex );
     logerr( "Cannot add vlaue for key \"%s\" to repository.", key );
     return -1;  
   }
   
 /*------------------------------------------------------------------------*\
-    Dump repository, that's it
+    Schedule dump of repository, that's it
 \*------------------------------------------------------------------------*/
+  pthread_mutex_unlock( &repositoryMutex );
   return _dumpRepository( repositoryFileName );
 }
 
@@ -323,7 +401,9 @@ int persistRemove( const char *key )
 /*------------------------------------------------------------------------*\
     Repository needs to be available
 \*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &repositoryMutex );
   if( !jRepository ) {
+    pthread_mutex_unlock( &repositoryMutex );
     logwarn( "Try to remove key \"%s\" from uninitialized repository.", 
                           key );
     return -1;
@@ -333,9 +413,11 @@ int persistRemove( const char *key )
     Store or replace value in repository, steal reference
 \*------------------------------------------------------------------------*/
   if( json_object_del(jRepository,key) ) {
+    pthread_mutex_unlock( &repositoryMutex );
     logerr( "Cannot remove key \"%s\" from repository.", key );
     return -1;
   }
+  pthread_mutex_unlock( &repositoryMutex );
 
 /*------------------------------------------------------------------------*\
     Dump repository, that's it
@@ -355,7 +437,9 @@ json_t *persistGetJSON( const char *key )
 /*------------------------------------------------------------------------*\
     Repository needs to be available
 \*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &repositoryMutex );
   if( !jRepository ) {
+    pthread_mutex_unlock( &repositoryMutex );
     logwarn( "Get value for key \"%s\" in uninitialized repository.", 
                           key );
     return NULL;
@@ -365,6 +449,7 @@ json_t *persistGetJSON( const char *key )
     Lookup
 \*------------------------------------------------------------------------*/
   json_t *jObj = json_object_get( jRepository, key );
+  pthread_mutex_unlock( &repositoryMutex );
   DBGMSG( "persistGetJSON: (%s)=%p", key, jObj ); 
   return jObj;
 }
@@ -516,14 +601,15 @@ bool persistGetBool( const char *key )
 
 
 /*=========================================================================*\
-      Write repository to file
+      Schedule writing of repository to file
+        the file is written by the writer thread after the coalescing
+        window, so callers never block on disk I/O
 \*=========================================================================*/
 static int _dumpRepository( const char *name )
 {
-  int retcode  = 0;
-  size_t flags = JSON_COMPACT;
-  
-  DBGMSG( "Dumping persistency file: \"%s\"", name ); 
+  int perr;
+
+  DBGMSG( "Scheduling dump of persistency file: \"%s\"", name ); 
 
 /*------------------------------------------------------------------------*\
     No name given? 
@@ -534,42 +620,248 @@ static int _dumpRepository( const char *name )
   }
 
 /*------------------------------------------------------------------------*\
-    No repository in mamory? 
+    Mark repository as dirty, start of coalescing window
 \*------------------------------------------------------------------------*/
-  if( !jRepository ) {
-    logerr( "Try to dump empty repository object." );
-    return -1;
+  pthread_mutex_lock( &repositoryMutex );
+  if( !repositoryDirty ) {
+    repositoryDirty      = true;
+    repositoryDirtySince = srvtime();
+  }
+
+/*------------------------------------------------------------------------*\
+    Start writer thread if necessary or wake it up
+\*------------------------------------------------------------------------*/
+  if( !writerRunning ) {
+    perr = pthread_create( &writerThread, NULL, _writerThread, NULL );
+    if( perr ) {
+      pthread_mutex_unlock( &repositoryMutex );
+      logerr( "Cannot start persistency writer thread: %s", strerror(perr) );
+      return _writeRepository();
+    }
+    writerRunning = true;
   }
+  else
+    pthread_cond_signal( &repositoryCond );
+  pthread_mutex_unlock( &repositoryMutex );
 
 /*------------------------------------------------------------------------*\
-    Use toolbox function 
+    That's all 
 \*------------------------------------------------------------------------*/
+  return 0;
+}
+
+
+/*=========================================================================*\
+      Write pending changes of repository to file
+        The repository is serialized while locked, the file is written
+        without holding the lock.
+        return 0 on success or if nothing was pending, -1 on error
+\*=========================================================================*/
+static int _writeRepository( void )
+{
+  char   *buffer;
+  char   *name;
+  int     retcode;
+  double  start;
+  size_t  flags = JSON_COMPACT;
+
 #ifdef ICK_DEBUG
   flags = JSON_INDENT(2) | JSON_PRESERVE_ORDER;
 #endif
 
-  if( json_dump_file(jRepository,name,flags) ) {
-    logerr( "Error writing to persistent repository \"%s\": %s ", 
-                     name, strerror(errno) );
-    retcode = -1;  
+/*------------------------------------------------------------------------*\
+    Serialize file updates (writer thread and explicit flushes)
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &writerMutex );
+
+/*------------------------------------------------------------------------*\
+    Nothing to do?
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &repositoryMutex );
+  if( !repositoryDirty || !repositoryFileName || !jRepository ) {
+    pthread_mutex_unlock( &repositoryMutex );
+    pthread_mutex_unlock( &writerMutex );
+    return 0;
+  }
+
+/*------------------------------------------------------------------------*\
+    Serialize repository and reset dirty flag
+\*------------------------------------------------------------------------*/
+  buffer = json_dumps( jRepository, flags );
+  name   = strdup( repositoryFileName );
+  repositoryDirty = false;
+  pthread_mutex_unlock( &repositoryMutex );
+  if( !buffer || !name ) {
+    pthread_mutex_unlock( &writerMutex );
+    logerr( "Cannot serialize persistent repository." );
+    Sfree( buffer );
+    Sfree( name );
+    return -1;
   }
 
 /*------------------------------------------------------------------------*\
-    Try to change file mode in any case (might conatain secret info) 
+    Write file
 \*------------------------------------------------------------------------*/
-  if( chmod(name,S_IRUSR|S_IWUSR) ) {
+  DBGMSG( "Dumping persistency file: \"%s\"", name ); 
+  start   = srvtime();
+  retcode = _writeFile( name, buffer );
+  metricsObserve( MetricPersistWriteSeconds, "state", srvtime()-start );
+  pthread_mutex_unlock( &writerMutex );
+
+/*------------------------------------------------------------------------*\
+    That's all 
+\*------------------------------------------------------------------------*/
+  Sfree( buffer );
+  Sfree( name );
+  return retcode;
+}
+
+
+/*=========================================================================*\
+      Write buffer to file atomically
+        data is written to a temporary file (only readable by the owner,
+        might contain secret info) which is synced and renamed
+        return 0 on success, -1 on error
+\*=========================================================================*/
+static int _writeFile( const char *name, const char *buffer )
+{
+  char    *tmpName;
+  int      fd;
+  size_t   len = strlen( buffer );
+  ssize_t  n;
+
+/*------------------------------------------------------------------------*\
+    Create temporary file
+\*------------------------------------------------------------------------*/
+  tmpName = malloc( strlen(name)+5 );
+  if( !tmpName ) {
+    logerr( "Cannot write persistent repository \"%s\": out of memory", name );
+    return -1;
+  }
+  sprintf( tmpName, "%s.tmp", name );
+  fd = open( tmpName, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR );
+  if( fd<0 ) {
+    logerr( "Error creating persistent repository \"%s\": %s ", 
+                     tmpName, strerror(errno) );
+    Sfree( tmpName );
+    return -1;
+  }
+  if( fchmod(fd,S_IRUSR|S_IWUSR) )
     logerr( "Could not chmod persistent repository \"%s\": %s ", 
+                     tmpName, strerror(errno) );
+
+/*------------------------------------------------------------------------*\
+    Write and sync data
+\*------------------------------------------------------------------------*/
+  while( len ) {
+    n = write( fd, buffer, len );
+    if( n<0 && errno==EINTR )
+      continue;
+    if( n<=0 )
+      break;
+    buffer += n;
+    len    -= n;
+  }
+  if( len || fsync(fd) ) {
+    logerr( "Error writing to persistent repository \"%s\": %s ", 
+                     tmpName, strerror(errno) );
+    close( fd );
+    unlink( tmpName );
+    Sfree( tmpName );
+    return -1;
+  }
+  close( fd );
+
+/*------------------------------------------------------------------------*\
+    Replace file
+\*------------------------------------------------------------------------*/
+  if( rename(tmpName,name) ) {
+    logerr( "Error replacing persistent repository \"%s\": %s ", 
                      name, strerror(errno) );
-    retcode = -1; 
+    unlink( tmpName );
+    Sfree( tmpName );
+    return -1;
   }
-  
+
+  // Make the rename itself durable
+  fsyncDir( name );
+
 /*------------------------------------------------------------------------*\
     That's all 
 \*------------------------------------------------------------------------*/
-  return retcode;
+  Sfree( tmpName );
+  return 0;
 }
 
-   
+
+/*=========================================================================*\
+      Writer thread: write repository after coalescing window
+\*=========================================================================*/
+static void *_writerThread( void *arg )
+{
+  struct timespec abstime;
+  double          due;
+
+  DBGMSG( "Persistency writer thread: starting." );
+  PTHREADSETNAME( "persist" );
+
+/*------------------------------------------------------------------------*\
+    Loop until stopped
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &repositoryMutex );
+  while( !writerStop ) {
+
+    // Wait for changes
+    if( !repositoryDirty ) {
+      pthread_cond_wait( &repositoryCond, &repositoryMutex );
+      continue;
+    }
+
+    // Wait for end of coalescing window
+    due = repositoryDirtySince + writeDelay;
+    if( srvtime()<due ) {
+      abstime.tv_sec  = (time_t)due;
+      abstime.tv_nsec = (long)((due-abstime.tv_sec)*1E9);
+      pthread_cond_timedwait( &repositoryCond, &repositoryMutex, &abstime );
+      continue;
+    }
+
+    // Write without holding the lock
+    pthread_mutex_unlock( &repositoryMutex );
+    _writeRepository();
+    pthread_mutex_lock( &repositoryMutex );
+  }
+  pthread_mutex_unlock( &repositoryMutex );
+
+/*------------------------------------------------------------------------*\
+    That's all (pending changes are flushed by persistShutdown)
+\*------------------------------------------------------------------------*/
+  DBGMSG( "Persistency writer thread: terminating." );
+  return NULL;
+}
+
+
+/*=========================================================================*\
+      Fork handlers: keep mutex consistent, threads do not survive a fork
+\*=========================================================================*/
+static void _atforkPrepare( void )
+{
+  pthread_mutex_lock( &repositoryMutex );
+}
+
+static void _atforkParent( void )
+{
+  pthread_mutex_unlock( &repositoryMutex );
+}
+
+static void _atforkChild( void )
+{
+  writerRunning = false;
+  pthread_cond_init( &repositoryCond, NULL );  // might have stale waiters
+  pthread_mutex_unlock( &repositoryMutex );
+}
+
+
 /*=========================================================================*\
       Free repository in memory
 \*=========================================================================*/
@@ -618,8 +910,10 @@ static int _readRepository( const char *name )
 /*------------------------------------------------------------------------*\
     Replace repository in memeory 
 \*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &repositoryMutex );
   _freeRepository( );
   jRepository = jObj;
+  pthread_mutex_unlock( &repositoryMutex );
       
 /*------------------------------------------------------------------------*\
     That's all
@@ -634,6 +928,6 @@ static int _readRepository( const char *name )
 /*=========================================================================*\
                                     END OF FILE
 \*=========================================================================*/
-
-
-
+
+
+
@@ -61,8 +61,10 @@ Remarks         : -
 \*=========================================================================*/
 int  persistSetFilename( const char *name );
 void persistShutdown( void );
+void persistSetWriteDelay( double delay );
+int  persistFlush( void );
 
-// all write activities will trigger a file dump if a name is set
+// all write activities will trigger a (delayed) file dump if a name is set
 int  persistSetJSON( const char *key, json_t *jObj );
 int  persistSetJSON_new( const char *key, json_t *value );
 int  persistSetString( const char *key, const char *value );
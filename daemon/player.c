@@ -78,11 +78,13 @@ Remarks         : -
 #include "ickScrobble.h"
 #include "metaIcy.h"
 #include "persist.h"
+#include "journal.h"
 #include "playlist.h"
 #include "feed.h"
 #include "audio.h"
 #include "player.h"
 #include "hmi.h"
+#include "metrics.h"
 
 // #define ICK_RAWMETA
 
@@ -104,111 +106,196 @@ typedef enum {
   PlayerThreadTerminatedError
 } PlayerThreadState;
 
+// Number of queue mutations kept for delta requests (getPlaybackQueueChanges)
+#define PlayerQueueChangeLogSize 512
+
+// Buffer size for persistence keys of zones
+#define PlayerKeySize            64
+
+// The HMI shows the main zone only
+#define HMIZONE(zone)            (!(zone)->index)
+
  
 /*=========================================================================*\
 	Private symbols
 \*=========================================================================*/
 
-// persistent
-static const char         *playerUUID;  
-static const char         *playerInterface;  
-static const char         *playerAudioDevice;  
-static const char         *playerHWID;  
-static const char         *playerModel;  
-static const char         *playerName;
-static double              playerVolume;
-static bool                playerMuted;
-static Playlist           *playerQueue;
-static PlayerPlaybackMode  playerPlaybackMode = PlaybackQueue;
+// A player zone: identity, queue, audio chain and playback thread
+struct _player {
+  int                         index;
+  ickP2pContext_t            *ictx;
+  Journal                    *journal;
+
+  // persistent
+  const char                 *uuid;
+  const char                 *audioDevice;
+  const char                 *name;
+  double                      volume;
+  bool                        muted;
+  Playlist                   *queue;
+  PlayerPlaybackMode          playbackMode;
+
+  // transient
+  pthread_mutex_t             mutex;
+  PlayerState                 state;
+  double                      lastChange;
+  AudioIf                    *audioIf;
+
+  // Playback thread
+  pthread_t                   playbackThread;
+  volatile PlayerThreadState  playbackThreadState;
+  char                       *currentTrackId;
+  PlaylistItem               *currentItem;      // for codec callbacks
+  CodecInstance              *codecInstance;
+};
+
+// shared by all zones of this process
+static const char         *playerInterface;
+static const char         *playerHWID;
+static const char         *playerModel;
 static AudioFormat         defaultAudioFormat;
 
-// transient
-pthread_mutex_t            playerMutex;
-static PlayerState         playerState = PlayerStateStop;
-static double              lastChange;
-static AudioIf            *audioIf;
-
-// Playback thread
-static pthread_t                   playbackThread;
-static volatile PlayerThreadState  playbackThreadState;
-static char                       *currentTrackId;
-static CodecInstance              *codecInstance;
+// the zones served by this process, the first one is the main zone
+static Player              mainZone = {
+  .playbackMode = PlaybackQueue,
+  .state        = PlayerStateStop
+};
+static Player             *zones[PlayerMaxZones] = { &mainZone };
+static int                 zoneCount = 1;
 
 
 /*=========================================================================*\
 	Private prototypes
 \*=========================================================================*/
-static int        _playerSetVolume( double volume, bool muted );
+static const char *_zoneKey( const Player *zone, const char *key, char *buffer );
+static int        _playerInitZone( Player *zone );
+static void       _playerShutdownZone( Player *zone );
+static int        _playerSetVolume( Player *zone, double volume, bool muted );
 static void      *_playbackThread( void *arg );
-static int        _playItem( PlaylistItem *item, AudioFormat *format );
-static AudioFeed *_feedFromPlayListItem( PlaylistItem *item, Codec **codec, const char **type, AudioFormat *format, int timeout );
+static int        _playItem( Player *zone, PlaylistItem *item, AudioFormat *format );
+static AudioFeed *_feedFromPlayListItem( PlaylistItem *item, Codec **codec, char **type, AudioFormat *format, int timeout );
 static int        _audioFeedCallback( AudioFeed *feed, void* usrData );
 static int        _codecNewFormatCallback( CodecInstance *instance, void *userData );
 #ifdef ICK_RAWMETA
 static void       _codecMetaCallback( CodecInstance *instance, CodecMetaType mType, json_t *jMeta, void *userData );
 #endif
+static void       _metricsCollector( void );
 
 
 /*=========================================================================*\
-      Init player
+      Init player (all zones)
 \*=========================================================================*/
 int playerInit( void )
 {
-  DBGMSG( "Initializing player module..." );
-  
+  int i;
+
+  DBGMSG( "Initializing player module (%d zones)...", zoneCount );
+
 /*------------------------------------------------------------------------*\
-    Init state. 
+    Get default audio format
 \*------------------------------------------------------------------------*/
-  playerState = PlayerStateStop;
+  if( !playerGetDefaultAudioFormat() ) {
+    logerr( "Invalid or no default audio format." );
+    return -1;
+  }
 
 /*------------------------------------------------------------------------*\
-    Get volume, safe default is volume 0 and unmuted 
+    Init zones
 \*------------------------------------------------------------------------*/
-  playerVolume   = persistGetReal( "PlayerVolume" );
-  playerMuted    = persistGetBool( "PlayerMuted" );  	
+  for( i=0; i<zoneCount; i++ ) {
+    if( _playerInitZone(zones[i]) )
+      return -1;
+  }
 
 /*------------------------------------------------------------------------*\
-    Load playlist
+    If possible tell cloud services about the current address
 \*------------------------------------------------------------------------*/
-  json_t *jQueue = persistGetJSON( "PlayerQueue" );
-  playerQueue    = playlistFromJSON( jQueue );
-  playlistLock( playerQueue );
-  playlistSetCursorPos( playerQueue, persistGetInteger("PlayerQueuePosition") );
-  playlistUnlock( playerQueue );
+  if( ickCloudGetAccessToken() )
+    ickCloudSetDeviceAddress( );
 
 /*------------------------------------------------------------------------*\
-    Get repeat mode
+    Report queue lengths with metrics
 \*------------------------------------------------------------------------*/
-  playerPlaybackMode = persistGetInteger( "PlayerPlaybackMode" );
+  metricsRegisterCollector( _metricsCollector );
 
 /*------------------------------------------------------------------------*\
-    Get default audio format
+    That's all
 \*------------------------------------------------------------------------*/
-  if( !playerGetDefaultAudioFormat() ) {
-    logerr( "Invalid or no default audio format." );
-    return -1;
+  return 0;
+}
+
+
+/*=========================================================================*\
+      Init a zone
+\*=========================================================================*/
+static int _playerInitZone( Player *zone )
+{
+  char key[PlayerKeySize];
+
+  DBGMSG( "Initializing player zone %d...", zone->index );
+
+/*------------------------------------------------------------------------*\
+    Init state. 
+\*------------------------------------------------------------------------*/
+  zone->state = PlayerStateStop;
+
+/*------------------------------------------------------------------------*\
+    Get volume, safe default is volume 0 and unmuted 
+\*------------------------------------------------------------------------*/
+  zone->volume   = persistGetReal( _zoneKey(zone,"PlayerVolume",key) );
+  zone->muted    = persistGetBool( _zoneKey(zone,"PlayerMuted",key) );
+
+/*------------------------------------------------------------------------*\
+    Load playlist, the main zone uses the default journal
+\*------------------------------------------------------------------------*/
+  if( zone->index )
+    snprintf( key, sizeof(key), "zone%d", zone->index );
+  zone->journal = journalNew( zone->index?key:NULL );
+  if( zone->journal )
+    zone->queue = journalLoad( zone->journal );
+  if( !zone->queue ) {
+    // Migrate queue stored in persistence repository by older versions
+    json_t *jQueue = persistGetJSON( _zoneKey(zone,"PlayerQueue",key) );
+    zone->queue    = playlistFromJSON( jQueue );
+    playlistLock( zone->queue );
+    playlistSetCursorPos( zone->queue, persistGetInteger(_zoneKey(zone,"PlayerQueuePosition",key)) );
+    playlistUnlock( zone->queue );
   }
 
+/*------------------------------------------------------------------------*\
+    Log and journal all queue modifications from now on
+\*------------------------------------------------------------------------*/
+  playlistLock( zone->queue );
+  if( playlistSetChangeLogSize(zone->queue,PlayerQueueChangeLogSize) )
+    logerr( "playerInit: could not set up change log of playback queue." );
+  if( !zone->journal || journalAttach(zone->journal,zone->queue) )
+    logerr( "playerInit: could not start journaling of playback queue." );
+  else if( persistGetJSON(_zoneKey(zone,"PlayerQueue",key)) ) {
+    persistRemove( _zoneKey(zone,"PlayerQueue",key) );
+    persistRemove( _zoneKey(zone,"PlayerQueuePosition",key) );
+  }
+  playlistUnlock( zone->queue );
 
 /*------------------------------------------------------------------------*\
-    Init mutex
+    Get repeat mode
 \*------------------------------------------------------------------------*/
-  ickMutexInit( &playerMutex );
+  zone->playbackMode = persistGetInteger( _zoneKey(zone,"PlayerPlaybackMode",key) );
 
 /*------------------------------------------------------------------------*\
-    Inform HMI and set timestamp 
+    Init mutex
 \*------------------------------------------------------------------------*/
-  hmiNewQueue( playerQueue );
-  hmiNewState( playerState );
-  hmiNewVolume( playerVolume, playerMuted );
-  hmiNewPlaybackMode( playerPlaybackMode );
-  lastChange = srvtime( );
+  ickMutexInit( &zone->mutex );
 
 /*------------------------------------------------------------------------*\
-    If possible tell cloud services about the current address
+    Inform HMI and set timestamp 
 \*------------------------------------------------------------------------*/
-  if( ickCloudGetAccessToken() )
-    ickCloudSetDeviceAddress( );
+  if( HMIZONE(zone) ) {
+    hmiNewQueue( zone->queue );
+    hmiNewState( zone->state );
+    hmiNewVolume( zone->volume, zone->muted );
+    hmiNewPlaybackMode( zone->playbackMode );
+  }
+  zone->lastChange = srvtime( );
 
 /*------------------------------------------------------------------------*\
     That's all
@@ -218,38 +305,183 @@ int playerInit( void )
 
 
 /*=========================================================================*\
-    Shut down player
+    Shut down player (all zones)
 \*=========================================================================*/
 void playerShutdown( void )
 {
+  int i;
+
   DBGMSG( "Shutting down player module..." );
-  
+
+/*------------------------------------------------------------------------*\
+    Shut down zones
+\*------------------------------------------------------------------------*/
+  for( i=0; i<zoneCount; i++ )
+    _playerShutdownZone( zones[i] );
+
+/*------------------------------------------------------------------------*\
+    Free recycled feeds and codec instances
+\*------------------------------------------------------------------------*/
+  audioFeedFreePool();
+  codecFreeInstancePool();
+}
+
+
+/*=========================================================================*\
+    Shut down a zone
+\*=========================================================================*/
+static void _playerShutdownZone( Player *zone )
+{
+  DBGMSG( "Shutting down player zone %d...", zone->index );
+
 /*------------------------------------------------------------------------*\
-    Save playback queue state
+    Close queue journal (all modifications are already stored)
 \*------------------------------------------------------------------------*/
-  playlistLock( playerQueue );
-  persistSetInteger( "PlayerQueuePosition", playlistGetCursorPos(playerQueue) );
-  persistSetJSON_new( "PlayerQueue", playlistGetJSON(playerQueue,PlaylistHybrid,0,0) );
-  playlistUnlock( playerQueue );
+  if( zone->journal ) {
+    playlistLock( zone->queue );
+    journalDelete( zone->journal, zone->queue );
+    playlistUnlock( zone->queue );
+    zone->journal = NULL;
+  }
 
 /*------------------------------------------------------------------------*\
     Shut down player thread (if any)
 \*------------------------------------------------------------------------*/
-  if( playerState==PlayerStatePlay || playerState==PlayerStatePause )
-    pthread_join( playbackThread, NULL );
+  if( zone->state==PlayerStatePlay || zone->state==PlayerStatePause )
+    pthread_join( zone->playbackThread, NULL );
 
 /*------------------------------------------------------------------------*\
     Close audio interface
 \*------------------------------------------------------------------------*/
-  if( audioIf ) {
-    audioIfDelete( audioIf, true );
-    audioIf = NULL;
+  if( zone->audioIf ) {
+    audioIfDelete( zone->audioIf, true );
+    zone->audioIf = NULL;
   }
 
 /*------------------------------------------------------------------------*\
     Delete mutex
 \*------------------------------------------------------------------------*/
-  pthread_mutex_destroy( &playerMutex );
+  pthread_mutex_destroy( &zone->mutex );
+}
+
+
+/*=========================================================================*\
+      Create zones
+        count<0 restores the persisted number of zones, additional zones
+        can only be created before playerInit() and are never removed
+        returns the number of zones
+\*=========================================================================*/
+int playerCreateZones( int count )
+{
+  DBGMSG( "playerCreateZones: %d", count );
+
+/*------------------------------------------------------------------------*\
+    Get and clip number of zones
+\*------------------------------------------------------------------------*/
+  if( count<0 )
+    count = persistGetInteger( "PlayerZones" );
+  if( count<1 )
+    count = 1;
+  if( count>PlayerMaxZones ) {
+    logwarn( "playerCreateZones: only %d zones are supported.", PlayerMaxZones );
+    count = PlayerMaxZones;
+  }
+
+/*------------------------------------------------------------------------*\
+    Create missing zones
+\*------------------------------------------------------------------------*/
+  while( zoneCount<count ) {
+    Player *zone = calloc( 1, sizeof(Player) );
+    if( !zone ) {
+      logerr( "playerCreateZones: out of memory!" );
+      break;
+    }
+    zone->index        = zoneCount;
+    zone->playbackMode = PlaybackQueue;
+    zone->state        = PlayerStateStop;
+    zones[zoneCount++] = zone;
+  }
+
+/*------------------------------------------------------------------------*\
+    Store number, that's all
+\*------------------------------------------------------------------------*/
+  persistSetInteger( "PlayerZones", zoneCount );
+  return zoneCount;
+}
+
+
+/*=========================================================================*\
+      Get number of zones
+\*=========================================================================*/
+int playerGetZoneCount( void )
+{
+  return zoneCount;
+}
+
+
+/*=========================================================================*\
+      Get a zone by index, zone 0 is the main zone
+        returns NULL if not existing
+\*=========================================================================*/
+Player *playerGetZone( int index )
+{
+  if( index<0 || index>=zoneCount )
+    return NULL;
+  return zones[index];
+}
+
+
+/*=========================================================================*\
+      Get the zone served by an ickstream context
+        returns NULL if not found
+\*=========================================================================*/
+Player *playerGetZoneByContext( const ickP2pContext_t *ictx )
+{
+  int i;
+
+  for( i=0; i<zoneCount; i++ ) {
+    if( zones[i]->ictx==ictx )
+      return zones[i];
+  }
+  return NULL;
+}
+
+
+/*=========================================================================*\
+      Get index of a zone
+\*=========================================================================*/
+int playerGetZoneIndex( const Player *zone )
+{
+  return zone->index;
+}
+
+
+/*=========================================================================*\
+      Set and get the ickstream context of a zone
+\*=========================================================================*/
+void playerSetContext( Player *zone, ickP2pContext_t *ictx )
+{
+  DBGMSG( "playerSetContext (zone %d): %p", zone->index, ictx );
+  zone->ictx = ictx;
+}
+
+ickP2pContext_t *playerGetContext( const Player *zone )
+{
+  return zone->ictx;
+}
+
+
+/*=========================================================================*\
+      Get persistence key of a zone
+        the main zone uses the plain key, others "Zone<index>.<key>"
+        buffer needs to have PlayerKeySize bytes
+\*=========================================================================*/
+static const char *_zoneKey( const Player *zone, const char *key, char *buffer )
+{
+  if( !zone->index )
+    return key;
+  snprintf( buffer, PlayerKeySize, "Zone%d.%s", zone->index, key );
+  return buffer;
 }
 
 
@@ -305,51 +537,51 @@ PlayerPlaybackMode playerPlaybackModeFromStr( const char *str )
 /*=========================================================================*\
       Get playback queue (playlist) 
 \*=========================================================================*/
-Playlist *playerGetQueue( void )
+Playlist *playerGetQueue( Player *zone )
 {
-  return playerQueue;
+  return zone->queue;
 }
 
 
 /*=========================================================================*\
       Clear player queue 
 \*=========================================================================*/
-void playerResetQueue( void )
+void playerResetQueue( Player *zone )
 {
   DBGMSG( "playerResetQueue" );
-  playlistLock( playerQueue );
-  playlistReset( playerQueue, true );
-  playlistUnlock( playerQueue );
+  playlistLock( zone->queue );
+  playlistReset( zone->queue, true );
+  playlistUnlock( zone->queue );
 }
 
 
 /*=========================================================================*\
       Get timstamp of last  change 
 \*=========================================================================*/
-double playerGetLastChange( void )
+double playerGetLastChange( Player *zone )
 {
-  DBGMSG( "playerGetLastChange: %lf", lastChange );
-  return lastChange;
+  DBGMSG( "playerGetLastChange: %lf", zone->lastChange );
+  return zone->lastChange;
 }
 
 
 /*=========================================================================*\
       Get playback state 
 \*=========================================================================*/
-PlayerState playerGetState( void )
+PlayerState playerGetState( Player *zone )
 {
-  DBGMSG( "playerGetState: %d (%s)", playerState, playerStateToStr(playerState) );
-  return playerState;
+  DBGMSG( "playerGetState: %d (%s)", zone->state, playerStateToStr(zone->state) );
+  return zone->state;
 }
 
 
 /*=========================================================================*\
       Get repeat mode 
 \*=========================================================================*/
-PlayerPlaybackMode playerGetPlaybackMode( void )
+PlayerPlaybackMode playerGetPlaybackMode( Player *zone )
 {
-  DBGMSG( "playerGetPlaybackMode: %d", playerPlaybackMode );
-  return playerPlaybackMode;
+  DBGMSG( "playerGetPlaybackMode: %d", zone->playbackMode );
+  return zone->playbackMode;
 }
 
 
@@ -506,43 +738,51 @@ const char *playerGetIpAddress( void )
 /*=========================================================================*\
     Get player UUID
 \*=========================================================================*/
-const char *playerGetUUID( void )
+const char *playerGetUUID( Player *zone )
 {
+  char key[PlayerKeySize];
 
 /*------------------------------------------------------------------------*\
     Get persistent value
 \*------------------------------------------------------------------------*/
-  if( !playerUUID )
-    playerUUID = persistGetString( "DeviceUUID" );
+  if( !zone->uuid )
+    zone->uuid = persistGetString( _zoneKey(zone,"DeviceUUID",key) );
 
 /*------------------------------------------------------------------------*\
     Need to set value once
 \*------------------------------------------------------------------------*/
-  if( !playerUUID ) {
+  if( !zone->uuid ) {
 #ifdef ICK_UUID
     uuid_t newUUID;
     char   strUUID[37];
     uuid_generate_random( newUUID );
     uuid_unparse_lower( newUUID, strUUID );
-    persistSetString( "DeviceUUID", strUUID );  // persist local buffer
-    playerUUID = persistGetString( "DeviceUUID" );
+    persistSetString( _zoneKey(zone,"DeviceUUID",key), strUUID );  // persist local buffer
+    zone->uuid = persistGetString( _zoneKey(zone,"DeviceUUID",key) );
 #else
+    const char *hwid;
+    char        strUUID[40];
     logwarn( "No UUID generator, trying to use hardware id as default." );
-    playerUUID = playerGetHWID();
-    if( !playerUUID ) {
+    hwid = playerGetHWID();
+    if( !hwid ) {
       logerr( "Could not determine player UUID" );
       return NULL;
     }
-    persistSetString( "DeviceUUID", playerUUID );
+    if( zone->index )
+      snprintf( strUUID, sizeof(strUUID), "%s-%d", hwid, zone->index );
+    else
+      snprintf( strUUID, sizeof(strUUID), "%s", hwid );
+    persistSetString( _zoneKey(zone,"DeviceUUID",key), strUUID );
+    zone->uuid = persistGetString( _zoneKey(zone,"DeviceUUID",key) );
 #endif
-    lognotice( "Initialized player UUID to: %s", playerUUID );
+    lognotice( "Initialized UUID of zone %d to: %s", zone->index, zone->uuid );
   }
 
 /*------------------------------------------------------------------------*\
     That's it
 \*------------------------------------------------------------------------*/
-  DBGMSG( "playerGetUUID: \"%s\"", playerUUID?playerUUID:"(null)" );
-  return playerUUID;
+  DBGMSG( "playerGetUUID: \"%s\"", zone->uuid?zone->uuid:"(null)" );
+  return zone->uuid;
 }
 
 
@@ -573,58 +813,60 @@ const char *playerGetInterface( void )
 /*=========================================================================*\
     Get audio device name
 \*=========================================================================*/
-const char *playerGetAudioDevice( void )
+const char *playerGetAudioDevice( Player *zone )
 {
-  if( !playerAudioDevice )
-    playerAudioDevice = persistGetString( "PlayerAudioDevice" );
-  DBGMSG( "playerGetAudioDevice: \"%s\"", playerAudioDevice?playerAudioDevice:"(null)" );
-  return playerAudioDevice;
+  char key[PlayerKeySize];
+  if( !zone->audioDevice )
+    zone->audioDevice = persistGetString( _zoneKey(zone,"PlayerAudioDevice",key) );
+  DBGMSG( "playerGetAudioDevice: \"%s\"", zone->audioDevice?zone->audioDevice:"(null)" );
+  return zone->audioDevice;
 }
 
 
 /*=========================================================================*\
     Get player name
 \*=========================================================================*/
-const char *playerGetName( void )
+const char *playerGetName( Player *zone )
 {
-  if( !playerName )
-    playerName = persistGetString( "PlayerName" );
-  DBGMSG( "playerGetName: \"%s\"", playerName?playerName:"(null)" );
-  return playerName;
+  char key[PlayerKeySize];
+  if( !zone->name )
+    zone->name = persistGetString( _zoneKey(zone,"PlayerName",key) );
+  DBGMSG( "playerGetName: \"%s\"", zone->name?zone->name:"(null)" );
+  return zone->name;
 }
 
 
 /*=========================================================================*\
       Get Volume 
 \*=========================================================================*/
-double playerGetVolume( void )
+double playerGetVolume( Player *zone )
 {
-  DBGMSG( "playerGetVolume: %.2lf%%", playerVolume*100 );
-  return playerVolume;
+  DBGMSG( "playerGetVolume: %.2lf%%", zone->volume*100 );
+  return zone->volume;
 }
 
 
 /*=========================================================================*\
       Get Muting state 
 \*=========================================================================*/
-bool playerGetMuting( void )
+bool playerGetMuting( Player *zone )
 {
-  DBGMSG( "playerGetMuting: %s", playerMuted?"On":"Off" );
-  return playerMuted;
+  DBGMSG( "playerGetMuting: %s", zone->muted?"On":"Off" );
+  return zone->muted;
 }
 
 
 /*=========================================================================*\
       Get playback position 
 \*=========================================================================*/
-double playerGetSeekPos( void )
+double playerGetSeekPos( Player *zone )
 {
   double pos = 0;
     
 /*------------------------------------------------------------------------*\
     Get Position from codec
 \*------------------------------------------------------------------------*/
-  if( codecInstance && codecGetSeekTime(codecInstance,&pos) )
+  if( zone->codecInstance && codecGetSeekTime(zone->codecInstance,&pos) )
     logwarn( "playerGetSeekPos: could not get seek time" );   
 
 /*------------------------------------------------------------------------*\
@@ -670,11 +912,12 @@ int playerSetDefaultAudioFormat( const char *format )
     Set player UUID (only in debug mode)
 \*=========================================================================*/
 #ifdef ICK_DEBUG
-void playerSetUUID( const char *uuid )
+void playerSetUUID( Player *zone, const char *uuid )
 {	
-  loginfo( "Setting player UUID to \"%s\"", uuid );
-  playerUUID = uuid;  
-  persistSetString( "DeviceUUID", uuid );
+  char key[PlayerKeySize];
+  loginfo( "Setting UUID of zone %d to \"%s\"", zone->index, uuid );
+  zone->uuid = uuid;  
+  persistSetString( _zoneKey(zone,"DeviceUUID",key), uuid );
 }
 #endif
 
@@ -711,34 +954,37 @@ void playerSetInterface( const char *name )
 /*=========================================================================*\
     Set audio device name
 \*=========================================================================*/
-void playerSetAudioDevice( const char *name )
+void playerSetAudioDevice( Player *zone, const char *name )
 {
-  loginfo( "Setting audio device to \"%s\"", name );
-  playerAudioDevice = name;  
-  persistSetString( "PlayerAudioDevice", name );
+  char key[PlayerKeySize];
+  loginfo( "Setting audio device of zone %d to \"%s\"", zone->index, name );
+  persistSetString( _zoneKey(zone,"PlayerAudioDevice",key), name );
+  zone->audioDevice = persistGetString( key );  // name might be transient
 }
 
 
 /*=========================================================================*\
     Set player name
 \*=========================================================================*/
-void playerSetName( const char *name, bool broadcast )
+void playerSetName( Player *zone, const char *name, bool broadcast )
 {
-  loginfo( "Setting player name to \"%s\"", name );
+  char key[PlayerKeySize];
+  loginfo( "Setting name of zone %d to \"%s\"", zone->index, name );
 
 /*------------------------------------------------------------------------*\
     Store new name 
 \*------------------------------------------------------------------------*/
-  playerName = name;  
-  persistSetString( "PlayerName", name );
+  persistSetString( _zoneKey(zone,"PlayerName",key), name );
+  zone->name = persistGetString( key );  // name might live in a message arena
 
 /*------------------------------------------------------------------------*\
     Update timestamp and broadcast new player state
 \*------------------------------------------------------------------------*/
-  lastChange = srvtime( );
-  hmiNewConfig();
+  zone->lastChange = srvtime( );
+  if( HMIZONE(zone) )
+    hmiNewConfig();
   if( broadcast )
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( zone, NULL );
 }
 
 
@@ -746,9 +992,10 @@ void playerSetName( const char *name, bool broadcast )
       Set Volume 
         returns effective volume (set to 0 if muted)
 \*=========================================================================*/
-double playerSetVolume( double volume, bool muted, bool broadcast )
+double playerSetVolume( Player *zone, double volume, bool muted, bool broadcast )
 {
-  loginfo( "Setting Volume to %lf", volume );
+  char key[PlayerKeySize];
+  loginfo( "Setting volume of zone %d to %lf", zone->index, volume );
 
 /*------------------------------------------------------------------------*\
     Clip value 
@@ -761,31 +1008,32 @@ double playerSetVolume( double volume, bool muted, bool broadcast )
 /*------------------------------------------------------------------------*\
     use internal interface to backend or codec
 \*------------------------------------------------------------------------*/
-  if( _playerSetVolume(playerVolume,playerMuted) )
+  if( _playerSetVolume(zone,zone->volume,zone->muted) )
     logwarn( "playerSetVolume: could not set volume to %.2lf%%%s", 
-              playerVolume*100, playerMuted?" (muted)":"" ); 
+              zone->volume*100, zone->muted?" (muted)":"" ); 
 
 /*------------------------------------------------------------------------*\
     Store new volume and muting state
 \*------------------------------------------------------------------------*/
-  playerVolume = volume;
-  persistSetReal( "PlayerVolume", volume );
-  playerMuted = muted;
-  persistSetBool( "playerMuted", muted );
+  zone->volume = volume;
+  persistSetReal( _zoneKey(zone,"PlayerVolume",key), volume );
+  zone->muted = muted;
+  persistSetBool( _zoneKey(zone,"PlayerMuted",key), muted );
 
 
 /*------------------------------------------------------------------------*\
     Update timestamp and broadcast new player state
 \*------------------------------------------------------------------------*/
-  lastChange = srvtime( );
-  hmiNewVolume( playerVolume, playerMuted );
+  zone->lastChange = srvtime( );
+  if( HMIZONE(zone) )
+    hmiNewVolume( zone->volume, zone->muted );
   if( broadcast )
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( zone, NULL );
 
 /*------------------------------------------------------------------------*\
     Return new volume 
 \*------------------------------------------------------------------------*/
-  return muted?0:playerVolume;
+  return muted?0:zone->volume;
 }
 
 
@@ -793,7 +1041,7 @@ double playerSetVolume( double volume, bool muted, bool broadcast )
       Set Volume 
         internal interface to audio backand or codec 
 \*=========================================================================*/
-static int _playerSetVolume( double volume, bool muted )
+static int _playerSetVolume( Player *zone, double volume, bool muted )
 {
   int rc = 0;
   DBGMSG( "_playerSetVolume: %lf%s", volume, muted?" (muted)":"" );
@@ -801,10 +1049,10 @@ static int _playerSetVolume( double volume, bool muted )
 /*------------------------------------------------------------------------*\
     Use backend
 \*------------------------------------------------------------------------*/
-  if( audioIf && audioIfSupportsVolume(audioIf) ) {
-    if( audioIfSetVolume(audioIf,volume,muted) ) {
+  if( zone->audioIf && audioIfSupportsVolume(zone->audioIf) ) {
+    if( audioIfSetVolume(zone->audioIf,volume,muted) ) {
       logerr( "_playerSetVolume: could not set volume to %.2lf%%%s for backend \"%s\"", 
-               volume*100, muted?" (muted)":"", audioIf->devName ); 
+               volume*100, muted?" (muted)":"", zone->audioIf->devName ); 
       rc = -1;
     }
 
@@ -813,10 +1061,10 @@ static int _playerSetVolume( double volume, bool muted )
 /*------------------------------------------------------------------------*\
     Use codec
 \*------------------------------------------------------------------------*/
-  else if( codecInstance ) {
-    if( codecSetVolume(codecInstance,playerVolume,playerMuted) ) {
+  else if( zone->codecInstance ) {
+    if( codecSetVolume(zone->codecInstance,zone->volume,zone->muted) ) {
       logerr( "_playerSetVolume: could not set volume to %.2lf%%%s for codec %s", 
-                volume*100, muted?" (muted)":"", codecInstance->codec->name );
+                volume*100, muted?" (muted)":"", zone->codecInstance->codec->name );
       rc = -1;
     } 
   }
@@ -831,32 +1079,33 @@ static int _playerSetVolume( double volume, bool muted )
 /*=========================================================================*\
       Set repeat mode
 \*=========================================================================*/
-int playerSetPlaybackMode( PlayerPlaybackMode mode, bool broadcast )
+int playerSetPlaybackMode( Player *zone, PlayerPlaybackMode mode, bool broadcast )
 {
+  char key[PlayerKeySize];
   bool playlistChanged = false;
-  loginfo( "Setting playback mode to %d", mode );
+  loginfo( "Setting playback mode of zone %d to %d", zone->index, mode );
 
 /*------------------------------------------------------------------------*\
     Store new state
 \*------------------------------------------------------------------------*/
-  if( playerPlaybackMode==mode )
+  if( zone->playbackMode==mode )
     return 0;
 
 /*------------------------------------------------------------------------*\
     Store new state 
 \*------------------------------------------------------------------------*/
-  playerPlaybackMode = mode;
-  persistSetInteger( "PlayerPlaybackMode", mode );
+  zone->playbackMode = mode;
+  persistSetInteger( _zoneKey(zone,"PlayerPlaybackMode",key), mode );
 
 /*------------------------------------------------------------------------*\
     Modify mapping if necessary
 \*------------------------------------------------------------------------*/
-  switch( playerPlaybackMode ) {
+  switch( zone->playbackMode ) {
     case PlaybackShuffle:
-      if( playerQueue ) {
+      if( zone->queue ) {
         int startPos = 0;
-        int endPos   = playlistGetLength( playerQueue )-1;
-        playlistShuffle( playerQueue, startPos, endPos, true );
+        int endPos   = playlistGetLength( zone->queue )-1;
+        playlistShuffle( zone->queue, startPos, endPos, true );
         playlistChanged = true;
       }
       break;
@@ -868,8 +1117,8 @@ int playerSetPlaybackMode( PlayerPlaybackMode mode, bool broadcast )
     case PlaybackRepeatQueue:
     case PlaybackRepeatItem:
     case PlaybackDynamic:
-      if( playerQueue ) {
-        playlistResetMapping( playerQueue, false );
+      if( zone->queue ) {
+        playlistResetMapping( zone->queue, false );
         playlistChanged = true;
       }
       break;
@@ -878,14 +1127,16 @@ int playerSetPlaybackMode( PlayerPlaybackMode mode, bool broadcast )
 /*------------------------------------------------------------------------*\
     Update timestamp and broadcast new player state
 \*------------------------------------------------------------------------*/
-  lastChange = srvtime( );
-  hmiNewPlaybackMode( mode );
-  if( playlistChanged )
-    hmiNewQueue( playerQueue );
+  zone->lastChange = srvtime( );
+  if( HMIZONE(zone) ) {
+    hmiNewPlaybackMode( mode );
+    if( playlistChanged )
+      hmiNewQueue( zone->queue );
+  }
   if( broadcast )
-    ickMessageNotifyPlayerState( NULL );
+    ickMessageNotifyPlayerState( zone, NULL );
   if( broadcast && playlistChanged )
-    ickMessageNotifyPlaylist( NULL );
+    ickMessageNotifyPlaylist( zone, NULL );
 
 /*=========================================================================*\
       return new mode 
@@ -897,28 +1148,28 @@ int playerSetPlaybackMode( PlayerPlaybackMode mode, bool broadcast )
 /*=========================================================================*\
       Change playback state 
 \*=========================================================================*/
-int playerSetState( PlayerState state, bool broadcast )
+int playerSetState( Player *zone, PlayerState state, bool broadcast )
 {
   int           rc = 0;
   int           perr;
   PlaylistItem *newTrack;
   const char   *newTrackId;
   
-  DBGMSG( "playerSetState: %s -> %s", playerStateToStr(playerState), playerStateToStr(state) );
+  DBGMSG( "playerSetState: %s -> %s", playerStateToStr(zone->state), playerStateToStr(state) );
   
 /*------------------------------------------------------------------------*\
     Lock player, we don't want concurrent modifications going on...
 \*------------------------------------------------------------------------*/
-  perr = pthread_mutex_lock( &playerMutex );
+  perr = pthread_mutex_lock( &zone->mutex );
   if( perr )
     logerr( "playerSetState: locking player mutex: %s", strerror(perr) );
 
 /*------------------------------------------------------------------------*\
     Get current playback item to detect changes in the queue 
 \*------------------------------------------------------------------------*/
-  playlistLock( playerQueue );
-  newTrack = playlistGetCursorItem( playerQueue );
-  playlistUnlock( playerQueue );
+  playlistLock( zone->queue );
+  newTrack = playlistGetCursorItem( zone->queue );
+  playlistUnlock( zone->queue );
 
 /*------------------------------------------------------------------------*\
     Switch on target state 
@@ -938,63 +1189,63 @@ int playerSetState( PlayerState state, bool broadcast )
       }
 
       // Try to setup audio interface if not yet done
-      if( !audioIf ) {
+      if( !zone->audioIf ) {
         const char         *device;
-        const AudioBackend *backend = audioBackendByDeviceString( playerAudioDevice, &device );
+        const AudioBackend *backend = audioBackendByDeviceString( zone->audioDevice, &device );
         if( backend )
-          audioIf = audioIfNew( backend, device, AudioFifoDefaultSize );
-        if( !audioIf ) {
-          logerr( "playerSetState (start): Could not open audio device \"%s\".", playerAudioDevice );
+          zone->audioIf = audioIfNew( backend, device, AudioFifoDefaultSize );
+        if( !zone->audioIf ) {
+          logerr( "playerSetState (start): Could not open audio device \"%s\".", zone->audioDevice );
           rc = -1;
           break;
         }
-        if( _playerSetVolume(playerVolume,playerMuted) )
+        if( _playerSetVolume(zone,zone->volume,zone->muted) )
           logwarn( "playerSetState (start): Could not set volume to %.2lf%% (%s).",
-                   playerVolume*100, playerMuted?"muted":"unmuted" );
+                   zone->volume*100, zone->muted?"muted":"unmuted" );
       }
 
       // Unpausing current track?
       playlistItemLock( newTrack );
       newTrackId = playlistItemGetId( newTrack );
 
-      if( playerState==PlayerStatePause && currentTrackId && !strcmp(newTrackId,currentTrackId) ) {
+      if( zone->state==PlayerStatePause && zone->currentTrackId && !strcmp(newTrackId,zone->currentTrackId) ) {
         lognotice( "playerSetState (start): Unpausing current item \"%s\" (%s).",
                    playlistItemGetText(newTrack), playlistItemGetId(newTrack) );
         playlistItemUnlock( newTrack );
-        playerState = PlayerStatePlay;
-        rc = audioIfSetPause( audioIf, false );
+        zone->state = PlayerStatePlay;
+        rc = audioIfSetPause( zone->audioIf, false );
         break;
       }
       playlistItemUnlock( newTrack );
 
      // Need to stop running track?
-      if( playerState==PlayerStatePlay || playerState==PlayerStatePause ) {
+      if( zone->state==PlayerStatePlay || zone->state==PlayerStatePause ) {
         DBGMSG( "playerSetState (start): Request active playback thread to terminate." );
-        if( !currentTrackId )
+        if( !zone->currentTrackId )
           logerr( "playerSetState (start): internal error (No current track)." );
         else
-          lognotice( "playerSetState (start): Stopping current track (%s).", currentTrackId );
-        if( playbackThreadState!=PlayerThreadRunning )
+          lognotice( "playerSetState (start): Stopping current track (%s).", zone->currentTrackId );
+        if( zone->playbackThreadState!=PlayerThreadRunning )
           logerr( "playerSetState (start): internal error: %s but no running playback thread.",
-                  playerStateToStr(playerState) );
+                  playerStateToStr(zone->state) );
         else {
-          playbackThreadState = PlayerThreadTerminating;
-          pthread_join( playbackThread, NULL ); 
+          zone->playbackThreadState = PlayerThreadTerminating;
+          pthread_join( zone->playbackThread, NULL ); 
         }
 
         // Stop audio interface (if not done by _playbackThread() )
-        if( !audioIf ) {
+        if( !zone->audioIf ) {
           logerr( "playerSetState (play): No audio interface to drop." );
         }
         else {
           DBGMSG( "playerSetState (play): Drop existing audio interface." );
-          if( audioIfStop(audioIf,AudioDrop) )
-            logerr( "playerSetState (play): Could not drop audio interface \"%s\".", audioIf->devName );
+          if( audioIfStop(zone->audioIf,AudioDrop) )
+            logerr( "playerSetState (play): Could not drop audio interface \"%s\".", zone->audioIf->devName );
         }
       }
 
       // Create new playback thread
-      rc = pthread_create( &playbackThread, NULL, _playbackThread, NULL );
+      rc = pthread_create( &zone->playbackThread, NULL, _playbackThread, zone );
       DBGMSG( "Starting new player thread." );
       if( rc ) {
         logerr( "playerSetState (start): Unable to start thread (%s).", strerror(rc) );
@@ -1003,7 +1254,7 @@ int playerSetState( PlayerState state, bool broadcast )
       }
 
       // Set new state
-      playerState = PlayerStatePlay;
+      zone->state = PlayerStatePlay;
       break;
 
 /*------------------------------------------------------------------------*\
@@ -1012,7 +1263,7 @@ int playerSetState( PlayerState state, bool broadcast )
     case PlayerStatePause:
 
      // not yet initialized?
-      if( !audioIf ) {
+      if( !zone->audioIf ) {
         logerr( "playerSetState (pause): audio device not yet initialized." );
         rc = -1;
         break;
@@ -1029,19 +1280,19 @@ int playerSetState( PlayerState state, bool broadcast )
       playlistItemLock( newTrack );
       newTrackId = playlistItemGetId( newTrack );
       playlistItemUnlock( newTrack );
-      if( currentTrackId && !strcmp(newTrackId,currentTrackId) ) {
+      if( zone->currentTrackId && !strcmp(newTrackId,zone->currentTrackId) ) {
 
         // Check for right state
-        if( playerState==PlayerStateStop )
+        if( zone->state==PlayerStateStop )
           logwarn( "playerSetState (pause): Cannot pause stopped playback." );
-        else if( playerState==PlayerStatePause )
+        else if( zone->state==PlayerStatePause )
           logwarn( "playerSetState (pause): Pause already paused playback." );
         // Pause audio output and set state
         else {
           lognotice( "playerSetState (pause): Playback paused." );
-          rc = audioIfSetPause( audioIf, true );
+          rc = audioIfSetPause( zone->audioIf, true );
           if( !rc )
-            playerState = PlayerStatePause;
+            zone->state = PlayerStatePause;
         }
         break;
       }
@@ -1057,30 +1308,32 @@ int playerSetState( PlayerState state, bool broadcast )
     case PlayerStateStop:
 
       // Inform HMI in any case
-      hmiNewPosition( 0.0 );
-      /*
-      playlistItemLock( newTrack );
-      newTrackId = playlistItemGetId( newTrack );
-      playlistItemUnlock( newTrack );
-      if( newTrack && (!currentTrackId || strcmp(newTrackId,currentTrackId)) )
-      */
-      hmiNewQueue( playerQueue );
+      if( HMIZONE(zone) ) {
+        hmiNewPosition( 0.0 );
+        /*
+        playlistItemLock( newTrack );
+        newTrackId = playlistItemGetId( newTrack );
+        playlistItemUnlock( newTrack );
+        if( newTrack && (!zone->currentTrackId || strcmp(newTrackId,zone->currentTrackId)) )
+        */
+        hmiNewQueue( zone->queue );
+      }
 
       // Stop audio interface
-      if( !audioIf ) {
+      if( !zone->audioIf ) {
         DBGMSG( "playerSetState (stop): No audio interface to delete." );
       }
       else {
         DBGMSG( "playerSetState (stop): Drop existing audio interface." );
-        if( audioIfStop(audioIf,AudioDrop) )
-          logerr( "playerSetState (stop): Could not stop audio interface \"%s\".", audioIf->devName );
+        if( audioIfStop(zone->audioIf,AudioDrop) )
+          logerr( "playerSetState (stop): Could not stop audio interface \"%s\".", zone->audioIf->devName );
       }
 
       // request thread to stop playback and set new player state
-      playbackThreadState = PlayerThreadTerminating;
-      if( playerState==PlayerStatePlay || playerState==PlayerStatePause )
-        pthread_join( playbackThread, NULL );
-      playerState = PlayerStateStop;
+      zone->playbackThreadState = PlayerThreadTerminating;
+      if( zone->state==PlayerStatePlay || zone->state==PlayerStatePause )
+        pthread_join( zone->playbackThread, NULL );
+      zone->state = PlayerStateStop;
 
       break; 
 
@@ -1096,13 +1349,16 @@ int playerSetState( PlayerState state, bool broadcast )
 /*------------------------------------------------------------------------*\
     Update timestamp, unlock player and broadcast new player state
 \*------------------------------------------------------------------------*/
-  lastChange = srvtime( );
-  perr = pthread_mutex_unlock( &playerMutex );
+  zone->lastChange = srvtime( );
+  perr = pthread_mutex_unlock( &zone->mutex );
   if( perr )
     logerr( "playerSetState: unlocking player mutex: %s", strerror(perr) );
-  hmiNewState( playerState );
-  if( broadcast )
-    ickMessageNotifyPlayerState( NULL );
+  if( HMIZONE(zone) )
+    hmiNewState( zone->state );
+  if( broadcast ) {
+    ickMessageNotifyPlayerState( zone, NULL );
+    ickMessageFlushNotifications();     // latency sensitive
+  }
 
 /*------------------------------------------------------------------------*\
     That's it 
@@ -1139,6 +1395,7 @@ const char *playerStateToStr( PlayerState state )
 \*=========================================================================*/
 static void *_playbackThread( void *arg )
 {
+  Player       *zone = arg;
   PlaylistItem *item;
   AudioFormat   backendFormat;
 
@@ -1155,84 +1412,89 @@ static void *_playbackThread( void *arg )
 /*------------------------------------------------------------------------*\
     Loop over player queue 
 \*------------------------------------------------------------------------*/
-  playbackThreadState = PlayerThreadRunning;
-  playlistLock( playerQueue );
-  item = playlistGetCursorItem( playerQueue );
+  zone->playbackThreadState = PlayerThreadRunning;
+  playlistLock( zone->queue );
+  item = playlistGetCursorItem( zone->queue );
   playlistItemIncRef( item );
-  playlistUnlock( playerQueue );
-  while( item && playbackThreadState==PlayerThreadRunning ) {
+  playlistUnlock( zone->queue );
+  while( item && zone->playbackThreadState==PlayerThreadRunning ) {
 
     // Play item
-    if( _playItem(item,&backendFormat) )
-      playbackThreadState = PlayerThreadTerminatedError;
+    TRACEBEGIN( "playItem" );
+    if( _playItem(zone,item,&backendFormat) )
+      zone->playbackThreadState = PlayerThreadTerminatedError;
+    TRACEEND( "playItem" );
 
     // Error or stopped?
-    if( playbackThreadState!=PlayerThreadRunning ) {
+    if( zone->playbackThreadState!=PlayerThreadRunning ) {
       playlistItemDecRef( item );
       break;
     }
 
     // Repeat track or reconnect stream?
-    if( playerPlaybackMode==PlaybackRepeatItem ||
+    if( zone->playbackMode==PlaybackRepeatItem ||
         playlistItemGetType(item)==PlaylistItemStream )
       continue;
     playlistItemDecRef( item );
 
     // Get next item
-    playlistLock( playerQueue );
-    item = playlistIncrCursorItem( playerQueue );
+    playlistLock( zone->queue );
+    item = playlistIncrCursorItem( zone->queue );
     if( item )
       playlistItemIncRef( item );
-    playlistUnlock( playerQueue );
+    playlistUnlock( zone->queue );
     if( item )
       continue;
 
     // repeat at end of list
-    if( playerPlaybackMode==PlaybackRepeatQueue ) {
-      playlistLock( playerQueue );
-      item = playlistSetCursorPos( playerQueue, 0 );
+    if( zone->playbackMode==PlaybackRepeatQueue ) {
+      playlistLock( zone->queue );
+      item = playlistSetCursorPos( zone->queue, 0 );
       if( item )
         playlistItemIncRef( item );
-      playlistUnlock( playerQueue );
+      playlistUnlock( zone->queue );
     }
 
     // repeat at end of list with shuffling
-    else if( playerPlaybackMode==PlaybackRepeatShuffle ) {
-      playlistLock( playerQueue );
-      playlistShuffle( playerQueue, 0, playlistGetLength(playerQueue)-1, false );
-      item = playlistSetCursorPos( playerQueue, 0 );
+    else if( zone->playbackMode==PlaybackRepeatShuffle ) {
+      playlistLock( zone->queue );
+      playlistShuffle( zone->queue, 0, playlistGetLength(zone->queue)-1, false );
+      item = playlistSetCursorPos( zone->queue, 0 );
       if( item )
         playlistItemIncRef( item );
-      playlistUnlock( playerQueue );
-      ickMessageNotifyPlaylist( NULL );
+      playlistUnlock( zone->queue );
+      ickMessageNotifyPlaylist( zone, NULL );
      }
 
   }  // End of: Thread main loop
-  DBGMSG( "Player thread: End of playback loop (state %d).", playbackThreadState );
+  DBGMSG( "Player thread: End of playback loop (state %d).", zone->playbackThreadState );
 
 /*------------------------------------------------------------------------*\
     Stop audio interface in draining mode if at end of item list,
     else drop data
 \*------------------------------------------------------------------------*/
-  if( audioIfStop(audioIf,playbackThreadState==PlayerThreadRunning?AudioDrain:AudioDrop) )
-    logerr( "Player thread: Could not stop audio interface \"%s\".", audioIf->devName );
+  if( audioIfStop(zone->audioIf,zone->playbackThreadState==PlayerThreadRunning?AudioDrain:AudioDrop) )
+    logerr( "Player thread: Could not stop audio interface \"%s\".", zone->audioIf->devName );
 
 /*------------------------------------------------------------------------*\
     Set and broadcast new player state
 \*------------------------------------------------------------------------*/
-  if( playbackThreadState==PlayerThreadRunning )
+  if( zone->playbackThreadState==PlayerThreadRunning )
     lognotice( "_playerThread: End of queue." );
-  playerState = PlayerStateStop;
-  ickMessageNotifyPlayerState( NULL );
-  hmiNewState( playerState );
-  hmiNewPosition( 0.0 );
+  zone->state = PlayerStateStop;
+  ickMessageNotifyPlayerState( zone, NULL );
+  ickMessageFlushNotifications();
+  if( HMIZONE(zone) ) {
+    hmiNewState( zone->state );
+    hmiNewPosition( 0.0 );
+  }
 
 
 /*------------------------------------------------------------------------*\
     Clean up, that's it ...
 \*------------------------------------------------------------------------*/
-  Sfree( currentTrackId );
-  DBGMSG( "Player thread: Terminated due to state %d.", playbackThreadState );
+  Sfree( zone->currentTrackId );
+  DBGMSG( "Player thread: Terminated due to state %d.", zone->playbackThreadState );
   return NULL;
 }
 
@@ -1246,12 +1508,12 @@ static void *_playbackThread( void *arg )
     Fixme: somehow reference the streamRef to allow the usage of
            alternatives for broken streams.
 \*=========================================================================*/
-static int _playItem( PlaylistItem *item, AudioFormat *format )
+static int _playItem( Player *zone, PlaylistItem *item, AudioFormat *format )
 {
   AudioFeed     *feed;
   Codec         *codec;
-  const char    *type;
-  CodecInstance *codecInst;   // mirrored to global variable codecInstance
+  char          *type;
+  CodecInstance *codecInst;   // mirrored to zone->codecInstance
   double         seekPos = 0;
   double         pos     = 0;
   int            retval = 0;
@@ -1266,7 +1528,7 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
 /*------------------------------------------------------------------------*\
     We will need an audio interface...
 \*------------------------------------------------------------------------*/
-  if( !audioIf ) {
+  if( !zone->audioIf ) {
     logerr( "_playItem: Called without initialized audio backend." );
     return -1;
   }
@@ -1274,8 +1536,10 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
 /*------------------------------------------------------------------------*\
    Inform HMI
 \*------------------------------------------------------------------------*/
-  hmiNewQueue( playerQueue );
-  hmiNewPosition( seekPos );
+  if( HMIZONE(zone) ) {
+    hmiNewQueue( zone->queue );
+    hmiNewPosition( seekPos );
+  }
 
 /*------------------------------------------------------------------------*\
     Try to get a connected feed and codec for new track,
@@ -1311,13 +1575,9 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
     // Change and distribute meta data of current item
 #ifdef ICK_RAWMETA
     else {
-      json_t *jRawMeta = json_object_get( playlistItemGetJSON(item), "rawMeta" );
-      if( !jRawMeta ) {
-        jRawMeta = json_object();
-        json_object_set_new( playlistItemGetJSON(item), "rawMeta", jRawMeta );
-      }
-      json_object_set_new( jRawMeta, "icyHeader", jIcyHdr );
-      ickMessageNotifyPlayerState( NULL );
+      playlistItemSetRawMeta( item, "icyHeader", jIcyHdr );
+      json_decref( jIcyHdr );
+      ickMessageNotifyPlayerState( zone, NULL );
     }
 #endif
 
@@ -1329,25 +1589,29 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
   DBGMSG( "_playItem (%s,\"%s\"): Init instance for codec %s (format %s).",
             playlistItemGetType(item)==PlaylistItemStream?"stream":"track",
             playlistItemGetText(item), codec->name, audioFormatStr(NULL,format) );
-  codecInst = codecNewInstance( codec, type, format, audioFeedGetFd(feed), audioIf->fifoIn );
+  codecInst = codecNewInstance( codec, type, format, audioFeedGetFd(feed), zone->audioIf->fifoIn );
   if( !codecInst ) {
     logerr( "_playItem (%s \"%s\"): Could not get instance of codec %s (format %s).",
             playlistItemGetType(item)==PlaylistItemStream?"Stream":"Track",
             playlistItemGetText(item), codec->name, audioFormatStr(NULL,format) );
     audioFeedDelete( feed, true );
+    Sfree( type );
     return -1;
   }
+  zone->currentItem = item;
   codecSetIcyInterval( codecInst, audioFeedGetIcyInterval(feed) );
   codecSetFormatCallback( codecInst, &_codecNewFormatCallback, format );
 #ifdef ICK_RAWMETA
-  codecSetMetaCallback( codecInst, &_codecMetaCallback, item );
+  codecSetMetaCallback( codecInst, &_codecMetaCallback, zone );
 #endif
   if( codecStartInstance(codecInst) ) {
     logerr( "_playItem (%s \"%s\"): Could not start codec.",
                 playlistItemGetType(item)==PlaylistItemStream?"Stream":"Track",
                 playlistItemGetText(item), audioFormatStr(NULL,format) );
     codecDeleteInstance( codecInst, true );
+    zone->currentItem = NULL;
     audioFeedDelete( feed, true );
+    Sfree( type );
     return -1;
   }
 
@@ -1355,9 +1619,11 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
     Wait till audio format is completed from stream info
 \*------------------------------------------------------------------------*/
   for( waitcntr=0; !audioFormatIsComplete(format); waitcntr++ ) {
-    if( playbackThreadState!=PlayerThreadRunning ) {
+    if( zone->playbackThreadState!=PlayerThreadRunning ) {
       codecDeleteInstance( codecInst, true );
+      zone->currentItem = NULL;
       audioFeedDelete( feed, true );
+      Sfree( type );
       return -1;
     }
     if( waitcntr>5 ) {
@@ -1365,7 +1631,9 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
               playlistItemGetType(item)==PlaylistItemStream?"Stream":"Track",
               playlistItemGetText(item), audioFormatStr(NULL,format) );
       codecDeleteInstance( codecInst, true );
+      zone->currentItem = NULL;
       audioFeedDelete( feed, true );
+      Sfree( type );
       return -1;
     }
     DBGMSG( "_playItem (%s \"%s\"): Waiting for audio format detection (%s).",
@@ -1380,12 +1648,14 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
   DBGMSG( "_playItem (%s \"%s\"): Setup audio backend.",
             playlistItemGetType(item)==PlaylistItemStream?"stream":"track",
             playlistItemGetText(item) );
-  if( audioIfPlay(audioIf,format,AudioDrain) ) {
+  if( audioIfPlay(zone->audioIf,format,AudioDrain) ) {
     logerr( "_playItem (%s \"%s\"): Could not setup audio backend (format %s).",
             playlistItemGetType(item)==PlaylistItemStream?"Stream":"Track",
             playlistItemGetText(item), audioFormatStr(NULL,format) );
     codecDeleteInstance( codecInst, true );
+    zone->currentItem = NULL;
     audioFeedDelete( feed, true );
+    Sfree( type );
     return -1;
   }
 
@@ -1395,20 +1665,20 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
   DBGMSG( "_playItem (%s \"%s\"): Set volume.",
             playlistItemGetType(item)==PlaylistItemStream?"stream":"track",
             playlistItemGetText(item) );
-  if( _playerSetVolume(playerVolume,playerMuted) )
+  if( _playerSetVolume(zone,zone->volume,zone->muted) )
     logwarn( "_playItem (%s \"%s\"): Could not set volume to %.2lf%% (%s).",
             playlistItemGetType(item)==PlaylistItemStream?"Stream":"Track",
-            playlistItemGetText(item), playerVolume*100, playerMuted?"muted":"unmuted" );
+            playlistItemGetText(item), zone->volume*100, zone->muted?"muted":"unmuted" );
 
 /*------------------------------------------------------------------------*\
     Save new track id and brodcast new player status
 \*------------------------------------------------------------------------*/
-  Sfree( currentTrackId );
+  Sfree( zone->currentTrackId );
   playlistItemLock( item );
-  currentTrackId = strdup( playlistItemGetId(item) );
+  zone->currentTrackId = strdup( playlistItemGetId(item) );
   playlistItemUnlock( item );
-  codecInstance = codecInst;
-  ickMessageNotifyPlayerState( NULL );
+  zone->codecInstance = codecInst;
+  ickMessageNotifyPlayerState( zone, NULL );
   playlistItemLock( item );
   lognotice( "_playItem (%s \"%s\"): Playing with %s (ID %s).",
                       playlistItemGetType(item)==PlaylistItemStream?"stream":"track",
@@ -1419,7 +1689,9 @@ static int _playItem( PlaylistItem *item, AudioFormat *format )
 /*------------------------------------------------------------------------*\
    Inform HMI
 \*------------------------------------------------------------------------*/
-  hmiNewFormat( type, format );
+  if( HMIZONE(zone) )
+    hmiNewFormat( type, format );
+  Sfree( type );
 
 /*------------------------------------------------------------------------*\
   Scrobble streams at start of playing
@@ -1431,7 +1703,7 @@ if( playlistItemGetType(item)==PlaylistItemStream &&
 /*------------------------------------------------------------------------*\
     Wait for end of feed or stop condition ...
 \*------------------------------------------------------------------------*/
-  while( playbackThreadState==PlayerThreadRunning ) {
+  while( zone->playbackThreadState==PlayerThreadRunning ) {
     DBGMSG( "_playItem (%s \"%s\"): Start wait loop iteration.",
             playlistItemGetType(item)==PlaylistItemStream?"stream":"track",
             playlistItemGetText(item) );
@@ -1453,7 +1725,7 @@ if( playlistItemGetType(item)==PlaylistItemStream &&
     if( rc>0 && !codecGetSeekTime(codecInst,&pos) ) {
 
       // Inform HMI on new positions but suppress updates in paused state
-      if( pos>seekPos && playerState==PlayerStatePlay )
+      if( pos>seekPos && zone->state==PlayerStatePlay && HMIZONE(zone) )
         hmiNewPosition( seekPos );
 
       // Store new position
@@ -1464,7 +1736,7 @@ if( playlistItemGetType(item)==PlaylistItemStream &&
   }
   DBGMSG( "_playItem (%s \"%s\"): Left wait loop with state %d.",
           playlistItemGetType(item)==PlaylistItemStream?"stream":"track",
-          playlistItemGetText(item), playbackThreadState );
+          playlistItemGetText(item), zone->playbackThreadState );
 
 /*------------------------------------------------------------------------*\
     Scrobble tracks after playing
@@ -1476,9 +1748,10 @@ if( playlistItemGetType(item)==PlaylistItemStream &&
 /*------------------------------------------------------------------------*\
     Get rid of codec instance
 \*------------------------------------------------------------------------*/
-  codecInstance = NULL;
+  zone->codecInstance = NULL;
   if( codecDeleteInstance(codecInst,true) )
     logerr( "_playItem (%s): Could not delete codec instance.", playlistItemGetText(item)  );
+  zone->currentItem = NULL;
 
 /*------------------------------------------------------------------------*\
     Get rid of feed
@@ -1498,18 +1771,20 @@ if( playlistItemGetType(item)==PlaylistItemStream &&
       Select an audio feed for a playlist item
         return opened feed on success, NULL on error
         *codec is set to the first matching codec
-        *type  cen be used to access the item format string
+        *type  is set to a copy of the item format string (if type is not NULL),
+               the caller needs to free it
         format can be used to supply a preferred format and will be set to
                the streamRef hints (if available)
         timeout is the connection timeout in milliseconds
 \*=========================================================================*/
-static AudioFeed *_feedFromPlayListItem( PlaylistItem *item, Codec **codec, const char **type, AudioFormat *format, int timeout )
+static AudioFeed *_feedFromPlayListItem( PlaylistItem *item, Codec **codec, char **type, AudioFormat *format, int timeout )
 {
   int          i;
   json_t      *jStreamingRefs;
   int          feedFlags = 0;
   AudioFeed   *feed = NULL;
   AudioFormat  refFormat;
+  const char  *feedType = NULL;
   enum {
     FormatStrict,
     FormatIgnore
@@ -1526,10 +1801,7 @@ static AudioFeed *_feedFromPlayListItem( PlaylistItem *item, Codec **codec, cons
 /*------------------------------------------------------------------------*\
     Get streaming hints for local content service
 \*------------------------------------------------------------------------*/
-  playlistItemLock( item );
   jStreamingRefs = playlistItemGetStreamingRefs( item );
-  json_incref( jStreamingRefs );
-  playlistItemUnlock( item );
 
 /*------------------------------------------------------------------------*\
     Get streaming hints for online content service
@@ -1570,8 +1842,6 @@ static AudioFeed *_feedFromPlayListItem( PlaylistItem *item, Codec **codec, cons
         continue;
       }
       thetype = json_string_value( jObj );
-      if( type )
-        *type = thetype;
 
       // Get URI
       jObj = json_object_get( jStreamRef, "url" );
@@ -1669,12 +1939,26 @@ static AudioFeed *_feedFromPlayListItem( PlaylistItem *item, Codec **codec, cons
         audioFeedDelete( feed, true );
         feed = NULL;
       }
-      else
+      else {
         audioFeedUnlock( feed );
+        feedType = thetype;
+      }
 
     }  // for( i=0; !feed&&i<json_array_size(jStreamingRefs); i++ )
   }
 
+/*------------------------------------------------------------------------*\
+    Copy type, since the streaming references are transient
+\*------------------------------------------------------------------------*/
+  if( feed && type ) {
+    *type = strdup( feedType );
+    if( !*type ) {
+      logerr( "_feedFromPlayListItem: out of memory!" );
+      audioFeedDelete( feed, true );
+      feed = NULL;
+    }
+  }
+
 /*------------------------------------------------------------------------*\
     Return result (if any)
 \*------------------------------------------------------------------------*/
@@ -1770,49 +2054,57 @@ static int _codecNewFormatCallback( CodecInstance *instance, void *userData )
 #ifdef ICK_RAWMETA
 static void _codecMetaCallback( CodecInstance *instance, CodecMetaType mType, json_t *jMeta, void *userData )
 {
-  PlaylistItem *item     = userData;
-  json_t       *jRawMeta = json_object_get( playlistItemGetJSON(item), "rawMeta" );
+  Player       *zone     = userData;
+  PlaylistItem *item     = zone->currentItem;
+  const char   *key;
+
+  if( !item )
+    return;
 
   DBGMSG( "_codecMetaCallback (%p,%s): type %d.",
           instance, instance->codec->name, mType );
 
-  // Process ICY data
-  if( mType==CodecMetaICY ) {
-    if( !jRawMeta ) {
-      jRawMeta = json_object();
-      json_object_set_new( playlistItemGetJSON(item), "rawMeta", jRawMeta );
-    }
-    json_object_set( jRawMeta, "icyInband", jMeta );
-  }
-
-  // Process ID3V1
-  else if( mType==CodecMetaID3V1 ) {
-    if( !jRawMeta ) {
-      jRawMeta = json_object();
-      json_object_set_new( playlistItemGetJSON(item), "rawMeta", jRawMeta );
-    }
-    json_object_set( jRawMeta, "id3v1", jMeta );
-  }
-
-  // Process ID3V2
-  else if( mType==CodecMetaID3V2 ) {
-    if( !jRawMeta ) {
-      jRawMeta = json_object();
-      json_object_set_new( playlistItemGetJSON(item), "rawMeta", jRawMeta );
-    }
-    json_object_set( jRawMeta, "id3v2", jMeta );
-  }
+  // Process ICY data, ID3V1 or ID3V2
+  if( mType==CodecMetaICY )
+    key = "icyInband";
+  else if( mType==CodecMetaID3V1 )
+    key = "id3v1";
+  else if( mType==CodecMetaID3V2 )
+    key = "id3v2";
 
   // Nothing to do...
   else
     return;
 
+  // Change item under its lock
+  if( playlistItemSetRawMeta(item,key,jMeta) )
+    return;
+
   // Inform controller
-  ickMessageNotifyPlayerState( NULL );
+  ickMessageNotifyPlayerState( zone, NULL );
 }
 #endif
 
 
+/*=========================================================================*\
+    Metrics collector: length of playback queues
+\*=========================================================================*/
+static void _metricsCollector( void )
+{
+  char label[16];
+  int  i, length;
+
+  for( i=0; i<zoneCount; i++ ) {
+    Player *zone = zones[i];
+    playlistLock( zone->queue );
+    length = playlistGetLength( zone->queue );
+    playlistUnlock( zone->queue );
+    sprintf( label, "%d", zone->index );
+    metricsSet( MetricQueueLength, label, length );
+  }
+}
+
+
 /*=========================================================================*\
                                     END OF FILE
 \*=========================================================================*/
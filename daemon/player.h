@@ -53,6 +53,7 @@ Remarks         : -
 	Includes needed by definitions from this file
 \*=========================================================================*/
 #include <stdbool.h>
+#include <ickP2p.h>
 #include "playlist.h"
 #include "audio.h"
 
@@ -60,6 +61,12 @@ Remarks         : -
 /*=========================================================================*\
        Macro and type definitions 
 \*=========================================================================*/
+struct _player;
+typedef struct _player Player;
+
+// Maximum number of zones (independent players) served by one process
+#define PlayerMaxZones 8
+
 typedef enum {
   PlayerStateStop,
   PlayerStatePlay,
@@ -88,37 +95,43 @@ typedef enum {
 
 int                 playerInit( void );
 void                playerShutdown( void );
+int                 playerCreateZones( int count );
+int                 playerGetZoneCount( void );
+Player             *playerGetZone( int index );
+Player             *playerGetZoneByContext( const ickP2pContext_t *ictx );
+int                 playerGetZoneIndex( const Player *zone );
+void                playerSetContext( Player *zone, ickP2pContext_t *ictx );
+ickP2pContext_t    *playerGetContext( const Player *zone );
 const char         *playerPlaybackModeToStr( PlayerPlaybackMode mode );
 PlayerPlaybackMode  playerPlaybackModeFromStr( const char *str );
-Playlist           *playerGetQueue( void );
-void                playerResetQueue( void );
-PlayerState         playerGetState( void );
-PlayerPlaybackMode  playerGetPlaybackMode( void );
-double              playerGetLastChange( void );
+Playlist           *playerGetQueue( Player *zone );
+void                playerResetQueue( Player *zone );
+PlayerState         playerGetState( Player *zone );
+PlayerPlaybackMode  playerGetPlaybackMode( Player *zone );
+double              playerGetLastChange( Player *zone );
 const AudioFormat  *playerGetDefaultAudioFormat( void );
 const char         *playerGetHWID( void );
 const char         *playerGetIpAddress( void );
-const char         *playerGetUUID( void );
-const char         *playerGetName( void );
+const char         *playerGetUUID( Player *zone );
+const char         *playerGetName( Player *zone );
 const char         *playerGetInterface( void );
-const char         *playerGetAudioDevice( void );
+const char         *playerGetAudioDevice( Player *zone );
 const char         *playerGetModel( void );
-double              playerGetVolume( void );
-bool                playerGetMuting( void );
-double              playerGetSeekPos( void );
+double              playerGetVolume( Player *zone );
+bool                playerGetMuting( Player *zone );
+double              playerGetSeekPos( Player *zone );
 int                 playerSetDefaultAudioFormat( const char *format );
-void                playerSetUUID( const char *name );
+void                playerSetUUID( Player *zone, const char *name );
 void                playerSetInterface( const char *name );
-void                playerSetAudioDevice( const char *name );
+void                playerSetAudioDevice( Player *zone, const char *name );
 void                playerSetModel( const char *name );
-void                playerSetName( const char *name, bool broadcast );
-double              playerSetVolume( double volume, bool muted, bool broadcast );
-int                 playerSetPlaybackMode( PlayerPlaybackMode state, bool broadcast );
-int                 playerSetState( PlayerState state, bool broadcast );
+void                playerSetName( Player *zone, const char *name, bool broadcast );
+double              playerSetVolume( Player *zone, double volume, bool muted, bool broadcast );
+int                 playerSetPlaybackMode( Player *zone, PlayerPlaybackMode state, bool broadcast );
+int                 playerSetState( Player *zone, PlayerState state, bool broadcast );
 const char         *playerStateToStr( PlayerState state );
 
 
-
 #endif  /* __PLAYER_H */
 
 
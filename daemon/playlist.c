@@ -52,12 +52,15 @@ Remarks         : -
 \************************************************************************/
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <strings.h>
 #include <pthread.h>
 #include <jansson.h>
 
 #include "ickutils.h"
+#include "jsonArena.h"
 #include "playlist.h"
 
 
@@ -70,20 +73,71 @@ Remarks         : -
 /*=========================================================================*\
 	Private definitions and symbols
 \*=========================================================================*/
+
+// A node of the position index (a treap with implicit keys)
+typedef struct _playlistNode {
+  struct _playlistNode *left;
+  struct _playlistNode *right;
+  struct _playlistNode *parent;
+  int                   size;             // number of nodes in subtree
+  unsigned int          priority;
+  PlaylistItem         *item;             // weak
+} PlaylistNode;
+
 struct _playlistItem {
   struct _playlistItem *nextOriginal;     // The original order
   struct _playlistItem *prevOriginal;
   struct _playlistItem *nextMapped;       // Order as played (when shuffled)
   struct _playlistItem *prevMapped;
+  PlaylistNode         *indexNode[2];     // Original and mapped position index
+  struct _playlistItem *nextSameHash;     // Chaining in id hash table
+  char                 *jsonBlob;         // Serialized item
+  const char           *id;               // interned
+  const char           *text;             // interned
+  const char           *image;            // interned, NULL if not available
+  double                duration;         // 0 if not available
+  unsigned int          refsOffset;       // Location of streaming refs in blob
+  unsigned int          refsLength;       //   (length 0 if not located)
+  unsigned int          idHash;           // Hash of id when added to table
+  int                   posTag;           // Temporary mapped position (mapping passes)
   int                   refCounter;
-  json_t               *jItem;
-  const char           *id;               // weak
-  const char           *text;             // weak
   PlaylistItemType      type;
-  json_t               *jStreamingRefs;   // weak
-  pthread_mutex_t       mutex;
 };
 
+// The item lists of a snapshot, shared by snapshots with the same structure
+typedef struct {
+  int                   refCounter;
+  int                   numberOfItems;
+  PlaylistItem        **original;         // strong
+  PlaylistItem        **mapped;           // weak (same items)
+  int                  *mappedPos;        // Mapped position of original item
+} PlaylistSnapshotBody;
+
+// An immutable view of a playlist
+struct _playlistSnapshot {
+  int                   refCounter;
+  json_int_t            version;
+  double                lastChange;
+  char                 *id;
+  char                 *name;
+  int                   cursorPos;
+  PlaylistSnapshotBody *body;
+};
+
+// An entry of the change log
+typedef struct {
+  json_int_t  version;
+  json_t     *jRecord;
+} PlaylistChange;
+
+// An interned string, shared by all items with the same id or text
+typedef struct _playlistString {
+  struct _playlistString *next;
+  unsigned int            hash;
+  int                     refCounter;
+  char                    str[];
+} PlaylistString;
+
 struct _playlist {
   char             *id;
   char             *name;
@@ -95,9 +149,51 @@ struct _playlist {
   PlaylistItem     *lastItemOriginal;
   PlaylistItem     *firstItemMapped;      // Root of mapped list
   PlaylistItem     *lastItemMapped;
+  PlaylistNode     *indexRoot[2];         // Original and mapped position index
+  PlaylistItem    **idTable;              // Hash table id -> items (multimap)
+  int               idTableSize;
+  int               idTableCount;
+  PlaylistJournalCallback journalCallback; // Mutation hook (persistence)
+  void             *journalUserData;
+  json_int_t        version;              // Version of last recorded mutation
+  PlaylistChange   *changeLog;            // Ring buffer of recent mutations
+  int               changeLogSize;
+  int               changeLogCount;
+  int               changeLogNext;
+  PlaylistSnapshot *snapshot;             // Published view
+  PlaylistSnapshotBody *snapshotBody;     // Current item lists of view
+  bool              snapshotPublish;      // Readers use snapshots: keep one published
   pthread_mutex_t   mutex;
 };
 
+// Initial size of id hash table (power of two)
+#define PLAYLIST_IDTABLE_MINSIZE 64
+
+// Initial size of string pool (power of two)
+#define PLAYLIST_STRINGTABLE_MINSIZE 256
+
+// Number of mutexes shared by all items (power of two)
+//   they are held only for header access or parsing a single item
+#define PLAYLIST_ITEMLOCK_STRIPES 256
+
+// Flags for item serialization (as used for ickstream messages)
+#define PLAYLIST_ITEM_DUMPFLAGS (JSON_PRESERVE_ORDER|JSON_COMPACT|JSON_ENSURE_ASCII)
+
+// A growing string buffer for serialized playlists
+typedef struct {
+  char   *str;
+  size_t  len;
+  size_t  size;
+} PlaylistBuffer;
+
+// The string pool and the striped item locks
+static PlaylistString  **stringTable;
+static int               stringTableSize;
+static int               stringTableCount;
+static pthread_mutex_t   stringTableMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t   itemLockStripes[PLAYLIST_ITEMLOCK_STRIPES];
+static pthread_once_t    itemLockOnce = PTHREAD_ONCE_INIT;
+
 // Enable or disable consistency checks (performance)
 #ifdef ICK_DEBUG
 #define CONSISTENCYCHECKING
@@ -107,11 +203,50 @@ struct _playlist {
 /*=========================================================================*\
         Private prototypes
 \*=========================================================================*/
-static int  _playlistItemFillHeader( PlaylistItem *pItem );
+static int  _playlistItemStore( PlaylistItem *pItem, json_t *jItem );
+static json_t *_playlistItemCopyJSON( PlaylistItem *pItem );
+static const char *_playlistItemSerialize( PlaylistItem *pItem );
+static json_t *_playlistGetJSONHeader( const char *id, const char *name, double lastChange, json_int_t version,
+                                       int countAll, PlaylistSortType order, int offset, int count );
+static int  _playlistBufferAppend( PlaylistBuffer *buffer, const char *str, size_t len );
+static pthread_mutex_t *_playlistItemStripe( PlaylistItem *pItem );
+static void _playlistItemLockInit( void );
+static void _playlistJournal( Playlist *plst, json_t *jRecord );
+static bool _playlistTranspose( Playlist *plst, PlaylistItem *pItem1, PlaylistItem *pItem2 );
+static unsigned int _playlistShuffleRandom( unsigned int *state );
+static int  _playlistApplyMapping( Playlist *plst, json_t *jMapping );
 static void _playlistAddItemBefore( Playlist *plst, PlaylistItem *anchorItem, PlaylistSortType order, PlaylistItem *newItem );
 //static void _playlistAddItemAfter( Playlist *plst, PlaylistItem *anchorItem, PlaylistSortType order, PlaylistItem *newItem );
 static void _playlistUnlinkItem( Playlist *plst, PlaylistItem *pItem, PlaylistSortType order );
 
+static void          _playlistIndexInsert( Playlist *plst, PlaylistSortType order, PlaylistItem *anchorItem, PlaylistItem *newItem );
+static void          _playlistIndexRemove( Playlist *plst, PlaylistSortType order, PlaylistItem *pItem );
+static void          _playlistIndexRebuild( Playlist *plst, PlaylistSortType order );
+static void          _playlistIndexFree( Playlist *plst, PlaylistSortType order );
+static PlaylistItem *_playlistIndexGet( Playlist *plst, PlaylistSortType order, int pos );
+static int           _playlistIndexRank( Playlist *plst, PlaylistSortType order, PlaylistItem *pItem );
+static unsigned int  _playlistIndexPriority( void );
+static void          _playlistIndexUpdate( PlaylistNode *node );
+static PlaylistNode *_playlistIndexMerge( PlaylistNode *left, PlaylistNode *right );
+static void          _playlistIndexSplit( PlaylistNode *node, int pos, PlaylistNode **left, PlaylistNode **right );
+static int           _playlistIndexCalcSize( PlaylistNode *node );
+static void          _playlistIndexFreeNodes( PlaylistNode *node, PlaylistSortType order );
+
+static int           _playlistSnapshotPublish( Playlist *plst );
+static void          _playlistSnapshotInvalidate( Playlist *plst, bool structure );
+static PlaylistSnapshotBody *_playlistSnapshotBodyNew( Playlist *plst );
+static void          _playlistSnapshotBodyRelease( PlaylistSnapshotBody *body );
+
+static unsigned int  _playlistIdHashValue( const char *id );
+static void          _playlistIdHashInsert( Playlist *plst, PlaylistItem *pItem );
+static void          _playlistIdHashRemove( Playlist *plst, PlaylistItem *pItem );
+static PlaylistItem *_playlistIdHashFind( Playlist *plst, const char *id );
+static int           _playlistIdHashResize( Playlist *plst, int size );
+static void          _playlistIdHashFree( Playlist *plst );
+
+static const char   *_playlistStringIntern( const char *str );
+static void          _playlistStringRelease( const char *str );
+
 #ifdef CONSISTENCYCHECKING
 #define CHKLIST( p ) _playlistCheckList( __FILE__, __LINE__, (p) );
 static int _playlistCheckList( const char *file, int line, Playlist *plst );
@@ -119,6 +254,8 @@ static int _playlistCheckList( const char *file, int line, Playlist *plst );
 #define CHKLIST( p ) {}
 #endif
 #define GETITEMTXT(item) ((item)?(item)->text:"none")
+#define RECORDING(p) ((p)->journalCallback || (p)->changeLogSize)
+#define INDEXSIZE(node) ((node)?(node)->size:0)
 
 
 /*=========================================================================*\
@@ -149,6 +286,11 @@ Playlist *playlistNew( void )
   ickMutexInit( &plst->mutex );
   plst->lastChange = srvtime();
 
+/*------------------------------------------------------------------------*\
+    Versions are time based, so they keep increasing across restarts
+\*------------------------------------------------------------------------*/
+  plst->version = (json_int_t)( plst->lastChange*1000 );
+
 /*------------------------------------------------------------------------*\
     That's all
 \*------------------------------------------------------------------------*/
@@ -218,14 +360,13 @@ Playlist *playlistFromJSON( json_t *jQueue )
     for( i=0; i<json_array_size(jObj); i++ ) {
       json_t       *jItem = json_array_get( jObj, i );
       PlaylistItem *pItem = playlistItemFromJSON( jItem );
-      if( pItem )
+      if( pItem ) {
         _playlistAddItemBefore( plst, NULL, PlaylistOriginal, pItem );
+        plst->_numberOfItems++;
+      }
       else
         logerr( "Playlist: could not parse playlist item #%d", i+1 );
     } 
-
-    // Store number of items
-    plst->_numberOfItems = json_array_size(jObj);
   }
 
   // Get mapping
@@ -238,28 +379,15 @@ Playlist *playlistFromJSON( json_t *jQueue )
     jObj = NULL;
   }
 
-  // Apply mapping
+  // Apply mapping: element i is the mapped position of original item i
+  if( jObj && _playlistApplyMapping(plst,jObj) ) {
+    logwarn( "Playlist: invalid mapping, using id mapping" );
+    jObj = NULL;
+  }
   if( !jObj ) {
     DBGMSG( "playlistFromJSON: found no mapping, using id.");
     playlistResetMapping( plst, false );
   }
-  else for( i=0; i<json_array_size(jObj); i++ ) {
-    json_t       *jPos = json_array_get( jObj, i );
-    PlaylistItem *pItem;
-    if( !json_is_integer(jPos) ) {
-      logwarn( "Playlist: mapping item #%d is not an integer, using id mapping" );
-      playlistResetMapping( plst, false );
-      break;
-    }
-    pItem = playlistGetItem( plst, PlaylistOriginal, json_integer_value(jPos) );
-    if( !pItem ) {
-      logerr( "Playlist: could not find mapped item #%d (position %s), using id mapping",
-                    i+1, json_integer_value(jPos) );
-      playlistResetMapping( plst, false );
-      break;
-    }
-    _playlistAddItemBefore( plst, NULL, PlaylistMapped, pItem );
-  }
 
 /*------------------------------------------------------------------------*\
     That's all 
@@ -289,6 +417,7 @@ void playlistDelete( Playlist *plst )
     Free all items and reset header
 \*------------------------------------------------------------------------*/
   playlistReset( plst, true );
+  playlistSetChangeLogSize( plst, 0 );
   
 /*------------------------------------------------------------------------*\
     Destroy mutex and free header
@@ -316,17 +445,145 @@ void playlistLock( Playlist *plst )
 
 /*=========================================================================*\
        Unlock playlist
+         A snapshot withdrawn by a mutation is replaced before unlocking,
+         so readers never have to build one
 \*=========================================================================*/
 void playlistUnlock( Playlist *plst )
 {
   int perr;
   DBGMSG( "playlist (%p): unlock", plst );
+  if( plst->snapshotPublish && !plst->snapshot )
+    _playlistSnapshotPublish( plst );
   perr = pthread_mutex_unlock( &plst->mutex );
   if( perr )
     logerr( "playlistUnlock: %s", strerror(perr) );
 }
 
 
+/*=========================================================================*\
+       Set callback for journaling of all mutations
+         callback is called with a JSON record (borrowed) describing the
+         mutation after it was applied, NULL disables journaling
+         Caller should lock playlist
+\*=========================================================================*/
+void playlistSetJournalCallback( Playlist *plst, PlaylistJournalCallback callback, void *userData )
+{
+  DBGMSG( "playlistSetJournalCallback (%p): %p", plst, callback );
+  plst->journalCallback = callback;
+  plst->journalUserData = userData;
+}
+
+
+/*=========================================================================*\
+       Set size of change log (number of recorded mutations)
+         0 disables the change log, the log is cleared in any case
+         Caller should lock playlist
+         return 0 on success, -1 on error
+\*=========================================================================*/
+int playlistSetChangeLogSize( Playlist *plst, int size )
+{
+  int i;
+
+  DBGMSG( "playlistSetChangeLogSize (%p): %d", plst, size );
+
+/*------------------------------------------------------------------------*\
+    Free old log
+\*------------------------------------------------------------------------*/
+  for( i=0; i<plst->changeLogSize; i++ ) {
+    if( plst->changeLog[i].jRecord )
+      json_decref( plst->changeLog[i].jRecord );
+  }
+  Sfree( plst->changeLog );
+  plst->changeLogSize  = 0;
+  plst->changeLogCount = 0;
+  plst->changeLogNext  = 0;
+
+/*------------------------------------------------------------------------*\
+    Allocate new one
+\*------------------------------------------------------------------------*/
+  if( size<=0 )
+    return 0;
+  plst->changeLog = calloc( size, sizeof(PlaylistChange) );
+  if( !plst->changeLog ) {
+    logerr( "playlistSetChangeLogSize: out of memory!" );
+    return -1;
+  }
+  plst->changeLogSize = size;
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return 0;
+}
+
+
+/*=========================================================================*\
+       Get version of playlist
+         the version is incremented with every recorded mutation
+\*=========================================================================*/
+json_int_t playlistGetVersion( Playlist *plst )
+{
+  DBGMSG( "playlistGetVersion (%p): %lld", plst, (long long)plst->version );
+  return plst->version;
+}
+
+
+/*=========================================================================*\
+       Get all mutations since a version as array of records
+         every record carries its version
+         returns NULL if the log does not cover the requested range or
+         contains records a client cannot replay (shuffling)
+         Caller should lock playlist
+\*=========================================================================*/
+json_t *playlistGetChanges( Playlist *plst, json_int_t version )
+{
+  json_t *jResult;
+  int     i, n;
+
+  DBGMSG( "playlistGetChanges (%p): since %lld (current %lld, %d logged)",
+          plst, (long long)version, (long long)plst->version, plst->changeLogCount );
+
+/*------------------------------------------------------------------------*\
+    Versions are consecutive, so check the range covered by the log
+\*------------------------------------------------------------------------*/
+  if( version>plst->version || version<plst->version-plst->changeLogCount )
+    return NULL;
+  n = (int)( plst->version-version );
+
+/*------------------------------------------------------------------------*\
+    Collect the latest n records in order
+\*------------------------------------------------------------------------*/
+  jResult = json_array();
+  for( i=n; i>0; i-- ) {
+    PlaylistChange *change;
+    const char     *op;
+    json_t         *jRecord;
+
+    change = &plst->changeLog[(plst->changeLogNext-i+plst->changeLogSize)%plst->changeLogSize];
+    op     = json_string_value( json_object_get(change->jRecord,"op") );
+    if( op && !strcmp(op,"shuffle") ) {
+      DBGMSG( "playlistGetChanges (%p): version %lld not replayable",
+              plst, (long long)change->version );
+      json_decref( jResult );
+      return NULL;
+    }
+
+    jRecord = json_copy( change->jRecord );
+    if( !jRecord || json_object_set_new(jRecord,"version",json_integer(change->version)) ||
+        json_array_append_new(jResult,jRecord) ) {
+      logerr( "playlistGetChanges: out of memory!" );
+      json_decref( jResult );
+      return NULL;
+    }
+  }
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return jResult;
+}
+
+
 /*=========================================================================*\
        Reset a playlist: remove all entries
          resetHeader - also reset name and ID
@@ -337,6 +594,13 @@ void playlistReset( Playlist *plst, bool resetHeader )
   DBGMSG( "playlistReset (%p)", plst );
   CHKLIST( plst );
 
+/*------------------------------------------------------------------------*\
+    Drop position indices
+\*------------------------------------------------------------------------*/
+  _playlistIndexFree( plst, PlaylistOriginal );
+  _playlistIndexFree( plst, PlaylistMapped );
+  _playlistIdHashFree( plst );
+
 /*------------------------------------------------------------------------*\
     Unreference all items
 \*------------------------------------------------------------------------*/
@@ -372,6 +636,10 @@ void playlistReset( Playlist *plst, bool resetHeader )
     Set timestamp, that's all
 \*------------------------------------------------------------------------*/
   plst->lastChange = srvtime();
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss sb}","op","reset","header",resetHeader) );
+  else
+    _playlistSnapshotInvalidate( plst, true );
 }
 
 
@@ -400,6 +668,9 @@ void playlistResetMapping( Playlist *plst, bool inverse )
       walk->prevMapped = walk->prevOriginal;
     }
 
+    // Rebuild position index
+    _playlistIndexRebuild( plst, PlaylistMapped );
+
     // Invalidate cursor index
     plst->_cursorPos = -1;
   }
@@ -419,12 +690,19 @@ void playlistResetMapping( Playlist *plst, bool inverse )
       walk->prevOriginal = walk->prevMapped;
     }
 
+    // Rebuild position index
+    _playlistIndexRebuild( plst, PlaylistOriginal );
+
   }
 
 /*------------------------------------------------------------------------*\
     Set timestamp
 \*------------------------------------------------------------------------*/
   plst->lastChange = srvtime();
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss sb}","op","resetMapping","inverse",inverse) );
+  else
+    _playlistSnapshotInvalidate( plst, true );
 
 /*------------------------------------------------------------------------*\
     That's all - check list consistency
@@ -443,6 +721,10 @@ void playlistSetId( Playlist *plst, const char *id )
 
   Sfree( plst->id );
   plst->id = strdup( id );
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss ss}","op","setId","id",id) );
+  else
+    _playlistSnapshotInvalidate( plst, false );
 }
 
 
@@ -456,6 +738,10 @@ void playlistSetName( Playlist *plst, const char *name )
 
   Sfree( plst->name );
   plst->name = strdup( name );
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss ss}","op","setName","name",name) );
+  else
+    _playlistSnapshotInvalidate( plst, false );
 }
 
 
@@ -521,12 +807,9 @@ int playlistGetCursorPos( Playlist *plst )
 \*------------------------------------------------------------------------*/
   if( plst->_cursorPos<0 ) {
     int pos = 0;
-    PlaylistItem *item = plst->firstItemMapped;
-    while( item && item!=plst->_cursorItem && plst->_cursorItem ) {
-      item = item->nextMapped;
-      pos++;
-    }
-    plst->_cursorPos = pos;
+    if( plst->_cursorItem )
+      pos = _playlistIndexRank( plst, PlaylistMapped, plst->_cursorItem );
+    plst->_cursorPos = pos<0 ? 0 : pos;
   }
 
 /*------------------------------------------------------------------------*\
@@ -581,6 +864,10 @@ PlaylistItem *playlistSetCursorPos( Playlist *plst, int pos )
   if( item ) {
     plst->_cursorItem = item;
     plst->_cursorPos  = pos;
+    if( RECORDING(plst) )
+      _playlistJournal( plst, json_pack("{ss}","op","cursor") );
+    else
+      _playlistSnapshotInvalidate( plst, false );
   }
 
 /*------------------------------------------------------------------------*\
@@ -620,6 +907,10 @@ PlaylistItem *playlistIncrCursorItem( Playlist *plst )
 \*------------------------------------------------------------------------*/
   if( plst->_cursorPos>=0 )
     plst->_cursorPos++;
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss}","op","cursor") );
+  else
+    _playlistSnapshotInvalidate( plst, false );
 
 /*------------------------------------------------------------------------*\
     Return current item
@@ -638,6 +929,7 @@ json_t *playlistGetJSON( Playlist *plst, PlaylistSortType order, int offset, int
 {
   json_t       *jResult  = json_array();
   json_t       *jMapping = NULL;
+  json_t       *jHeader;
   PlaylistItem *pItem;
   int           i;
 
@@ -673,17 +965,24 @@ json_t *playlistGetJSON( Playlist *plst, PlaylistSortType order, int offset, int
 \*------------------------------------------------------------------------*/
   pItem = playlistGetItem( plst, order, offset );
   for( i=count; pItem && i; i-- ) {
-    json_array_append( jResult, pItem->jItem );  // strong
+    json_array_append_new( jResult, _playlistItemCopyJSON(pItem) );
     pItem = playlistItemGetNext( pItem, order );
   }
 
 /*------------------------------------------------------------------------*\
     Collect mapping
+      For larger ranges tag all items with their mapped position in one pass
+      over the mapped list, for small ones querying the index is cheaper.
 \*------------------------------------------------------------------------*/
   if( jMapping ) {
+    bool tagged = count>plst->_numberOfItems/8;
+    if( tagged ) {
+      for( i=0,pItem=plst->firstItemMapped; pItem; i++,pItem=pItem->nextMapped )
+        pItem->posTag = i;
+    }
     pItem = playlistGetItem( plst, PlaylistOriginal, offset );
     for( i=count; pItem && i; i-- ) {
-      int pos = playlistGetItemPos( plst, PlaylistMapped, pItem );
+      int pos = tagged ? pItem->posTag : playlistGetItemPos( plst, PlaylistMapped, pItem );
       json_array_append_new( jMapping, json_integer(pos) );  // steal reference
       pItem = playlistItemGetNext( pItem, PlaylistOriginal );
     }
@@ -692,27 +991,102 @@ json_t *playlistGetJSON( Playlist *plst, PlaylistSortType order, int offset, int
 /*------------------------------------------------------------------------*\
     Build header
 \*------------------------------------------------------------------------*/
-  jResult = json_pack( "{ss sf si si si ss so}",
-                         "jsonrpc",       "2.0",
-                         "lastChanged",   plst->lastChange,
-                         "count",         json_array_size(jResult),
-                         "countAll",      playlistGetLength(plst),
-                         "offset",        offset,
-                         "order",         playlistSortTypeToStr(order),
-                         "items",         jResult );
-  // Mapping, Name and ID are optional
+  jHeader = _playlistGetJSONHeader( plst->id, plst->name, plst->lastChange, plst->version,
+                                    plst->_numberOfItems, order, offset, json_array_size(jResult) );
+  json_object_set_new( jHeader, "items", jResult );
+  // Mapping is optional
   if( jMapping )
-    json_object_set_new( jResult, "mapping", jMapping );
-  if( plst->id )
-    json_object_set_new( jResult, "playlistId", json_string(plst->id) );
-  if( plst->name )
-    json_object_set_new( jResult, "playlistName", json_string(plst->name) );
+    json_object_set_new( jHeader, "mapping", jMapping );
 
 /*------------------------------------------------------------------------*\
     That's all
 \*------------------------------------------------------------------------*/
-  // DBGMSG( "playlistGetJSON(%p): result %p", plst, jResult );
-  return jResult;                       
+  // DBGMSG( "playlistGetJSON(%p): result %p", plst, jHeader );
+  return jHeader;
+}
+
+
+/*=========================================================================*\
+       Get playlist serialized in ickstream JSON format
+         same as playlistGetJSON, but assembled from the cached serialized
+         items without building a JSON tree
+         Caller should lock playlist
+         return allocated string or NULL on error
+\*=========================================================================*/
+char *playlistGetJSONString( Playlist *plst, PlaylistSortType order, int offset, int count )
+{
+  PlaylistSnapshot *snapshot;
+  char             *result;
+
+  snapshot = playlistGetSnapshot( plst );
+  if( !snapshot )
+    return NULL;
+  result = playlistSnapshotGetJSONString( snapshot, order, offset, count );
+  playlistSnapshotRelease( snapshot );
+
+  return result;
+}
+
+
+/*=========================================================================*\
+       Build header of serialized playlist (without items and mapping)
+\*=========================================================================*/
+static json_t *_playlistGetJSONHeader( const char *id, const char *name, double lastChange, json_int_t version,
+                                       int countAll, PlaylistSortType order, int offset, int count )
+{
+  json_t *jHeader;
+
+  jHeader = json_pack( "{ss sf sI si si si ss}",
+                         "jsonrpc",       "2.0",
+                         "lastChanged",   lastChange,
+                         "version",       version,
+                         "count",         count,
+                         "countAll",      countAll,
+                         "offset",        offset,
+                         "order",         playlistSortTypeToStr(order) );
+  if( !jHeader ) {
+    logerr( "_playlistGetJSONHeader: out of memory!" );
+    return NULL;
+  }
+
+  // Name and ID are optional
+  if( id )
+    json_object_set_new( jHeader, "playlistId", json_string(id) );
+  if( name )
+    json_object_set_new( jHeader, "playlistName", json_string(name) );
+
+  return jHeader;
+}
+
+
+/*=========================================================================*\
+       Append to a string buffer, len<0 means zero terminated string
+         the buffer is freed on error
+         return 0 on success, -1 on error
+\*=========================================================================*/
+static int _playlistBufferAppend( PlaylistBuffer *buffer, const char *str, size_t len )
+{
+  if( len==(size_t)-1 )
+    len = strlen( str );
+
+  // Grow buffer exponentially
+  if( buffer->len+len+1>buffer->size ) {
+    size_t  size = MAX( 2*buffer->size, buffer->len+len+1 );
+    char   *ptr  = realloc( buffer->str, size );
+    if( !ptr ) {
+      logerr( "_playlistBufferAppend: out of memory!" );
+      Sfree( buffer->str );
+      return -1;
+    }
+    buffer->str  = ptr;
+    buffer->size = size;
+  }
+
+  // Append including terminating zero
+  memcpy( buffer->str+buffer->len, str, len );
+  buffer->len += len;
+  buffer->str[buffer->len] = 0;
+  return 0;
 }
 
 
@@ -726,9 +1100,6 @@ PlaylistItem *playlistGetItem( Playlist *plst, PlaylistSortType order, int pos )
 {
   PlaylistItem *item = NULL;
 
-#ifdef ICK_DEBUG
-  int posbuf = pos;
-#endif
   //CHKLIST( plst );
 
 /*------------------------------------------------------------------------*\
@@ -736,10 +1107,8 @@ PlaylistItem *playlistGetItem( Playlist *plst, PlaylistSortType order, int pos )
 \*------------------------------------------------------------------------*/
   switch( order ) {
     case PlaylistOriginal:
-      item = plst->firstItemOriginal;
-      break;
     case PlaylistMapped:
-      item = plst->firstItemMapped;
+      item = _playlistIndexGet( plst, order, pos );
       break;
     default:
       logerr( "playlistGetItem: unsupported sort mode %s, %d.",
@@ -747,23 +1116,11 @@ PlaylistItem *playlistGetItem( Playlist *plst, PlaylistSortType order, int pos )
       break;
   }
 
-/*------------------------------------------------------------------------*\
-    Check for lower bound
-\*------------------------------------------------------------------------*/
-  if( pos<0 )
-    item = NULL;
-
-/*------------------------------------------------------------------------*\
-    Loop over list
-\*------------------------------------------------------------------------*/
-  while( pos-- && item )
-   item = playlistItemGetNext( item, order );
-
 /*------------------------------------------------------------------------*\
     Return
 \*------------------------------------------------------------------------*/
   DBGMSG( "playlistGetItem (%p): order=%s pos=%d -> %p (%s)",
-          plst, playlistSortTypeToStr(order), posbuf, item, GETITEMTXT(item) );
+          plst, playlistSortTypeToStr(order), pos, item, GETITEMTXT(item) );
   return item;
 }
 
@@ -775,8 +1132,7 @@ PlaylistItem *playlistGetItem( Playlist *plst, PlaylistSortType order, int pos )
 \*=========================================================================*/
 int playlistGetItemPos( Playlist *plst, PlaylistSortType order, PlaylistItem *item )
 {
-  int           pos  = 0;
-  PlaylistItem *walk = NULL;
+  int pos = -1;
   CHKLIST( plst );
 
 /*------------------------------------------------------------------------*\
@@ -784,10 +1140,8 @@ int playlistGetItemPos( Playlist *plst, PlaylistSortType order, PlaylistItem *it
 \*------------------------------------------------------------------------*/
   switch( order ) {
     case PlaylistOriginal:
-      walk = plst->firstItemOriginal;
-      break;
     case PlaylistMapped:
-      walk = plst->firstItemMapped;
+      pos = _playlistIndexRank( plst, order, item );
       break;
     default:
       logerr( "playlistGetItem: unsupported sort mode %s, %d.",
@@ -795,16 +1149,6 @@ int playlistGetItemPos( Playlist *plst, PlaylistSortType order, PlaylistItem *it
       break;
   }
 
-/*------------------------------------------------------------------------*\
-    Loop over list and search for item
-\*------------------------------------------------------------------------*/
-  while( walk && walk!=item ) {
-    pos++;
-    walk = playlistItemGetNext( walk, order );
-  }
-  if( !walk )
-    pos = -1;
-
 /*------------------------------------------------------------------------*\
     Return
 \*------------------------------------------------------------------------*/
@@ -821,15 +1165,28 @@ int playlistGetItemPos( Playlist *plst, PlaylistSortType order, PlaylistItem *it
 \*=========================================================================*/
 PlaylistItem *playlistGetItemById( Playlist *plst, const char *id )
 {
-  PlaylistItem *item;
+  PlaylistItem *item = NULL;
+  PlaylistItem *walk;
+  int           pos  = -1;
+  unsigned int  hash;
   CHKLIST( plst );
 
  /*------------------------------------------------------------------------*\
-     Loop over list and check Id
+     Loop over hash chain and use the match with lowest original position
  \*------------------------------------------------------------------------*/
-   for( item=plst->firstItemOriginal; item; item=item->nextOriginal )
-     if( !strcmp(item->id,id) )
-       break;
+   if( plst->idTable ) {
+     hash = _playlistIdHashValue( id );
+     for( walk=plst->idTable[hash&(plst->idTableSize-1)]; walk; walk=walk->nextSameHash ) {
+       int wPos;
+       if( walk->idHash!=hash || strcmp(walk->id,id) )
+         continue;
+       wPos = _playlistIndexRank( plst, PlaylistOriginal, walk );
+       if( !item || wPos<pos ) {
+         item = walk;
+         pos  = wPos;
+       }
+     }
+   }
 
  /*------------------------------------------------------------------------*\
      Return
@@ -840,6 +1197,37 @@ PlaylistItem *playlistGetItemById( Playlist *plst, const char *id )
 }
 
 
+/*=========================================================================*\
+       Notify playlist about modified meta data of an item
+         updates the id index (the id might have changed) and the journal
+\*=========================================================================*/
+void playlistItemChanged( Playlist *plst, PlaylistItem *pItem )
+{
+  DBGMSG( "playlistItemChanged (%p): item=%p id=\"%s\"",
+          plst, pItem, pItem->id );
+
+/*------------------------------------------------------------------------*\
+    Rehash if id has changed
+\*------------------------------------------------------------------------*/
+  if( pItem->idHash!=_playlistIdHashValue(pItem->id) ) {
+    _playlistIdHashRemove( plst, pItem );
+    _playlistIdHashInsert( plst, pItem );
+  }
+
+/*------------------------------------------------------------------------*\
+    Journal new meta data by position in original list
+\*------------------------------------------------------------------------*/
+  plst->lastChange = srvtime();
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss si so}","op","setItem",
+                                      "pos",_playlistIndexRank(plst,PlaylistOriginal,pItem),
+                                      "item",_playlistItemCopyJSON(pItem)) );
+  else
+    _playlistSnapshotInvalidate( plst, false );
+  CHKLIST( plst );
+}
+
+
 /*=========================================================================*\
        Add items to playlist or replace playlist
          oPos       - the position in the original list to add the items
@@ -919,6 +1307,11 @@ int playlistAddItems( Playlist *plst, int oPos, int mPos, json_t *jItems, bool r
 \*------------------------------------------------------------------------*/
   plst->_cursorPos = -1;
   plst->lastChange = srvtime();
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss si si sb sO}","op","add",
+                                      "oPos",oPos,"mPos",mPos,"reset",resetFlag,"items",jItems) );
+  else
+    _playlistSnapshotInvalidate( plst, true );
 
 /*------------------------------------------------------------------------*\
     That's all
@@ -996,7 +1389,7 @@ int playlistDeleteItems( Playlist *plst, json_t *jItems )
     Remove all items with this ID
 \*------------------------------------------------------------------------*/
     else for(;;) {
-      PlaylistItem *pItem = playlistGetItemById( plst, id );
+      PlaylistItem *pItem = _playlistIdHashFind( plst, id );
       if( !pItem )
         break;
 
@@ -1023,6 +1416,10 @@ int playlistDeleteItems( Playlist *plst, json_t *jItems )
     Set timestamp, that's it
 \*------------------------------------------------------------------------*/
   plst->lastChange = srvtime();
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss sO}","op","delete","items",jItems) );
+  else
+    _playlistSnapshotInvalidate( plst, true );
   CHKLIST( plst );
   return rc;
 }
@@ -1172,6 +1569,11 @@ int playlistMoveItems( Playlist *plst, PlaylistSortType order, int pos, json_t *
 \*------------------------------------------------------------------------*/
   plst->lastChange = srvtime();
   Sfree( pItems );
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss ss si sO}","op","move",
+                                      "order",playlistSortTypeToStr(order),"pos",pos,"items",jItems) );
+  else
+    _playlistSnapshotInvalidate( plst, true );
   CHKLIST( plst );
   return rc;
 }
@@ -1186,12 +1588,28 @@ int playlistMoveItems( Playlist *plst, PlaylistSortType order, int pos, json_t *
 \*=========================================================================*/
 PlaylistItem *playlistShuffle( Playlist *plst, int startPos, int endPos, bool moveCursorToStart )
 {
-  PlaylistItem *item1, *item2;
-  int           pos = startPos;
+  unsigned int seed = (unsigned int)rndInteger( 1, 0x7fffffffL );
+  return playlistShuffleWithSeed( plst, startPos, endPos, moveCursorToStart, seed );
+}
 
-  DBGMSG( "playlistShuffle (%p): %d-%d/%d cursorToStart:%s",
+
+/*=========================================================================*\
+       Shuffle playlist (mapping) with a given seed
+         Same as playlistShuffle, but the result is determined by the seed
+         (used for replaying the journal)
+\*=========================================================================*/
+PlaylistItem *playlistShuffleWithSeed( Playlist *plst, int startPos, int endPos, bool moveCursorToStart, unsigned int seed )
+{
+  PlaylistItem  *item, *prev, *next;
+  PlaylistItem **items;
+  PlaylistNode **nodes;
+  int            pos = startPos;
+  int            count, i;
+  unsigned int   state;
+
+  DBGMSG( "playlistShuffle (%p): %d-%d/%d cursorToStart:%s seed:%u",
            plst, startPos, endPos, plst->_numberOfItems,
-           moveCursorToStart?"Yes":"No"  );
+           moveCursorToStart?"Yes":"No", seed );
   CHKLIST( plst );
 
 /*------------------------------------------------------------------------*\
@@ -1212,8 +1630,8 @@ PlaylistItem *playlistShuffle( Playlist *plst, int startPos, int endPos, bool mo
 /*------------------------------------------------------------------------*\
     Get first element
 \*------------------------------------------------------------------------*/
-  item1 = playlistGetItem( plst, PlaylistMapped, startPos );
-  if( !item1 ) {
+  item = playlistGetItem( plst, PlaylistMapped, startPos );
+  if( !item ) {
     logerr( "playlistShuffle: invalid start position %d", startPos );
     return NULL;
   }
@@ -1222,33 +1640,96 @@ PlaylistItem *playlistShuffle( Playlist *plst, int startPos, int endPos, bool mo
     Swap with cursor if requested and increment to next element
 \*------------------------------------------------------------------------*/
   if( moveCursorToStart ) {
-    playlistTranspose( plst, item1, plst->_cursorItem );
-    item1 = plst->_cursorItem->nextMapped;
+    _playlistTranspose( plst, item, plst->_cursorItem );
+    item = plst->_cursorItem->nextMapped;
     pos++;
   }
 
 /*------------------------------------------------------------------------*\
-    Shuffle: Select the first item from remaining set and step to next one
+    Nothing left to shuffle?
 \*------------------------------------------------------------------------*/
-  while( pos<endPos ) {
-    int rnd = (int)rndInteger( pos, endPos );
-    item2   = playlistGetItem( plst, PlaylistMapped, rnd );
-    if( !item1 || !item2 ) {
-      logerr( "playlistShuffle: corrupt linked list @%d<->%d/%d",
-               pos, rnd, endPos );
-      break;
-    }
-    DBGMSG( "playlistShuffle (%p): swap %d<->%d/%d ", plst, pos, rnd, endPos  );
+  count = endPos - pos + 1;
+  if( count<2 || !item )
+    goto done;
 
-    // This invalidates the cursor position and sets the timestamp
-    playlistTranspose( plst, item1, item2 );
-    item1 = item2->nextMapped;
-    pos++;
+/*------------------------------------------------------------------------*\
+    Collect items of range and their index nodes
+\*------------------------------------------------------------------------*/
+  items = calloc( count, sizeof(PlaylistItem *) );
+  nodes = calloc( count, sizeof(PlaylistNode *) );
+  if( !items || !nodes ) {
+    logerr( "playlistShuffle: out of memory!" );
+    Sfree( items );
+    Sfree( nodes );
+    return NULL;
+  }
+  prev = item->prevMapped;
+  for( i=0; i<count && item; i++,item=item->nextMapped ) {
+    items[i] = item;
+    nodes[i] = item->indexNode[PlaylistMapped];
+  }
+  next = item;
+  if( i<count ) {
+    logerr( "playlistShuffle: corrupt linked list @%d/%d", pos+i, endPos );
+    Sfree( items );
+    Sfree( nodes );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Shuffle (Fisher-Yates): select the first item from remaining set
+\*------------------------------------------------------------------------*/
+  state = seed ? seed : 1;
+  for( i=0; i<count-1; i++ ) {
+    int rnd = i + (int)(_playlistShuffleRandom(&state)%(unsigned int)(count-i));
+    item       = items[i];
+    items[i]   = items[rnd];
+    items[rnd] = item;
   }
 
 /*------------------------------------------------------------------------*\
-    Return item under cursor
+    Relink range in mapped list
+\*------------------------------------------------------------------------*/
+  for( i=0; i<count; i++ ) {
+    items[i]->prevMapped = i ? items[i-1] : prev;
+    items[i]->nextMapped = i<count-1 ? items[i+1] : next;
+  }
+  if( prev )
+    prev->nextMapped = items[0];
+  else
+    plst->firstItemMapped = items[0];
+  if( next )
+    next->prevMapped = items[count-1];
+  else
+    plst->lastItemMapped = items[count-1];
+
+/*------------------------------------------------------------------------*\
+    Position index: the nodes keep their positions, just exchange items
+\*------------------------------------------------------------------------*/
+  for( i=0; i<count; i++ ) {
+    items[i]->indexNode[PlaylistMapped] = nodes[i];
+    if( nodes[i] )
+      nodes[i]->item = items[i];
+  }
+  Sfree( items );
+  Sfree( nodes );
+
+/*------------------------------------------------------------------------*\
+    Invalidate cursor index and set timestamp
+\*------------------------------------------------------------------------*/
+  plst->_cursorPos = -1;
+  plst->lastChange = srvtime();
+
+/*------------------------------------------------------------------------*\
+    Journal and return item under cursor
 \*------------------------------------------------------------------------*/
+done:
+  if( RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss si si sb sI}","op","shuffle",
+                                      "start",startPos,"end",endPos,
+                                      "cursorToStart",moveCursorToStart,"seed",(json_int_t)seed) );
+  else
+    _playlistSnapshotInvalidate( plst, true );
   CHKLIST( plst );
   return plst->_cursorItem;
 }
@@ -1259,10 +1740,40 @@ PlaylistItem *playlistShuffle( Playlist *plst, int startPos, int endPos, bool mo
           returns true, if items are different, false else
 \*=========================================================================*/
 bool playlistTranspose( Playlist *plst, PlaylistItem *pItem1, PlaylistItem *pItem2 )
+{
+  int  pos1 = -1, pos2 = -1;
+  bool rc;
+
+/*------------------------------------------------------------------------*\
+    Get positions for journal before swapping
+\*------------------------------------------------------------------------*/
+  if( RECORDING(plst) ) {
+    pos1 = _playlistIndexRank( plst, PlaylistMapped, pItem1 );
+    pos2 = _playlistIndexRank( plst, PlaylistMapped, pItem2 );
+  }
+
+/*------------------------------------------------------------------------*\
+    Swap and journal
+\*------------------------------------------------------------------------*/
+  rc = _playlistTranspose( plst, pItem1, pItem2 );
+  if( rc && RECORDING(plst) )
+    _playlistJournal( plst, json_pack("{ss si si}","op","transpose","pos1",pos1,"pos2",pos2) );
+  else if( rc )
+    _playlistSnapshotInvalidate( plst, true );
+  return rc;
+}
+
+
+/*=========================================================================*\
+       Transpose two items in the mapped list (without journaling)
+          returns true, if items are different, false else
+\*=========================================================================*/
+static bool _playlistTranspose( Playlist *plst, PlaylistItem *pItem1, PlaylistItem *pItem2 )
 {
   PlaylistItem *item;
+  PlaylistNode *node;
 
-  DBGMSG( "playlistTranspose (%p): %p <-> %p", plst, pItem1, pItem2 );
+  DBGMSG( "_playlistTranspose (%p): %p <-> %p", plst, pItem1, pItem2 );
   CHKLIST( plst );
 
 /*------------------------------------------------------------------------*\
@@ -1305,6 +1816,17 @@ bool playlistTranspose( Playlist *plst, PlaylistItem *pItem1, PlaylistItem *pIte
   else if( !pItem1->nextMapped )
     plst->lastItemMapped = pItem1;
 
+/*------------------------------------------------------------------------*\
+    Swap nodes in position index
+\*------------------------------------------------------------------------*/
+  node = pItem1->indexNode[PlaylistMapped];
+  pItem1->indexNode[PlaylistMapped] = pItem2->indexNode[PlaylistMapped];
+  pItem2->indexNode[PlaylistMapped] = node;
+  if( pItem1->indexNode[PlaylistMapped] )
+    pItem1->indexNode[PlaylistMapped]->item = pItem1;
+  if( pItem2->indexNode[PlaylistMapped] )
+    pItem2->indexNode[PlaylistMapped]->item = pItem2;
+
 /*------------------------------------------------------------------------*\
     Invalidate cursor index if cursor is part of the exchange
 \*------------------------------------------------------------------------*/
@@ -1406,6 +1928,9 @@ static void _playlistAddItemBefore( Playlist *plst, PlaylistItem *anchorItem,
       if( !plst->lastItemOriginal || !anchorItem )
         plst->lastItemOriginal = newItem;
 
+      // Update position index and id table
+      _playlistIndexInsert( plst, order, anchorItem, newItem );
+      _playlistIdHashInsert( plst, newItem );
       break;
 
 /*------------------------------------------------------------------------*\
@@ -1430,6 +1955,9 @@ static void _playlistAddItemBefore( Playlist *plst, PlaylistItem *anchorItem,
         plst->firstItemMapped = newItem;
       if( !plst->lastItemMapped || !anchorItem )
         plst->lastItemMapped = newItem;
+
+      // Update position index
+      _playlistIndexInsert( plst, order, anchorItem, newItem );
       break;
   }
 
@@ -1542,6 +2070,8 @@ static void _playlistUnlinkItem( Playlist *plst, PlaylistItem *pItem, PlaylistSo
       plst->firstItemOriginal = pItem->nextOriginal;
     if( pItem==plst->lastItemOriginal )
       plst->lastItemOriginal = pItem->prevOriginal;
+    _playlistIndexRemove( plst, PlaylistOriginal, pItem );
+    _playlistIdHashRemove( plst, pItem );
   }
 
 /*------------------------------------------------------------------------*\
@@ -1556,61 +2086,1157 @@ static void _playlistUnlinkItem( Playlist *plst, PlaylistItem *pItem, PlaylistSo
       plst->firstItemMapped = pItem->nextMapped;
     if( pItem==plst->lastItemMapped )
       plst->lastItemMapped = pItem->prevMapped;
+    _playlistIndexRemove( plst, PlaylistMapped, pItem );
   }
 }
 
 
-/***************************************************************************\
- * Functions operating on playlist items
-\***************************************************************************/
-
-
 /*=========================================================================*\
-       Create (allocate and init) an item from ickstream JSON object
-          reference counter is set to one
-          return NULL on error
+       Build mapped list from a JSON mapping array
+         element i of the array is the mapped position of original item i
+         (as created by playlistGetJSON for hybrid order)
+         the mapped list needs to be empty
+       returns 0 on success, -1 on error (mapped list is unchanged)
 \*=========================================================================*/
-PlaylistItem *playlistItemFromJSON( json_t *jItem )
+static int _playlistApplyMapping( Playlist *plst, json_t *jMapping )
 {
-  PlaylistItem        *item;
+  PlaylistItem **mapped;
+  PlaylistItem  *item;
+  int            i;
 
 /*------------------------------------------------------------------------*\
-    Allocate header
+    Length must match
 \*------------------------------------------------------------------------*/
-  item = calloc( 1, sizeof(PlaylistItem) );
-  if( !item ) {
-    logerr( "playlistItemFromJSON: out of memeory!" );
-    return NULL;
+  if( json_array_size(jMapping)!=plst->_numberOfItems ) {
+    logerr( "Playlist: mapping list length differs from playlist items" );
+    return -1;
   }
+  if( !plst->_numberOfItems )
+    return 0;
 
 /*------------------------------------------------------------------------*\
-    Init mutex and reference counter
-\*------------------------------------------------------------------------*/
-  ickMutexInit( &item->mutex );
-  item->refCounter = 1;
-
-/*------------------------------------------------------------------------*\
-    Keep instance of JSON object
-\*------------------------------------------------------------------------*/
-  item->jItem = json_incref( jItem );
-  // DBGMSG( "playlistItemFromJSON: JSON refCnt=%d", jItem->refcount );
-
-/*------------------------------------------------------------------------*\
-    Extract header info
+    Collect items by mapped position, mapping needs to be a permutation
 \*------------------------------------------------------------------------*/
-  if( _playlistItemFillHeader(item) ) {
-    json_decref( jItem );
-    pthread_mutex_destroy( &item->mutex );
-    Sfree( item );
-    return NULL;
+  mapped = calloc( plst->_numberOfItems, sizeof(PlaylistItem *) );
+  if( !mapped ) {
+    logerr( "_playlistApplyMapping: out of memory!" );
+    return -1;
+  }
+  for( i=0,item=plst->firstItemOriginal; item; i++,item=item->nextOriginal ) {
+    json_t *jPos = json_array_get( jMapping, i );
+    int     pos;
+    if( !json_is_integer(jPos) ) {
+      logerr( "Playlist: mapping item #%d is not an integer", i+1 );
+      Sfree( mapped );
+      return -1;
+    }
+    pos = json_integer_value( jPos );
+    if( pos<0 || pos>=plst->_numberOfItems || mapped[pos] ) {
+      logerr( "Playlist: mapping item #%d has invalid or duplicate position %d",
+              i+1, pos );
+      Sfree( mapped );
+      return -1;
+    }
+    mapped[pos] = item;
   }
 
 /*------------------------------------------------------------------------*\
-    That's all
+    Link mapped list
 \*------------------------------------------------------------------------*/
-  DBGMSG( "playlistItemFromJSON: %p \"%s\" (id=%s)",
-                     item, item->text, item->id );
-  return item;
+  for( i=0; i<plst->_numberOfItems; i++ )
+    _playlistAddItemBefore( plst, NULL, PlaylistMapped, mapped[i] );
+
+  Sfree( mapped );
+  return 0;
+}
+
+
+/*=========================================================================*\
+       Record a mutation: increment version, withdraw snapshot, add record
+       to change log and pass it to the journal callback
+         adds the resulting cursor position (-1 if not set)
+         the record is consumed (steals reference)
+\*=========================================================================*/
+static void _playlistJournal( Playlist *plst, json_t *jRecord )
+{
+  int         pos = -1;
+  const char *op;
+
+  if( !jRecord ) {
+    logerr( "_playlistJournal (%p): could not create record.", plst );
+    return;
+  }
+
+  if( plst->_cursorItem )
+    pos = _playlistIndexRank( plst, PlaylistMapped, plst->_cursorItem );
+  json_object_set_new( jRecord, "cursor", json_integer(pos) );
+  plst->version++;
+
+  op = json_string_value( json_object_get(jRecord,"op") );
+  _playlistSnapshotInvalidate( plst, !op || (strcmp(op,"cursor") && strcmp(op,"setId") &&
+                                            strcmp(op,"setName") && strcmp(op,"setItem")) );
+
+  if( plst->changeLogSize ) {
+    PlaylistChange *change = &plst->changeLog[plst->changeLogNext];
+    if( change->jRecord )
+      json_decref( change->jRecord );
+    change->version = plst->version;
+    change->jRecord = jsonArenaPromote( jRecord );   // might refer to request
+    plst->changeLogNext = (plst->changeLogNext+1)%plst->changeLogSize;
+    if( plst->changeLogCount<plst->changeLogSize )
+      plst->changeLogCount++;
+  }
+
+  if( plst->journalCallback )
+    plst->journalCallback( plst, jRecord, plst->journalUserData );
+  json_decref( jRecord );
+}
+
+
+/*=========================================================================*\
+       Pseudo random generator for shuffling (xorshift32)
+         state must not be zero
+\*=========================================================================*/
+static unsigned int _playlistShuffleRandom( unsigned int *state )
+{
+  *state ^= *state<<13;
+  *state ^= *state>>17;
+  *state ^= *state<<5;
+  return *state;
+}
+
+
+/***************************************************************************\
+ * Functions operating on snapshots
+ *   A snapshot is an immutable, reference counted view of a playlist that
+ *   can be used without holding the playlist lock. Once a reader asked for
+ *   a snapshot, the playlist keeps the current one published (RCU style):
+ *   mutations withdraw it and the writer publishes the new version when it
+ *   releases the lock, so several mutations in one lock cycle cost one
+ *   rebuild and readers only take a reference. Mutations of header data or
+ *   the cursor only replace the small snapshot header and share the item
+ *   lists with the previous version.
+\***************************************************************************/
+
+/*=========================================================================*\
+       Get a snapshot of a playlist
+         Caller should lock playlist, the snapshot can be used without lock
+         returns a new reference or NULL on error
+\*=========================================================================*/
+PlaylistSnapshot *playlistGetSnapshot( Playlist *plst )
+{
+  DBGMSG( "playlistGetSnapshot (%p): version %lld", plst, (long long)plst->version );
+
+/*------------------------------------------------------------------------*\
+    Build the first snapshot or one within a writer's lock cycle,
+    from now on writers keep it up to date
+\*------------------------------------------------------------------------*/
+  plst->snapshotPublish = true;
+  if( !plst->snapshot && _playlistSnapshotPublish(plst) )
+    return NULL;
+
+/*------------------------------------------------------------------------*\
+    Return new reference to published snapshot
+\*------------------------------------------------------------------------*/
+  __sync_add_and_fetch( &plst->snapshot->refCounter, 1 );
+  return plst->snapshot;
+}
+
+
+/*=========================================================================*\
+       Build and publish a snapshot of the current version
+         Caller should lock playlist
+         returns 0 on success, -1 on error
+\*=========================================================================*/
+static int _playlistSnapshotPublish( Playlist *plst )
+{
+  PlaylistSnapshot *snapshot;
+
+  DBGMSG( "_playlistSnapshotPublish (%p): version %lld", plst, (long long)plst->version );
+
+/*------------------------------------------------------------------------*\
+    Create header
+\*------------------------------------------------------------------------*/
+  snapshot = calloc( 1, sizeof(PlaylistSnapshot) );
+  if( !snapshot ) {
+    logerr( "_playlistSnapshotPublish: out of memory!" );
+    return -1;
+  }
+  snapshot->refCounter = 1;
+  snapshot->version    = plst->version;
+  snapshot->lastChange = plst->lastChange;
+  snapshot->cursorPos  = playlistGetCursorPos( plst );
+  if( (plst->id && !(snapshot->id=strdup(plst->id))) ||
+      (plst->name && !(snapshot->name=strdup(plst->name))) ) {
+    logerr( "_playlistSnapshotPublish: out of memory!" );
+    playlistSnapshotRelease( snapshot );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Reuse item lists if structure is unchanged
+\*------------------------------------------------------------------------*/
+  if( !plst->snapshotBody )
+    plst->snapshotBody = _playlistSnapshotBodyNew( plst );
+  if( !plst->snapshotBody ) {
+    playlistSnapshotRelease( snapshot );
+    return -1;
+  }
+  snapshot->body = plst->snapshotBody;
+  __sync_add_and_fetch( &snapshot->body->refCounter, 1 );
+
+/*------------------------------------------------------------------------*\
+    Publish (the playlist owns the initial reference)
+\*------------------------------------------------------------------------*/
+  plst->snapshot = snapshot;
+  return 0;
+}
+
+
+/*=========================================================================*\
+       Release a snapshot (no lock needed)
+\*=========================================================================*/
+void playlistSnapshotRelease( PlaylistSnapshot *snapshot )
+{
+  if( __sync_sub_and_fetch(&snapshot->refCounter,1)>0 )
+    return;
+
+  DBGMSG( "playlistSnapshotRelease (%p): version %lld freed",
+          snapshot, (long long)snapshot->version );
+  if( snapshot->body )
+    _playlistSnapshotBodyRelease( snapshot->body );
+  Sfree( snapshot->id );
+  Sfree( snapshot->name );
+  Sfree( snapshot );
+}
+
+
+/*=========================================================================*\
+       Get header data of snapshot
+\*=========================================================================*/
+json_int_t playlistSnapshotGetVersion( PlaylistSnapshot *snapshot )
+{
+  return snapshot->version;
+}
+
+double playlistSnapshotGetLastChange( PlaylistSnapshot *snapshot )
+{
+  return snapshot->lastChange;
+}
+
+const char *playlistSnapshotGetId( PlaylistSnapshot *snapshot )
+{
+  return snapshot->id;
+}
+
+const char *playlistSnapshotGetName( PlaylistSnapshot *snapshot )
+{
+  return snapshot->name;
+}
+
+int playlistSnapshotGetLength( PlaylistSnapshot *snapshot )
+{
+  return snapshot->body->numberOfItems;
+}
+
+int playlistSnapshotGetCursorPos( PlaylistSnapshot *snapshot )
+{
+  return snapshot->cursorPos;
+}
+
+
+/*=========================================================================*\
+       Get item at a given position of a snapshot
+         the item is referenced by the snapshot as long as this exists
+         return NULL if position is out of range
+\*=========================================================================*/
+PlaylistItem *playlistSnapshotGetItem( PlaylistSnapshot *snapshot, PlaylistSortType order, int pos )
+{
+  PlaylistSnapshotBody *body = snapshot->body;
+
+  if( pos<0 || pos>=body->numberOfItems )
+    return NULL;
+
+  switch( order ) {
+    case PlaylistOriginal:
+      return body->original[pos];
+    case PlaylistMapped:
+      return body->mapped[pos];
+    default:
+      break;
+  }
+
+  logerr( "playlistSnapshotGetItem: unsupported sort mode %s, %d.",
+           playlistSortTypeToStr(order), order );
+  return NULL;
+}
+
+
+/*=========================================================================*\
+       Get item under the cursor of a snapshot
+\*=========================================================================*/
+PlaylistItem *playlistSnapshotGetCursorItem( PlaylistSnapshot *snapshot )
+{
+  return playlistSnapshotGetItem( snapshot, PlaylistMapped, snapshot->cursorPos );
+}
+
+
+/*=========================================================================*\
+       Get snapshot serialized in ickstream JSON format
+         same as playlistGetJSON, but assembled from the cached serialized
+         items without building a JSON tree, no lock needed
+         return allocated string or NULL on error
+\*=========================================================================*/
+char *playlistSnapshotGetJSONString( PlaylistSnapshot *snapshot, PlaylistSortType order, int offset, int count )
+{
+  PlaylistSnapshotBody *body = snapshot->body;
+  PlaylistBuffer        buffer;
+  json_t               *jHeader;
+  PlaylistItem        **items;
+  bool                  hybrid = false;
+  char                  numStr[16];
+  int                   i, n;
+
+  DBGMSG( "playlistSnapshotGetJSONString (%p): order=%s offset=%d count=%d",
+           snapshot, playlistSortTypeToStr(order), offset, count );
+
+/*------------------------------------------------------------------------*\
+    Is the requested sort mode supported?
+\*------------------------------------------------------------------------*/
+  if( order!=PlaylistOriginal && order!=PlaylistMapped && order!=PlaylistHybrid ) {
+    logerr( "playlistSnapshotGetJSONString: unsupported sort mode %s, %d.",
+             playlistSortTypeToStr(order), order );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    A zero or negative count argument means all items
+\*------------------------------------------------------------------------*/
+  if( count<=0 )
+    count = body->numberOfItems;
+
+/*------------------------------------------------------------------------*\
+    Hybrid order means original list with mapping
+\*------------------------------------------------------------------------*/
+  if( order==PlaylistHybrid ) {
+    order  = PlaylistOriginal;
+    hybrid = true;
+  }
+  items = order==PlaylistOriginal ? body->original : body->mapped;
+
+/*------------------------------------------------------------------------*\
+    Count items in range
+\*------------------------------------------------------------------------*/
+  n = 0;
+  if( offset>=0 && offset<body->numberOfItems )
+    n = MIN( count, body->numberOfItems-offset );
+
+/*------------------------------------------------------------------------*\
+    Start with serialized header, remove closing brace
+\*------------------------------------------------------------------------*/
+  jHeader = _playlistGetJSONHeader( snapshot->id, snapshot->name, snapshot->lastChange, snapshot->version,
+                                    body->numberOfItems, order, offset, n );
+  if( !jHeader )
+    return NULL;
+  buffer.str = json_dumps( jHeader, PLAYLIST_ITEM_DUMPFLAGS );
+  json_decref( jHeader );
+  if( !buffer.str ) {
+    logerr( "playlistSnapshotGetJSONString: could not serialize header." );
+    return NULL;
+  }
+  buffer.len  = strlen( buffer.str ) - 1;
+  buffer.size = buffer.len + 1;
+
+/*------------------------------------------------------------------------*\
+    Append serialized items
+\*------------------------------------------------------------------------*/
+  if( _playlistBufferAppend(&buffer,",\"items\":[",-1) )
+    return NULL;
+  for( i=0; i<n; i++ ) {
+    PlaylistItem *pItem = items[offset+i];
+    const char   *str;
+    int           rc;
+
+    pthread_mutex_lock( _playlistItemStripe(pItem) );
+    str = _playlistItemSerialize( pItem );
+    rc  = (i && _playlistBufferAppend(&buffer,",",1)) ||
+          !str || _playlistBufferAppend(&buffer,str,-1);
+    pthread_mutex_unlock( _playlistItemStripe(pItem) );
+    if( rc ) {
+      logerr( "playlistSnapshotGetJSONString: could not serialize item #%d.", offset+i );
+      Sfree( buffer.str );
+      return NULL;
+    }
+  }
+  if( _playlistBufferAppend(&buffer,"]",1) )
+    return NULL;
+
+/*------------------------------------------------------------------------*\
+    Append mapping
+\*------------------------------------------------------------------------*/
+  if( hybrid ) {
+    if( _playlistBufferAppend(&buffer,",\"mapping\":[",-1) )
+      return NULL;
+    for( i=0; i<n; i++ ) {
+      sprintf( numStr, "%s%d", i?",":"", body->mappedPos[offset+i] );
+      if( _playlistBufferAppend(&buffer,numStr,-1) )
+        return NULL;
+    }
+    if( _playlistBufferAppend(&buffer,"]",1) )
+      return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Close object, that's all
+\*------------------------------------------------------------------------*/
+  if( _playlistBufferAppend(&buffer,"}",1) )
+    return NULL;
+  return buffer.str;
+}
+
+
+/*=========================================================================*\
+       Withdraw published snapshot after a mutation
+         structure - the item lists changed as well
+\*=========================================================================*/
+static void _playlistSnapshotInvalidate( Playlist *plst, bool structure )
+{
+  if( plst->snapshot ) {
+    playlistSnapshotRelease( plst->snapshot );
+    plst->snapshot = NULL;
+  }
+  if( structure && plst->snapshotBody ) {
+    _playlistSnapshotBodyRelease( plst->snapshotBody );
+    plst->snapshotBody = NULL;
+  }
+}
+
+
+/*=========================================================================*\
+       Create item lists of a snapshot
+         Caller should lock playlist
+         return NULL on error
+\*=========================================================================*/
+static PlaylistSnapshotBody *_playlistSnapshotBodyNew( Playlist *plst )
+{
+  PlaylistSnapshotBody *body;
+  PlaylistItem         *pItem;
+  int                   i, n = plst->_numberOfItems;
+
+/*------------------------------------------------------------------------*\
+    Allocate
+\*------------------------------------------------------------------------*/
+  body = calloc( 1, sizeof(PlaylistSnapshotBody) );
+  if( body && n ) {
+    body->original  = malloc( n*sizeof(PlaylistItem *) );
+    body->mapped    = malloc( n*sizeof(PlaylistItem *) );
+    body->mappedPos = malloc( n*sizeof(int) );
+  }
+  if( !body || (n && (!body->original || !body->mapped || !body->mappedPos)) ) {
+    logerr( "_playlistSnapshotBodyNew: out of memory!" );
+    if( body ) {
+      Sfree( body->original );
+      Sfree( body->mapped );
+      Sfree( body->mappedPos );
+      Sfree( body );
+    }
+    return NULL;
+  }
+  body->refCounter    = 1;
+  body->numberOfItems = n;
+
+/*------------------------------------------------------------------------*\
+    Collect items in both orders, tag items with their mapped positions
+\*------------------------------------------------------------------------*/
+  for( i=0,pItem=plst->firstItemMapped; pItem && i<n; i++,pItem=pItem->nextMapped ) {
+    body->mapped[i] = pItem;
+    pItem->posTag   = i;
+  }
+  for( i=0,pItem=plst->firstItemOriginal; pItem && i<n; i++,pItem=pItem->nextOriginal ) {
+    body->original[i]  = pItem;
+    body->mappedPos[i] = pItem->posTag;
+    __sync_add_and_fetch( &pItem->refCounter, 1 );
+  }
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  DBGMSG( "_playlistSnapshotBodyNew (%p): %d items", plst, n );
+  return body;
+}
+
+
+/*=========================================================================*\
+       Release item lists of a snapshot (no lock needed)
+         items that were removed from the playlist meanwhile are freed
+\*=========================================================================*/
+static void _playlistSnapshotBodyRelease( PlaylistSnapshotBody *body )
+{
+  int i;
+
+  if( __sync_sub_and_fetch(&body->refCounter,1)>0 )
+    return;
+
+  for( i=0; i<body->numberOfItems; i++ )
+    playlistItemDecRef( body->original[i] );
+  Sfree( body->original );
+  Sfree( body->mapped );
+  Sfree( body->mappedPos );
+  Sfree( body );
+}
+
+
+/***************************************************************************\
+ * Functions operating on the position index
+ *   Each order is indexed by a treap with implicit keys (the position),
+ *   every node stores the size of its subtree. This allows to get an item
+ *   by position, the position of an item, insertion and removal in
+ *   O(log n). The linked lists stay the primary representation.
+\***************************************************************************/
+
+/*=========================================================================*\
+       Insert an item to the position index before a given anchor
+         if anchor is NULL, the item is added to the end of the index
+\*=========================================================================*/
+static void _playlistIndexInsert( Playlist *plst, PlaylistSortType order, PlaylistItem *anchorItem, PlaylistItem *newItem )
+{
+  PlaylistNode *node, *left, *right;
+  int           pos;
+
+/*------------------------------------------------------------------------*\
+    Get position of anchor
+\*------------------------------------------------------------------------*/
+  pos = INDEXSIZE( plst->indexRoot[order] );
+  if( anchorItem ) {
+    pos = _playlistIndexRank( plst, order, anchorItem );
+    if( pos<0 ) {
+      logerr( "_playlistIndexInsert (%p): anchor %p not indexed, appending.",
+              plst, anchorItem );
+      pos = INDEXSIZE( plst->indexRoot[order] );
+    }
+  }
+
+/*------------------------------------------------------------------------*\
+    Create node
+\*------------------------------------------------------------------------*/
+  node = calloc( 1, sizeof(PlaylistNode) );
+  if( !node ) {
+    logerr( "_playlistIndexInsert: out of memory!" );
+    return;
+  }
+  node->size     = 1;
+  node->priority = _playlistIndexPriority();
+  node->item     = newItem;
+  newItem->indexNode[order] = node;
+
+/*------------------------------------------------------------------------*\
+    Split at position and merge with new node in between
+\*------------------------------------------------------------------------*/
+  _playlistIndexSplit( plst->indexRoot[order], pos, &left, &right );
+  plst->indexRoot[order] = _playlistIndexMerge( _playlistIndexMerge(left,node), right );
+  plst->indexRoot[order]->parent = NULL;
+}
+
+
+/*=========================================================================*\
+       Remove an item from the position index
+\*=========================================================================*/
+static void _playlistIndexRemove( Playlist *plst, PlaylistSortType order, PlaylistItem *pItem )
+{
+  PlaylistNode *node = pItem->indexNode[order];
+  PlaylistNode *parent, *subTree, *walk;
+
+  if( !node )
+    return;
+
+/*------------------------------------------------------------------------*\
+    Replace node by merged children
+\*------------------------------------------------------------------------*/
+  parent  = node->parent;
+  subTree = _playlistIndexMerge( node->left, node->right );
+  if( subTree )
+    subTree->parent = parent;
+  if( !parent )
+    plst->indexRoot[order] = subTree;
+  else if( parent->left==node )
+    parent->left = subTree;
+  else
+    parent->right = subTree;
+
+/*------------------------------------------------------------------------*\
+    Adjust sizes up to the root
+\*------------------------------------------------------------------------*/
+  for( walk=parent; walk; walk=walk->parent )
+    walk->size--;
+
+/*------------------------------------------------------------------------*\
+    Free node
+\*------------------------------------------------------------------------*/
+  pItem->indexNode[order] = NULL;
+  Sfree( node );
+}
+
+
+/*=========================================================================*\
+       Rebuild position index from linked list in linear time
+\*=========================================================================*/
+static void _playlistIndexRebuild( Playlist *plst, PlaylistSortType order )
+{
+  PlaylistNode **stack;
+  PlaylistItem  *item;
+  int            n, top = 0;
+
+/*------------------------------------------------------------------------*\
+    Drop old index
+\*------------------------------------------------------------------------*/
+  _playlistIndexFree( plst, order );
+
+/*------------------------------------------------------------------------*\
+    Get length of list
+\*------------------------------------------------------------------------*/
+  item = order==PlaylistOriginal ? plst->firstItemOriginal : plst->firstItemMapped;
+  for( n=0; item; n++ )
+    item = playlistItemGetNext( item, order );
+  if( !n )
+    return;
+
+/*------------------------------------------------------------------------*\
+    Build cartesian tree using a stack of the right spine
+\*------------------------------------------------------------------------*/
+  stack = calloc( n, sizeof(PlaylistNode *) );
+  if( !stack ) {
+    logerr( "_playlistIndexRebuild: out of memory!" );
+    return;
+  }
+  item = order==PlaylistOriginal ? plst->firstItemOriginal : plst->firstItemMapped;
+  for( ; item; item=playlistItemGetNext(item,order) ) {
+    PlaylistNode *last = NULL;
+    PlaylistNode *node = calloc( 1, sizeof(PlaylistNode) );
+    if( !node ) {
+      logerr( "_playlistIndexRebuild: out of memory!" );
+      break;
+    }
+    node->priority = _playlistIndexPriority();
+    node->item     = item;
+    item->indexNode[order] = node;
+    while( top && stack[top-1]->priority<node->priority )
+      last = stack[--top];
+    node->left = last;
+    if( last )
+      last->parent = node;
+    if( top ) {
+      stack[top-1]->right = node;
+      node->parent = stack[top-1];
+    }
+    stack[top++] = node;
+  }
+
+/*------------------------------------------------------------------------*\
+    Set root and calculate subtree sizes
+\*------------------------------------------------------------------------*/
+  plst->indexRoot[order] = top ? stack[0] : NULL;
+  _playlistIndexCalcSize( plst->indexRoot[order] );
+  Sfree( stack );
+}
+
+
+/*=========================================================================*\
+       Free position index
+\*=========================================================================*/
+static void _playlistIndexFree( Playlist *plst, PlaylistSortType order )
+{
+  _playlistIndexFreeNodes( plst->indexRoot[order], order );
+  plst->indexRoot[order] = NULL;
+}
+
+
+/*=========================================================================*\
+       Get item at position from index
+         returns NULL if pos is out of bounds
+\*=========================================================================*/
+static PlaylistItem *_playlistIndexGet( Playlist *plst, PlaylistSortType order, int pos )
+{
+  PlaylistNode *node = plst->indexRoot[order];
+
+  while( node ) {
+    int leftSize = INDEXSIZE( node->left );
+    if( pos<leftSize )
+      node = node->left;
+    else if( pos==leftSize )
+      return node->item;
+    else {
+      pos -= leftSize+1;
+      node = node->right;
+    }
+  }
+
+  return NULL;
+}
+
+
+/*=========================================================================*\
+       Get position of item from index
+         returns -1 if item is not member of the index
+\*=========================================================================*/
+static int _playlistIndexRank( Playlist *plst, PlaylistSortType order, PlaylistItem *pItem )
+{
+  PlaylistNode *node;
+  int           pos;
+
+  if( !pItem || !pItem->indexNode[order] )
+    return -1;
+
+  node = pItem->indexNode[order];
+  pos  = INDEXSIZE( node->left );
+  while( node->parent ) {
+    if( node==node->parent->right )
+      pos += INDEXSIZE( node->parent->left ) + 1;
+    node = node->parent;
+  }
+
+  return node==plst->indexRoot[order] ? pos : -1;
+}
+
+
+/*=========================================================================*\
+       Get a pseudo random priority for new nodes
+         quality is not critical here, it only affects the balance
+\*=========================================================================*/
+static unsigned int _playlistIndexPriority( void )
+{
+  static unsigned int state = 2463534242U;
+
+  state ^= state<<13;
+  state ^= state>>17;
+  state ^= state<<5;
+  return state;
+}
+
+
+/*=========================================================================*\
+       Recalculate size of a node and set parent of children
+\*=========================================================================*/
+static void _playlistIndexUpdate( PlaylistNode *node )
+{
+  node->size = 1 + INDEXSIZE(node->left) + INDEXSIZE(node->right);
+  if( node->left )
+    node->left->parent = node;
+  if( node->right )
+    node->right->parent = node;
+}
+
+
+/*=========================================================================*\
+       Merge two trees, all nodes of left are placed before those of right
+         parent pointer of the returned root is not set
+\*=========================================================================*/
+static PlaylistNode *_playlistIndexMerge( PlaylistNode *left, PlaylistNode *right )
+{
+  if( !left )
+    return right;
+  if( !right )
+    return left;
+
+  if( left->priority>right->priority ) {
+    left->right = _playlistIndexMerge( left->right, right );
+    _playlistIndexUpdate( left );
+    return left;
+  }
+
+  right->left = _playlistIndexMerge( left, right->left );
+  _playlistIndexUpdate( right );
+  return right;
+}
+
+
+/*=========================================================================*\
+       Split a tree: the first pos nodes go to left, the rest to right
+         parent pointers of the returned roots are not set
+\*=========================================================================*/
+static void _playlistIndexSplit( PlaylistNode *node, int pos, PlaylistNode **left, PlaylistNode **right )
+{
+  if( !node ) {
+    *left  = NULL;
+    *right = NULL;
+    return;
+  }
+
+  if( INDEXSIZE(node->left)<pos ) {
+    _playlistIndexSplit( node->right, pos-INDEXSIZE(node->left)-1, &node->right, right );
+    *left = node;
+  }
+  else {
+    _playlistIndexSplit( node->left, pos, left, &node->left );
+    *right = node;
+  }
+
+  _playlistIndexUpdate( node );
+}
+
+
+/*=========================================================================*\
+       Calculate sizes of all nodes in a tree
+\*=========================================================================*/
+static int _playlistIndexCalcSize( PlaylistNode *node )
+{
+  if( !node )
+    return 0;
+  node->size = 1 + _playlistIndexCalcSize(node->left) + _playlistIndexCalcSize(node->right);
+  return node->size;
+}
+
+
+/*=========================================================================*\
+       Free all nodes of a tree and reset the references of the items
+\*=========================================================================*/
+static void _playlistIndexFreeNodes( PlaylistNode *node, PlaylistSortType order )
+{
+  if( !node )
+    return;
+  _playlistIndexFreeNodes( node->left, order );
+  _playlistIndexFreeNodes( node->right, order );
+  node->item->indexNode[order] = NULL;
+  Sfree( node );
+}
+
+
+/***************************************************************************\
+ * Functions operating on the id hash table
+ *   All items of the original list are chained into buckets by the hash of
+ *   their id. Several items with the same id may coexist (multimap). The
+ *   table is doubled whenever the load factor exceeds one.
+\***************************************************************************/
+
+/*=========================================================================*\
+       Calculate hash value of an item id (FNV-1a)
+\*=========================================================================*/
+static unsigned int _playlistIdHashValue( const char *id )
+{
+  unsigned int hash = 2166136261U;
+
+  while( *id ) {
+    hash ^= (unsigned char)*id++;
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+
+
+/*=========================================================================*\
+       Add an item to the id hash table
+\*=========================================================================*/
+static void _playlistIdHashInsert( Playlist *plst, PlaylistItem *pItem )
+{
+  int bucket;
+
+/*------------------------------------------------------------------------*\
+    Create or grow table if necessary
+\*------------------------------------------------------------------------*/
+  if( !plst->idTable || plst->idTableCount>=plst->idTableSize ) {
+    int size = plst->idTable ? 2*plst->idTableSize : PLAYLIST_IDTABLE_MINSIZE;
+    if( _playlistIdHashResize(plst,size) && !plst->idTable ) {
+      logerr( "_playlistIdHashInsert (%p): could not create table, item %p (%s) not hashed.",
+              plst, pItem, pItem->text );
+      return;
+    }
+  }
+
+/*------------------------------------------------------------------------*\
+    Link item to head of bucket chain
+\*------------------------------------------------------------------------*/
+  pItem->idHash       = _playlistIdHashValue( pItem->id );
+  bucket              = pItem->idHash & (plst->idTableSize-1);
+  pItem->nextSameHash = plst->idTable[bucket];
+  plst->idTable[bucket] = pItem;
+  plst->idTableCount++;
+}
+
+
+/*=========================================================================*\
+       Remove an item from the id hash table
+         uses the hash value stored on insertion, so this works even if
+         the id of the item was modified in the meantime
+\*=========================================================================*/
+static void _playlistIdHashRemove( Playlist *plst, PlaylistItem *pItem )
+{
+  PlaylistItem **link;
+
+  if( !plst->idTable )
+    return;
+
+/*------------------------------------------------------------------------*\
+    Find and unlink item from bucket chain
+\*------------------------------------------------------------------------*/
+  for( link=&plst->idTable[pItem->idHash&(plst->idTableSize-1)]; *link; link=&(*link)->nextSameHash ) {
+    if( *link!=pItem )
+      continue;
+    *link = pItem->nextSameHash;
+    pItem->nextSameHash = NULL;
+    plst->idTableCount--;
+    return;
+  }
+
+  logerr( "_playlistIdHashRemove (%p): item %p (%s) not hashed.",
+          plst, pItem, pItem->text );
+}
+
+
+/*=========================================================================*\
+       Find an arbitrary item with a given id
+         returns weak pointer to item or NULL if not found
+\*=========================================================================*/
+static PlaylistItem *_playlistIdHashFind( Playlist *plst, const char *id )
+{
+  PlaylistItem *walk;
+  unsigned int  hash;
+
+  if( !plst->idTable )
+    return NULL;
+
+  hash = _playlistIdHashValue( id );
+  for( walk=plst->idTable[hash&(plst->idTableSize-1)]; walk; walk=walk->nextSameHash )
+    if( walk->idHash==hash && !strcmp(walk->id,id) )
+      return walk;
+
+  return NULL;
+}
+
+
+/*=========================================================================*\
+       Resize id hash table, size needs to be a power of two
+         returns 0 on success, -1 on error (table is unchanged)
+\*=========================================================================*/
+static int _playlistIdHashResize( Playlist *plst, int size )
+{
+  PlaylistItem **table;
+  PlaylistItem  *walk, *next;
+  int            i;
+
+  DBGMSG( "_playlistIdHashResize (%p): %d -> %d buckets",
+          plst, plst->idTableSize, size );
+
+/*------------------------------------------------------------------------*\
+    Allocate new bucket array
+\*------------------------------------------------------------------------*/
+  table = calloc( size, sizeof(PlaylistItem *) );
+  if( !table ) {
+    logerr( "_playlistIdHashResize: out of memory!" );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Rechain all items using the stored hash values
+\*------------------------------------------------------------------------*/
+  for( i=0; i<plst->idTableSize; i++ ) {
+    for( walk=plst->idTable[i]; walk; walk=next ) {
+      next = walk->nextSameHash;
+      walk->nextSameHash = table[walk->idHash&(size-1)];
+      table[walk->idHash&(size-1)] = walk;
+    }
+  }
+
+/*------------------------------------------------------------------------*\
+    Replace table
+\*------------------------------------------------------------------------*/
+  Sfree( plst->idTable );
+  plst->idTable     = table;
+  plst->idTableSize = size;
+  return 0;
+}
+
+
+/*=========================================================================*\
+       Free id hash table and reset the chain links of all items
+\*=========================================================================*/
+static void _playlistIdHashFree( Playlist *plst )
+{
+  PlaylistItem *walk, *next;
+  int           i;
+
+  for( i=0; i<plst->idTableSize; i++ ) {
+    for( walk=plst->idTable[i]; walk; walk=next ) {
+      next = walk->nextSameHash;
+      walk->nextSameHash = NULL;
+    }
+  }
+
+  Sfree( plst->idTable );
+  plst->idTableSize  = 0;
+  plst->idTableCount = 0;
+}
+
+
+/***************************************************************************\
+ * Functions operating on the string pool
+\***************************************************************************/
+
+
+/*=========================================================================*\
+       Get an interned copy of a string, increments reference counter
+         return NULL on error
+\*=========================================================================*/
+static const char *_playlistStringIntern( const char *str )
+{
+  PlaylistString  *pStr;
+  unsigned int     hash;
+  int              perr;
+
+/*------------------------------------------------------------------------*\
+    Lock pool
+\*------------------------------------------------------------------------*/
+  perr = pthread_mutex_lock( &stringTableMutex );
+  if( perr )
+    logerr( "_playlistStringIntern: locking string pool: %s", strerror(perr) );
+
+/*------------------------------------------------------------------------*\
+    Already known?
+\*------------------------------------------------------------------------*/
+  hash = _playlistIdHashValue( str );
+  if( stringTable ) {
+    for( pStr=stringTable[hash&(stringTableSize-1)]; pStr; pStr=pStr->next ) {
+      if( pStr->hash==hash && !strcmp(pStr->str,str) ) {
+        pStr->refCounter++;
+        pthread_mutex_unlock( &stringTableMutex );
+        return pStr->str;
+      }
+    }
+  }
+
+/*------------------------------------------------------------------------*\
+    Grow table if load factor exceeds one
+\*------------------------------------------------------------------------*/
+  if( stringTableCount>=stringTableSize ) {
+    int              size = stringTableSize ? 2*stringTableSize : PLAYLIST_STRINGTABLE_MINSIZE;
+    PlaylistString **table, *next;
+    int              i;
+
+    table = calloc( size, sizeof(PlaylistString *) );
+    if( !table ) {
+      pthread_mutex_unlock( &stringTableMutex );
+      logerr( "_playlistStringIntern: out of memory!" );
+      return NULL;
+    }
+    for( i=0; i<stringTableSize; i++ ) {
+      for( pStr=stringTable[i]; pStr; pStr=next ) {
+        next = pStr->next;
+        pStr->next = table[pStr->hash&(size-1)];
+        table[pStr->hash&(size-1)] = pStr;
+      }
+    }
+    Sfree( stringTable );
+    stringTable     = table;
+    stringTableSize = size;
+  }
+
+/*------------------------------------------------------------------------*\
+    Create new entry
+\*------------------------------------------------------------------------*/
+  pStr = malloc( sizeof(PlaylistString)+strlen(str)+1 );
+  if( !pStr ) {
+    pthread_mutex_unlock( &stringTableMutex );
+    logerr( "_playlistStringIntern: out of memory!" );
+    return NULL;
+  }
+  strcpy( pStr->str, str );
+  pStr->hash       = hash;
+  pStr->refCounter = 1;
+  pStr->next       = stringTable[hash&(stringTableSize-1)];
+  stringTable[hash&(stringTableSize-1)] = pStr;
+  stringTableCount++;
+
+/*------------------------------------------------------------------------*\
+    Unlock pool, that's all
+\*------------------------------------------------------------------------*/
+  pthread_mutex_unlock( &stringTableMutex );
+  return pStr->str;
+}
+
+
+/*=========================================================================*\
+       Release an interned string, free it if no longer referenced
+\*=========================================================================*/
+static void _playlistStringRelease( const char *str )
+{
+  PlaylistString  *pStr, **pPrev;
+  int              perr;
+
+  if( !str )
+    return;
+  pStr = (PlaylistString *)( str-offsetof(PlaylistString,str) );
+
+/*------------------------------------------------------------------------*\
+    Lock pool, still referenced?
+\*------------------------------------------------------------------------*/
+  perr = pthread_mutex_lock( &stringTableMutex );
+  if( perr )
+    logerr( "_playlistStringRelease: locking string pool: %s", strerror(perr) );
+  if( --pStr->refCounter>0 ) {
+    pthread_mutex_unlock( &stringTableMutex );
+    return;
+  }
+
+/*------------------------------------------------------------------------*\
+    Unlink from chain and free
+\*------------------------------------------------------------------------*/
+  for( pPrev=&stringTable[pStr->hash&(stringTableSize-1)]; *pPrev; pPrev=&(*pPrev)->next ) {
+    if( *pPrev==pStr ) {
+      *pPrev = pStr->next;
+      break;
+    }
+  }
+  stringTableCount--;
+  Sfree( pStr );
+
+/*------------------------------------------------------------------------*\
+    Unlock pool, that's all
+\*------------------------------------------------------------------------*/
+  pthread_mutex_unlock( &stringTableMutex );
+}
+
+
+/***************************************************************************\
+ * Functions operating on playlist items
+\***************************************************************************/
+
+
+/*=========================================================================*\
+       Create (allocate and init) an item from ickstream JSON object
+          reference counter is set to one
+          return NULL on error
+\*=========================================================================*/
+PlaylistItem *playlistItemFromJSON( json_t *jItem )
+{
+  PlaylistItem        *item;
+
+/*------------------------------------------------------------------------*\
+    Allocate header
+\*------------------------------------------------------------------------*/
+  item = calloc( 1, sizeof(PlaylistItem) );
+  if( !item ) {
+    logerr( "playlistItemFromJSON: out of memeory!" );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Init reference counter
+\*------------------------------------------------------------------------*/
+  item->refCounter = 1;
+
+/*------------------------------------------------------------------------*\
+    Extract header info, keep JSON object in serialized form only
+\*------------------------------------------------------------------------*/
+  if( _playlistItemStore(item,jItem) ) {
+    Sfree( item );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  DBGMSG( "playlistItemFromJSON: %p \"%s\" (id=%s)",
+                     item, item->text, item->id );
+  return item;
 }
 
 
@@ -1619,9 +3245,13 @@ PlaylistItem *playlistItemFromJSON( json_t *jItem )
 \*=========================================================================*/
 void playlistItemIncRef( PlaylistItem *pItem )
 {
-  pItem->refCounter++;
-  DBGMSG( "playlistItemIncRef (%p): now %d references (jrefcnt=%d)",
-          pItem, pItem->refCounter, pItem->jItem->refcount );
+#ifdef ICK_DEBUG
+  int refCounter = __sync_add_and_fetch( &pItem->refCounter, 1 );
+  DBGMSG( "playlistItemIncRef (%p): now %d references",
+          pItem, refCounter );
+#else
+  __sync_add_and_fetch( &pItem->refCounter, 1 );
+#endif
 }
 
 
@@ -1630,27 +3260,23 @@ void playlistItemIncRef( PlaylistItem *pItem )
 \*=========================================================================*/
 void playlistItemDecRef( PlaylistItem *pItem )
 {
-  pItem->refCounter--;
-  DBGMSG( "playlistItemDecRef (%p): now %d references (jrefcnt=%d)",
-          pItem, pItem->refCounter, pItem->jItem->refcount );
-
-  /* {
-    char *out = json_dumps( pItem->jItem, JSON_PRESERVE_ORDER | JSON_COMPACT | JSON_ENSURE_ASCII );
-    DBGMSG( "playlistItemDecRef: %s", out );
-    free( out );
-  } */
+  int refCounter = __sync_sub_and_fetch( &pItem->refCounter, 1 );
+  DBGMSG( "playlistItemDecRef (%p): now %d references",
+          pItem, refCounter );
 
 /*------------------------------------------------------------------------*\
     Still referenced?
 \*------------------------------------------------------------------------*/
-  if( pItem->refCounter>0 )
+  if( refCounter>0 )
     return;
 
 /*------------------------------------------------------------------------*\
     Free all header features
 \*------------------------------------------------------------------------*/
-  json_decref( pItem->jItem );
-  pthread_mutex_destroy( &pItem->mutex );
+  Sfree( pItem->jsonBlob );
+  _playlistStringRelease( pItem->id );
+  _playlistStringRelease( pItem->text );
+  _playlistStringRelease( pItem->image );
 
 /*------------------------------------------------------------------------*\
     Free header
@@ -1666,7 +3292,7 @@ void playlistItemLock( PlaylistItem *item )
 {
   int perr;
   DBGMSG( "playlistItem (%p): lock", item );
-  perr = pthread_mutex_lock( &item->mutex );
+  perr = pthread_mutex_lock( _playlistItemStripe(item) );
   if( perr )
     logerr( "playlistItemLock: %s", strerror(perr) );
 
@@ -1680,7 +3306,7 @@ void playlistItemUnlock( PlaylistItem *item )
 {
   int perr;
   DBGMSG( "playlistItem (%p): unlock", item );
-  perr = pthread_mutex_unlock( &item->mutex );
+  perr = pthread_mutex_unlock( _playlistItemStripe(item) );
   if( perr )
     logerr( "playlistItemUnlock: %s", strerror(perr) );
 }
@@ -1789,49 +3415,104 @@ PlaylistItemType  playlistItemGetType( PlaylistItem *pItem )
 
 /*=========================================================================*\
        Get JSON representation of playlist item
+         The result is a transient copy that needs to be decref'ed,
+         use playlistItemSetMetaData() or playlistItemSetRawMeta() to
+         modify the item.
+         return NULL on error
 \*=========================================================================*/
 json_t *playlistItemGetJSON( PlaylistItem *pItem )
 {
-  return pItem->jItem;
+  return _playlistItemCopyJSON( pItem );
+}
+
+
+/*=========================================================================*\
+       Get serialized JSON representation of playlist item
+         the result is a copy of the serialized form and needs to be freed
+         return NULL on error
+\*=========================================================================*/
+char *playlistItemGetJSONString( PlaylistItem *pItem )
+{
+  char *result;
+
+  pthread_mutex_lock( _playlistItemStripe(pItem) );
+  result = strdup( pItem->jsonBlob );
+  pthread_mutex_unlock( _playlistItemStripe(pItem) );
+
+  if( !result )
+    logerr( "playlistItemGetJSONString: out of memory!" );
+  return result;
 }
 
 
 /*=========================================================================*\
        Get stream reference list for playlist item
+         The result needs to be decref'ed
+         return NULL if not available
 \*=========================================================================*/
 json_t *playlistItemGetStreamingRefs( PlaylistItem *pItem )
 {
-  return pItem->jStreamingRefs;
+  json_t       *jRefs;
+  json_error_t  error;
+
+/*------------------------------------------------------------------------*\
+    Parse located part of serialized form only
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( _playlistItemStripe(pItem) );
+  if( pItem->refsLength ) {
+    jRefs = json_loadb( pItem->jsonBlob+pItem->refsOffset, pItem->refsLength, 0, &error );
+    if( !jRefs )
+      logerr( "playlistItemGetStreamingRefs (%s): parse error at line %d: %s",
+              pItem->text, error.line, error.text );
+    pthread_mutex_unlock( _playlistItemStripe(pItem) );
+    return jRefs;
+  }
+  pthread_mutex_unlock( _playlistItemStripe(pItem) );
+
+/*------------------------------------------------------------------------*\
+    Not located (typically not available): use full item
+\*------------------------------------------------------------------------*/
+  return playlistItemGetAttribute( pItem, "streamingRefs" );
 }
 
 
 /*=========================================================================*\
        Get an attribute
+         The result needs to be decref'ed
          return NULL if not available
 \*=========================================================================*/
 json_t *playlistItemGetAttribute( PlaylistItem *pItem, const char *attribute )
 {
+  json_t *jItem;
+  json_t *jObj;
+
   DBGMSG( "playlistItemGetAttribute (%p,%s): \"%s\".",
            pItem, pItem->text, attribute );
 
-  // Get an return attribute
-  return json_object_get( pItem->jItem, attribute );
+  // Get attribute from transient copy
+  jItem = _playlistItemCopyJSON( pItem );
+  jObj  = json_incref( json_object_get(jItem,attribute) );
+  json_decref( jItem );
+
+  return jObj;
 }
 
 
 /*=========================================================================*\
        Get a model attribute
+         The result needs to be decref'ed
          return NULL if not available
 \*=========================================================================*/
 json_t *playlistItemGetModelAttribute( PlaylistItem *pItem, const char *attribute )
 {
   json_t *jObj;
+  json_t *jAttr;
 
   DBGMSG( "playlistItemGetModelAttribute (%p,%s): \"%s\".",
            pItem, pItem->text, attribute );
 
   // Get attribute container
-  jObj = json_object_get( pItem->jItem, "itemAttributes" );
+  jObj = playlistItemGetAttribute( pItem, "itemAttributes" );
   if( !jObj  ) {
     logwarn( "playlistItemGetModelAttribute (%s): Field \"itemAttributes\" not found.",
               pItem->text );
@@ -1839,7 +3520,9 @@ json_t *playlistItemGetModelAttribute( PlaylistItem *pItem, const char *attribut
   }
 
   // Get an return attribute
-  return json_object_get( jObj, attribute );
+  jAttr = json_incref( json_object_get(jObj,attribute) );
+  json_decref( jObj );
+  return jAttr;
 }
 
 
@@ -1849,44 +3532,20 @@ json_t *playlistItemGetModelAttribute( PlaylistItem *pItem, const char *attribut
 \*=========================================================================*/
 double playlistItemGetDuration( PlaylistItem *pItem )
 {
-  json_t *jObj;
-  double  duration = 0;
-
-/*------------------------------------------------------------------------*\
-    Find and parse attribute
-\*------------------------------------------------------------------------*/
-  jObj = playlistItemGetModelAttribute( pItem, "duration" );
-  if( json_getreal(jObj,&duration) )
-      logwarn( "playlistItemGetDuration (%s): Cannot interpret attribute \"duration\".",
-               pItem->text );
-
-/*------------------------------------------------------------------------*\
-    That's it
-\*------------------------------------------------------------------------*/
-  DBGMSG( "playlistItemGetDuration (%p,%s): %lfs.", pItem, pItem->text, duration );
-  return duration;
+  DBGMSG( "playlistItemGetDuration (%p,%s): %lfs.", pItem, pItem->text, pItem->duration );
+  return pItem->duration;
 }
 
 
 /*=========================================================================*\
        Get image URI
+         the result is valid while the item is locked
          return NULL if not available
 \*=========================================================================*/
 const char *playlistItemGetImageUri( PlaylistItem *pItem )
 {
-  json_t *jObj;
-
   DBGMSG( "playlistItemGetImageUri (%p,%s).", pItem, pItem->text );
-
-  jObj = json_object_get( pItem->jItem, "image" );
-  if( jObj && json_is_string(jObj) )
-     return json_string_value( jObj );
-
-  if( jObj )
-    logwarn( "playlistItemGetImageUri (%s): Field \"image\" is not a string.",
-             pItem->text );
-
-  return NULL;
+  return pItem->image;
 }
 
 
@@ -1895,93 +3554,246 @@ const char *playlistItemGetImageUri( PlaylistItem *pItem )
 \*=========================================================================*/
 int playlistItemSetMetaData( PlaylistItem *pItem, json_t *metaObj, bool replace )
 {
+  json_t *jItem;
+  int     rc;
+
   DBGMSG( "playlistItemSetMetaData (%p,%s): %p replace:%s",
            pItem, pItem->text, metaObj, replace?"On":"Off" );
 
 /*------------------------------------------------------------------------*\
-    Replace mode: exchange object with new one
+    New meta data is typically part of a request: get it out of the arena
 \*------------------------------------------------------------------------*/
-  if( replace ) {
-    json_decref( pItem->jItem );
-    pItem->jItem = json_incref( metaObj );
-  }
+  metaObj = jsonArenaPromote( metaObj );
+  if( !metaObj )
+    return -1;
 
 /*------------------------------------------------------------------------*\
-    Merge mode: try to merge new Object into existing one
+    Lock item, replace mode: use new object as is
 \*------------------------------------------------------------------------*/
-  else if( json_object_merge(pItem->jItem,metaObj) ) {
-    logerr( "playlistItemSetMetaData (%s): could not merge new meta data.",
-            pItem->text );
-    return -1;
+  pthread_mutex_lock( _playlistItemStripe(pItem) );
+  if( replace )
+    jItem = json_incref( metaObj );
+
+/*------------------------------------------------------------------------*\
+    Merge mode: try to merge new Object into a copy of the existing one
+\*------------------------------------------------------------------------*/
+  else {
+    jItem = _playlistItemCopyJSON( pItem );
+    if( !jItem || json_object_merge(jItem,metaObj) ) {
+      pthread_mutex_unlock( _playlistItemStripe(pItem) );
+      json_decref( jItem );
+      json_decref( metaObj );
+      logerr( "playlistItemSetMetaData (%s): could not merge new meta data.",
+              pItem->text );
+      return -1;
+    }
   }
 
 /*------------------------------------------------------------------------*\
-    Adjust header info
+    Store new header and serialized form, this also checks the meta data
 \*------------------------------------------------------------------------*/
-  if( _playlistItemFillHeader(pItem) ) {
+  rc = _playlistItemStore( pItem, jItem );
+  pthread_mutex_unlock( _playlistItemStripe(pItem) );
+  if( rc )
     logerr( "playlistItemSetMetaData (%s): invalid header of new meta data.",
             pItem->text );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  json_decref( jItem );
+  json_decref( metaObj );
+  return rc;
+}
+
+
+/*=========================================================================*\
+       Set a member of the raw meta data (e.g. ICY or ID3 tags) of the item
+         jMeta is not stolen, the change is not journaled
+         return -1 on error
+\*=========================================================================*/
+int playlistItemSetRawMeta( PlaylistItem *pItem, const char *key, json_t *jMeta )
+{
+  json_t *jItem;
+  json_t *jRawMeta;
+  int     rc = -1;
+
+  DBGMSG( "playlistItemSetRawMeta (%p,%s): %s", pItem, pItem->text, key );
+
+/*------------------------------------------------------------------------*\
+    Lock item and get a copy of the JSON object
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( _playlistItemStripe(pItem) );
+  jItem = _playlistItemCopyJSON( pItem );
+  if( !jItem ) {
+    pthread_mutex_unlock( _playlistItemStripe(pItem) );
     return -1;
   }
 
 /*------------------------------------------------------------------------*\
-    That's all
+    Get or create container, set member and store changed item
 \*------------------------------------------------------------------------*/
-  return 0;
+  jRawMeta = json_object_get( jItem, "rawMeta" );
+  if( !jRawMeta ) {
+    jRawMeta = json_object();
+    if( json_object_set_new(jItem,"rawMeta",jRawMeta) )
+      jRawMeta = NULL;
+  }
+  if( jRawMeta && !json_object_set(jRawMeta,key,jMeta) )
+    rc = _playlistItemStore( pItem, jItem );
+  if( rc )
+    logerr( "playlistItemSetRawMeta (%s): could not set \"%s\".", pItem->text, key );
+
+/*------------------------------------------------------------------------*\
+    Unlock item, that's all
+\*------------------------------------------------------------------------*/
+  pthread_mutex_unlock( _playlistItemStripe(pItem) );
+  json_decref( jItem );
+  return rc;
 }
 
 
 /*=========================================================================*\
-       Extract some header info from playlist JSON item for fast access
+       Store JSON item: extract header info for fast access and serialize
+         id, text and image are interned, the location of the streaming
+         refs within the serialized form is recorded. The header is not
+         changed on error. Caller must lock shared items.
          return 0 on success, -1 on error
 \*=========================================================================*/
-static int _playlistItemFillHeader( PlaylistItem *pItem )
+static int _playlistItemStore( PlaylistItem *pItem, json_t *jItem )
 {
-  json_t     *jObj;
-  const char *typeStr;
+  json_t           *jObj;
+  const char       *typeStr;
+  const char       *idStr;
+  const char       *textStr;
+  const char       *imageStr = NULL;
+  double            duration = 0;
+  char             *blob;
+  size_t            refsOffset = 0;
+  size_t            refsLength = 0;
+  PlaylistItemType  type;
 
 /*------------------------------------------------------------------------*\
-    Extract id for quick access (weak ref.)
+    Get id
 \*------------------------------------------------------------------------*/
-  jObj = json_object_get( pItem->jItem, "id" );
+  jObj = json_object_get( jItem, "id" );
   if( !jObj || !json_is_string(jObj) ) {
-    logerr( "_playlistItemFillHeader: Field \"id\" missing or of wrong type." );
+    logerr( "_playlistItemStore: Field \"id\" missing or of wrong type." );
     return -1;
   }
-  pItem->id = json_string_value( jObj );
+  idStr = json_string_value( jObj );
 
 /*------------------------------------------------------------------------*\
-    Extract text for quick access (weak ref.)
+    Get text
 \*------------------------------------------------------------------------*/
-  jObj = json_object_get( pItem->jItem, "text" );
+  jObj = json_object_get( jItem, "text" );
   if( !jObj || !json_is_string(jObj) ) {
-    logerr( "_playlistItemFillHeader: Field \"text\" missing or of wrong type." );
+    logerr( "_playlistItemStore: Field \"text\" missing or of wrong type." );
     return -1;
   }
-  pItem->text = json_string_value( jObj );
+  textStr = json_string_value( jObj );
 
 /*------------------------------------------------------------------------*\
     Extract item type
 \*------------------------------------------------------------------------*/
-  jObj = json_object_get( pItem->jItem, "type" );
+  jObj = json_object_get( jItem, "type" );
   if( !jObj || !json_is_string(jObj) ) {
-    logwarn( "_playlistItemFillHeader: Field \"type\" missing or of wrong type." );
+    logwarn( "_playlistItemStore: Field \"type\" missing or of wrong type." );
     return -1;
   }
   typeStr = json_string_value( jObj );
   if( !strcmp(typeStr,"track") )
-    pItem->type = PlaylistItemTrack;
+    type = PlaylistItemTrack;
   else if( !strcmp(typeStr,"stream") )
-    pItem->type = PlaylistItemStream;
+    type = PlaylistItemStream;
   else {
-    logerr( "_playlistItemFillHeader: Unknown type \"%s\"", typeStr );
+    logerr( "_playlistItemStore: Unknown type \"%s\"", typeStr );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Get optional image and duration
+\*------------------------------------------------------------------------*/
+  jObj = json_object_get( jItem, "image" );
+  if( jObj && json_is_string(jObj) )
+    imageStr = json_string_value( jObj );
+  else if( jObj )
+    logwarn( "_playlistItemStore (%s): Field \"image\" is not a string.", textStr );
+
+  jObj = json_object_get( json_object_get(jItem,"itemAttributes"), "duration" );
+  if( jObj && json_getreal(jObj,&duration) )
+    logwarn( "_playlistItemStore (%s): Cannot interpret attribute \"duration\".", textStr );
+
+/*------------------------------------------------------------------------*\
+    Serialize
+\*------------------------------------------------------------------------*/
+  blob = json_dumps( jItem, PLAYLIST_ITEM_DUMPFLAGS );
+  if( !blob ) {
+    logerr( "_playlistItemStore (%s): could not serialize item.", textStr );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Locate streaming refs, the serialization of a member is identical
+    to its part in the serialization of the item
+\*------------------------------------------------------------------------*/
+  jObj = json_object_get( jItem, "streamingRefs" );
+  if( jObj ) {
+    const char *key  = "\"streamingRefs\":";
+    char       *refs = json_dumps( jObj, PLAYLIST_ITEM_DUMPFLAGS );
+    const char *ptr  = blob;
+    while( refs && (ptr=strstr(ptr,key))!=NULL ) {
+      ptr += strlen( key );
+      if( !strncmp(ptr,refs,strlen(refs)) ) {
+        refsOffset = ptr - blob;
+        refsLength = strlen( refs );
+        break;
+      }
+    }
+    if( !refsLength )
+      logwarn( "_playlistItemStore (%s): could not locate streaming refs.", textStr );
+    Sfree( refs );
+  }
+
+/*------------------------------------------------------------------------*\
+    Intern strings for quick access
+\*------------------------------------------------------------------------*/
+  idStr = _playlistStringIntern( idStr );
+  if( !idStr ) {
+    Sfree( blob );
+    return -1;
+  }
+  textStr = _playlistStringIntern( textStr );
+  if( !textStr ) {
+    _playlistStringRelease( idStr );
+    Sfree( blob );
     return -1;
   }
+  if( imageStr ) {
+    imageStr = _playlistStringIntern( imageStr );
+    if( !imageStr ) {
+      _playlistStringRelease( idStr );
+      _playlistStringRelease( textStr );
+      Sfree( blob );
+      return -1;
+    }
+  }
 
 /*------------------------------------------------------------------------*\
-    Extract streaming data list for quick access (weak ref.), optional
+    Replace header info and serialized form
 \*------------------------------------------------------------------------*/
-  pItem->jStreamingRefs = json_object_get( pItem->jItem, "streamingRefs" );
+  _playlistStringRelease( pItem->id );
+  _playlistStringRelease( pItem->text );
+  _playlistStringRelease( pItem->image );
+  Sfree( pItem->jsonBlob );
+  pItem->id         = idStr;
+  pItem->text       = textStr;
+  pItem->image      = imageStr;
+  pItem->type       = type;
+  pItem->duration   = duration;
+  pItem->jsonBlob   = blob;
+  pItem->refsOffset = refsOffset;
+  pItem->refsLength = refsLength;
 
 /*------------------------------------------------------------------------*\
     That's all
@@ -1990,6 +3802,67 @@ static int _playlistItemFillHeader( PlaylistItem *pItem )
 }
 
 
+/*=========================================================================*\
+       Get a new reference to a JSON representation of an item
+         The item is parsed into a transient copy
+         return NULL on error
+\*=========================================================================*/
+static json_t *_playlistItemCopyJSON( PlaylistItem *pItem )
+{
+  json_t       *jItem;
+  json_error_t  error;
+
+  pthread_mutex_lock( _playlistItemStripe(pItem) );
+  jItem = json_loads( pItem->jsonBlob, 0, &error );
+  if( !jItem )
+    logerr( "_playlistItemCopyJSON (%s): parse error at line %d: %s",
+            pItem->text, error.line, error.text );
+  pthread_mutex_unlock( _playlistItemStripe(pItem) );
+
+  return jItem;
+}
+
+
+/*=========================================================================*\
+       Get serialized form of an item
+         the result is owned by the item, caller must lock the item
+\*=========================================================================*/
+static const char *_playlistItemSerialize( PlaylistItem *pItem )
+{
+  return pItem->jsonBlob;
+}
+
+
+/*=========================================================================*\
+       Get the mutex protecting an item
+         Items share a fixed set of recursive mutexes selected by address
+\*=========================================================================*/
+static pthread_mutex_t *_playlistItemStripe( PlaylistItem *pItem )
+{
+  uintptr_t key = (uintptr_t)pItem;
+
+  pthread_once( &itemLockOnce, _playlistItemLockInit );
+  key ^= key>>12;
+  return &itemLockStripes[(key>>4)&(PLAYLIST_ITEMLOCK_STRIPES-1)];
+}
+
+
+/*=========================================================================*\
+       Init striped item locks (called once)
+\*=========================================================================*/
+static void _playlistItemLockInit( void )
+{
+  pthread_mutexattr_t attr;
+  int                 i;
+
+  pthread_mutexattr_init( &attr );
+  pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+  for( i=0; i<PLAYLIST_ITEMLOCK_STRIPES; i++ )
+    pthread_mutex_init( &itemLockStripes[i], &attr );
+  pthread_mutexattr_destroy( &attr );
+}
+
+
 /*=========================================================================*\
        Check consistency of playlist
 \*=========================================================================*/
@@ -2117,6 +3990,52 @@ static int _playlistCheckList( const char *file, int line, Playlist *plst )
     rc = -1;
   }
 
+/*------------------------------------------------------------------------*\
+    Check position indices
+\*------------------------------------------------------------------------*/
+  for( i=0,item=plst->firstItemOriginal; item; i++,item=item->nextOriginal ) {
+    if( _playlistIndexRank(plst,PlaylistOriginal,item)!=i ) {
+      _mylog( file, line, LOG_ERR, "item #%d (%p, %s): original index position %d corrupt",
+              i, item, item->text, _playlistIndexRank(plst,PlaylistOriginal,item) );
+      rc = -1;
+    }
+  }
+  for( i=0,item=plst->firstItemMapped; item; i++,item=item->nextMapped ) {
+    if( _playlistIndexRank(plst,PlaylistMapped,item)!=i ) {
+      _mylog( file, line, LOG_ERR, "item #%d (%p, %s): mapped index position %d corrupt",
+              i, item, item->text, _playlistIndexRank(plst,PlaylistMapped,item) );
+      rc = -1;
+    }
+  }
+  if( INDEXSIZE(plst->indexRoot[PlaylistOriginal])!=plst->_numberOfItems ||
+      INDEXSIZE(plst->indexRoot[PlaylistMapped])!=plst->_numberOfItems ) {
+    _mylog( file, line, LOG_ERR, "index sizes (%d/%d) do not match number of items (%d)",
+            INDEXSIZE(plst->indexRoot[PlaylistOriginal]),
+            INDEXSIZE(plst->indexRoot[PlaylistMapped]), plst->_numberOfItems );
+    rc = -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Check id hash table
+\*------------------------------------------------------------------------*/
+  for( i=0,item=plst->firstItemOriginal; item; i++,item=item->nextOriginal ) {
+    PlaylistItem *walk = NULL;
+    if( plst->idTable )
+      for( walk=plst->idTable[item->idHash&(plst->idTableSize-1)]; walk; walk=walk->nextSameHash )
+        if( walk==item )
+          break;
+    if( !walk || item->idHash!=_playlistIdHashValue(item->id) ) {
+      _mylog( file, line, LOG_ERR, "item #%d (%p, %s): id \"%s\" not or wrongly hashed",
+              i, item, item->text, item->id );
+      rc = -1;
+    }
+  }
+  if( plst->idTableCount!=plst->_numberOfItems ) {
+    _mylog( file, line, LOG_ERR, "id table count (%d) does not match number of items (%d)",
+            plst->idTableCount, plst->_numberOfItems );
+    rc = -1;
+  }
+
 /*------------------------------------------------------------------------*\
     That's it
 \*------------------------------------------------------------------------*/
@@ -74,6 +74,10 @@ typedef struct _playlist Playlist;
 struct _playlistItem;
 typedef struct _playlistItem  PlaylistItem;
 
+// An immutable, reference counted view of a playlist (usable without lock)
+struct _playlistSnapshot;
+typedef struct _playlistSnapshot  PlaylistSnapshot;
+
 typedef enum {
   PlaylistItemTrack,
   PlaylistItemStream
@@ -86,6 +90,9 @@ typedef enum {
   PlaylistBoth        // Address both lists (internal for unlinking)
 } PlaylistSortType;
 
+// Hook for journaling all mutations of a playlist (the record is borrowed)
+typedef void (*PlaylistJournalCallback)( Playlist *plst, json_t *jRecord, void *userData );
+
 
 /*=========================================================================*\
     Global symbols 
@@ -102,6 +109,10 @@ Playlist     *playlistFromJSON( json_t *jObj );
 void          playlistDelete( Playlist *plst );
 void          playlistLock( Playlist *plst );
 void          playlistUnlock( Playlist *plst );
+void          playlistSetJournalCallback( Playlist *plst, PlaylistJournalCallback callback, void *userData );
+int           playlistSetChangeLogSize( Playlist *plst, int size );
+json_int_t    playlistGetVersion( Playlist *plst );
+json_t       *playlistGetChanges( Playlist *plst, json_int_t version );
 void          playlistReset( Playlist *plst, bool resetHeader );
 void          playlistResetMapping( Playlist *plst, bool inverse );
 void          playlistSetId( Playlist *plst, const char *id );
@@ -115,16 +126,31 @@ PlaylistItem *playlistSetCursorPos( Playlist *plst, int pos );
 PlaylistItem *playlistIncrCursorItem( Playlist *plst );
 
 json_t       *playlistGetJSON( Playlist *plst, PlaylistSortType order, int offset, int count );
+char         *playlistGetJSONString( Playlist *plst, PlaylistSortType order, int offset, int count );
 PlaylistItem *playlistGetItem( Playlist *plst, PlaylistSortType order, int pos );
 int           playlistGetItemPos( Playlist *plst, PlaylistSortType order, PlaylistItem *item );
 PlaylistItem *playlistGetItemById( Playlist *plst, const char *id );
+void          playlistItemChanged( Playlist *plst, PlaylistItem *pItem );
 PlaylistItem *playlistGetCursorItem( Playlist *plst );
 int           playlistAddItems( Playlist *plst, int oPos, int mPos, json_t *jItems, bool resetFlag );
 int           playlistDeleteItems( Playlist *plst, json_t *jItems );
 int           playlistMoveItems( Playlist *plst, PlaylistSortType order, int pos, json_t *jItems );
 PlaylistItem *playlistShuffle( Playlist *plst, int startPos, int endPos, bool moveCursorToStart );
+PlaylistItem *playlistShuffleWithSeed( Playlist *plst, int startPos, int endPos, bool moveCursorToStart, unsigned int seed );
 bool          playlistTranspose( Playlist *plst, PlaylistItem *pItem1, PlaylistItem *pItem2 );
 
+PlaylistSnapshot *playlistGetSnapshot( Playlist *plst );
+void              playlistSnapshotRelease( PlaylistSnapshot *snapshot );
+json_int_t        playlistSnapshotGetVersion( PlaylistSnapshot *snapshot );
+double            playlistSnapshotGetLastChange( PlaylistSnapshot *snapshot );
+const char       *playlistSnapshotGetId( PlaylistSnapshot *snapshot );
+const char       *playlistSnapshotGetName( PlaylistSnapshot *snapshot );
+int               playlistSnapshotGetLength( PlaylistSnapshot *snapshot );
+int               playlistSnapshotGetCursorPos( PlaylistSnapshot *snapshot );
+PlaylistItem     *playlistSnapshotGetItem( PlaylistSnapshot *snapshot, PlaylistSortType order, int pos );
+PlaylistItem     *playlistSnapshotGetCursorItem( PlaylistSnapshot *snapshot );
+char             *playlistSnapshotGetJSONString( PlaylistSnapshot *snapshot, PlaylistSortType order, int offset, int count );
+
 const char       *playlistSortTypeToStr( PlaylistSortType order );
 PlaylistSortType  playlistSortTypeFromStr( const char *str );
 
@@ -139,12 +165,14 @@ const char       *playlistItemGetText( PlaylistItem *pItem );
 const char       *playlistItemGetId( PlaylistItem *pItem );
 PlaylistItemType  playlistItemGetType( PlaylistItem *pItem );
 json_t           *playlistItemGetJSON( PlaylistItem *pItem );
+char             *playlistItemGetJSONString( PlaylistItem *pItem );
 json_t           *playlistItemGetStreamingRefs( PlaylistItem *pItem );
 json_t           *playlistItemGetAttribute( PlaylistItem *pItem, const char *attribute );
 json_t           *playlistItemGetModelAttribute( PlaylistItem *pItem, const char *attribute );
 double            playlistItemGetDuration( PlaylistItem *pItem );
 const char       *playlistItemGetImageUri( PlaylistItem *pItem );
 int               playlistItemSetMetaData( PlaylistItem *pItem, json_t *metaObj, bool replace );
+int               playlistItemSetRawMeta( PlaylistItem *pItem, const char *key, json_t *jMeta );
 
 
 #endif  /* __PLAYLIST_H */
@@ -92,6 +92,23 @@ Remarks         : -
 #define DBGMEM( title, pointer, size  ) { ;}
 #endif
 
+#ifdef ICK_TRACE
+#define TraceNameSize  27
+#define TRACEBEGIN( name )         _traceEvent( 'B', (name), 0 )
+#define TRACEEND( name )           _traceEvent( 'E', (name), 0 )
+#define TRACEINSTANT( name )       _traceEvent( 'i', (name), 0 )
+#define TRACECOUNTER( name, val )  _traceEvent( 'C', (name), (long)(val) )
+#if defined __linux__ && !defined PTHREADSETNAME
+#include <sys/prctl.h>
+#define PTHREADSETNAME( name )  prctl( PR_SET_NAME, (name) )
+#endif
+#else
+#define TRACEBEGIN( name )         { ;}
+#define TRACEEND( name )           { ;}
+#define TRACEINSTANT( name )       { ;}
+#define TRACECOUNTER( name, val )  { ;}
+#endif
+
 #ifndef PTHREADSETNAME
 #define PTHREADSETNAME( name )  { ;}
 #endif
@@ -120,23 +137,34 @@ Remarks         : -
    Prototypes
 \*========================================================================*/
 double      srvtime( void );
+void        rndSeed( unsigned int seed );
 long        rndInteger( long min, long max );
 json_t     *json_mkstring( const char *str, ssize_t len );
 int         json_getinteger( const json_t *jObj, long *value );
 int         json_getreal( const json_t *jObj, double *value );
 int         json_object_merge( json_t *target, json_t *source );
+char       *json_dumps_member( const json_t *jObj, size_t flags, const char *key, const char *raw );
 const char *json_rpcerrstr( json_t *jError );
 long        getAndIncrementCounter( void );
 int         strcmpprefix( const char *str, const char *prefix );
 char       *strIso88591toUtf8( const char *str, ssize_t len );
 int         ickMutexInit( pthread_mutex_t *mutex );
+int         fsyncDir( const char *fileName );
 
 
+int    logStartAsync( void );
+void   logStopAsync( void );
 void   logSetStreamLevel( int prio );
 void   logSetSyslogLevel( int prio );
 int    logGetStreamLevel( void );
 int    logGetSyslogLevel( void );
 
+#ifdef ICK_TRACE
+void    _traceEvent( char phase, const char *name, long value );
+json_t *traceGetJSON( void );
+int     traceDumpFile( const char *fileName );
+#endif
+
 void   _mylog( const char *file, int line, int prio, const char *fmt, ... );
 void   _mydump( const char *file, int line, int prio, const char *title, const void *ptr, size_t size );
 void  *_smalloc( const char *file, int line, size_t s );
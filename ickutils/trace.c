@@ -0,0 +1,383 @@
+/*$*********************************************************************\
+
+Name            : -
+
+Source File     : trace.c
+
+Description     : per-thread event tracing (Chrome trace format)
+
+Comments        : -
+
+Called by       : - 
+
+Calls           : 
+
+Error Messages  : -
+  
+Date            : 18.10.2026
+
+Updates         : -
+                  
+Author          : -
+
+Remarks         : -
+
+*************************************************************************
+ * Copyright (c) 2026, ickStream GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright 
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright 
+ *     notice, this list of conditions and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of ickStream nor the names of its contributors 
+ *     may be used to endorse or promote products derived from this software 
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\************************************************************************/
+
+#ifdef ICK_TRACE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "ickutils.h"
+
+// Events per thread ring (power of 2), maximum number of rings and
+// size of the thread name table
+#define TraceRingSize    1024
+#define TraceMaxRings    32
+#define TraceMaxThreads  64
+
+
+/*=========================================================================*\
+	Global symbols
+\*=========================================================================*/
+// none
+
+
+/*=========================================================================*\
+	Private definitions
+\*=========================================================================*/
+typedef struct {
+  double          timestamp;
+  long            value;
+  pid_t           tid;
+  char            phase;          // 'B', 'E', 'C' or 'i'
+  char            name[TraceNameSize];
+} TraceRecord;
+
+// Flight recorder of a thread, overwrites oldest records.
+// Rings of terminated threads are reused by new threads.
+typedef struct _traceRing {
+  struct _traceRing *next;
+  volatile int       orphaned;
+  pid_t              tid;           // current owner
+  volatile unsigned long head;    // index of next record
+  TraceRecord        records[TraceRingSize];
+} TraceRing;
+
+typedef struct {
+  pid_t           tid;
+  char            name[TraceNameSize];
+} TraceThread;
+
+
+/*=========================================================================*\
+	Private symbols
+\*=========================================================================*/
+static pthread_key_t    traceRingKey;
+static pthread_once_t   traceRingKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t  traceMutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing       *traceRingList;
+static int              traceRingCount;
+static TraceThread      traceThreads[TraceMaxThreads];
+static int              traceThreadCount;
+static unsigned         traceThreadNext;
+
+
+/*=========================================================================*\
+	Private prototypes
+\*=========================================================================*/
+static TraceRing *_traceGetRing( void );
+static void       _traceCreateKey( void );
+static void       _traceReleaseRing( void *arg );
+static double     _traceLastTime( const TraceRing *ring );
+
+
+/*========================================================================*\
+   Record an event in the ring of the calling thread
+     Does not block (besides once per thread for registration)
+\*========================================================================*/
+void _traceEvent( char phase, const char *name, long value )
+{
+  TraceRing     *ring;
+  TraceRecord   *rec;
+  unsigned long  head;
+
+/*------------------------------------------------------------------------*\
+    Get ring of this thread
+\*------------------------------------------------------------------------*/
+  ring = _traceGetRing();
+  if( !ring )
+    return;
+
+/*------------------------------------------------------------------------*\
+    Fill in record, publish after all data is written
+\*------------------------------------------------------------------------*/
+  head           = ring->head;
+  rec            = &ring->records[ head%TraceRingSize ];
+  rec->timestamp = srvtime();
+  rec->value     = value;
+  rec->tid       = ring->tid;
+  rec->phase     = phase;
+  strncpy( rec->name, name?name:"", TraceNameSize-1 );
+  rec->name[TraceNameSize-1] = 0;
+  __sync_synchronize();
+  ring->head = head+1;
+}
+
+
+/*========================================================================*\
+   Get all recorded events in Chrome trace format (also read by Perfetto)
+     Can be called while threads are recording.
+     returns an object with "traceEvents" or NULL on error
+\*========================================================================*/
+json_t *traceGetJSON( void )
+{
+  json_t        *jEvents;
+  TraceRing     *ring;
+  TraceRecord   *buffer;
+  unsigned long  start, end, i;
+  int            pid = (int)getpid();
+  int            n;
+
+  DBGMSG( "traceGetJSON: %d rings.", traceRingCount );
+
+/*------------------------------------------------------------------------*\
+    Allocate copy buffer and result
+\*------------------------------------------------------------------------*/
+  buffer  = malloc( TraceRingSize*sizeof(TraceRecord) );
+  jEvents = json_array();
+  if( !buffer || !jEvents ) {
+    logerr( "traceGetJSON: out of memory!" );
+    Sfree( buffer );
+    if( jEvents )
+      json_decref( jEvents );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Thread names
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &traceMutex );
+  for( n=0; n<traceThreadCount; n++ )
+    json_array_append_new( jEvents, json_pack( "{ss ss si si s{ss}}",
+                             "name", "thread_name", "ph", "M",
+                             "pid",  pid, "tid", (int)traceThreads[n].tid,
+                             "args", "name", traceThreads[n].name ) );
+
+/*------------------------------------------------------------------------*\
+    Loop over all rings
+\*------------------------------------------------------------------------*/
+  for( ring=traceRingList; ring; ring=ring->next ) {
+
+    // Copy ring without locking
+    end   = ring->head;
+    start = end>TraceRingSize ? end-TraceRingSize : 0;
+    __sync_synchronize();
+    for( i=start; i<end; i++ )
+      buffer[i%TraceRingSize] = ring->records[i%TraceRingSize];
+    __sync_synchronize();
+
+    // Skip records that might have been overwritten meanwhile
+    if( ring->head>=start+TraceRingSize )
+      start = ring->head-TraceRingSize+1;
+
+    // Convert records
+    for( i=start; i<end; i++ ) {
+      TraceRecord *rec = &buffer[ i%TraceRingSize ];
+      json_t      *jEvent;
+      jEvent = json_pack( "{ss ss# sf si si}",
+                          "name", rec->name,
+                          "ph",   &rec->phase, (int)1,
+                          "ts",   rec->timestamp*1E6,
+                          "pid",  pid, "tid", (int)rec->tid );
+      if( !jEvent )
+        continue;
+      if( rec->phase=='C' )
+        json_object_set_new( jEvent, "args", json_pack("{sI}","value",(json_int_t)rec->value) );
+      else if( rec->phase=='i' )
+        json_object_set_new( jEvent, "s", json_string("t") );
+      json_array_append_new( jEvents, jEvent );
+    }
+  }
+  pthread_mutex_unlock( &traceMutex );
+  Sfree( buffer );
+
+/*------------------------------------------------------------------------*\
+    Return result
+\*------------------------------------------------------------------------*/
+  return json_pack( "{so ss}", "traceEvents", jEvents, "displayTimeUnit", "ms" );
+}
+
+
+/*========================================================================*\
+   Write all recorded events in Chrome trace format to a file
+     returns 0 on success, -1 on error
+\*========================================================================*/
+int traceDumpFile( const char *fileName )
+{
+  json_t *jTrace;
+  int     rc;
+
+/*------------------------------------------------------------------------*\
+    Get trace and write it
+\*------------------------------------------------------------------------*/
+  jTrace = traceGetJSON();
+  if( !jTrace )
+    return -1;
+  rc = json_dump_file( jTrace, fileName, JSON_COMPACT );
+  json_decref( jTrace );
+  if( rc ) {
+    logerr( "traceDumpFile: Could not write to \"%s\".", fileName );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    That's it
+\*------------------------------------------------------------------------*/
+  loginfo( "traceDumpFile: Trace written to \"%s\".", fileName );
+  return 0;
+}
+
+
+/*========================================================================*\
+   Get ring of calling thread, register or reuse one if necessary
+     returns NULL on error or if all rings are in use
+\*========================================================================*/
+static TraceRing *_traceGetRing( void )
+{
+  TraceRing *ring;
+
+/*------------------------------------------------------------------------*\
+    Already registered?
+\*------------------------------------------------------------------------*/
+  pthread_once( &traceRingKeyOnce, _traceCreateKey );
+  ring = pthread_getspecific( traceRingKey );
+  if( ring )
+    return ring;
+
+/*------------------------------------------------------------------------*\
+    Create a new ring or reuse the ring of a terminated thread with the
+    oldest records (to keep as much history as possible)
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &traceMutex );
+  ring = NULL;
+  if( traceRingCount<TraceMaxRings ) {
+    ring = calloc( 1, sizeof(TraceRing) );
+    if( ring ) {
+      ring->next    = traceRingList;
+      traceRingList = ring;
+      traceRingCount++;
+    }
+  }
+  else {
+    TraceRing *walk;
+    for( walk=traceRingList; walk; walk=walk->next ) {
+      if( !walk->orphaned )
+        continue;
+      if( !ring || _traceLastTime(walk)<_traceLastTime(ring) )
+        ring = walk;
+    }
+    if( ring )
+      ring->orphaned = 0;
+  }
+  if( !ring ) {
+    pthread_mutex_unlock( &traceMutex );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Register thread name (records keep the thread id)
+\*------------------------------------------------------------------------*/
+  ring->tid = (pid_t)syscall( SYS_gettid );
+  {
+    TraceThread *thread = &traceThreads[ traceThreadNext++%TraceMaxThreads ];
+    thread->tid  = ring->tid;
+    strcpy( thread->name, "ickpd" );
+#ifdef __linux__
+    prctl( PR_GET_NAME, thread->name );  // at most 16 bytes
+#endif
+    if( traceThreadCount<TraceMaxThreads )
+      traceThreadCount++;
+  }
+  pthread_mutex_unlock( &traceMutex );
+
+/*------------------------------------------------------------------------*\
+    Assign to this thread
+\*------------------------------------------------------------------------*/
+  pthread_setspecific( traceRingKey, ring );
+  return ring;
+}
+
+
+/*========================================================================*\
+   Create key for thread specific rings
+\*========================================================================*/
+static void _traceCreateKey( void )
+{
+  pthread_key_create( &traceRingKey, _traceReleaseRing );
+}
+
+
+/*========================================================================*\
+   Thread termination: ring might be reused (old records are kept)
+\*========================================================================*/
+static void _traceReleaseRing( void *arg )
+{
+  TraceRing *ring = arg;
+
+  pthread_mutex_lock( &traceMutex );
+  ring->orphaned = 1;
+  pthread_mutex_unlock( &traceMutex );
+}
+
+
+/*========================================================================*\
+   Get timestamp of last record in a ring (0 if empty)
+\*========================================================================*/
+static double _traceLastTime( const TraceRing *ring )
+{
+  if( !ring->head )
+    return 0;
+  return ring->records[ (ring->head-1)%TraceRingSize ].timestamp;
+}
+
+#endif  /* ICK_TRACE */
+
+
+/*=========================================================================*\
+                                    END OF FILE
+\*=========================================================================*/
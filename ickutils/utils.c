@@ -56,12 +56,46 @@ Remarks         : -
 #include <stdlib.h>
 #include <stdarg.h>
 #include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
 #include <sys/time.h>
 
 #include "ickutils.h"
 
 #define DUMPCOLS 16
 
+// Asynchronous logging: per-thread ring of records (power of 2),
+// maximum length of a message and writer interval (seconds)
+#define LogRingSize      64
+#define LogMessageSize   1024
+#define LogFlushInterval 0.05
+
+
+/*=========================================================================*\
+	Private definitions
+\*=========================================================================*/
+typedef struct {
+  unsigned long   seqNo;          // global order of records
+  double          timestamp;
+  const char     *file;
+  int             line;
+  int             prio;
+  char            msg[LogMessageSize];
+} LogRecord;
+
+// Single producer (owner thread), single consumer (writer thread)
+typedef struct _logRing {
+  struct _logRing *next;
+  pthread_t        thread;
+  volatile unsigned long head;    // next record to write (producer)
+  volatile unsigned long tail;    // next record to read (consumer)
+  volatile unsigned long dropped; // records lost due to overflow
+  volatile int     orphaned;      // owner thread has terminated
+  LogRecord        records[LogRingSize];
+} LogRing;
+
 
 /*=========================================================================*\
 	Global symbols
@@ -75,6 +109,29 @@ static int              streamloglevel = LOG_NOTICE;
 static int              sysloglevel = LOG_ALERT;
 static pthread_mutex_t  loggerMutex  = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t  counterMutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int     rndSeedValue = 0;
+
+static volatile int     logAsync;
+static volatile int     logWriterStop;
+static pthread_t        logWriterThread;
+static pthread_mutex_t  logWriterMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   logWriterCond  = PTHREAD_COND_INITIALIZER;
+static pthread_key_t    logRingKey;
+static pthread_once_t   logRingKeyOnce = PTHREAD_ONCE_INIT;
+static LogRing * volatile logRingList;
+static unsigned long    logSeqNo;
+
+
+/*=========================================================================*\
+	Private prototypes
+\*=========================================================================*/
+static int      _logEnqueue( const char *file, int line, int prio, const char *fmt, va_list a_list );
+static LogRing *_logGetRing( void );
+static void     _logCreateKey( void );
+static void     _logReleaseRing( void *arg );
+static void    *_logWriter( void *arg );
+static int      _logFlush( void );
+static void     _logOutput( const LogRing *ring, const LogRecord *rec );
 
 
 void logSetStreamLevel( int prio )
@@ -103,12 +160,30 @@ int    logGetSyslogLevel( void )
 \*========================================================================*/
 void _mylog( const char *file, int line,  int prio, const char *fmt, ... )
 {
+  va_list a_list;
+
+/*------------------------------------------------------------------------*\
+    Nothing to do? (no locks taken so far)
+\*------------------------------------------------------------------------*/
+  if( prio>streamloglevel && (prio>sysloglevel || prio>=LOG_DEBUG) )
+    return;
+
+/*------------------------------------------------------------------------*\
+    Asynchronous mode: queue to ring of calling thread
+\*------------------------------------------------------------------------*/
+  if( logAsync ) {
+    int rc;
+    va_start( a_list, fmt );
+    rc = _logEnqueue( file, line, prio, fmt, a_list );
+    va_end( a_list );
+    if( !rc )
+      return;
+  }
 
 /*------------------------------------------------------------------------*\
     Init arguments, lock mutex
 \*------------------------------------------------------------------------*/
   pthread_mutex_lock( &loggerMutex );
-  va_list a_list;
   va_start( a_list, fmt );
   
 /*------------------------------------------------------------------------*\
@@ -151,6 +226,346 @@ void _mylog( const char *file, int line,  int prio, const char *fmt, ... )
 }
 
 
+/*========================================================================*\
+   Switch to asynchronous logging
+     Messages are formatted by the calling thread into a lock free ring
+     buffer, the prefix, stream and syslog output are done by a writer
+     thread. A thread never blocks on logging, messages are dropped (and
+     counted) if its ring overflows.
+     Must be called after fork() (daemon mode)
+     returns 0 on success, -1 on error
+\*========================================================================*/
+int logStartAsync( void )
+{
+  int rc;
+
+/*------------------------------------------------------------------------*\
+    Already running?
+\*------------------------------------------------------------------------*/
+  if( logAsync )
+    return 0;
+
+/*------------------------------------------------------------------------*\
+    Create writer thread
+\*------------------------------------------------------------------------*/
+  pthread_once( &logRingKeyOnce, _logCreateKey );
+  logWriterStop = 0;
+  rc = pthread_create( &logWriterThread, NULL, _logWriter, NULL );
+  if( rc ) {
+    logerr( "logStartAsync: Unable to start writer thread (%s).", strerror(rc) );
+    return -1;
+  }
+
+/*------------------------------------------------------------------------*\
+    Switch mode
+\*------------------------------------------------------------------------*/
+  __sync_synchronize();
+  logAsync = 1;
+  return 0;
+}
+
+
+/*========================================================================*\
+   Switch back to synchronous logging
+     All queued messages are written before this function returns.
+     Should be called when all other threads have terminated.
+\*========================================================================*/
+void logStopAsync( void )
+{
+
+/*------------------------------------------------------------------------*\
+    Not running?
+\*------------------------------------------------------------------------*/
+  if( !logAsync )
+    return;
+
+/*------------------------------------------------------------------------*\
+    Switch mode and stop writer thread (it does a final flush)
+\*------------------------------------------------------------------------*/
+  logAsync = 0;
+  __sync_synchronize();
+  pthread_mutex_lock( &logWriterMutex );
+  logWriterStop = 1;
+  pthread_cond_signal( &logWriterCond );
+  pthread_mutex_unlock( &logWriterMutex );
+  pthread_join( logWriterThread, NULL );
+}
+
+
+/*========================================================================*\
+   Format a message into the ring of the calling thread
+     Does not lock or block.
+     returns 0 on success, -1 if no ring is available (use synchronous mode)
+\*========================================================================*/
+static int _logEnqueue( const char *file, int line, int prio, const char *fmt, va_list a_list )
+{
+  LogRing       *ring;
+  LogRecord     *rec;
+  unsigned long  head;
+
+/*------------------------------------------------------------------------*\
+    Get ring of this thread
+\*------------------------------------------------------------------------*/
+  ring = _logGetRing();
+  if( !ring )
+    return -1;
+
+/*------------------------------------------------------------------------*\
+    Ring full? Drop message.
+\*------------------------------------------------------------------------*/
+  head = ring->head;
+  if( head-ring->tail>=LogRingSize ) {
+    __sync_add_and_fetch( &ring->dropped, 1 );
+    return 0;
+  }
+
+/*------------------------------------------------------------------------*\
+    Fill in record
+\*------------------------------------------------------------------------*/
+  rec            = &ring->records[ head%LogRingSize ];
+  rec->seqNo     = __sync_add_and_fetch( &logSeqNo, 1 );
+  rec->timestamp = srvtime();
+  rec->file      = file;
+  rec->line      = line;
+  rec->prio      = prio;
+  if( vsnprintf(rec->msg,LogMessageSize,fmt,a_list)>=LogMessageSize )
+    strcpy( rec->msg+LogMessageSize-4, "..." );
+
+/*------------------------------------------------------------------------*\
+    Publish record, wake up writer for important messages or filled ring
+\*------------------------------------------------------------------------*/
+  __sync_synchronize();
+  ring->head = head+1;
+  if( prio<=LOG_WARNING || head+1-ring->tail>=LogRingSize/2 )
+    pthread_cond_signal( &logWriterCond );
+
+/*------------------------------------------------------------------------*\
+    That's it
+\*------------------------------------------------------------------------*/
+  return 0;
+}
+
+
+/*========================================================================*\
+   Get ring of calling thread, create and register if necessary
+     returns NULL on error
+\*========================================================================*/
+static LogRing *_logGetRing( void )
+{
+  LogRing *ring;
+
+/*------------------------------------------------------------------------*\
+    Already allocated?
+\*------------------------------------------------------------------------*/
+  ring = pthread_getspecific( logRingKey );
+  if( ring )
+    return ring;
+
+/*------------------------------------------------------------------------*\
+    Create new ring
+\*------------------------------------------------------------------------*/
+  ring = calloc( 1, sizeof(LogRing) );
+  if( !ring )
+    return NULL;
+  ring->thread = pthread_self();
+  if( pthread_setspecific(logRingKey,ring) ) {
+    Sfree( ring );
+    return NULL;
+  }
+
+/*------------------------------------------------------------------------*\
+    Push to global list (lock free, the writer only removes elements)
+\*------------------------------------------------------------------------*/
+  do
+    ring->next = logRingList;
+  while( !__sync_bool_compare_and_swap(&logRingList,ring->next,ring) );
+
+/*------------------------------------------------------------------------*\
+    That's it
+\*------------------------------------------------------------------------*/
+  return ring;
+}
+
+
+/*========================================================================*\
+   Create key for thread specific rings
+\*========================================================================*/
+static void _logCreateKey( void )
+{
+  pthread_key_create( &logRingKey, _logReleaseRing );
+}
+
+
+/*========================================================================*\
+   Thread termination: mark ring to be freed by writer after flushing
+\*========================================================================*/
+static void _logReleaseRing( void *arg )
+{
+  LogRing *ring = arg;
+
+  __sync_synchronize();
+  ring->orphaned = 1;
+}
+
+
+/*========================================================================*\
+   Writer thread
+\*========================================================================*/
+static void *_logWriter( void *arg )
+{
+  struct timeval  now;
+  struct timespec abstime;
+
+  PTHREADSETNAME( "logWriter" );
+
+/*------------------------------------------------------------------------*\
+    Loop till stopped
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &logWriterMutex );
+  while( !logWriterStop ) {
+
+    // Sleep for the flush interval (or till woken up)
+    gettimeofday( &now, NULL );
+    abstime.tv_sec  = now.tv_sec;
+    abstime.tv_nsec = now.tv_usec*1000 + (long)(LogFlushInterval*1E9);
+    if( abstime.tv_nsec>=1000000000 ) {
+      abstime.tv_sec++;
+      abstime.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait( &logWriterCond, &logWriterMutex, &abstime );
+
+    // Write all pending messages
+    pthread_mutex_unlock( &logWriterMutex );
+    _logFlush();
+    pthread_mutex_lock( &logWriterMutex );
+  }
+  pthread_mutex_unlock( &logWriterMutex );
+
+/*------------------------------------------------------------------------*\
+    Final flush
+\*------------------------------------------------------------------------*/
+  while( _logFlush() )
+    ;
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return NULL;
+}
+
+
+/*========================================================================*\
+   Write all pending records of all rings in global order
+     Also reports dropped messages and frees rings of terminated threads
+     Only called by the writer thread.
+     returns number of records written
+\*========================================================================*/
+static int _logFlush( void )
+{
+  LogRing   *ring, *next, **prevPtr;
+  LogRing   *oldest;
+  LogRecord *rec;
+  int        count = 0;
+
+/*------------------------------------------------------------------------*\
+    Merge rings by sequence number: pick the oldest head record each time
+\*------------------------------------------------------------------------*/
+  pthread_mutex_lock( &loggerMutex );
+  for( ;; ) {
+    oldest = NULL;
+    for( ring=logRingList; ring; ring=ring->next ) {
+      if( ring->tail==ring->head )
+        continue;
+      __sync_synchronize();
+      if( !oldest || ring->records[ring->tail%LogRingSize].seqNo <
+                     oldest->records[oldest->tail%LogRingSize].seqNo )
+        oldest = ring;
+    }
+    if( !oldest )
+      break;
+
+    // Write and release record
+    rec = &oldest->records[ oldest->tail%LogRingSize ];
+    _logOutput( oldest, rec );
+    __sync_synchronize();
+    oldest->tail++;
+    count++;
+  }
+
+/*------------------------------------------------------------------------*\
+    Report overflows
+\*------------------------------------------------------------------------*/
+  for( ring=logRingList; ring; ring=ring->next ) {
+    unsigned long dropped = ring->dropped;
+    if( !dropped )
+      continue;
+    __sync_sub_and_fetch( &ring->dropped, dropped );
+    if( LOG_WARNING<=streamloglevel )
+      fprintf( stderr, "%.4f %d [%p]: %lu log messages dropped\n",
+               srvtime(), LOG_WARNING, (void*)ring->thread, dropped );
+    if( LOG_WARNING<=sysloglevel )
+      syslog( LOG_WARNING, "%lu log messages dropped", dropped );
+  }
+  fflush( stderr );
+  pthread_mutex_unlock( &loggerMutex );
+
+/*------------------------------------------------------------------------*\
+    Free drained rings of terminated threads. New rings are only pushed
+    in front, so the head pointer is swapped atomically
+\*------------------------------------------------------------------------*/
+  prevPtr = (LogRing **)&logRingList;
+  for( ring=logRingList; ring; ring=next ) {
+    next = ring->next;
+    if( !ring->orphaned || ring->tail!=ring->head || ring->dropped ) {
+      prevPtr = &ring->next;
+      continue;
+    }
+    if( prevPtr==&logRingList &&
+        !__sync_bool_compare_and_swap(&logRingList,ring,next) ) {
+      // New rings were pushed meanwhile: find predecessor
+      for( prevPtr=(LogRing **)&logRingList; *prevPtr!=ring; prevPtr=&(*prevPtr)->next )
+        ;
+      *prevPtr = next;
+    }
+    else if( prevPtr!=&logRingList )
+      *prevPtr = next;
+    Sfree( ring );
+  }
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return count;
+}
+
+
+/*========================================================================*\
+   Output a queued record to stream and syslog
+     Caller needs to lock loggerMutex.
+\*========================================================================*/
+static void _logOutput( const LogRing *ring, const LogRecord *rec )
+{
+
+/*------------------------------------------------------------------------*\
+   Log to stream (flushed by caller)
+\*------------------------------------------------------------------------*/
+  if( rec->prio<=streamloglevel ) {
+    if( rec->file )
+      fprintf( stderr, "%.4f %d [%p] %s,%d: %s\n", rec->timestamp, rec->prio,
+               (void*)ring->thread, rec->file, rec->line, rec->msg );
+    else
+      fprintf( stderr, "%.4f %d [%p]: %s\n", rec->timestamp, rec->prio,
+               (void*)ring->thread, rec->msg );
+  }
+
+/*------------------------------------------------------------------------*\
+    use syslog facility, hide debugging messages from syslog
+\*------------------------------------------------------------------------*/
+  if( rec->prio<=sysloglevel && rec->prio<LOG_DEBUG )
+    syslog( rec->prio, "%s", rec->msg );
+}
+
+
 /*========================================================================*\
    Dump memory area (stream only)
 \*========================================================================*/
@@ -224,19 +639,33 @@ void _mydump( const char *file, int line, int prio, const char *title, const voi
 }
 
 
+/*========================================================================*\
+   Seed the random number generator
+     Using a fixed seed makes all following random sequences (e.g. the
+     shuffle order of the player queue) reproducible.
+     A seed of 0 selects a seed derived from the current time.
+\*========================================================================*/
+void rndSeed( unsigned int seed )
+{
+  if( !seed )
+    seed = (unsigned int) srvtime();
+  if( !seed )
+    seed = 1;
+
+  DBGMSG( "rndSeed = %u", seed );
+  rndSeedValue = seed;
+  srandom( seed );
+}
+
+
 /*========================================================================*\
    Draw a random nuber from range [min, max] (both included)
 \*========================================================================*/
 long rndInteger( long min, long max )
 {
-  static unsigned int seed = 0;
-
   // Init with seed?
-  if( !seed ) {
-    seed = (unsigned int) srvtime();
-    DBGMSG( "rndSeed = %u", seed );
-    srandom( seed );
-  }
+  if( !rndSeedValue )
+    rndSeed( 0 );
 
   // Use simple random facility
   long rnd = random();
@@ -433,6 +862,52 @@ int json_object_merge( json_t *target, json_t *source )
 }
 
 
+/*========================================================================*\
+   Serialize a JSON object with an additional, already serialized member
+     key is not escaped, raw is inserted verbatim (must be valid JSON)
+     This allows to splice in cached fragments without parsing them.
+     return allocated string or NULL on error
+\*========================================================================*/
+char *json_dumps_member( const json_t *jObj, size_t flags, const char *key, const char *raw )
+{
+  char   *str, *result;
+  size_t  len, extra;
+
+/*------------------------------------------------------------------------*\
+    Serialize object and find closing brace
+\*------------------------------------------------------------------------*/
+  if( !json_is_object(jObj) )
+    return NULL;
+  str = json_dumps( jObj, flags );
+  if( !str )
+    return NULL;
+  len = strlen( str );
+  while( len && str[len-1]!='}' )
+    len--;
+  if( !len ) {
+    free( str );
+    return NULL;
+  }
+  len--;
+
+/*------------------------------------------------------------------------*\
+    Append member
+\*------------------------------------------------------------------------*/
+  extra  = strlen(key) + strlen(raw) + 6;
+  result = realloc( str, len+extra );
+  if( !result ) {
+    free( str );
+    return NULL;
+  }
+  sprintf( result+len, "%s\"%s\":%s}", json_object_size(jObj)?",":"", key, raw );
+
+/*------------------------------------------------------------------------*\
+    That's all
+\*------------------------------------------------------------------------*/
+  return result;
+}
+
+
 /*========================================================================*\
    Get a string description for an JSON-RPC error object
      This is a not reentrant function for debugging only.
@@ -542,6 +1017,34 @@ int ickMutexInit( pthread_mutex_t *mutex )
 }
 
 
+/*========================================================================*\
+   Sync directory containing a file (makes a rename durable)
+     return 0 on success, -1 on error
+\*========================================================================*/
+int fsyncDir( const char *fileName )
+{
+  char *path = strdup( fileName );
+  int   fd, rc = 0;
+
+  if( !path ) {
+    logerr( "fsyncDir: out of memory!" );
+    return -1;
+  }
+
+  fd = open( dirname(path), O_RDONLY );
+  if( fd<0 || fsync(fd) ) {
+    logwarn( "fsyncDir: could not sync directory of \"%s\": %s",
+             fileName, strerror(errno) );
+    rc = -1;
+  }
+  if( fd>=0 )
+    close( fd );
+
+  Sfree( path );
+  return rc;
+}
+
+
 /*========================================================================*\
    Log memory usage (by this code only)
 \*========================================================================*/